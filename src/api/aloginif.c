@@ -345,6 +345,28 @@ static void aloginif_send_to_server(int fd, struct api_session_data *sd, int msg
 	WFIFOSET(aloginif->fd, len);
 }
 
+/**
+ * Sends a request to a specific char server, instead of the one of the session world.
+ */
+static void aloginif_send_to_char_server(int fd, struct api_session_data *sd, int char_server_id, int msg_id, void *data, size_t data_len)
+{
+	nullpo_retv(sd);
+	Assert_retv(aloginif->fd != -1);
+
+	const int len = (int)sizeof(struct PACKET_API_PROXY) + (int)data_len;
+	WFIFOHEAD(aloginif->fd, len);
+	struct PACKET_API_PROXY *p = WFIFOP(aloginif->fd, 0);
+	p->packet_id = HEADER_API_PROXY_REQUEST;
+	p->packet_len = len;
+	INIT_PACKET_PROXY_FIELDS(p, sd, proxy_flag_login);
+	p->char_server_id = char_server_id;
+	p->flags = proxy_flag_char;
+	if (data && data_len > 0)
+		memcpy(((struct PACKET_API_PROXY0*)p)->data, data, data_len);
+
+	WFIFOSET(aloginif->fd, len);
+}
+
 static void aloginif_send_split_to_server(int fd, struct api_session_data *sd, int msg_id, char *data, size_t data_len, int proxy_flag)
 {
 	nullpo_retv(sd);
@@ -461,6 +483,7 @@ void aloginif_defaults(void)
 	aloginif->on_ready = aloginif_on_ready;
 	aloginif->send_to_server = aloginif_send_to_server;
 	aloginif->send_split_to_server = aloginif_send_split_to_server;
+	aloginif->send_to_char_server = aloginif_send_to_char_server;
 
 	aloginif->parse = aloginif_parse;
 	aloginif->parse_connection_state = aloginif_parse_connection_state;
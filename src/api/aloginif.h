@@ -82,6 +82,7 @@ struct aloginif_interface {
 	void (*on_ready) (void);
 	void (*send_to_server) (int fd, struct api_session_data *sd, int msg_id, void *data, size_t data_len, int proxy_flag);
 	void (*send_split_to_server) (int fd, struct api_session_data *sd, int msg_id, char *data, size_t data_len, int proxy_flag);
+	void (*send_to_char_server) (int fd, struct api_session_data *sd, int char_server_id, int msg_id, void *data, size_t data_len);
 
 	int (*parse) (int fd);
 	int (*parse_connection_state) (int fd);
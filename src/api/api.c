@@ -70,6 +70,7 @@ int do_final(void)
 	HPM->event(HPET_FINAL);
 
 	aclif->final();
+	handlers->final();
 	httpparser->final();
 
 	HPM_api_do_final();
@@ -229,6 +230,7 @@ static bool api_config_read_console(const char *filename, struct config_t *confi
 	}
 	libconfig->setting_lookup_mutable_string(setting, "timestamp_format", showmsg->timestamp_format, sizeof(showmsg->timestamp_format));
 	libconfig->setting_lookup_int(setting, "console_msg_log", &showmsg->console_log);
+	libconfig->setting_lookup_int(setting, "watchdog_threshold", &core->watchdog_threshold);
 
 	return true;
 }
@@ -358,6 +360,8 @@ static bool api_config_read(const char *filename, bool imported)
 
 	libconfig->setting_lookup_int(setting, "remove_disconnected_delay", &aclif->remove_disconnected_delay);
 	libconfig->setting_lookup_int(setting, "ip_connections_limit", &api->ip_connections_limit);
+	libconfig->setting_lookup_int(setting, "emblem_cache_size", &api->emblem_cache_size);
+	libconfig->setting_lookup_int(setting, "metrics_timeout", &api->metrics_timeout);
 
 	if (!api_config_read_console(filename, &config, imported))
 		retval = false;
@@ -468,6 +472,8 @@ void api_defaults(void)
 	sprintf(api->server_db,"ragnarok");
 	api->mysql_handle = NULL;
 	api->ip_connections_limit = 5;
+	api->emblem_cache_size = 1000;
+	api->metrics_timeout = 1000;
 
 	api->port = 7121;
 	api->ip_set = 0;
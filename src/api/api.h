@@ -69,6 +69,8 @@ struct api_interface {
 	uint16 port;
 
 	int ip_connections_limit;
+	int emblem_cache_size;
+	int metrics_timeout;
 
 	int (*setipport) (unsigned short map_index, uint32 ip, uint16 port);
 	bool (*config_read) (const char *filename, bool imported);
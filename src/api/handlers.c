@@ -25,12 +25,15 @@
 
 #include "common/cbasetypes.h"
 #include "common/api.h"
+#include "common/core.h"
 //#include "common/chunked.h"
 #include "common/memmgr.h"
+#include "common/metrics.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/socket.h"
 #include "common/strlib.h"
+#include "common/timer.h"
 #include "common/utils.h"
 #include "api/aclif.h"
 #include "api/apipackets.h"
@@ -314,8 +317,12 @@ HTTP_DATA(emblem_upload)
 
 	GET_HTTP_DATA(p, emblem_upload);
 
-	if (p->result == 1)
+	if (p->result == 1) {
+		const struct emblem_request *request = sd->custom;
+		if (request != NULL)
+			handlers->emblem_cache_invalidate(request->guild_id);
 		httpsender->send_json_text(fd, "{\"Type\":1}", HTTP_STATUS_OK);
+	}
 	else // Not sure if intentional, but kRO sends status 500
 		httpsender->send_json_text(fd, "{\"Type\":4}", HTTP_STATUS_INTERNAL_SERVER_ERROR);
 
@@ -363,6 +370,13 @@ HTTP_URL(emblem_upload)
 	CREATE_HTTP_DATA(data, emblem_upload_guild_id);
 	data.guild_id = RET_INT_HEADER(GUILD_ID, 0);
 	data.is_gif = is_gif;
+
+	struct emblem_request *request;
+	CREATE(request, struct emblem_request, 1);
+	request->guild_id = data.guild_id;
+	aFree(sd->custom);
+	sd->custom = request;
+
 	SEND_CHAR_ASYNC_DATA(emblem_upload_guild_id, &data);
 	SEND_CHAR_ASYNC_DATA_SPLIT(emblem_upload, img, img_size);
 
@@ -395,7 +409,14 @@ HTTP_DATA(emblem_download)
 	}
 
 	RFIFO_CHUNKED_COMPLETE(p) {
-		httpsender->send_binary(fd, sd->data.data, sd->data.data_size);
+		const struct emblem_request *request = sd->custom;
+		const struct emblem_cache_entry *entry = NULL;
+		if (request != NULL && sd->data.data_size > 0)
+			entry = handlers->emblem_cache_put(request->guild_id, request->version, sd->data.data, sd->data.data_size);
+		if (entry != NULL)
+			handlers->emblem_send(fd, sd, entry);
+		else
+			httpsender->send_binary(fd, sd->data.data, sd->data.data_size);
 		aclif->terminate_connection(fd);
 	}
 }
@@ -413,6 +434,20 @@ HTTP_URL(emblem_download)
 	data.guild_id = RET_INT_HEADER(GUILD_ID, 0);
 	data.version = RET_INT_HEADER(VERSION, 0);
 
+	const struct emblem_cache_entry *entry = handlers->emblem_cache_get(data.guild_id, data.version);
+	if (entry != NULL) {
+		handlers->emblem_send(fd, sd, entry);
+		aclif->terminate_connection(fd);
+		return true;
+	}
+
+	struct emblem_request *request;
+	CREATE(request, struct emblem_request, 1);
+	request->guild_id = data.guild_id;
+	request->version = data.version;
+	aFree(sd->custom);
+	sd->custom = request;
+
 	SEND_CHAR_ASYNC_DATA(emblem_download, &data);
 
 	return true;
@@ -643,13 +678,383 @@ HTTP_URL(test_url)
 	return true;
 }
 
+HTTP_DATA(metrics)
+{
+	struct metrics_request *request = sd->custom;
+	if (request == NULL || request->sent)
+		return;
+
+	GET_HTTP_DATA(p, metrics);
+	if (data_size < sizeof(*p) || data_size < sizeof(*p) + p->count * sizeof(struct metrics_sample)) {
+		ShowError("Wrong metrics reply size %d: %lu\n", fd, data_size);
+		return;
+	}
+
+	handlers->metrics_add(sd, p->server_type, p->world_name, p->samples, p->count);
+	if (p->last == 0)
+		return;
+
+	request = sd->custom;
+	request->pending += p->servers - 1;
+	if (request->pending <= 0)
+		handlers->metrics_send(fd, sd);
+}
+
+HTTP_URL(metrics)
+{
+#ifdef DEBUG_LOG
+	ShowInfo("metrics called %d: %s\n", fd, httpparser->get_method_str(sd));
+#endif
+#ifdef REQUEST_LOG
+	aclif->show_request(fd, sd, false);
+#endif
+	struct metrics_request *request;
+	CREATE(request, struct metrics_request, 1);
+	request->timer = INVALID_TIMER;
+	aFree(sd->custom);
+	sd->custom = request;
+
+	metrics->collect();
+	handlers->metrics_add(sd, SERVER_TYPE_API, "", VECTOR_DATA(metrics->samples), VECTOR_LENGTH(metrics->samples));
+	metrics->clear();
+	request = sd->custom;
+
+	if (sockt->session_is_active(aloginif->fd)) {
+		CREATE_HTTP_DATA(data, metrics);
+		SEND_LOGIN_ASYNC_DATA(metrics, &data);
+		request->pending++;
+
+		struct DBIterator *iter = db_iterator(aclif->char_servers_db);
+		for (struct char_server_data *server = dbi_first(iter); dbi_exists(iter); server = dbi_next(iter)) {
+			safestrncpy(data.world_name, server->world_name, sizeof(data.world_name));
+			aloginif->send_to_char_server(fd, sd, server->id, API_MSG_metrics, &data, sizeof(struct PACKET_API_metrics));
+			request->pending++;
+		}
+		dbi_destroy(iter);
+	}
+
+	if (request->pending == 0)
+		handlers->metrics_send(fd, sd);
+	else
+		request->timer = timer->add(timer->gettick() + api->metrics_timeout, handlers->metrics_timeout, fd, (intptr_t)sd->id);
+
+	return true;
+}
+
+/**
+ * Appends samples received from a server to the metrics request of session.
+ *
+ * @param sd session data
+ * @param server_type enum server_types of the server
+ * @param world_name world of the server, empty for login and api servers
+ * @param samples received samples
+ * @param count number of samples
+ */
+static void handlers_metrics_add(struct api_session_data *sd, int server_type, const char *world_name, const struct metrics_sample *samples, int count)
+{
+	nullpo_retv(sd);
+	nullpo_retv(world_name);
+
+	struct metrics_request *request = sd->custom;
+	nullpo_retv(request);
+	if (count <= 0)
+		return;
+	nullpo_retv(samples);
+
+	request = aRealloc(request, sizeof(*request) + (request->count + count) * sizeof(struct metrics_entry));
+	sd->custom = request;
+	for (int i = 0; i < count; i++) {
+		struct metrics_entry *entry = &request->entries[request->count++];
+		entry->server_type = (uint8)server_type;
+		safestrncpy(entry->world_name, world_name, sizeof(entry->world_name));
+		entry->sample = samples[i];
+		entry->sample.label[sizeof(entry->sample.label) - 1] = '\0';
+	}
+}
+
+/**
+ * Appends a label to metrics sample line, escaping its value.
+ */
+static void handlers_metrics_append_label(StringBuf *buf, const char *name, const char *value)
+{
+	StrBuf->Printf(buf, ",%s=\"", name);
+	for (const char *c = value; *c != '\0'; c++) {
+		if (*c == '\\' || *c == '"')
+			StrBuf->Printf(buf, "\\%c", *c);
+		else if (*c == '\n')
+			StrBuf->AppendStr(buf, "\\n");
+		else
+			StrBuf->Printf(buf, "%c", *c);
+	}
+	StrBuf->AppendStr(buf, "\"");
+}
+
+/**
+ * Writes collected metrics in Prometheus text format, grouped by metric.
+ *
+ * @param buf output buffer
+ * @param request metrics request
+ */
+static void handlers_metrics_format(StringBuf *buf, const struct metrics_request *request)
+{
+	nullpo_retv(buf);
+	nullpo_retv(request);
+
+	for (int id = 0; id < METRIC_MAX; id++) {
+		const struct metrics_definition *def = metrics->definition(id);
+		bool found = false;
+
+		for (int i = 0; i < request->count; i++) {
+			const struct metrics_entry *entry = &request->entries[i];
+			if (entry->sample.id != id)
+				continue;
+
+			if (!found && def->help != NULL) {
+				StrBuf->Printf(buf, "# HELP %s %s\n", def->family, def->help);
+				StrBuf->Printf(buf, "# TYPE %s %s\n", def->family, def->type);
+			}
+			found = true;
+
+			const char *server = "unknown";
+			switch (entry->server_type) {
+				case SERVER_TYPE_LOGIN: server = "login"; break;
+				case SERVER_TYPE_CHAR: server = "char"; break;
+				case SERVER_TYPE_MAP: server = "map"; break;
+				case SERVER_TYPE_API: server = "api"; break;
+			}
+			StrBuf->Printf(buf, "%s{server=\"%s\"", def->name, server);
+			if (entry->world_name[0] != '\0')
+				handlers_metrics_append_label(buf, "world", entry->world_name);
+			if (def->label != NULL)
+				handlers_metrics_append_label(buf, def->label, entry->sample.label);
+			if (def->scale == 1)
+				StrBuf->Printf(buf, "} %"PRId64"\n", entry->sample.value);
+			else
+				StrBuf->Printf(buf, "} %.6f\n", (double)entry->sample.value / def->scale);
+		}
+	}
+}
+
+/**
+ * Sends collected metrics to client and closes connection.
+ *
+ * @param fd connection
+ * @param sd session data
+ */
+static void handlers_metrics_send(int fd, struct api_session_data *sd)
+{
+	nullpo_retv(sd);
+	struct metrics_request *request = sd->custom;
+	nullpo_retv(request);
+
+	if (request->sent)
+		return;
+	request->sent = true;
+	if (request->timer != INVALID_TIMER) {
+		timer->delete(request->timer, handlers->metrics_timeout);
+		request->timer = INVALID_TIMER;
+	}
+
+	StringBuf buf;
+	StrBuf->Init(&buf);
+	handlers->metrics_format(&buf, request);
+	httpsender->send_content(fd, "text/plain; version=0.0.4; charset=utf-8", StrBuf->Value(&buf), StrBuf->Length(&buf));
+	StrBuf->Destroy(&buf);
+
+	aclif->terminate_connection(fd);
+}
+
+/**
+ * Sends metrics collected so far when some servers didn't reply in time.
+ */
+static int handlers_metrics_timeout(int tid, int64 tick, int id, intptr_t data)
+{
+	if (!sockt->session_is_active(id))
+		return 0;
+	struct api_session_data *sd = sockt->session[id]->session_data;
+	if (sd == NULL || sd->id != (int)data)
+		return 0;
+	struct metrics_request *request = sd->custom;
+	if (request == NULL || request->timer != tid)
+		return 0;
+
+	request->timer = INVALID_TIMER;
+	ShowWarning("Metrics request %d: %d server replies missing after %d ms.\n", id, request->pending, api->metrics_timeout);
+	handlers->metrics_send(id, sd);
+	return 0;
+}
+
+#define EMBLEM_CACHE_KEY(guild_id, version) ((int64)(((uint64)(uint32)(guild_id) << 32) | (uint32)(version)))
+
+/**
+ * Unlinks emblem cache entry from least recently used list.
+ */
+static void handlers_emblem_cache_unlink(struct emblem_cache_entry *entry)
+{
+	if (entry->prev != NULL)
+		entry->prev->next = entry->next;
+	else
+		handlers->emblem_cache_head = entry->next;
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	else
+		handlers->emblem_cache_tail = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+/**
+ * Links emblem cache entry as most recently used.
+ */
+static void handlers_emblem_cache_link(struct emblem_cache_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = handlers->emblem_cache_head;
+	if (handlers->emblem_cache_head != NULL)
+		handlers->emblem_cache_head->prev = entry;
+	handlers->emblem_cache_head = entry;
+	if (handlers->emblem_cache_tail == NULL)
+		handlers->emblem_cache_tail = entry;
+}
+
+/**
+ * Looks up cached emblem and marks it as most recently used.
+ *
+ * @param guild_id guild id
+ * @param version emblem version
+ * @return cached emblem or NULL if not cached
+ */
+static struct emblem_cache_entry *handlers_emblem_cache_get(int guild_id, int version)
+{
+	if (handlers->emblem_cache == NULL)
+		return NULL;
+
+	struct emblem_cache_entry *entry = i64db_get(handlers->emblem_cache, EMBLEM_CACHE_KEY(guild_id, version));
+	if (entry == NULL)
+		return NULL;
+
+	if (entry != handlers->emblem_cache_head) {
+		handlers_emblem_cache_unlink(entry);
+		handlers_emblem_cache_link(entry);
+	}
+	return entry;
+}
+
+/**
+ * Stores emblem in cache, dropping least recently used emblems over api->emblem_cache_size.
+ *
+ * @param guild_id guild id
+ * @param version emblem version
+ * @param data emblem data
+ * @param data_size emblem data size
+ * @return cached emblem or NULL if cache disabled
+ */
+static struct emblem_cache_entry *handlers_emblem_cache_put(int guild_id, int version, const char *data, size_t data_size)
+{
+	nullpo_retr(NULL, data);
+
+	if (handlers->emblem_cache == NULL || api->emblem_cache_size <= 0)
+		return NULL;
+
+	struct emblem_cache_entry *entry = i64db_get(handlers->emblem_cache, EMBLEM_CACHE_KEY(guild_id, version));
+	if (entry != NULL)
+		handlers->emblem_cache_remove(entry);
+
+	while (handlers->emblem_cache_count >= api->emblem_cache_size && handlers->emblem_cache_tail != NULL)
+		handlers->emblem_cache_remove(handlers->emblem_cache_tail);
+
+	CREATE(entry, struct emblem_cache_entry, 1);
+	entry->guild_id = guild_id;
+	entry->version = version;
+	entry->data = aMalloc(data_size);
+	memcpy(entry->data, data, data_size);
+	entry->data_size = data_size;
+
+	// FNV-1a over emblem data, so reused versions after guild recreation still change tag
+	uint32 hash = 2166136261U;
+	for (size_t i = 0; i < data_size; i++) {
+		hash ^= (uint8)data[i];
+		hash *= 16777619U;
+	}
+	snprintf(entry->etag, sizeof(entry->etag), "\"%d-%d-%08x\"", guild_id, version, hash);
+
+	i64db_put(handlers->emblem_cache, EMBLEM_CACHE_KEY(guild_id, version), entry);
+	handlers_emblem_cache_link(entry);
+	handlers->emblem_cache_count++;
+	return entry;
+}
+
+/**
+ * Removes emblem from cache and frees it.
+ */
+static void handlers_emblem_cache_remove(struct emblem_cache_entry *entry)
+{
+	nullpo_retv(entry);
+
+	i64db_remove(handlers->emblem_cache, EMBLEM_CACHE_KEY(entry->guild_id, entry->version));
+	handlers_emblem_cache_unlink(entry);
+	handlers->emblem_cache_count--;
+	aFree(entry->data);
+	aFree(entry);
+}
+
+/**
+ * Removes all cached emblem versions of guild.
+ *
+ * @param guild_id guild id
+ */
+static void handlers_emblem_cache_invalidate(int guild_id)
+{
+	struct emblem_cache_entry *entry = handlers->emblem_cache_head;
+	while (entry != NULL) {
+		struct emblem_cache_entry *next = entry->next;
+		if (entry->guild_id == guild_id)
+			handlers->emblem_cache_remove(entry);
+		entry = next;
+	}
+}
+
+/**
+ * Sends cached emblem, or 304 if client If-None-Match already has it.
+ *
+ * @param fd connection
+ * @param sd session data
+ * @param entry cached emblem
+ * @return true in case of success, false if something goes wrong
+ */
+static bool handlers_emblem_send(int fd, struct api_session_data *sd, const struct emblem_cache_entry *entry)
+{
+	nullpo_retr(false, sd);
+	nullpo_retr(false, entry);
+
+	const char *if_none_match = strdb_get(sd->headers_db, "If-None-Match");
+	if (if_none_match == NULL)
+		if_none_match = strdb_get(sd->headers_db, "if-none-match");
+	if (if_none_match != NULL && (strstr(if_none_match, entry->etag) != NULL || strcmp(if_none_match, "*") == 0))
+		return httpsender->send_not_modified(fd, entry->etag);
+
+	return httpsender->send_binary_etag(fd, entry->data, entry->data_size, entry->etag);
+}
+
 static int do_init_handlers(bool minimal)
 {
+	if (minimal)
+		return 0;
+
+	timer->add_func_list(handlers->metrics_timeout, "handlers->metrics_timeout");
+
+	handlers->emblem_cache = i64db_alloc(DB_OPT_BASE);
 	return 0;
 }
 
 static void do_final_handlers(void)
 {
+	if (handlers->emblem_cache == NULL)
+		return;
+
+	while (handlers->emblem_cache_head != NULL)
+		handlers->emblem_cache_remove(handlers->emblem_cache_head);
+	db_destroy(handlers->emblem_cache);
+	handlers->emblem_cache = NULL;
 }
 
 void handlers_defaults(void)
@@ -660,6 +1065,21 @@ void handlers_defaults(void)
 	handlers->sendHotkeyV2Tab = handlers_sendHotkeyV2Tab;
 	handlers->hotkeyTabIdToName = handlers_hotkeyTabIdToName;
 
+	handlers->emblem_cache = NULL;
+	handlers->emblem_cache_head = NULL;
+	handlers->emblem_cache_tail = NULL;
+	handlers->emblem_cache_count = 0;
+	handlers->emblem_cache_get = handlers_emblem_cache_get;
+	handlers->emblem_cache_put = handlers_emblem_cache_put;
+	handlers->emblem_cache_invalidate = handlers_emblem_cache_invalidate;
+	handlers->emblem_cache_remove = handlers_emblem_cache_remove;
+	handlers->emblem_send = handlers_emblem_send;
+
+	handlers->metrics_add = handlers_metrics_add;
+	handlers->metrics_format = handlers_metrics_format;
+	handlers->metrics_send = handlers_metrics_send;
+	handlers->metrics_timeout = handlers_metrics_timeout;
+
 #define handler(method, url, func, flags) handlers->parse_ ## func = handlers_parse_ ## func
 #define handler2(method, url, func, flags) handlers->parse_ ## func = handlers_parse_ ## func; \
 	handlers->func = handlers_ ## func
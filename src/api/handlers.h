@@ -23,6 +23,7 @@
 
 #include "api/api.h"
 #include "common/hercules.h"
+#include "common/apipackets.h"
 #include "common/db.h"
 #include "api/httphandler.h"
 #include "api/jsonparser.h"
@@ -30,6 +31,52 @@
 #include <stdarg.h>
 
 struct userconfig_userhotkeys_v2;
+struct StringBuf;
+
+#ifndef EMBLEM_ETAG_SIZE
+#define EMBLEM_ETAG_SIZE 40
+#endif
+
+/**
+ * Cached guild emblem, linked into least recently used order.
+ **/
+struct emblem_cache_entry {
+	int guild_id;
+	int version;
+	char etag[EMBLEM_ETAG_SIZE];
+	char *data;
+	size_t data_size;
+	struct emblem_cache_entry *prev; // more recently used
+	struct emblem_cache_entry *next; // less recently used
+};
+
+/**
+ * Emblem request data kept in api_session_data::custom until char server reply.
+ **/
+struct emblem_request {
+	int guild_id;
+	int version;
+};
+
+/**
+ * Metrics sample received from a server.
+ **/
+struct metrics_entry {
+	uint8 server_type; // enum server_types
+	char world_name[MAX_CHARSERVER_NAME_SIZE];
+	struct metrics_sample sample;
+};
+
+/**
+ * Metrics request data kept in api_session_data::custom until all servers reply.
+ **/
+struct metrics_request {
+	int pending; // server replies still expected
+	int timer;
+	bool sent;
+	int count;
+	struct metrics_entry entries[];
+};
 
 /**
  * handlers.c Interface
@@ -40,6 +87,21 @@ struct handlers_interface {
 	void (*sendHotkeyV2Tab) (JsonP *json, struct userconfig_userhotkeys_v2 *hotkeys);
 	const char *(*hotkeyTabIdToName) (int tab_id);
 
+	struct DBMap *emblem_cache; // int64 (guild_id << 32 | version) -> struct emblem_cache_entry*
+	struct emblem_cache_entry *emblem_cache_head;
+	struct emblem_cache_entry *emblem_cache_tail;
+	int emblem_cache_count;
+	struct emblem_cache_entry *(*emblem_cache_get) (int guild_id, int version);
+	struct emblem_cache_entry *(*emblem_cache_put) (int guild_id, int version, const char *data, size_t data_size);
+	void (*emblem_cache_invalidate) (int guild_id);
+	void (*emblem_cache_remove) (struct emblem_cache_entry *entry);
+	bool (*emblem_send) (int fd, struct api_session_data *sd, const struct emblem_cache_entry *entry);
+
+	void (*metrics_add) (struct api_session_data *sd, int server_type, const char *world_name, const struct metrics_sample *samples, int count);
+	void (*metrics_format) (struct StringBuf *buf, const struct metrics_request *request);
+	void (*metrics_send) (int fd, struct api_session_data *sd);
+	int (*metrics_timeout) (int tid, int64 tick, int id, intptr_t data);
+
 #define handler(method, url, func, flags) bool (*parse_ ## func) (int fd, struct api_session_data *sd)
 #define handler2(method, url, func, flags) bool (*parse_ ## func) (int fd, struct api_session_data *sd); \
 	void (*func) (int fd, struct api_session_data *sd, const void *data, size_t data_size)
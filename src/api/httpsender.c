@@ -236,6 +236,108 @@ static bool httpsender_send_binary(int fd, const char *data, const size_t data_l
 	return true;
 }
 
+/**
+ * Sends binary content to fd together with an entity tag.
+ *
+ * Used for responses that the client may revalidate later with If-None-Match.
+ *
+ * @param fd connection
+ * @param data content to be sent
+ * @param data_len content length
+ * @param etag quoted entity tag of content
+ * @return true in case of success, false if something goes wrong
+ */
+static bool httpsender_send_binary_etag(int fd, const char *data, const size_t data_len, const char *etag)
+{
+#ifdef DEBUG_LOG
+	ShowInfo("httpsender_send_binary_etag\n");
+#endif  // DEBUG_LOG
+
+	nullpo_retr(false, data);
+	nullpo_retr(false, etag);
+
+	size_t buf_sz = snprintf(tmp_buffer, sizeof(tmp_buffer),
+		"HTTP/1.1 200 OK\n"
+		"Server: %s\n"
+		"Content-Type: octet-stream\n"
+		"Content-Length: %lu\n"
+		"ETag: %s\n"
+		"\n",
+		httpsender->server_name, data_len, etag);
+	WFIFOHEAD(fd, buf_sz);
+	WFIFOADDSTR(fd, tmp_buffer);
+	sockt->flush(fd);
+	WFIFOHEAD(fd, data_len);
+	WFIFOADDBUF(fd, data, data_len);
+	sockt->flush(fd);
+	return true;
+}
+
+/**
+ * Sends content of any size and type to fd.
+ *
+ * Unlike httpsender->send_plain, the content isn't copied to tmp_buffer, so it
+ * can be bigger than MAX_RESPONSE_SIZE.
+ *
+ * @param fd connection
+ * @param content_type value of Content-Type header
+ * @param data content to be sent
+ * @param data_len content length
+ * @return true in case of success, false if something goes wrong
+ */
+static bool httpsender_send_content(int fd, const char *content_type, const char *data, const size_t data_len)
+{
+#ifdef DEBUG_LOG
+	ShowInfo("httpsender_send_content\n");
+#endif  // DEBUG_LOG
+
+	nullpo_retr(false, content_type);
+	nullpo_retr(false, data);
+
+	size_t buf_sz = snprintf(tmp_buffer, sizeof(tmp_buffer),
+		"HTTP/1.1 200 OK\n"
+		"Server: %s\n"
+		"Content-Type: %s\n"
+		"Content-Length: %lu\n"
+		"\n",
+		httpsender->server_name, content_type, data_len);
+	WFIFOHEAD(fd, buf_sz);
+	WFIFOADDSTR(fd, tmp_buffer);
+	sockt->flush(fd);
+	WFIFOHEAD(fd, data_len);
+	WFIFOADDBUF(fd, data, data_len);
+	sockt->flush(fd);
+	return true;
+}
+
+/**
+ * Sends "304 Not Modified" response without body to fd.
+ *
+ * @param fd connection
+ * @param etag quoted entity tag of content still valid on client side
+ * @return true in case of success, false if something goes wrong
+ */
+static bool httpsender_send_not_modified(int fd, const char *etag)
+{
+#ifdef DEBUG_LOG
+	ShowInfo("httpsender_send_not_modified\n");
+#endif  // DEBUG_LOG
+
+	nullpo_retr(false, etag);
+
+	size_t buf_sz = snprintf(tmp_buffer, sizeof(tmp_buffer),
+		"HTTP/1.1 %d %s\n"
+		"Server: %s\n"
+		"ETag: %s\n"
+		"\n",
+		HTTP_STATUS_NOT_MODIFIED, httpsender->http_status_name(HTTP_STATUS_NOT_MODIFIED),
+		httpsender->server_name, etag);
+	WFIFOHEAD(fd, buf_sz);
+	WFIFOADDSTR(fd, tmp_buffer);
+	sockt->flush(fd);
+	return true;
+}
+
 void httpsender_defaults(void)
 {
 	httpsender = &httpsender_s;
@@ -255,4 +357,7 @@ void httpsender_defaults(void)
 	httpsender->send_json = httpsender_send_json;
 	httpsender->send_json_text = httpsender_send_json_text;
 	httpsender->send_binary = httpsender_send_binary;
+	httpsender->send_binary_etag = httpsender_send_binary_etag;
+	httpsender->send_not_modified = httpsender_send_not_modified;
+	httpsender->send_content = httpsender_send_content;
 }
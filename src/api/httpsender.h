@@ -56,6 +56,9 @@ struct httpsender_interface {
 	bool (*send_json) (int fd, const JsonW *json);
 	bool (*send_json_text) (int fd, const char *json, enum http_status status);
 	bool (*send_binary) (int fd, const char *data, const size_t data_len);
+	bool (*send_binary_etag) (int fd, const char *data, const size_t data_len, const char *etag);
+	bool (*send_not_modified) (int fd, const char *etag);
+	bool (*send_content) (int fd, const char *content_type, const char *data, const size_t data_len);
 };
 
 #ifdef HERCULES_CORE
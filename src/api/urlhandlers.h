@@ -35,5 +35,6 @@ handler2(HTTP_POST, "/party/add", party_add, REQ_API_AUTH | REQ_CHAR_ID | REQ_PA
 handler2(HTTP_POST, "/party/del", party_del, REQ_API_AUTH | REQ_MASTER_AID);
 handler2(HTTP_POST, "/party/info", party_info, REQ_API_AUTH | REQ_CHAR_ID | REQ_QUERY_AID);
 handler(HTTP_GET, "/test/url", test_url, REQ_DEFAULT);
+handler2(HTTP_GET, "/metrics", metrics, REQ_TRUSTED);
 packet_handler(userconfig_load_emotes);
 packet_handler(userconfig_load_hotkeys);
@@ -35,6 +35,7 @@
 #include "common/db.h"
 #include "common/HPM.h"
 #include "common/memmgr.h"
+#include "common/metrics.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/socket.h"
@@ -112,6 +113,9 @@ static int capiif_parse_fromlogin_api_proxy(int fd)
 		case API_MSG_party_del:
 			capiif->parse_party_del(fd);
 			break;
+		case API_MSG_metrics:
+			capiif->parse_metrics(fd);
+			break;
 		default:
 			ShowError("Unknown proxy packet 0x%04x received from login-server, disconnecting.\n", msg);
 			sockt->eof(fd);
@@ -247,6 +251,28 @@ void capiif_parse_userconfig_save_userhotkey_v2(int fd)
 	inter_userconfig->hotkey_tab_tosql(p->account_id, &data->hotkeys);
 }
 
+void capiif_parse_metrics(int fd)
+{
+	RFIFO_API_DATA(data, metrics);
+	RFIFO_API_PROXY_PACKET(p);
+	const bool has_map_server = sockt->session_is_active(chr->map_server.fd);
+
+	metrics->collect();
+	metrics->add(METRIC_ONLINE_USERS, NULL, db_size(chr->online_char_db));
+	metrics->send(chr->login_fd, p, data->world_name, has_map_server ? 1 : 0);
+
+	// the map server replies after this reply, through the same connection
+	if (has_map_server) {
+		uint8 buf[sizeof(struct PACKET_API_PROXY) + sizeof(struct PACKET_API_metrics)];
+		struct PACKET_API_PROXY *packet = (struct PACKET_API_PROXY *)buf;
+
+		memcpy(buf, p, sizeof(buf));
+		packet->packet_len = sizeof(buf);
+		packet->flags = proxy_flag_map;
+		mapif->send(buf, sizeof(buf));
+	}
+}
+
 void capiif_emblem_download(int fd, int guild_id, int emblem_id)
 {
 	struct guild *g = inter_guild->fromsql(guild_id);
@@ -360,6 +386,7 @@ void capiif_defaults(void) {
 	capiif->emblem_download = capiif_emblem_download;
 	capiif->parse_fromlogin_api_proxy = capiif_parse_fromlogin_api_proxy;
 	capiif->parse_proxy_api_from_map = capiif_parse_proxy_api_from_map;
+	capiif->parse_metrics = capiif_parse_metrics;
 	capiif->parse_userconfig_load_emotes = capiif_parse_userconfig_load_emotes;
 	capiif->parse_userconfig_save_emotes = capiif_parse_userconfig_save_emotes;
 	capiif->parse_charconfig_load = capiif_parse_charconfig_load;
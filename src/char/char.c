@@ -301,6 +301,8 @@ static void char_set_char_offline(int char_id, int account_id)
 
 		if (cp != NULL)
 			idb_remove(chr->char_db_,char_id);
+		chr->item_snapshot_remove(char_id, TABLE_INVENTORY);
+		chr->item_snapshot_remove(char_id, TABLE_CART);
 		if (c_ach != NULL) {
 			VECTOR_CLEAR(*c_ach);
 			idb_remove(inter_achievement->char_achievements, char_id);
@@ -824,11 +826,121 @@ static int char_getitemdata_from_sql(struct item *items, int max, int guid, enum
 	SQL->StmtFree(stmt);
 	StrBuf->Destroy(&buf);
 
+	chr->item_snapshot_set(items, i, guid, table); // Base of the next chr->memitemdata_to_sql
+
 	return i;
 }
 
+/**
+ * Returns the key of an item snapshot in chr->item_snapshots.
+ */
+static int64 char_item_snapshot_key(int guid, enum inventory_table_type table)
+{
+	return ((int64)table << 32) | (uint32)guid;
+}
+
+/**
+ * Looks up the last persisted rows of an item table.
+ * @param[in] guid  The character/guild ID (depending on table).
+ * @param[in] table The type of table (@see enum inventory_table_type).
+ * @return The snapshot, or NULL if the rows are not known.
+ */
+static struct item_snapshot *char_item_snapshot_get(int guid, enum inventory_table_type table)
+{
+	return (struct item_snapshot *)i64db_get(chr->item_snapshots, chr->item_snapshot_key(guid, table));
+}
+
+/**
+ * Stores the last persisted rows of an item table, replacing the previous snapshot.
+ * The `id` field of the items must hold their row IDs.
+ * @param[in] items The items array (empty entries are skipped).
+ * @param[in] count The size of the items array.
+ * @param[in] guid  The character/guild ID (depending on table).
+ * @param[in] table The type of table (@see enum inventory_table_type).
+ */
+static void char_item_snapshot_set(const struct item *items, int count, int guid, enum inventory_table_type table)
+{
+	struct item_snapshot *snapshot;
+	int i, amount = 0;
+
+	if (count > 0)
+		nullpo_retv(items);
+
+	for (i = 0; i < count; i++) {
+		if (items[i].nameid != 0)
+			amount++;
+	}
+
+	snapshot = aMalloc(sizeof(*snapshot) + amount * sizeof(snapshot->items[0]));
+	snapshot->amount = 0;
+	for (i = 0; i < count; i++) {
+		if (items[i].nameid != 0)
+			snapshot->items[snapshot->amount++] = items[i];
+	}
+
+	i64db_put(chr->item_snapshots, chr->item_snapshot_key(guid, table), snapshot); // Releases the previous one.
+}
+
+/**
+ * Forgets the last persisted rows of an item table, the next save will read them from the database.
+ * Must be called whenever the rows are modified other than through chr->memitemdata_to_sql.
+ * @param[in] guid  The character/guild ID (depending on table).
+ * @param[in] table The type of table (@see enum inventory_table_type).
+ */
+static void char_item_snapshot_remove(int guid, enum inventory_table_type table)
+{
+	i64db_remove(chr->item_snapshots, chr->item_snapshot_key(guid, table));
+}
+
+/// Lookup entry used to match saved items against persisted rows.
+struct item_match_entry {
+	uint32 hash;
+	int index;
+};
+
+/**
+ * Hashes the fields identifying an item row (the same fields compared by char_item_match).
+ */
+static uint32 char_item_match_hash(const struct item *it)
+{
+	const uint8 *parts[4] = { (const uint8 *)&it->nameid, (const uint8 *)&it->unique_id, (const uint8 *)it->card, (const uint8 *)it->option };
+	const size_t lengths[4] = { sizeof(it->nameid), sizeof(it->unique_id), sizeof(int) * MAX_SLOTS, 5 * MAX_ITEM_OPTIONS };
+	uint32 hash = 2166136261U; // FNV-1a
+	int i;
+	size_t j;
+
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < lengths[i]; j++)
+			hash = (hash ^ parts[i][j]) * 16777619U;
+	}
+	return hash;
+}
+
+/**
+ * Whether a saved item and a persisted row are the same item.
+ */
+static bool char_item_match(const struct item *a, const struct item *b)
+{
+	return a->nameid == b->nameid
+		&& a->unique_id == b->unique_id
+		&& memcmp(a->card, b->card, sizeof(int) * MAX_SLOTS) == 0
+		&& memcmp(a->option, b->option, 5 * MAX_ITEM_OPTIONS) == 0;
+}
+
+static int char_item_match_entry_cmp(const void *a, const void *b)
+{
+	const struct item_match_entry *ea = a, *eb = b;
+
+	if (ea->hash != eb->hash)
+		return ea->hash < eb->hash ? -1 : 1;
+	return ea->index - eb->index;
+}
+
 /**
  * Saves an array of 'item' entries into the specified table. [Smokexyz/Hercules]
+ *
+ * The items are compared against the last persisted rows, kept in memory (@see chr->item_snapshot_get),
+ * so only the rows that differ are written, and the table is only read when no snapshot is known.
  * @param[in] items        The items array.
  * @param[in] current_size The current size of the items array (-1 to automatically use the maximum size, for fixed size inventories).
  * @param[in] guid         The character/account/guild ID (depending on table).
@@ -842,7 +954,7 @@ static int char_memitemdata_to_sql(const struct item *p_items, int current_size,
 	bool has_favorite = false;
 	int total_updates = 0, total_deletes = 0, total_inserts = 0;
 	int max_size = 0;
-	int db_size = 0;
+	int errors = 0;
 
 	switch (table) {
 	case TABLE_INVENTORY:
@@ -870,40 +982,83 @@ static int char_memitemdata_to_sql(const struct item *p_items, int current_size,
 	if (current_size == -1)
 		current_size = max_size;
 
+	if (current_size > 0)
+		nullpo_retr(-1, p_items);
+
+	/**
+	 * Last persisted rows, read from the table only if they aren't known yet.
+	 */
+	const struct item_snapshot *snapshot = chr->item_snapshot_get(guid, table);
+	if (snapshot == NULL) {
+		struct item *cp_items = aCalloc(max_size, sizeof(struct item));
+		int db_size = chr->getitemdata_from_sql(cp_items, max_size, guid, table); // Stores the snapshot.
+
+		aFree(cp_items);
+		if (db_size < 0 || (snapshot = chr->item_snapshot_get(guid, table)) == NULL) {
+			ShowError("char_memitemdata_to_sql: Couldn't read the current %s rows of %d.\n", tablename, guid);
+			return -1;
+		}
+	}
+
+	/**
+	 * Index the saved items by hash, so each row is matched in O(log n).
+	 * Equal items keep their array order, the first unmatched one is used.
+	 */
 	bool *matched_p = NULL;
+	int *row_ids = NULL;
+	struct item_match_entry *lookup = NULL;
+	int lookup_size = 0;
 	if (current_size > 0) {
-		nullpo_ret(p_items);
-
 		matched_p = aCalloc(current_size, sizeof(bool));
+		row_ids = aCalloc(current_size, sizeof(int));
+		lookup = aMalloc(current_size * sizeof(struct item_match_entry));
+		for (int i = 0; i < current_size; i++) {
+			if (p_items[i].nameid == 0)
+				continue;
+			lookup[lookup_size].hash = char_item_match_hash(&p_items[i]);
+			lookup[lookup_size].index = i;
+			lookup_size++;
+		}
+		qsort(lookup, lookup_size, sizeof(struct item_match_entry), char_item_match_entry_cmp);
 	}
 
 	StringBuf buf;
 	StrBuf->Init(&buf);
 
 	/**
-	 * If the storage table is not empty, check for items and replace or delete where needed.
+	 * Replace the rows that changed, delete the ones that no longer exist.
 	 */
-	struct item *cp_items = aCalloc(max_size, sizeof(struct item));
-	if ((db_size = chr->getitemdata_from_sql(cp_items, max_size, guid, table)) > 0) {
-		int *deletes = aCalloc(db_size, sizeof(struct item));
-
-		for (int i = 0; i < db_size; i++) {
-			const struct item *cp_it = &cp_items[i];
-
-			int j = 0;
-			ARR_FIND(0, current_size, j,
-					 matched_p[j] != true
-					 && p_items[j].nameid != 0
-					 && cp_it->nameid == p_items[j].nameid
-					 && cp_it->unique_id == p_items[j].unique_id
-					 && memcmp(p_items[j].card, cp_it->card, sizeof(int) * MAX_SLOTS) == 0
-					 && memcmp(p_items[j].option, cp_it->option, 5 * MAX_ITEM_OPTIONS) == 0);
+	if (snapshot->amount > 0) {
+		int *deletes = aCalloc(snapshot->amount, sizeof(int));
+
+		for (int i = 0; i < snapshot->amount; i++) {
+			const struct item *cp_it = &snapshot->items[i];
+			uint32 hash = char_item_match_hash(cp_it);
+			int lo = 0, hi = lookup_size;
+			int j = current_size;
+
+			while (lo < hi) { // Lower bound of the hash.
+				int mid = (lo + hi) / 2;
+				if (lookup[mid].hash < hash)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			for (; lo < lookup_size && lookup[lo].hash == hash; lo++) {
+				if (!matched_p[lookup[lo].index] && char_item_match(&p_items[lookup[lo].index], cp_it)) {
+					j = lookup[lo].index;
+					break;
+				}
+			}
 
 			if (j < current_size) { // Item found.
 				matched_p[j] = true; // Mark the item as matched.
+				row_ids[j] = cp_it->id;
 
 				// If the amount has changed, set for replacement with current item properties.
-				if (memcmp(cp_it, &p_items[j], sizeof(struct item)) != 0) {
+				struct item cur = p_items[j];
+				cur.id = cp_it->id;
+				if (memcmp(cp_it, &cur, sizeof(struct item)) != 0) {
 					if (total_updates == 0) {
 						StrBuf->Clear(&buf);
 						StrBuf->Printf(&buf, "REPLACE INTO `%s` (`id`, `%s`, `nameid`, `amount`, `equip`, `identify`, `refine`, `grade`, `attribute`", tablename, selectoption);
@@ -938,8 +1093,10 @@ static int char_memitemdata_to_sql(const struct item *p_items, int current_size,
 			}
 		}
 
-		if (total_updates > 0 && SQL_ERROR == SQL->QueryStr(inter->sql_handle, StrBuf->Value(&buf)))
+		if (total_updates > 0 && SQL_ERROR == SQL->QueryStr(inter->sql_handle, StrBuf->Value(&buf))) {
 			Sql_ShowDebug(inter->sql_handle);
+			errors++;
+		}
 
 		/**
 		 * Handle deletions, if any.
@@ -952,8 +1109,10 @@ static int char_memitemdata_to_sql(const struct item *p_items, int current_size,
 
 			StrBuf->AppendStr(&buf, ");");
 
-			if (SQL_ERROR == SQL->QueryStr(inter->sql_handle, StrBuf->Value(&buf)))
+			if (SQL_ERROR == SQL->QueryStr(inter->sql_handle, StrBuf->Value(&buf))) {
 				Sql_ShowDebug(inter->sql_handle);
+				errors++;
+			}
 		}
 
 		aFree(deletes);
@@ -997,20 +1156,98 @@ static int char_memitemdata_to_sql(const struct item *p_items, int current_size,
 		total_inserts++;
 	}
 
-	if (total_inserts > 0 && SQL_ERROR == SQL->QueryStr(inter->sql_handle, StrBuf->Value(&buf)))
-		Sql_ShowDebug(inter->sql_handle);
+	if (total_inserts > 0) {
+		if (SQL_ERROR == SQL->QueryStr(inter->sql_handle, StrBuf->Value(&buf))) {
+			Sql_ShowDebug(inter->sql_handle);
+			errors++;
+		} else if (chr->item_snapshot_insert_ids(row_ids, matched_p, p_items, current_size, total_inserts, tablename, selectoption, guid) != total_inserts) {
+			errors++; // The IDs of the new rows are unknown, the snapshot can't be kept.
+		}
+	}
 
 	StrBuf->Destroy(&buf);
 
-	aFree(cp_items);
+	/**
+	 * The saved items are the new persisted rows.
+	 */
+	if (errors == 0) {
+		struct item *rows = NULL;
+		int amount = 0;
+
+		if (current_size > 0) {
+			rows = aMalloc(current_size * sizeof(struct item));
+			for (int i = 0; i < current_size; i++) {
+				if (p_items[i].nameid == 0)
+					continue;
+				rows[amount] = p_items[i];
+				rows[amount].id = row_ids[i];
+				amount++;
+			}
+		}
+		chr->item_snapshot_set(rows, amount, guid, table);
+		if (rows != NULL)
+			aFree(rows);
+	} else {
+		chr->item_snapshot_remove(guid, table); // The rows are unknown now.
+	}
+
 	if (matched_p != NULL)
 		aFree(matched_p);
+	if (row_ids != NULL)
+		aFree(row_ids);
+	if (lookup != NULL)
+		aFree(lookup);
 
 	ShowInfo("%s save complete - guid: %d (replace: %d, insert: %d, delete: %d)\n", tablename, guid, total_updates, total_inserts, total_deletes);
 
+	if (errors > 0)
+		return -1;
 	return total_updates + total_inserts + total_deletes;
 }
 
+/**
+ * Fetches the row IDs of the items inserted by the last query of chr->memitemdata_to_sql.
+ * The new rows are the ones from LAST_INSERT_ID() onwards, in insertion order.
+ * @param[out] row_ids    Row ID of each item, filled for the unmatched (inserted) entries.
+ * @param[in]  matched_p  Whether each item matched an existing row.
+ * @param[in]  p_items    The items array.
+ * @param[in]  size       The size of the items array.
+ * @param[in]  inserts    Number of inserted rows.
+ * @param[in]  tablename  The table name.
+ * @param[in]  selectoption The owner column name.
+ * @param[in]  guid       The character/guild ID.
+ * @return The number of IDs retrieved, or -1 in case of failure.
+ */
+static int char_item_snapshot_insert_ids(int *row_ids, const bool *matched_p, const struct item *p_items, int size, int inserts, const char *tablename, const char *selectoption, int guid)
+{
+	uint64 first_id = SQL->LastInsertId(inter->sql_handle);
+	int count = 0, i = 0;
+	char *data;
+
+	nullpo_retr(-1, row_ids);
+	nullpo_retr(-1, matched_p);
+	nullpo_retr(-1, p_items);
+
+	if (SQL_ERROR == SQL->Query(inter->sql_handle, "SELECT `id` FROM `%s` WHERE `%s`='%d' AND `id`>='%"PRIu64"' ORDER BY `id` LIMIT %d",
+	                            tablename, selectoption, guid, first_id, inserts)) {
+		Sql_ShowDebug(inter->sql_handle);
+		return -1;
+	}
+
+	while (SQL_SUCCESS == SQL->NextRow(inter->sql_handle)) {
+		while (i < size && (matched_p[i] || p_items[i].nameid == 0))
+			i++;
+		if (i >= size)
+			break;
+		SQL->GetData(inter->sql_handle, 0, &data, NULL);
+		row_ids[i++] = atoi(data);
+		count++;
+	}
+	SQL->FreeResult(inter->sql_handle);
+
+	return count;
+}
+
 /**
  * Returns the correct gender ID for the given character and enum value.
  *
@@ -1467,6 +1704,7 @@ static int char_mmo_char_fromsql(int char_id, struct mmo_charstatus *p, bool loa
 static int char_mmo_char_sql_init(void)
 {
 	chr->char_db_= idb_alloc(DB_OPT_RELEASE_DATA);
+	chr->item_snapshots = i64db_alloc(DB_OPT_RELEASE_DATA);
 
 	//the 'set offline' part is now in check_login_conn ...
 	//if the server connects to loginserver
@@ -1829,6 +2067,8 @@ static int char_divorce_char_sql(int partner_id1, int partner_id2)
 		Sql_ShowDebug(inter->sql_handle);
 	if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE (`nameid`='%d' OR `nameid`='%d') AND (`char_id`='%d' OR `char_id`='%d') LIMIT 2", inventory_db, WEDDING_RING_M, WEDDING_RING_F, partner_id1, partner_id2) )
 		Sql_ShowDebug(inter->sql_handle);
+	chr->item_snapshot_remove(partner_id1, TABLE_INVENTORY);
+	chr->item_snapshot_remove(partner_id2, TABLE_INVENTORY);
 
 	WBUFW(buf,0) = 0x2b12;
 	WBUFL(buf,2) = partner_id1;
@@ -1956,6 +2196,9 @@ static int char_delete_char_sql(int char_id)
 	if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `char_id`='%d'", cart_db, char_id) )
 		Sql_ShowDebug(inter->sql_handle);
 
+	chr->item_snapshot_remove(char_id, TABLE_INVENTORY);
+	chr->item_snapshot_remove(char_id, TABLE_CART);
+
 	/* delete memo areas */
 	if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `char_id`='%d'", memo_db, char_id) )
 		Sql_ShowDebug(inter->sql_handle);
@@ -2572,6 +2815,7 @@ static void char_change_sex_sub(int sex, int acc, int char_id, int class, int gu
 		SQL->StmtFree(stmt);
 		return;
 	}
+	chr->item_snapshot_remove(char_id, TABLE_INVENTORY);
 
 	/** Correct the job class for gender specific jobs according to the passed gender. **/
 	if (class == JOB_BARD || class == JOB_DANCER)
@@ -3285,6 +3529,66 @@ static void char_parse_frommap_save_character(int fd)
 	RFIFOSKIP(fd,size);
 }
 
+static void char_save_character_delta_nack(int fd, int aid, int cid)
+{
+	WFIFOHEAD(fd,10);
+	WFIFOW(fd,0) = 0x2b29; //Map-server will send the complete data on next save.
+	WFIFOL(fd,2) = aid;
+	WFIFOL(fd,6) = cid;
+	WFIFOSET(fd,10);
+}
+
+/**
+ * Applies a delta save on top of the cached character data and saves it.
+ * Only the changed sections are sent by the map-server, and only those reach the SQL tables.
+ */
+static void char_parse_frommap_save_character_delta(int fd)
+{
+	int aid = RFIFOL(fd,4), cid = RFIFOL(fd,8), size = RFIFOW(fd,2);
+	struct online_char_data *character = (struct online_char_data *)idb_get(chr->online_char_db, aid);
+	struct mmo_charstatus *cp = (struct mmo_charstatus *)idb_get(chr->char_db_, cid);
+	struct mmo_charstatus char_dat;
+	int pos = 12;
+
+	if (character == NULL || character->char_id != cid) {
+		ShowError("parse_from_map (save-char-delta): Received data for non-existing/offline character (%d:%d).\n", aid, cid);
+		chr->set_char_online(false, cid, aid);
+		RFIFOSKIP(fd,size);
+		return;
+	}
+	if (cp == NULL) { // Not cached (e.g. char-server restart), the delta has no base.
+		chr->save_character_delta_nack(fd, aid, cid);
+		RFIFOSKIP(fd,size);
+		return;
+	}
+
+	memcpy(&char_dat, cp, sizeof(char_dat));
+	while (pos + 6 <= size) {
+		uint32 offset = RFIFOL(fd,pos);
+		uint16 length = RFIFOW(fd,pos+4);
+
+		if (pos + 6 + length > size || offset > sizeof(char_dat) || length > sizeof(char_dat) - offset)
+			break;
+		memcpy((uint8 *)&char_dat + offset, RFIFOP(fd,pos+6), length);
+		pos += 6 + length;
+	}
+
+	if (pos != size) {
+		ShowError("parse_from_map (save-char-delta): Malformed section at offset %d for character (%d:%d).\n", pos, aid, cid);
+		chr->save_character_delta_nack(fd, aid, cid);
+		RFIFOSKIP(fd,size);
+		return;
+	}
+
+	chr->mmo_char_tosql(cid, &char_dat);
+
+	// The cache is only updated when everything was saved, resend it all otherwise.
+	if (memcmp(cp, &char_dat, sizeof(char_dat)) != 0)
+		chr->save_character_delta_nack(fd, aid, cid);
+
+	RFIFOSKIP(fd,size);
+}
+
 // 0 - not ok
 // 1 - ok
 static void char_select_ack(int fd, int account_id, uint8 flag)
@@ -3944,6 +4248,14 @@ static int char_parse_frommap(int fd)
 			}
 			break;
 
+			case 0x2b28: // Receive changed character data sections from map-server for saving
+				if (RFIFOREST(fd) < 4 || RFIFOREST(fd) < RFIFOW(fd,2))
+					return 0;
+			{
+				chr->parse_frommap_save_character_delta(fd);
+			}
+			break;
+
 			case 0x2b02: // req char selection
 				if( RFIFOREST(fd) < 22 )
 					return 0;
@@ -5767,6 +6079,7 @@ static bool char_config_read_console(const char *filename, const struct config_t
 	}
 	libconfig->setting_lookup_mutable_string(setting, "timestamp_format", showmsg->timestamp_format, sizeof(showmsg->timestamp_format));
 	libconfig->setting_lookup_int(setting, "console_msg_log", &showmsg->console_log);
+	libconfig->setting_lookup_int(setting, "watchdog_threshold", &core->watchdog_threshold);
 
 	return true;
 }
@@ -6132,6 +6445,7 @@ int do_final(void)
 		Sql_ShowDebug(inter->sql_handle);
 
 	chr->char_db_->destroy(chr->char_db_, NULL);
+	db_destroy(chr->item_snapshots);
 	chr->online_char_db->destroy(chr->online_char_db, chr->online_char_destroy_sub);
 	auth_db->destroy(auth_db, NULL);
 
@@ -6437,6 +6751,7 @@ void char_defaults(void)
 	chr->char_fd = -1;
 	chr->online_char_db = NULL;
 	chr->char_db_ = NULL;
+	chr->item_snapshots = NULL;
 
 	memset(chr->userid, 0, sizeof(chr->userid));
 	memset(chr->passwd, 0, sizeof(chr->passwd));
@@ -6466,6 +6781,11 @@ void char_defaults(void)
 	chr->create_charstatus = char_create_charstatus;
 	chr->mmo_char_tosql = char_mmo_char_tosql;
 	chr->memitemdata_to_sql = char_memitemdata_to_sql;
+	chr->item_snapshot_key = char_item_snapshot_key;
+	chr->item_snapshot_get = char_item_snapshot_get;
+	chr->item_snapshot_set = char_item_snapshot_set;
+	chr->item_snapshot_remove = char_item_snapshot_remove;
+	chr->item_snapshot_insert_ids = char_item_snapshot_insert_ids;
 	chr->getitemdata_from_sql = char_getitemdata_from_sql;
 	chr->mmo_gender = char_mmo_gender;
 	chr->mmo_chars_fromsql = char_mmo_chars_fromsql;
@@ -6525,6 +6845,8 @@ void char_defaults(void)
 	chr->parse_frommap_set_users = char_parse_frommap_set_users;
 	chr->save_character_ack = char_save_character_ack;
 	chr->parse_frommap_save_character = char_parse_frommap_save_character;
+	chr->save_character_delta_nack = char_save_character_delta_nack;
+	chr->parse_frommap_save_character_delta = char_parse_frommap_save_character_delta;
 	chr->select_ack = char_select_ack;
 	chr->parse_frommap_char_select_req = char_parse_frommap_char_select_req;
 	chr->parse_frommap_remove_friend = char_parse_frommap_remove_friend;
@@ -98,6 +98,12 @@ enum inventory_table_type {
 	TABLE_GUILD_STORAGE,
 };
 
+/// Last persisted rows of an item table, for a character or guild (@see chr->memitemdata_to_sql).
+struct item_snapshot {
+	int amount;          ///< Number of rows
+	struct item items[]; ///< Rows, `id` holds the row ID
+};
+
 struct char_auth_node {
 	int account_id;
 	int char_id;
@@ -119,6 +125,7 @@ struct char_interface {
 	int char_fd;
 	struct DBMap *online_char_db; // int account_id -> struct online_char_data*
 	struct DBMap *char_db_;
+	struct DBMap *item_snapshots; // int64 (table << 32 | guid) -> struct item_snapshot*
 	char userid[NAME_LENGTH];
 	char passwd[NAME_LENGTH];
 	char server_name[20];
@@ -154,6 +161,11 @@ struct char_interface {
 	int (*mmo_char_tosql) (int char_id, struct mmo_charstatus* p);
 	int (*getitemdata_from_sql) (struct item *items, int max, int guid, enum inventory_table_type table);
 	int (*memitemdata_to_sql) (const struct item items[], int current_size, int guid, enum inventory_table_type table);
+	int64 (*item_snapshot_key) (int guid, enum inventory_table_type table);
+	struct item_snapshot *(*item_snapshot_get) (int guid, enum inventory_table_type table);
+	void (*item_snapshot_set) (const struct item *items, int count, int guid, enum inventory_table_type table);
+	void (*item_snapshot_remove) (int guid, enum inventory_table_type table);
+	int (*item_snapshot_insert_ids) (int *row_ids, const bool *matched_p, const struct item *p_items, int size, int inserts, const char *tablename, const char *selectoption, int guid);
 	int (*mmo_gender) (const struct char_session_data *sd, const struct mmo_charstatus *p, char sex);
 	int (*mmo_chars_fromsql) (struct char_session_data* sd, uint8* buf, int *count);
 	int (*mmo_char_fromsql) (int char_id, struct mmo_charstatus* p, bool load_everything);
@@ -212,6 +224,8 @@ struct char_interface {
 	void (*parse_frommap_set_users) (int fd);
 	void (*save_character_ack) (int fd, int aid, int cid);
 	void (*parse_frommap_save_character) (int fd);
+	void (*save_character_delta_nack) (int fd, int aid, int cid);
+	void (*parse_frommap_save_character_delta) (int fd);
 	void (*select_ack) (int fd, int account_id, uint8 flag);
 	void (*parse_frommap_char_select_req) (int fd);
 	void (*parse_frommap_remove_friend) (int fd);
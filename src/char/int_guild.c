@@ -1184,6 +1184,7 @@ static bool inter_guild_disband(int guild_id)
 
 	if (SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `guild_id` = '%d'", guild_storage_db, guild_id))
 		Sql_ShowDebug(inter->sql_handle);
+	chr->item_snapshot_remove(guild_id, TABLE_GUILD_STORAGE);
 
 	if (SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `guild_id` = '%d' OR `alliance_id` = '%d'", guild_alliance_db, guild_id, guild_id))
 		Sql_ShowDebug(inter->sql_handle);
@@ -360,6 +360,7 @@ static int inter_storage_guild_storage_fromsql(int guild_id, struct guild_storag
 		}
 		gstor->items.capacity = gstor->items.amount;
 	}
+	chr->item_snapshot_set(gstor->items.data, gstor->items.amount, guild_id, TABLE_GUILD_STORAGE);
 	ShowInfo("guild storage load complete from DB - id: %d (total: %d)\n", guild_id, gstor->items.amount);
 	return 0;
 }
@@ -387,6 +388,7 @@ static int inter_storage_guild_storage_delete(int guild_id)
 {
 	if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `guild_id`='%d'", guild_storage_db, guild_id) )
 		Sql_ShowDebug(inter->sql_handle);
+	chr->item_snapshot_remove(guild_id, TABLE_GUILD_STORAGE);
 	return 0;
 }
 
@@ -455,6 +457,10 @@ static bool inter_storage_retrieve_bound_items(int char_id, int account_id, int
 		return true;
 	}
 
+	// Both tables are modified below, outside of chr->memitemdata_to_sql
+	chr->item_snapshot_remove(char_id, TABLE_INVENTORY);
+	chr->item_snapshot_remove(guild_id, TABLE_GUILD_STORAGE);
+
 	//First we delete the character's items
 	StrBuf->Clear(&buf);
 	StrBuf->Printf(&buf, "DELETE FROM `%s` WHERE",inventory_db);
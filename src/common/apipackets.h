@@ -52,6 +52,10 @@
 #define ADVENTURER_AGENCY_PAGE_SIZE 10
 #endif
 
+#ifndef METRICS_LABEL_LENGTH
+#define METRICS_LABEL_LENGTH 24
+#endif
+
 #define HEADER_API_PROXY_REQUEST 0x2842
 #define HEADER_API_PROXY_REPLY 0x2818
 
@@ -218,6 +222,14 @@ struct PACKET_API_party_info {
 	struct PACKET_API_party_info_data data;
 } __attribute__((packed));
 
+struct PACKET_API_metrics_data {
+	char world_name[MAX_CHARSERVER_NAME_SIZE];
+} __attribute__((packed));
+
+struct PACKET_API_metrics {
+	struct PACKET_API_metrics_data data;
+} __attribute__((packed));
+
 // char to api
 struct PACKET_API_REPLY_userconfig_load_emotes {
 	int result; // 0 = error, 1 = success
@@ -290,6 +302,21 @@ struct PACKET_API_REPLY_party_info {
 	int type;
 } __attribute__((packed));
 
+struct metrics_sample {
+	uint8 id;                            // enum metrics_id
+	char label[METRICS_LABEL_LENGTH];    // value of the metric label, if it has one
+	int64 value;
+} __attribute__((packed));
+
+struct PACKET_API_REPLY_metrics {
+	uint8 server_type;                   // enum server_types
+	char world_name[MAX_CHARSERVER_NAME_SIZE];
+	uint8 servers;                       // number of servers behind this one that also reply (map server behind char server)
+	uint8 last;                          // last reply packet of this server
+	uint16 count;
+	struct metrics_sample samples[];
+} __attribute__((packed));
+
 #define WFIFO_APICHAR_SIZE sizeof(struct PACKET_API_PROXY)
 #define CHUNKED_FLAG_SIZE 1
 
@@ -158,6 +158,57 @@ static CPCMD_C(mem_report, server)
 #endif
 }
 
+/**
+ * Timer function profiling
+ * Usage:
+ *   server timer_profile                 shows the data collected so far
+ *   server timer_profile on [seconds]    starts profiling, dumping to log/ every [seconds] (default 60, 0 disables)
+ *   server timer_profile off             stops profiling
+ *   server timer_profile reset           discards the data collected so far
+ **/
+static CPCMD_C(timer_profile, server)
+{
+	char action[16] = "";
+	int interval = 60;
+
+	if (line != NULL)
+		sscanf(line, "%15s %d", action, &interval);
+
+	if (action[0] == '\0') {
+		timer->profile_report(NULL);
+	} else if (strcmpi(action, "on") == 0) {
+		timer->profile_start(interval);
+		if (interval > 0)
+			ShowInfo("Timer profiling enabled, dumping to log/ every %d seconds.\n", interval);
+		else
+			ShowInfo("Timer profiling enabled.\n");
+	} else if (strcmpi(action, "off") == 0) {
+		timer->profile_stop();
+		ShowInfo("Timer profiling disabled.\n");
+	} else if (strcmpi(action, "reset") == 0) {
+		timer->profile_reset();
+		ShowInfo("Timer profiling data discarded.\n");
+	} else {
+		ShowInfo("Usage: server timer_profile [on [dump_interval_seconds]|off|reset]\n");
+	}
+}
+
+/**
+ * Main loop phase statistics
+ * Usage:
+ *   server loop_stats          shows the time spent in each main loop phase
+ *   server loop_stats reset    discards the data collected so far
+ **/
+static CPCMD_C(loop_stats, server)
+{
+	if (line != NULL && strcmpi(line, "reset") == 0) {
+		core->loop_reset();
+		ShowInfo("Main loop statistics discarded.\n");
+	} else {
+		core->loop_report();
+	}
+}
+
 /**
  * Displays command list
  **/
@@ -249,6 +300,8 @@ static void console_load_defaults(void)
 		CP_DEF_S(ers_report,server),
 		CP_DEF_S(mem_report,server),
 		CP_DEF_S(malloc_usage,server),
+		CP_DEF_S(timer_profile,server),
+		CP_DEF_S(loop_stats,server),
 		CP_DEF_S(exit,server),
 		/**
 		 * Sql related commands
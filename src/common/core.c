@@ -33,6 +33,7 @@
 #include "common/grfio.h"
 #include "common/md5calc.h"
 #include "common/memmgr.h"
+#include "common/metrics.h"
 #include "common/mmo.h"
 #include "common/mutex.h"
 #include "common/nullpo.h"
@@ -48,13 +49,20 @@
 #include "common/utils.h"
 
 #ifndef _WIN32
+#	include <pthread.h> // pthread_kill()
 #	include <unistd.h>
 #else
 #	include "common/winapi.h" // Console close event handling
 #endif
+#if defined(HAVE_LIBBACKTRACE)
+#	include "libbacktrace/backtrace.h"
+#elif defined(HAVE_EXECINFO)
+#	include <execinfo.h>
+#endif
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 /*
  * Uncomment the line below if you want to silence the root warning on startup
@@ -243,8 +251,246 @@ static bool usercheck(void)
 	return true;
 }
 
+/*======================================
+ * CORE : Main loop monitoring
+ *--------------------------------------
+ * Every main loop iteration is split in phases (timers, socket processing,
+ * waiting for network events) whose durations are accumulated in
+ * histograms, shown with the 'server loop_stats' console command.
+ *
+ * Optionally, a watchdog thread checks that the main thread doesn't stay
+ * busy for longer than core->watchdog_threshold milliseconds. When it
+ * does, the watchdog interrupts it with a signal to capture its stack and
+ * appends a report to log/<server>-stalls.log, along with the timer
+ * function and the server-specific context being executed.
+ */
+
+static struct duration_histogram core_loop_stats[CORE_LOOP_MAX];
+static int64 core_loop_stats_start = 0;
+
+/// Returns the statistics of a main loop phase since the last reset.
+static const struct duration_histogram *core_loop_get_stats(enum core_loop_phase phase)
+{
+	Assert_retr(NULL, phase >= 0 && phase < CORE_LOOP_MAX);
+	return &core_loop_stats[phase];
+}
+
+/// Shows the main loop phase statistics in the console.
+static void core_loop_report(void)
+{
+	static const char *names[CORE_LOOP_MAX] = { "timers", "sockets", "idle", "total" };
+	int i;
+
+	ShowInfo("Main loop statistics over the last %.1f seconds (%"PRIu64" iterations):\n",
+	         (double)(timer->gettick_us() - core_loop_stats_start) / 1000000, core_loop_stats[CORE_LOOP_TOTAL].count);
+	ShowMessage("%-8s %10s %9s %9s %9s %9s %9s\n", "phase", "total ms", "avg us", "p50 us", "p99 us", "p99.9 us", "max us");
+	for (i = 0; i < CORE_LOOP_MAX; i++) {
+		const struct duration_histogram *stats = &core_loop_stats[i];
+		if (stats->count == 0)
+			continue;
+		ShowMessage("%-8s %10.3f %9"PRId64" %9"PRId64" %9"PRId64" %9"PRId64" %9"PRId64"\n", names[i],
+		            (double)stats->total_us / 1000, stats->total_us / (int64)stats->count,
+		            duration_histogram_percentile(stats, 500), duration_histogram_percentile(stats, 990),
+		            duration_histogram_percentile(stats, 999),
+		            stats->max_us);
+	}
+}
+
+/// Discards the main loop phase statistics.
+static void core_loop_reset(void)
+{
+	memset(core_loop_stats, 0, sizeof(core_loop_stats));
+	core_loop_stats_start = timer->gettick_us();
+}
+
+#ifndef _WIN32
+/// Signal used to capture the stack of the main thread.
+#define CORE_WATCHDOG_SIGNAL SIGUSR2
+/// Maximum number of captured stack frames.
+#define CORE_WATCHDOG_FRAMES 64
+
+static struct thread_handle *core_watchdog_thread = NULL;
+static volatile bool core_watchdog_running = false;
+static struct mutex_data *core_watchdog_lock = NULL;
+static struct cond_data *core_watchdog_wake = NULL; ///< signaled when the watchdog is stopped
+static pthread_t core_main_thread;
+static uintptr_t core_watchdog_frames[CORE_WATCHDOG_FRAMES];
+static volatile sig_atomic_t core_watchdog_frame_count = -1; ///< -1 while a capture is pending
+
+#ifdef HAVE_LIBBACKTRACE
+static int core_watchdog_simple_callback(void *data, uintptr_t pc)
+{
+	if (pc == (uintptr_t)-1)
+		return 1; // end of the stack
+	core_watchdog_frames[core_watchdog_frame_count++] = pc;
+	return (core_watchdog_frame_count == CORE_WATCHDOG_FRAMES) ? 1 : 0;
+}
+
+static void core_watchdog_error_callback(void *data, const char *msg, int errnum)
+{
+}
+
+static int core_watchdog_print_callback(void *data, uintptr_t pc, const char *filename, int lineno, const char *function)
+{
+	fprintf(data, "  0x%lx %s (%s:%d)\n", (unsigned long)pc, function != NULL ? function : "???", filename != NULL ? filename : "???", lineno);
+	return 0;
+}
+#endif  // HAVE_LIBBACKTRACE
+
+/// Captures the stack of the main thread, interrupted by the watchdog.
+static void core_watchdog_signal(int sn)
+{
+#if defined(HAVE_LIBBACKTRACE)
+	core_watchdog_frame_count = 0;
+	if (nullpo->backtrace_state != NULL)
+		backtrace_simple(nullpo->backtrace_state, 1, core_watchdog_simple_callback, core_watchdog_error_callback, NULL);
+#elif defined(HAVE_EXECINFO)
+	core_watchdog_frame_count = backtrace((void **)core_watchdog_frames, CORE_WATCHDOG_FRAMES);
+#else
+	core_watchdog_frame_count = 0;
+#endif
+}
+
+/// Waits for ms milliseconds, or until the watchdog is stopped.
+static void core_watchdog_wait(int ms)
+{
+	mutex->lock(core_watchdog_lock);
+	if (core_watchdog_running)
+		mutex->cond_wait(core_watchdog_wake, core_watchdog_lock, ms);
+	mutex->unlock(core_watchdog_lock);
+}
+
+/// Writes a report of a stalled main thread. Runs in the watchdog thread.
+static void core_watchdog_report(int64 busy_us)
+{
+	char filename[256], context[256] = "", timestring[32];
+	const char *timer_name = timer->running();
+	time_t now = time(NULL);
+	FILE *fp;
+	int i;
+
+	if (core->watchdog_context != NULL)
+		core->watchdog_context(context, sizeof(context));
+
+	// ask the main thread for its stack and give it a little while to answer
+	core_watchdog_frame_count = -1;
+	pthread_kill(core_main_thread, CORE_WATCHDOG_SIGNAL);
+	for (i = 0; i < 20 && core_watchdog_frame_count < 0; i++)
+		core_watchdog_wait(5);
+
+	ShowWarning("Main loop busy for %"PRId64" ms (timer: %s%s%s), see log/%s-stalls.log.\n", busy_us / 1000,
+	            timer_name != NULL ? timer_name : "none", context[0] != '\0' ? ", " : "", context, SERVER_NAME);
+
+	snprintf(filename, sizeof(filename), "log/%s-stalls.log", SERVER_NAME);
+	if ((fp = fopen(filename, "a")) == NULL)
+		return;
+	strftime(timestring, sizeof(timestring), "%Y-%m-%d %H:%M:%S", localtime(&now));
+	fprintf(fp, "[%s] main loop busy for %"PRId64" ms\n", timestring, busy_us / 1000);
+	fprintf(fp, "timer: %s\n", timer_name != NULL ? timer_name : "none");
+	if (context[0] != '\0')
+		fprintf(fp, "%s\n", context);
+	if (core_watchdog_frame_count < 0) {
+		fprintf(fp, "stack: not captured (the main thread didn't answer)\n");
+	} else {
+		fprintf(fp, "stack:\n");
+#if defined(HAVE_LIBBACKTRACE)
+		for (i = 0; i < core_watchdog_frame_count; i++)
+			backtrace_pcinfo(nullpo->backtrace_state, core_watchdog_frames[i], core_watchdog_print_callback, core_watchdog_error_callback, fp);
+#elif defined(HAVE_EXECINFO)
+		fflush(fp);
+		backtrace_symbols_fd((void **)core_watchdog_frames, core_watchdog_frame_count, fileno(fp));
+#else
+		fprintf(fp, "  (not available on this platform)\n");
+#endif
+	}
+	fprintf(fp, "\n");
+	fclose(fp);
+}
+
+static void *core_watchdog_main(void *param)
+{
+	int64 reported = 0; // busy period that was already reported
+	int interval = max(core->watchdog_threshold / 4, 10);
+
+	while (core_watchdog_running) {
+		int64 busy_since;
+
+		core_watchdog_wait(interval);
+		busy_since = core->busy_since;
+		if (!core_watchdog_running || busy_since == 0 || busy_since == reported)
+			continue;
+		if (timer->gettick_us() - busy_since < (int64)core->watchdog_threshold * 1000)
+			continue;
+		reported = busy_since;
+		core_watchdog_report(timer->gettick_us() - busy_since);
+	}
+	return NULL;
+}
+#endif  // _WIN32
+
+/// Starts the stall watchdog, if enabled.
+static void core_watchdog_init(void)
+{
+	if (core->watchdog_threshold <= 0)
+		return;
+#ifndef _WIN32
+	{
+		struct sigaction sact;
+
+		memset(&sact, 0, sizeof(sact));
+		sact.sa_handler = core_watchdog_signal;
+		sigemptyset(&sact.sa_mask);
+		sact.sa_flags = SA_RESTART;
+		sigaction(CORE_WATCHDOG_SIGNAL, &sact, NULL);
+	}
+	core_watchdog_signal(CORE_WATCHDOG_SIGNAL); // loads the unwinder now, the signal handler can't do it safely
+	core_main_thread = pthread_self();
+	core_watchdog_lock = mutex->create();
+	core_watchdog_wake = mutex->cond_create();
+	core_watchdog_running = true;
+	if (core_watchdog_lock == NULL || core_watchdog_wake == NULL
+	 || (core_watchdog_thread = thread->create(core_watchdog_main, NULL)) == NULL) {
+		ShowError("core_watchdog_init: failed to start the watchdog thread.\n");
+		core_watchdog_running = false;
+		if (core_watchdog_wake != NULL)
+			mutex->cond_destroy(core_watchdog_wake);
+		if (core_watchdog_lock != NULL)
+			mutex->destroy(core_watchdog_lock);
+		core_watchdog_wake = NULL;
+		core_watchdog_lock = NULL;
+		return;
+	}
+	ShowStatus("Main loop watchdog enabled (threshold: %d ms).\n", core->watchdog_threshold);
+#else
+	ShowWarning("core_watchdog_init: the main loop watchdog is not supported on this platform.\n");
+#endif  // _WIN32
+}
+
+/// Stops the stall watchdog.
+static void core_watchdog_final(void)
+{
+#ifndef _WIN32
+	if (core_watchdog_thread == NULL)
+		return;
+	mutex->lock(core_watchdog_lock);
+	core_watchdog_running = false;
+	mutex->cond_signal(core_watchdog_wake);
+	mutex->unlock(core_watchdog_lock);
+	thread->wait(core_watchdog_thread, NULL);
+	core_watchdog_thread = NULL;
+	mutex->cond_destroy(core_watchdog_wake);
+	mutex->destroy(core_watchdog_lock);
+	core_watchdog_wake = NULL;
+	core_watchdog_lock = NULL;
+	signal(CORE_WATCHDOG_SIGNAL, SIG_IGN);
+#endif  // _WIN32
+}
+
 static void core_defaults(void)
 {
+	core->loop_report = core_loop_report;
+	core->loop_reset = core_loop_reset;
+	core->loop_stats = core_loop_get_stats;
 	nullpo_defaults();
 	hpm_defaults();
 	HCache_defaults();
@@ -266,6 +512,7 @@ static void core_defaults(void)
 	rnd_defaults();
 	md5_defaults();
 	thread_defaults();
+	metrics_defaults();
 }
 
 /**
@@ -344,6 +591,30 @@ static CMDLINEARG(version)
 	return false;
 }
 
+/**
+ * Captures the received traffic to a file, to be replayed with '--traffic-replay'.
+ */
+static CMDLINEARG(trafficrecord)
+{
+	if (!sockt->traffic_record(params)) {
+		ShowFatalError("Unable to capture the traffic to '%s'.\n", params);
+		exit(EXIT_FAILURE);
+	}
+	return true;
+}
+
+/**
+ * Replays a traffic capture instead of using the network.
+ */
+static CMDLINEARG(trafficreplay)
+{
+	if (!sockt->traffic_replay(params)) {
+		ShowFatalError("Unable to replay the traffic captured in '%s'.\n", params);
+		exit(EXIT_FAILURE);
+	}
+	return true;
+}
+
 /**
  * Checks if there is a value available for the current argument
  *
@@ -438,6 +709,8 @@ static void cmdline_init(void)
 	CMDLINEARG_DEF(help, 'h', "Displays this help screen", CMDLINE_OPT_NORMAL);
 	CMDLINEARG_DEF(version, 'v', "Displays the server's version.", CMDLINE_OPT_NORMAL);
 	CMDLINEARG_DEF2(load-plugin, loadplugin, "Loads an additional plugin (can be repeated).", CMDLINE_OPT_PARAM|CMDLINE_OPT_PREINIT);
+	CMDLINEARG_DEF2(traffic-record, trafficrecord, "Captures the received traffic to a file.", CMDLINE_OPT_PARAM|CMDLINE_OPT_PREINIT);
+	CMDLINEARG_DEF2(traffic-replay, trafficreplay, "Replays a traffic capture instead of using the network.", CMDLINE_OPT_PARAM|CMDLINE_OPT_PREINIT);
 	cmdline_args_init_local();
 }
 
@@ -535,18 +808,36 @@ int main(int argc, char **argv)
 
 	do_init(argc,argv);
 
+	core_loop_reset();
+	core_watchdog_init();
+
 	// Main runtime cycle
 	while (core->runflag != CORE_ST_STOP) {
-		int next = timer->perform(timer->gettick_nocache());
+		int64 start = timer->gettick_us(), timers_end, end;
+		int next;
+
+		core->busy_since = start;
+		core->idle_us = 0;
+		next = timer->perform(timer->gettick_nocache());
+		timers_end = timer->gettick_us();
 		sockt->perform(next);
+		end = timer->gettick_us();
+
+		duration_histogram_record(&core_loop_stats[CORE_LOOP_TIMERS], timers_end - start);
+		duration_histogram_record(&core_loop_stats[CORE_LOOP_SOCKETS], end - timers_end - core->idle_us);
+		duration_histogram_record(&core_loop_stats[CORE_LOOP_IDLE], core->idle_us);
+		duration_histogram_record(&core_loop_stats[CORE_LOOP_TOTAL], end - start);
 	}
 
+	core_watchdog_final();
+
 	console->final();
 
 	retval = do_final();
 	HPM->final();
 	timer->final();
 	packets->final();
+	metrics->final();
 	sockt->final();
 	DB->final();
 	thread->final();
@@ -74,6 +74,16 @@ struct cmdline_interface {
 	const char *(*arg_source) (struct CmdlineArgData *arg);
 };
 
+enum core_loop_phase {
+	CORE_LOOP_TIMERS,
+	CORE_LOOP_SOCKETS,
+	CORE_LOOP_IDLE,
+	CORE_LOOP_TOTAL,
+	CORE_LOOP_MAX
+};
+
+struct duration_histogram;
+
 struct core_interface {
 	int arg_c;
 	char **arg_v;
@@ -85,6 +95,18 @@ struct core_interface {
 	/// Called when a terminate signal is received. (Ctrl+C pressed)
 	/// If NULL, runflag is set to CORE_ST_STOP instead.
 	void (*shutdown_callback)(void);
+
+	/* Main loop monitoring */
+	volatile int64 busy_since; ///< When the main thread started its current busy period (us), 0 while it waits for network events.
+	int64 idle_us;             ///< Time spent waiting for network events during the current main loop iteration (us).
+	int watchdog_threshold;    ///< Busy time (ms) after which the stall watchdog reports the main thread, 0 disables it.
+	/// Optional, describes what the server is doing for stall reports.
+	/// Called from the watchdog thread while the main thread is stalled, so it can only read simple values.
+	void (*watchdog_context)(char *buf, size_t size);
+
+	void (*loop_report)(void);
+	void (*loop_reset)(void);
+	const struct duration_histogram *(*loop_stats)(enum core_loop_phase phase);
 };
 
 #define CMDLINEARG(x) bool cmdline_arg_ ## x (const char *name, const char *params)
@@ -27,7 +27,9 @@
  *  (4) Protected functions used in the interface of the database
  *  (5) Public functions
  *
- *  The databases are structured as a hashtable of RED-BLACK trees.
+ *  The databases are structured as a hashtable of RED-BLACK trees, unless
+ *  they are allocated with DB_OPT_OPEN_ADDRESSING, in which case they are
+ *  structured as a resizable open addressing hashtable with linear probing.
  *
  *  <B>Properties of the RED-BLACK trees being used:</B>
  *  1. The value of any node is greater than the value of its left child and
@@ -64,7 +66,20 @@
  *  - change the structure of the database to T-Trees
  *  - create a db that organizes itself by splaying
  *
+ *  <B>Properties of the open addressing hashtable being used:</B>
+ *  1. The number of slots is always a power of 2.
+ *  2. Keys and data are stored inline in the slots, so a lookup is a single
+ *     linear probe sequence over contiguous memory.
+ *  3. Removed entries leave a DB_SLOT_DELETED marker behind, so probe
+ *     sequences going through them keep working. The markers are dropped
+ *     when the table is rebuilt.
+ *  4. The table is rebuilt (and grown if needed) when the used and deleted
+ *     slots go over DB_OA_MAX_LOAD. While the database is locked (ie. there
+ *     are iterators alive) the rebuild is postponed until it's unlocked,
+ *     unless the table is completely full.
+ *
  *  HISTORY:
+ *    2026/10/16 - Added open addressing databases (DB_OPT_OPEN_ADDRESSING)
  *    2013/08/25 - Added int64/uint64 support for keys [Ind/Hercules]
  *    2013/04/27 - Added ERS to speed up iterator memory allocation [Ind/Hercules]
  *    2012/03/09 - Added enum for data types (int, uint, void*)
@@ -111,6 +126,10 @@ struct db_interface *DB;
  *  enum DBNodeColor - Enumeration of colors of the nodes.                   *
  *  struct DBNode     - Structure of a node in RED-BLACK trees.              *
  *  struct db_free    - Structure that holds a deleted node to be freed.     *
+ *  DB_OA_INITIAL_SIZE - Initial size of open addressing hashtables.        *
+ *  DB_OA_MAX_LOAD   - Maximum load of open addressing hashtables.           *
+ *  enum DBSlotState  - Enumeration of states of open addressing slots.      *
+ *  struct DBSlot     - Structure of a slot in open addressing hashtables.   *
  *  struct DBMap_impl - Structure of the database.                           *
  *  stats             - Statistics about the database system.                *
  *****************************************************************************/
@@ -181,6 +200,49 @@ struct db_free {
 	struct DBNode **root;
 };
 
+/**
+ * Initial number of slots of an open addressing hashtable.
+ * Must be a power of 2.
+ * @private
+ * @see struct DBMap_impl#slots
+ */
+#define DB_OA_INITIAL_SIZE 32
+
+/**
+ * Maximum load (used and deleted slots) of an open addressing hashtable, in
+ * sixteenths of its size, before it is rebuilt.
+ * @private
+ * @see #db_oa_reserve()
+ */
+#define DB_OA_MAX_LOAD 12
+
+/**
+ * The state of the slots of an open addressing hashtable.
+ * @private
+ * @see struct DBSlot
+ */
+enum DBSlotState {
+	DB_SLOT_EMPTY = 0,
+	DB_SLOT_USED,
+	DB_SLOT_DELETED,
+};
+
+/**
+ * A slot of an open addressing hashtable.
+ * @param key Key of this database entry
+ * @param data Data of this database entry
+ * @param hash Hash of the key, used to skip most key comparisons
+ * @param state State of the slot (enum DBSlotState)
+ * @private
+ * @see struct DBMap_impl#slots
+ */
+struct DBSlot {
+	union DBKey key;
+	struct DBData data;
+	uint32 hash;
+	uint8 state;
+};
+
 /**
  * Complete database structure.
  * @param vtable Interface of the database
@@ -195,6 +257,9 @@ struct db_free {
  * @param hash Hasher of the database
  * @param release Releaser of the database
  * @param ht Hashtable of RED-BLACK trees
+ * @param slots Open addressing hashtable (DB_OPT_OPEN_ADDRESSING only)
+ * @param slot_count Number of slots in the open addressing hashtable
+ * @param slot_deleted Number of deleted slots in the open addressing hashtable
  * @param type Type of the database
  * @param options Options of the database
  * @param item_count Number of items in the database
@@ -221,6 +286,9 @@ struct DBMap_impl {
 	DBReleaser release;
 	struct DBNode *ht[HASH_SIZE];
 	struct DBNode *cache;
+	struct DBSlot *slots;
+	uint32 slot_count;
+	uint32 slot_deleted;
 	enum DBType type;
 	enum DBOptions options;
 	uint32 item_count;
@@ -232,7 +300,8 @@ struct DBMap_impl {
  * Complete iterator structure.
  * @param vtable Interface of the iterator
  * @param db Parent database
- * @param ht_index Current index of the hashtable
+ * @param ht_index Current index of the hashtable (or slot of the open
+ *          addressing hashtable)
  * @param node Current node
  * @private
  * @see struct DBIterator
@@ -2386,237 +2455,1066 @@ static enum DBOptions db_obj_options(struct DBMap *self)
 }
 
 /*****************************************************************************\
- *  (5) Section with public functions.
- *  db_fix_options     - Apply database type restrictions to the options.
- *  db_default_cmp     - Get the default comparator for a type of database.
- *  db_default_hash    - Get the default hasher for a type of database.
- *  db_default_release - Get the default releaser for a type of database with the specified options.
- *  db_custom_release  - Get a releaser that behaves a certain way.
- *  db_alloc           - Allocate a new database.
- *  db_i2key           - Manual cast from `int` to `union DBKey`.
- *  db_ui2key          - Manual cast from `unsigned int` to `union DBKey`.
- *  db_str2key         - Manual cast from `unsigned char *` to `union DBKey`.
- *  db_i642key         - Manual cast from `int64` to `union DBKey`.
- *  db_ui642key        - Manual cast from `uin64` to `union DBKey`.
- *  db_i2data          - Manual cast from `int` to `struct DBData`.
- *  db_ui2data         - Manual cast from `unsigned int` to `struct DBData`.
- *  db_ptr2data        - Manual cast from `void*` to `struct DBData`.
- *  db_data2i          - Gets `int` value from `struct DBData`.
- *  db_data2ui         - Gets `unsigned int` value from `struct DBData`.
- *  db_data2ptr        - Gets `void*` value from `struct DBData`.
- *  db_init            - Initializes the database system.
- *  db_final           - Finalizes the database system.
+ *  (4b) Section with protected functions used in the interface of open      *
+ *  addressing databases (DB_OPT_OPEN_ADDRESSING) and their iterators.       *
+ *  The wrappers with variable arguments (getall, ensure, foreach, clear and *
+ *  destroy) and size/type/options are shared with the RED-BLACK databases.  *
+ *  db_oa_hash        - Hash of a key, mixed for the power of 2 tables.      *
+ *  db_oa_find        - Find the slot of an entry.                           *
+ *  db_oa_find_insert - Find the slot where an entry is or should be put.    *
+ *  db_oa_rehash      - Rebuild the hashtable with the specified size.       *
+ *  db_oa_reserve     - Make room for one more entry.                        *
+ *  db_oa_unlock      - Unlock the database, rebuilding it if needed.        *
+ *  db_oa_free_slot   - Release an entry and mark its slot as deleted.       *
+ *  dbit_oa_first     - Fetches the first entry from the database.           *
+ *  dbit_oa_last      - Fetches the last entry from the database.            *
+ *  dbit_oa_next      - Fetches the next entry from the database.            *
+ *  dbit_oa_prev      - Fetches the previous entry from the database.        *
+ *  dbit_oa_exists    - Returns true if the current entry exists.            *
+ *  dbit_oa_remove    - Remove the current entry from the database.          *
+ *  dbit_oa_destroy   - Destroys the iterator, unlocking the database.       *
+ *  db_oa_iterator    - Return a new database iterator.                      *
+ *  db_oa_exists      - Checks if an entry exists.                           *
+ *  db_oa_get         - Get the data identified by the key.                  *
+ *  db_oa_vgetall     - Get the data of the matched entries.                 *
+ *  db_oa_vensure     - Get the data identified by the key, creating if it   *
+ *           doesn't exist yet.                                              *
+ *  db_oa_put         - Put data identified by the key in the database.      *
+ *  db_oa_remove      - Remove an entry from the database.                   *
+ *  db_oa_vforeach    - Apply a function to every entry in the database.     *
+ *  db_oa_vclear      - Remove all entries from the database.                *
+ *  db_oa_vdestroy    - Destroy the database, freeing all the used memory.   *
 \*****************************************************************************/
 
 /**
- * Returns the fixed options according to the database type.
- * Sets required options and unsets unsupported options.
- * For numeric databases DB_OPT_DUP_KEY and DB_OPT_RELEASE_KEY are unset.
- * @param type Type of the database
- * @param options Original options of the database
- * @return Fixed options of the database
+ * Returns the hash of a key for an open addressing hashtable.
+ * The default hashers of the numeric databases return the key itself, so the
+ * hash is mixed to spread sequential keys (like block ids) over the table.
+ * @param db Target database
+ * @param key Key to be hashed
+ * @return Mixed hash of the key
  * @private
- * @see #db_default_release()
- * @see #db_alloc()
  */
-static enum DBOptions db_fix_options(enum DBType type, enum DBOptions options)
+static uint32 db_oa_hash(struct DBMap_impl *db, union DBKey key)
 {
-	DB_COUNTSTAT(db_fix_options);
-	switch (type) {
-		case DB_INT:
-		case DB_UINT:
-		case DB_INT64:
-		case DB_UINT64: // Numeric database, do nothing with the keys
-			return (enum DBOptions)(options&~(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY));
+	uint64 h = db->hash(key, db->maxlen);
 
-		default:
-			ShowError("db_fix_options: Unknown database type %u with options %x\n", type, options);
-			FALLTHROUGH
-		case DB_STRING:
-		case DB_ISTRING: // String databases, no fix required
-			return options;
-	}
+	h ^= h >> 33;
+	h *= UINT64_C(0xff51afd7ed558ccd);
+	h ^= h >> 33;
+	h *= UINT64_C(0xc4ceb9fe1a85ec53);
+	h ^= h >> 33;
+	return (uint32)h;
 }
 
 /**
- * Returns the default comparator for the specified type of database.
- * @param type Type of database
- * @return Comparator for the type of database or NULL if unknown database
- * @public
- * @see #db_int_cmp()
- * @see #db_uint_cmp()
- * @see #db_string_cmp()
- * @see #db_istring_cmp()
- * @see #db_int64_cmp()
- * @see #db_uint64_cmp()
+ * Finds the slot of the entry identified by the key.
+ * @param db Target database
+ * @param key Key that identifies the entry
+ * @param hash Hash of the key
+ * @return Slot of the entry or NULL if not found
+ * @private
  */
-static DBComparator db_default_cmp(enum DBType type)
+static struct DBSlot *db_oa_find(struct DBMap_impl *db, union DBKey key, uint32 hash)
 {
-	DB_COUNTSTAT(db_default_cmp);
-	switch (type) {
-		case DB_INT:     return &db_int_cmp;
-		case DB_UINT:    return &db_uint_cmp;
-		case DB_STRING:  return &db_string_cmp;
-		case DB_ISTRING: return &db_istring_cmp;
-		case DB_INT64:   return &db_int64_cmp;
-		case DB_UINT64:  return &db_uint64_cmp;
-		default:
-			ShowError("db_default_cmp: Unknown database type %u\n", type);
+	uint32 mask = db->slot_count - 1;
+	uint32 i = hash & mask;
+
+	while (true) {
+		struct DBSlot *slot = &db->slots[i];
+		if (slot->state == DB_SLOT_EMPTY)
 			return NULL;
+		if (slot->state == DB_SLOT_USED && slot->hash == hash && db->cmp(key, slot->key, db->maxlen) == 0)
+			return slot;
+		i = (i + 1) & mask;
 	}
 }
 
 /**
- * Returns the default hasher for the specified type of database.
- * @param type Type of database
- * @return Hasher of the type of database or NULL if unknown database
- * @public
- * @see #db_int_hash()
- * @see #db_uint_hash()
- * @see #db_string_hash()
- * @see #db_istring_hash()
- * @see #db_int64_hash()
- * @see #db_uint64_hash()
+ * Finds the slot of the entry identified by the key, or the slot where it
+ * should be put if it doesn't exist.
+ * Deleted slots found in the probe sequence are reused.
+ * @param db Target database
+ * @param key Key that identifies the entry
+ * @param hash Hash of the key
+ * @return Slot of the entry (DB_SLOT_USED) or a free slot
+ * @private
  */
-static DBHasher db_default_hash(enum DBType type)
+static struct DBSlot *db_oa_find_insert(struct DBMap_impl *db, union DBKey key, uint32 hash)
+{
+	uint32 mask = db->slot_count - 1;
+	uint32 i = hash & mask;
+	struct DBSlot *deleted = NULL;
+
+	while (true) {
+		struct DBSlot *slot = &db->slots[i];
+		if (slot->state == DB_SLOT_EMPTY)
+			return (deleted != NULL) ? deleted : slot;
+		if (slot->state == DB_SLOT_DELETED) {
+			if (deleted == NULL)
+				deleted = slot;
+		} else if (slot->hash == hash && db->cmp(key, slot->key, db->maxlen) == 0) {
+			return slot;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+/**
+ * Rebuilds the open addressing hashtable with the specified number of slots,
+ * dropping the deleted slots.
+ * @param db Target database
+ * @param slot_count New number of slots (power of 2, greater than the number of entries)
+ * @private
+ */
+static void db_oa_rehash(struct DBMap_impl *db, uint32 slot_count)
 {
-	DB_COUNTSTAT(db_default_hash);
-	switch (type) {
-		case DB_INT:     return &db_int_hash;
-		case DB_UINT:    return &db_uint_hash;
-		case DB_STRING:  return &db_string_hash;
-		case DB_ISTRING: return &db_istring_hash;
-		case DB_INT64:   return &db_int64_hash;
-		case DB_UINT64:  return &db_uint64_hash;
-		default:
-			ShowError("db_default_hash: Unknown database type %u\n", type);
-			return NULL;
+	struct DBSlot *old_slots = db->slots;
+	uint32 old_count = db->slot_count;
+	uint32 i;
+
+	db->slots = aCalloc(slot_count, sizeof(struct DBSlot));
+	db->slot_count = slot_count;
+	db->slot_deleted = 0;
+	for (i = 0; i < old_count; i++) {
+		uint32 mask = slot_count - 1;
+		uint32 j;
+
+		if (old_slots[i].state != DB_SLOT_USED)
+			continue;
+		for (j = old_slots[i].hash & mask; db->slots[j].state != DB_SLOT_EMPTY; j = (j + 1) & mask)
+			;
+		db->slots[j] = old_slots[i];
 	}
+	aFree(old_slots);
 }
 
 /**
- * Returns the default releaser for the specified type of database with the
- * specified options.
- *
- * NOTE: the options are fixed with #db_fix_options() before choosing the
- * releaser.
- *
- * @param type Type of database
- * @param options Options of the database
- * @return Default releaser for the type of database with the specified options
- * @public
- * @see #db_release_nothing()
- * @see #db_release_key()
- * @see #db_release_data()
- * @see #db_release_both()
- * @see #db_custom_release()
+ * Makes sure there is room in the open addressing hashtable for one more
+ * entry, rebuilding it if the load is too high.
+ * While the database is locked the rebuild is postponed until
+ * #db_oa_unlock(), unless the hashtable is completely full.
+ * @param db Target database
+ * @private
  */
-static DBReleaser db_default_release(enum DBType type, enum DBOptions options)
+static void db_oa_reserve(struct DBMap_impl *db)
 {
-	DB_COUNTSTAT(db_default_release);
-	options = DB->fix_options(type, options);
-	if (options&DB_OPT_RELEASE_DATA) { // Release data, what about the key?
-		if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
-			return &db_release_both; // Release both key and data
-		return &db_release_data; // Only release data
+	uint32 load = db->item_count + db->slot_deleted + 1;
+	uint32 slot_count = db->slot_count;
+
+	if ((uint64)load * 16 <= (uint64)slot_count * DB_OA_MAX_LOAD)
+		return;
+	if (db->free_lock != 0) {
+		if (load < slot_count)
+			return; // postponed until the database is unlocked
+		ShowWarning("db_oa_reserve: Hashtable is full while the database is locked, iterators might skip or repeat entries.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
 	}
-	if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
-		return &db_release_key; // Only release key
-	return &db_release_nothing; // Release nothing
+	// keep the load at or under half of the hashtable after rebuilding it
+	while ((uint64)(db->item_count + 1) * 2 > slot_count)
+		slot_count <<= 1;
+	db_oa_rehash(db, slot_count);
 }
 
 /**
- * Returns the releaser that releases the specified release options.
- * @param which Options that specified what the releaser releases
- * @return Releaser for the specified release options
- * @public
- * @see #db_release_nothing()
- * @see #db_release_key()
- * @see #db_release_data()
- * @see #db_release_both()
- * @see #db_default_release()
+ * Unlocks the database, rebuilding the open addressing hashtable if
+ * insertions or removals done while it was locked left it overloaded.
+ * @param db Target database
+ * @private
+ * @see #db_free_unlock()
  */
-static DBReleaser db_custom_release(enum DBReleaseOption which)
+static void db_oa_unlock(struct DBMap_impl *db)
 {
-	DB_COUNTSTAT(db_custom_release);
-	switch (which) {
-		case DB_RELEASE_NOTHING: return &db_release_nothing;
-		case DB_RELEASE_KEY:     return &db_release_key;
-		case DB_RELEASE_DATA:    return &db_release_data;
-		case DB_RELEASE_BOTH:    return &db_release_both;
-		default:
-			ShowError("db_custom_release: Unknown release options %u\n", which);
-			return NULL;
+	db_free_unlock(db);
+	if (db->free_lock == 0 && db->global_lock == 0 && db->slots != NULL
+	 && (uint64)(db->item_count + db->slot_deleted) * 16 > (uint64)db->slot_count * DB_OA_MAX_LOAD) {
+		uint32 slot_count = db->slot_count;
+		while ((uint64)db->item_count * 2 > slot_count)
+			slot_count <<= 1;
+		db_oa_rehash(db, slot_count);
 	}
 }
 
 /**
- * Allocate a new database of the specified type.
- *
- * NOTE: the options are fixed by #db_fix_options() before creating the
- * database.
- *
- * @param file File where the database is being allocated
- * @param line Line of the file where the database is being allocated
- * @param type Type of database
- * @param options Options of the database
- * @param maxlen Maximum length of the string to be used as key in string
- *          databases. If 0, the maximum number of maxlen is used (64K).
- * @return The interface of the database
- * @public
- * @see struct DBMap_impl
- * @see #db_fix_options()
+ * Releases the key of an entry whose data was already released, and marks
+ * its slot as deleted.
+ * @param db Target database
+ * @param slot Slot of the entry
+ * @private
  */
-static struct DBMap *db_alloc(const char *file, const char *func, int line, enum DBType type, enum DBOptions options, unsigned short maxlen)
+static void db_oa_free_slot(struct DBMap_impl *db, struct DBSlot *slot)
 {
-	struct DBMap_impl *db;
-	unsigned int i;
-	char ers_name[50];
+	if (db->options&DB_OPT_DUP_KEY)
+		db_dup_key_free(db, slot->key);
+	else
+		db->release(slot->key, slot->data, DB_RELEASE_KEY);
+	slot->state = DB_SLOT_DELETED;
+	db->slot_deleted++;
+	db->item_count--;
+}
 
-#ifdef DB_ENABLE_STATS
-	DB_COUNTSTAT(db_alloc);
-	switch (type) {
-		case DB_INT: DB_COUNTSTAT(db_int_alloc); break;
-		case DB_UINT: DB_COUNTSTAT(db_uint_alloc); break;
-		case DB_STRING: DB_COUNTSTAT(db_string_alloc); break;
-		case DB_ISTRING: DB_COUNTSTAT(db_istring_alloc); break;
-		case DB_INT64: DB_COUNTSTAT(db_int64_alloc); break;
-		case DB_UINT64: DB_COUNTSTAT(db_uint64_alloc); break;
-	}
-#endif /* DB_ENABLE_STATS */
-	db = ers_alloc(db_alloc_ers, struct DBMap_impl);
+/**
+ * Fetches the first entry in the database.
+ * Returns the data of the entry.
+ * Puts the key in out_key, if out_key is not NULL.
+ * @param self Iterator
+ * @param out_key Key of the entry
+ * @return Data of the entry
+ * @protected
+ * @see struct DBIterator#first()
+ */
+static struct DBData *dbit_oa_first(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
 
-	options = DB->fix_options(type, options);
-	/* Interface of the database */
-	db->vtable.iterator = db_obj_iterator;
-	db->vtable.exists   = db_obj_exists;
-	db->vtable.get      = db_obj_get;
-	db->vtable.getall   = db_obj_getall;
-	db->vtable.vgetall  = db_obj_vgetall;
-	db->vtable.ensure   = db_obj_ensure;
-	db->vtable.vensure  = db_obj_vensure;
-	db->vtable.put      = db_obj_put;
-	db->vtable.remove   = db_obj_remove;
-	db->vtable.foreach  = db_obj_foreach;
-	db->vtable.vforeach = db_obj_vforeach;
-	db->vtable.clear    = db_obj_clear;
-	db->vtable.vclear   = db_obj_vclear;
-	db->vtable.destroy  = db_obj_destroy;
-	db->vtable.vdestroy = db_obj_vdestroy;
-	db->vtable.size     = db_obj_size;
-	db->vtable.type     = db_obj_type;
-	db->vtable.options  = db_obj_options;
-	/* File and line of allocation */
-	db->alloc_file = file;
-	db->alloc_line = line;
-	/* Lock system */
-	db->free_list = NULL;
-	db->free_count = 0;
-	db->free_max = 0;
-	db->free_lock = 0;
-	/* Other */
-	snprintf(ers_name, 50, "db_alloc:nodes:%s:%s:%d",func,file,line);
-	db->nodes = ers_new(sizeof(struct DBNode),ers_name,ERS_OPT_WAIT|ERS_OPT_FREE_NAME|ERS_OPT_CLEAN);
+	DB_COUNTSTAT(dbit_first);
+	// position before the first entry
+	it->ht_index = -1;
+	// get next entry
+	return self->next(self, out_key);
+}
+
+/**
+ * Fetches the last entry in the database.
+ * Returns the data of the entry.
+ * Puts the key in out_key, if out_key is not NULL.
+ * @param self Iterator
+ * @param out_key Key of the entry
+ * @return Data of the entry
+ * @protected
+ * @see struct DBIterator#last()
+ */
+static struct DBData *dbit_oa_last(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+
+	DB_COUNTSTAT(dbit_last);
+	// position after the last entry
+	it->ht_index = (int)it->db->slot_count;
+	// get previous entry
+	return self->prev(self, out_key);
+}
+
+/**
+ * Fetches the next entry in the database.
+ * Returns the data of the entry.
+ * Puts the key in out_key, if out_key is not NULL.
+ * @param self Iterator
+ * @param out_key Key of the entry
+ * @return Data of the entry
+ * @protected
+ * @see struct DBIterator#next()
+ */
+static struct DBData *dbit_oa_next(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+	struct DBMap_impl *db = it->db;
+
+	DB_COUNTSTAT(dbit_next);
+	if (it->ht_index < -1)
+		it->ht_index = -1;
+	while (++(it->ht_index) < (int)db->slot_count) {
+		struct DBSlot *slot = &db->slots[it->ht_index];
+		if (slot->state == DB_SLOT_USED) {
+			if (out_key)
+				memcpy(out_key, &slot->key, sizeof(union DBKey));
+			return &slot->data;
+		}
+	}
+	it->ht_index = (int)db->slot_count;
+	return NULL; // not found
+}
+
+/**
+ * Fetches the previous entry in the database.
+ * Returns the data of the entry.
+ * Puts the key in out_key, if out_key is not NULL.
+ * @param self Iterator
+ * @param out_key Key of the entry
+ * @return Data of the entry
+ * @protected
+ * @see struct DBIterator#prev()
+ */
+static struct DBData *dbit_oa_prev(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+	struct DBMap_impl *db = it->db;
+
+	DB_COUNTSTAT(dbit_prev);
+	if (it->ht_index > (int)db->slot_count)
+		it->ht_index = (int)db->slot_count;
+	while (--(it->ht_index) >= 0) {
+		struct DBSlot *slot = &db->slots[it->ht_index];
+		if (slot->state == DB_SLOT_USED) {
+			if (out_key)
+				memcpy(out_key, &slot->key, sizeof(union DBKey));
+			return &slot->data;
+		}
+	}
+	it->ht_index = -1;
+	return NULL; // not found
+}
+
+/**
+ * Returns true if the fetched entry exists.
+ * The databases entries might have NULL data, so use this to to test if
+ * the iterator is done.
+ * @param self Iterator
+ * @return true if the entry exists
+ * @protected
+ * @see struct DBIterator#exists()
+ */
+static bool dbit_oa_exists(struct DBIterator *self)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+
+	DB_COUNTSTAT(dbit_exists);
+	return (it->ht_index >= 0 && it->ht_index < (int)it->db->slot_count
+			&& it->db->slots[it->ht_index].state == DB_SLOT_USED);
+}
+
+/**
+ * Removes the current entry from the database.
+ *
+ * NOTE: struct DBIterator#exists() will return false until another entry is
+ * fetched.
+ *
+ * Puts data of the removed entry in out_data, if out_data is not NULL (unless data has been released)
+ * @param self Iterator
+ * @param out_data Data of the removed entry.
+ * @return 1 if entry was removed, 0 otherwise
+ * @protected
+ * @see struct DBMap#remove()
+ * @see struct DBIterator#remove()
+ */
+static int dbit_oa_remove(struct DBIterator *self, struct DBData *out_data)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+	struct DBMap_impl *db = it->db;
+	struct DBSlot *slot;
+
+	DB_COUNTSTAT(dbit_remove);
+	if (!self->exists(self))
+		return 0;
+	slot = &db->slots[it->ht_index];
+	db->release(slot->key, slot->data, DB_RELEASE_DATA);
+	if (out_data)
+		memcpy(out_data, &slot->data, sizeof(struct DBData));
+	db_oa_free_slot(db, slot);
+	return 1;
+}
+
+/**
+ * Destroys this iterator and unlocks the database.
+ * @param self Iterator
+ * @protected
+ */
+static void dbit_oa_destroy(struct DBIterator *self)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+
+	DB_COUNTSTAT(dbit_destroy);
+	// unlock the database
+	db_oa_unlock(it->db);
+	// free iterator
+	ers_free(db_iterator_ers,self);
+}
+
+/**
+ * Returns a new iterator for this database.
+ * The iterator keeps the database locked until it is destroyed.
+ * The database will keep functioning normally but will only be rebuilt when
+ * unlocked, so destroy the iterator as soon as possible.
+ * @param self Database
+ * @return New iterator
+ * @protected
+ */
+static struct DBIterator *db_oa_iterator(struct DBMap *self)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBIterator_impl *it;
+
+	DB_COUNTSTAT(db_iterator);
+	it = ers_alloc(db_iterator_ers, struct DBIterator_impl);
+	/* Interface of the iterator **/
+	it->vtable.first   = dbit_oa_first;
+	it->vtable.last    = dbit_oa_last;
+	it->vtable.next    = dbit_oa_next;
+	it->vtable.prev    = dbit_oa_prev;
+	it->vtable.exists  = dbit_oa_exists;
+	it->vtable.remove  = dbit_oa_remove;
+	it->vtable.destroy = dbit_oa_destroy;
+	/* Initial state (before the first entry) */
+	it->db = db;
+	it->ht_index = -1;
+	it->node = NULL;
+	/* Lock the database */
+	db_free_lock(db);
+	return &it->vtable;
+}
+
+/**
+ * Returns true if the entry exists.
+ * @param self Interface of the database
+ * @param key Key that identifies the entry
+ * @return true is the entry exists
+ * @protected
+ * @see struct DBMap#exists()
+ */
+static bool db_oa_exists(struct DBMap *self, union DBKey key)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+
+	DB_COUNTSTAT(db_exists);
+	if (db == NULL) return false; // nullpo candidate
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		return false; // nullpo candidate
+	}
+
+	return (db_oa_find(db, key, db_oa_hash(db, key)) != NULL);
+}
+
+/**
+ * Get the data of the entry identified by the key.
+ * NOTE: The returned pointer is only valid until the next insertion.
+ * @param self Interface of the database
+ * @param key Key that identifies the entry
+ * @return Data of the entry or NULL if not found
+ * @protected
+ * @see struct DBMap#get()
+ */
+static struct DBData *db_oa_get(struct DBMap *self, union DBKey key)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBSlot *slot;
+
+	DB_COUNTSTAT(db_get);
+	if (db == NULL) return NULL; // nullpo candidate
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_get: Attempted to retrieve non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return NULL; // nullpo candidate
+	}
+
+	slot = db_oa_find(db, key, db_oa_hash(db, key));
+	if (slot == NULL)
+		return NULL;
+	return &slot->data;
+}
+
+/**
+ * Get the data of the entries matched by <code>match</code>.
+ * It puts a maximum of <code>max</code> entries into <code>buf</code>.
+ * If <code>buf</code> is NULL, it only counts the matches.
+ * Returns the number of entries that matched.
+ * NOTE: if the value returned is greater than <code>max</code>, only the
+ * first <code>max</code> entries found are put into the buffer.
+ * @param self Interface of the database
+ * @param buf Buffer to put the data of the matched entries
+ * @param max Maximum number of data entries to be put into buf
+ * @param match Function that matches the database entries
+ * @param args Extra arguments for match
+ * @return The number of entries that matched
+ * @protected
+ * @see struct DBMap#vgetall()
+ */
+static unsigned int db_oa_vgetall(struct DBMap *self, struct DBData **buf, unsigned int max, DBMatcher match, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	uint32 i;
+	unsigned int ret = 0;
+
+	DB_COUNTSTAT(db_vgetall);
+	if (db == NULL) return 0; // nullpo candidate
+	if (match == NULL) return 0; // nullpo candidate
+
+	db_free_lock(db);
+	for (i = 0; i < db->slot_count; i++) {
+		struct DBSlot *slot = &db->slots[i];
+		va_list argscopy;
+
+		if (slot->state != DB_SLOT_USED)
+			continue;
+		va_copy(argscopy, args);
+		if (match(slot->key, slot->data, argscopy) == 0) {
+			if (buf && ret < max)
+				buf[ret] = &slot->data;
+			ret++;
+		}
+		va_end(argscopy);
+	}
+	db_oa_unlock(db);
+	return ret;
+}
+
+/**
+ * Get the data of the entry identified by the key.
+ * If the entry does not exist, an entry is added with the data returned by
+ * <code>create</code>.
+ * NOTE: The returned pointer is only valid until the next insertion.
+ * @param self Interface of the database
+ * @param key Key that identifies the entry
+ * @param create Function used to create the data if the entry doesn't exist
+ * @param args Extra arguments for create
+ * @return Data of the entry
+ * @protected
+ * @see struct DBMap#vensure()
+ */
+static struct DBData *db_oa_vensure(struct DBMap *self, union DBKey key, DBCreateData create, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBSlot *slot;
+	uint32 hash;
+
+	DB_COUNTSTAT(db_vensure);
+	if (db == NULL) return NULL; // nullpo candidate
+	if (create == NULL) {
+		ShowError("db_ensure: Create function is NULL for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return NULL; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_ensure: Attempted to use non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return NULL; // nullpo candidate
+	}
+
+	hash = db_oa_hash(db, key);
+	slot = db_oa_find(db, key, hash);
+	if (slot == NULL) {
+		struct DBData data;
+		va_list argscopy;
+
+		if (db->item_count == UINT32_MAX) {
+			ShowError("db_vensure: item_count overflow, aborting item insertion.\n"
+					"Database allocated at %s:%d",
+					db->alloc_file, db->alloc_line);
+			return NULL;
+		}
+		// create the data first, create() might use the database
+		va_copy(argscopy, args);
+		data = create(key, argscopy);
+		va_end(argscopy);
+		db_oa_reserve(db);
+		slot = db_oa_find_insert(db, key, hash);
+		if (slot->state == DB_SLOT_DELETED)
+			db->slot_deleted--;
+		slot->state = DB_SLOT_USED;
+		slot->hash = hash;
+		db->item_count++;
+		// put key and data in the slot
+		if (db->options&DB_OPT_DUP_KEY) {
+			slot->key = db_dup_key(db, key);
+			if (db->options&DB_OPT_RELEASE_KEY)
+				db->release(key, data, DB_RELEASE_KEY);
+		} else {
+			slot->key = key;
+		}
+		slot->data = data;
+	}
+	return &slot->data;
+}
+
+/**
+ * Put the data identified by the key in the database.
+ * Puts the previous data in out_data, if out_data is not NULL. (unless data has been released)
+ * NOTE: Uses the new key, the old one is released.
+ * @param self Interface of the database
+ * @param key Key that identifies the data
+ * @param data Data to be put in the database
+ * @param out_data Previous data if the entry exists
+ * @return 1 if if the entry already exists, 0 otherwise
+ * @protected
+ * @see struct DBMap#put()
+ */
+static int db_oa_put(struct DBMap *self, union DBKey key, struct DBData data, struct DBData *out_data)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBSlot *slot;
+	uint32 hash;
+	int retval = 0;
+
+	DB_COUNTSTAT(db_put);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_put: Database is being destroyed, aborting entry insertion.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_put: Attempted to use non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_DATA) && (data.type == DB_DATA_PTR && data.u.ptr == NULL)) {
+		ShowError("db_put: Attempted to use non-allowed NULL data for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	if (db->item_count == UINT32_MAX) {
+		ShowError("db_put: item_count overflow, aborting item insertion.\n"
+				"Database allocated at %s:%d",
+				db->alloc_file, db->alloc_line);
+		return 0;
+	}
+	hash = db_oa_hash(db, key);
+	slot = db_oa_find(db, key, hash);
+	if (slot != NULL) { // equal entry, replace
+		db->release(slot->key, slot->data, DB_RELEASE_BOTH);
+		if (out_data)
+			memcpy(out_data, &slot->data, sizeof(*out_data));
+		retval = 1;
+	} else {
+		db_oa_reserve(db);
+		slot = db_oa_find_insert(db, key, hash);
+		if (slot->state == DB_SLOT_DELETED)
+			db->slot_deleted--;
+		slot->state = DB_SLOT_USED;
+		slot->hash = hash;
+		db->item_count++;
+	}
+	// put key and data in the slot
+	if (db->options&DB_OPT_DUP_KEY) {
+		slot->key = db_dup_key(db, key);
+		if (db->options&DB_OPT_RELEASE_KEY)
+			db->release(key, data, DB_RELEASE_KEY);
+	} else {
+		slot->key = key;
+	}
+	slot->data = data;
+	return retval;
+}
+
+/**
+ * Remove an entry from the database.
+ * Puts the previous data in out_data, if out_data is not NULL. (unless data has been released)
+ * NOTE: The key (of the database) is released in #db_oa_free_slot().
+ * @param self Interface of the database
+ * @param key Key that identifies the entry
+ * @param out_data Previous data if the entry exists
+ * @return 1 if if the entry already exists, 0 otherwise
+ * @protected
+ * @see #db_oa_free_slot()
+ * @see struct DBMap#remove()
+ */
+static int db_oa_remove(struct DBMap *self, union DBKey key, struct DBData *out_data)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBSlot *slot;
+
+	DB_COUNTSTAT(db_remove);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_remove: Database is being destroyed. Aborting entry deletion.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_remove: Attempted to use non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	slot = db_oa_find(db, key, db_oa_hash(db, key));
+	if (slot == NULL)
+		return 0;
+	db->release(slot->key, slot->data, DB_RELEASE_DATA);
+	if (out_data)
+		memcpy(out_data, &slot->data, sizeof(*out_data));
+	db_oa_free_slot(db, slot);
+	return 1;
+}
+
+/**
+ * Apply <code>func</code> to every entry in the database.
+ * Returns the sum of values returned by func.
+ * @param self Interface of the database
+ * @param func Function to be applied
+ * @param args Extra arguments for func
+ * @return Sum of the values returned by func
+ * @protected
+ * @see struct DBMap#vforeach()
+ */
+static int db_oa_vforeach(struct DBMap *self, DBApply func, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	uint32 i;
+	int sum = 0;
+
+	DB_COUNTSTAT(db_vforeach);
+	if (db == NULL) return 0; // nullpo candidate
+	if (func == NULL) {
+		ShowError("db_foreach: Passed function is NULL for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	db_free_lock(db);
+	for (i = 0; i < db->slot_count; i++) {
+		va_list argscopy;
+
+		// func might insert entries, so the slots are always accessed through db
+		if (db->slots[i].state != DB_SLOT_USED)
+			continue;
+		va_copy(argscopy, args);
+		sum += func(db->slots[i].key, &db->slots[i].data, argscopy);
+		va_end(argscopy);
+	}
+	db_oa_unlock(db);
+	return sum;
+}
+
+/**
+ * Removes all entries from the database.
+ * Before deleting an entry, func is applied to it.
+ * Releases the key and the data.
+ * Returns the sum of values returned by func, if it exists.
+ * @param self Interface of the database
+ * @param func Function to be applied to every entry before deleting
+ * @param args Extra arguments for func
+ * @return Sum of values returned by func
+ * @protected
+ * @see struct DBMap#vclear()
+ */
+static int db_oa_vclear(struct DBMap *self, DBApply func, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	int sum = 0;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vclear);
+	if (db == NULL) return 0; // nullpo candidate
+
+	db_free_lock(db);
+	for (i = 0; i < db->slot_count; i++) {
+		struct DBSlot *slot = &db->slots[i];
+
+		if (slot->state == DB_SLOT_USED) {
+			if (func) {
+				va_list argscopy;
+				va_copy(argscopy, args);
+				sum += func(slot->key, &slot->data, argscopy);
+				va_end(argscopy);
+				slot = &db->slots[i];
+				if (slot->state != DB_SLOT_USED)
+					continue; // func removed it
+			}
+			db->release(slot->key, slot->data, DB_RELEASE_DATA);
+			db_oa_free_slot(db, slot);
+		}
+	}
+	if (db->free_lock == 1 && db->global_lock == 0) {
+		// nothing is iterating the database, shrink it back
+		aFree(db->slots);
+		db->slots = aCalloc(DB_OA_INITIAL_SIZE, sizeof(struct DBSlot));
+		db->slot_count = DB_OA_INITIAL_SIZE;
+		db->slot_deleted = 0;
+	}
+	db_oa_unlock(db);
+	return sum;
+}
+
+/**
+ * Finalize the database, feeing all the memory it uses.
+ * Before deleting an entry, func is applied to it.
+ * Returns the sum of values returned by func, if it exists.
+ * NOTE: This locks the database globally. Any attempt to insert or remove
+ * a database entry will give an error and be aborted (except for clearing).
+ * @param self Interface of the database
+ * @param func Function to be applied to every entry before deleting
+ * @param args Extra arguments for func
+ * @return Sum of values returned by func
+ * @protected
+ * @see struct DBMap#vdestroy()
+ */
+static int db_oa_vdestroy(struct DBMap *self, DBApply func, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	int sum;
+
+	DB_COUNTSTAT(db_vdestroy);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_vdestroy: Database is already locked for destruction. Aborting second database destruction.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0;
+	}
+	if (db->free_lock)
+		ShowWarning("db_vdestroy: Database is still in use, %u lock(s) left. Continuing database destruction.\n"
+				"Database allocated at %s:%d\n",
+				db->free_lock, db->alloc_file, db->alloc_line);
+
+	db_free_lock(db);
+	db->global_lock = 1;
+	sum = self->vclear(self, func, args);
+	aFree(db->slots);
+	db->slots = NULL;
+	db->slot_count = 0;
+	db_free_unlock(db);
+	ers_free(db_alloc_ers, db);
+	return sum;
+}
+
+/*****************************************************************************\
+ *  (5) Section with public functions.
+ *  db_fix_options     - Apply database type restrictions to the options.
+ *  db_default_cmp     - Get the default comparator for a type of database.
+ *  db_default_hash    - Get the default hasher for a type of database.
+ *  db_default_release - Get the default releaser for a type of database with the specified options.
+ *  db_custom_release  - Get a releaser that behaves a certain way.
+ *  db_alloc           - Allocate a new database.
+ *  db_i2key           - Manual cast from `int` to `union DBKey`.
+ *  db_ui2key          - Manual cast from `unsigned int` to `union DBKey`.
+ *  db_str2key         - Manual cast from `unsigned char *` to `union DBKey`.
+ *  db_i642key         - Manual cast from `int64` to `union DBKey`.
+ *  db_ui642key        - Manual cast from `uin64` to `union DBKey`.
+ *  db_i2data          - Manual cast from `int` to `struct DBData`.
+ *  db_ui2data         - Manual cast from `unsigned int` to `struct DBData`.
+ *  db_ptr2data        - Manual cast from `void*` to `struct DBData`.
+ *  db_data2i          - Gets `int` value from `struct DBData`.
+ *  db_data2ui         - Gets `unsigned int` value from `struct DBData`.
+ *  db_data2ptr        - Gets `void*` value from `struct DBData`.
+ *  db_init            - Initializes the database system.
+ *  db_final           - Finalizes the database system.
+\*****************************************************************************/
+
+/**
+ * Returns the fixed options according to the database type.
+ * Sets required options and unsets unsupported options.
+ * For numeric databases DB_OPT_DUP_KEY and DB_OPT_RELEASE_KEY are unset.
+ * @param type Type of the database
+ * @param options Original options of the database
+ * @return Fixed options of the database
+ * @private
+ * @see #db_default_release()
+ * @see #db_alloc()
+ */
+static enum DBOptions db_fix_options(enum DBType type, enum DBOptions options)
+{
+	DB_COUNTSTAT(db_fix_options);
+	switch (type) {
+		case DB_INT:
+		case DB_UINT:
+		case DB_INT64:
+		case DB_UINT64: // Numeric database, do nothing with the keys
+			return (enum DBOptions)(options&~(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY));
+
+		default:
+			ShowError("db_fix_options: Unknown database type %u with options %x\n", type, options);
+			FALLTHROUGH
+		case DB_STRING:
+		case DB_ISTRING: // String databases, no fix required
+			return options;
+	}
+}
+
+/**
+ * Returns the default comparator for the specified type of database.
+ * @param type Type of database
+ * @return Comparator for the type of database or NULL if unknown database
+ * @public
+ * @see #db_int_cmp()
+ * @see #db_uint_cmp()
+ * @see #db_string_cmp()
+ * @see #db_istring_cmp()
+ * @see #db_int64_cmp()
+ * @see #db_uint64_cmp()
+ */
+static DBComparator db_default_cmp(enum DBType type)
+{
+	DB_COUNTSTAT(db_default_cmp);
+	switch (type) {
+		case DB_INT:     return &db_int_cmp;
+		case DB_UINT:    return &db_uint_cmp;
+		case DB_STRING:  return &db_string_cmp;
+		case DB_ISTRING: return &db_istring_cmp;
+		case DB_INT64:   return &db_int64_cmp;
+		case DB_UINT64:  return &db_uint64_cmp;
+		default:
+			ShowError("db_default_cmp: Unknown database type %u\n", type);
+			return NULL;
+	}
+}
+
+/**
+ * Returns the default hasher for the specified type of database.
+ * @param type Type of database
+ * @return Hasher of the type of database or NULL if unknown database
+ * @public
+ * @see #db_int_hash()
+ * @see #db_uint_hash()
+ * @see #db_string_hash()
+ * @see #db_istring_hash()
+ * @see #db_int64_hash()
+ * @see #db_uint64_hash()
+ */
+static DBHasher db_default_hash(enum DBType type)
+{
+	DB_COUNTSTAT(db_default_hash);
+	switch (type) {
+		case DB_INT:     return &db_int_hash;
+		case DB_UINT:    return &db_uint_hash;
+		case DB_STRING:  return &db_string_hash;
+		case DB_ISTRING: return &db_istring_hash;
+		case DB_INT64:   return &db_int64_hash;
+		case DB_UINT64:  return &db_uint64_hash;
+		default:
+			ShowError("db_default_hash: Unknown database type %u\n", type);
+			return NULL;
+	}
+}
+
+/**
+ * Returns the default releaser for the specified type of database with the
+ * specified options.
+ *
+ * NOTE: the options are fixed with #db_fix_options() before choosing the
+ * releaser.
+ *
+ * @param type Type of database
+ * @param options Options of the database
+ * @return Default releaser for the type of database with the specified options
+ * @public
+ * @see #db_release_nothing()
+ * @see #db_release_key()
+ * @see #db_release_data()
+ * @see #db_release_both()
+ * @see #db_custom_release()
+ */
+static DBReleaser db_default_release(enum DBType type, enum DBOptions options)
+{
+	DB_COUNTSTAT(db_default_release);
+	options = DB->fix_options(type, options);
+	if (options&DB_OPT_RELEASE_DATA) { // Release data, what about the key?
+		if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
+			return &db_release_both; // Release both key and data
+		return &db_release_data; // Only release data
+	}
+	if (options&(DB_OPT_DUP_KEY|DB_OPT_RELEASE_KEY))
+		return &db_release_key; // Only release key
+	return &db_release_nothing; // Release nothing
+}
+
+/**
+ * Returns the releaser that releases the specified release options.
+ * @param which Options that specified what the releaser releases
+ * @return Releaser for the specified release options
+ * @public
+ * @see #db_release_nothing()
+ * @see #db_release_key()
+ * @see #db_release_data()
+ * @see #db_release_both()
+ * @see #db_default_release()
+ */
+static DBReleaser db_custom_release(enum DBReleaseOption which)
+{
+	DB_COUNTSTAT(db_custom_release);
+	switch (which) {
+		case DB_RELEASE_NOTHING: return &db_release_nothing;
+		case DB_RELEASE_KEY:     return &db_release_key;
+		case DB_RELEASE_DATA:    return &db_release_data;
+		case DB_RELEASE_BOTH:    return &db_release_both;
+		default:
+			ShowError("db_custom_release: Unknown release options %u\n", which);
+			return NULL;
+	}
+}
+
+/**
+ * Allocate a new database of the specified type.
+ *
+ * NOTE: the options are fixed by #db_fix_options() before creating the
+ * database.
+ *
+ * @param file File where the database is being allocated
+ * @param line Line of the file where the database is being allocated
+ * @param type Type of database
+ * @param options Options of the database
+ * @param maxlen Maximum length of the string to be used as key in string
+ *          databases. If 0, the maximum number of maxlen is used (64K).
+ * @return The interface of the database
+ * @public
+ * @see struct DBMap_impl
+ * @see #db_fix_options()
+ */
+static struct DBMap *db_alloc(const char *file, const char *func, int line, enum DBType type, enum DBOptions options, unsigned short maxlen)
+{
+	struct DBMap_impl *db;
+	unsigned int i;
+	char ers_name[50];
+
+#ifdef DB_ENABLE_STATS
+	DB_COUNTSTAT(db_alloc);
+	switch (type) {
+		case DB_INT: DB_COUNTSTAT(db_int_alloc); break;
+		case DB_UINT: DB_COUNTSTAT(db_uint_alloc); break;
+		case DB_STRING: DB_COUNTSTAT(db_string_alloc); break;
+		case DB_ISTRING: DB_COUNTSTAT(db_istring_alloc); break;
+		case DB_INT64: DB_COUNTSTAT(db_int64_alloc); break;
+		case DB_UINT64: DB_COUNTSTAT(db_uint64_alloc); break;
+	}
+#endif /* DB_ENABLE_STATS */
+	db = ers_alloc(db_alloc_ers, struct DBMap_impl);
+
+	options = DB->fix_options(type, options);
+	/* Interface of the database */
+	if (options&DB_OPT_OPEN_ADDRESSING) {
+		db->vtable.iterator = db_oa_iterator;
+		db->vtable.exists   = db_oa_exists;
+		db->vtable.get      = db_oa_get;
+		db->vtable.getall   = db_obj_getall;
+		db->vtable.vgetall  = db_oa_vgetall;
+		db->vtable.ensure   = db_obj_ensure;
+		db->vtable.vensure  = db_oa_vensure;
+		db->vtable.put      = db_oa_put;
+		db->vtable.remove   = db_oa_remove;
+		db->vtable.foreach  = db_obj_foreach;
+		db->vtable.vforeach = db_oa_vforeach;
+		db->vtable.clear    = db_obj_clear;
+		db->vtable.vclear   = db_oa_vclear;
+		db->vtable.destroy  = db_obj_destroy;
+		db->vtable.vdestroy = db_oa_vdestroy;
+		db->vtable.size     = db_obj_size;
+		db->vtable.type     = db_obj_type;
+		db->vtable.options  = db_obj_options;
+	} else {
+		db->vtable.iterator = db_obj_iterator;
+		db->vtable.exists   = db_obj_exists;
+		db->vtable.get      = db_obj_get;
+		db->vtable.getall   = db_obj_getall;
+		db->vtable.vgetall  = db_obj_vgetall;
+		db->vtable.ensure   = db_obj_ensure;
+		db->vtable.vensure  = db_obj_vensure;
+		db->vtable.put      = db_obj_put;
+		db->vtable.remove   = db_obj_remove;
+		db->vtable.foreach  = db_obj_foreach;
+		db->vtable.vforeach = db_obj_vforeach;
+		db->vtable.clear    = db_obj_clear;
+		db->vtable.vclear   = db_obj_vclear;
+		db->vtable.destroy  = db_obj_destroy;
+		db->vtable.vdestroy = db_obj_vdestroy;
+		db->vtable.size     = db_obj_size;
+		db->vtable.type     = db_obj_type;
+		db->vtable.options  = db_obj_options;
+	}
+	/* File and line of allocation */
+	db->alloc_file = file;
+	db->alloc_line = line;
+	/* Lock system */
+	db->free_list = NULL;
+	db->free_count = 0;
+	db->free_max = 0;
+	db->free_lock = 0;
+	/* Other */
+	if (options&DB_OPT_OPEN_ADDRESSING) {
+		db->nodes = NULL;
+		db->slots = aCalloc(DB_OA_INITIAL_SIZE, sizeof(struct DBSlot));
+		db->slot_count = DB_OA_INITIAL_SIZE;
+	} else {
+		snprintf(ers_name, 50, "db_alloc:nodes:%s:%s:%d",func,file,line);
+		db->nodes = ers_new(sizeof(struct DBNode),ers_name,ERS_OPT_WAIT|ERS_OPT_FREE_NAME|ERS_OPT_CLEAN);
+		db->slots = NULL;
+		db->slot_count = 0;
+	}
+	db->slot_deleted = 0;
 	db->cmp = DB->default_cmp(type);
 	db->hash = DB->default_hash(type);
 	db->release = DB->default_release(type, options);
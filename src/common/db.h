@@ -38,6 +38,7 @@
  *  - see what functions need or should be added to the database interface   *
  *                                                                           *
  *  HISTORY:                                                                 *
+ *    2026/10/16 - Added open addressing databases (DB_OPT_OPEN_ADDRESSING)  *
  *    2013/08/25 - Added int64/uint64 support for keys                       *
  *    2012/03/09 - Added enum for data types (int, uint, void*)              *
  *    2007/11/09 - Added an iterator to the database.                        *
@@ -140,6 +141,14 @@ enum DBType {
  * @param DB_OPT_RELEASE_BOTH Releases both key and data.
  * @param DB_OPT_ALLOW_NULL_KEY Allow NULL keys in the database.
  * @param DB_OPT_ALLOW_NULL_DATA Allow NULL data in the database.
+ * @param DB_OPT_OPEN_ADDRESSING Stores the entries inline in a resizable open
+ *          addressing hashtable instead of the hashtable of RED-BLACK trees.
+ *          Lookups are a single linear probe sequence, which is much faster
+ *          for big databases.
+ *          WARNING: the struct DBData pointers returned by struct DBMap#get()
+ *          and struct DBMap#ensure() are only valid until the next insertion
+ *          in the database (the table might be resized), so they must not be
+ *          kept around.
  * @public
  * @see #db_fix_options()
  * @see #db_default_release()
@@ -153,6 +162,7 @@ enum DBOptions {
 	DB_OPT_RELEASE_BOTH    = DB_OPT_RELEASE_KEY|DB_OPT_RELEASE_DATA,
 	DB_OPT_ALLOW_NULL_KEY  = 0x08,
 	DB_OPT_ALLOW_NULL_DATA = 0x10,
+	DB_OPT_OPEN_ADDRESSING = 0x20,
 };
 
 /**
@@ -363,6 +363,20 @@ ERS *ers_new(uint32 size, char *name, enum ERSOptions options)
 	return &instance->VTable;
 }
 
+void ers_usage(size_t *used, size_t *allocated)
+{
+	ers_cache_t *cache;
+
+	nullpo_retv(used);
+	nullpo_retv(allocated);
+
+	*used = *allocated = 0;
+	for (cache = CacheList; cache; cache = cache->Next) {
+		*used += (size_t)cache->UsedObjs * cache->ObjectSize;
+		*allocated += (size_t)(cache->UsedObjs + cache->Free) * cache->ObjectSize;
+	}
+}
+
 void ers_report(void)
 {
 	ers_cache_t *cache;
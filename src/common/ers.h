@@ -156,6 +156,7 @@ typedef struct eri {
 // Disable the public functions
 #	define ers_new(size,name,options) NULL
 #	define ers_report() (void)0
+#	define ers_usage(used,allocated) (*(used) = 0, *(allocated) = 0, (void)0)
 #	define ers_final() (void)0
 #else /* not DISABLE_ERS */
 // These defines should be used to allow the code to keep working whenever
@@ -188,6 +189,13 @@ ERS *ers_new(uint32 size, char *name, enum ERSOptions options);
  */
 void ers_report(void);
 
+/**
+ * Retrieves the memory of all the caches, in bytes.
+ * @param used Memory of the entries being used
+ * @param allocated Memory of all the entries, including the reusable ones
+ */
+void ers_usage(size_t *used, size_t *allocated);
+
 /**
  * Clears the remainder of the managers
  **/
@@ -0,0 +1,204 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2023 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#define HERCULES_CORE
+
+#include "metrics.h"
+
+#include "common/cbasetypes.h"
+#include "common/core.h"
+#include "common/ers.h"
+#include "common/memmgr.h"
+#include "common/nullpo.h"
+#include "common/showmsg.h"
+#include "common/socket.h"
+#include "common/sql.h"
+#include "common/strlib.h"
+#include "common/timer.h"
+#include "common/utils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/** @file
+ * Implementation of the metrics interface.
+ */
+
+static struct metrics_interface metrics_s;
+struct metrics_interface *metrics;
+
+static const struct metrics_definition metrics_definitions[METRIC_MAX] = {
+#define METRICS_DEFINITION(id, name, family, type, label, scale, help) { name, family, type, label, scale, help },
+	METRICS_LIST(METRICS_DEFINITION)
+#undef METRICS_DEFINITION
+};
+
+/// @copydoc metrics_interface::final()
+static void metrics_final(void)
+{
+	VECTOR_CLEAR(metrics->samples);
+}
+
+/// @copydoc metrics_interface::definition()
+static const struct metrics_definition *metrics_definition(int id)
+{
+	if (id < 0 || id >= METRIC_MAX)
+		return NULL;
+	return &metrics_definitions[id];
+}
+
+/// @copydoc metrics_interface::clear()
+static void metrics_clear(void)
+{
+	VECTOR_CLEAR(metrics->samples);
+}
+
+/// @copydoc metrics_interface::add()
+static void metrics_add(enum metrics_id id, const char *label, int64 value)
+{
+	struct metrics_sample *sample;
+
+	Assert_retv(id >= 0 && id < METRIC_MAX);
+
+	VECTOR_ENSURE(metrics->samples, 1, 64);
+	VECTOR_PUSHZEROED(metrics->samples);
+	sample = &VECTOR_LAST(metrics->samples);
+	sample->id = (uint8)id;
+	if (label != NULL)
+		safestrncpy(sample->label, label, sizeof(sample->label));
+	sample->value = value;
+}
+
+/// Adds the samples of the main loop statistics.
+static void metrics_collect_loop(void)
+{
+	static const char *phases[CORE_LOOP_MAX] = { "timers", "sockets", "idle", "total" };
+	const struct duration_histogram *stats;
+	char label[METRICS_LABEL_LENGTH];
+	int i;
+
+	for (i = 0; i < CORE_LOOP_MAX; i++) {
+		if ((stats = core->loop_stats(i)) == NULL)
+			continue;
+		metrics->add(METRIC_LOOP_SECONDS, phases[i], stats->total_us);
+		metrics->add(METRIC_LOOP_MAX_SECONDS, phases[i], stats->max_us);
+	}
+
+	if ((stats = core->loop_stats(CORE_LOOP_TOTAL)) == NULL)
+		return;
+	// Bucket i counts the durations under 2^i us, the last one is unbounded.
+	for (i = 0; i < DURATION_HISTOGRAM_BUCKETS - 1; i++) {
+		snprintf(label, sizeof(label), "%.6f", (double)(INT64_C(1) << i) / 1000000);
+		metrics->add(METRIC_LOOP_BUCKET, label, (int64)duration_histogram_count_under(stats, i));
+	}
+	metrics->add(METRIC_LOOP_BUCKET, "+Inf", (int64)stats->count);
+	metrics->add(METRIC_LOOP_SUM, NULL, stats->total_us);
+	metrics->add(METRIC_LOOP_COUNT, NULL, (int64)stats->count);
+}
+
+/// @copydoc metrics_interface::collect()
+static void metrics_collect(void)
+{
+	struct SqlQueryStats sql_stats;
+	size_t ers_used, ers_allocated;
+	int64 sessions = 0, wfifo = 0;
+	int i;
+
+	for (i = 0; i < sockt->fd_max; i++) {
+		const struct socket_data *s;
+		int j;
+
+		if (!sockt->session_is_valid(i))
+			continue;
+		s = sockt->session[i];
+		sessions++;
+		wfifo += (int64)s->wdata_size;
+		// shared broadcast buffers queued after wdata, minus what was already sent of the first one
+		for (j = 0; j < s->wrefs_count; j++)
+			wfifo += (int64)(s->wrefs[j].buf->len - (j == 0 ? s->wrefs_sent : 0));
+	}
+
+	metrics->add(METRIC_UPTIME, NULL, (int64)timer->get_uptime());
+	metrics->add(METRIC_SESSIONS, NULL, sessions);
+	metrics->add(METRIC_WFIFO_BYTES, NULL, wfifo);
+	metrics->add(METRIC_TIMERS, NULL, timer->queue_size());
+	metrics->add(METRIC_MEMMGR_BYTES, NULL, (int64)iMalloc->usage() * 1024);
+
+	ers_usage(&ers_used, &ers_allocated);
+	metrics->add(METRIC_ERS_USED_BYTES, NULL, (int64)ers_used);
+	metrics->add(METRIC_ERS_BYTES, NULL, (int64)ers_allocated);
+
+	SQL->QueryStats(&sql_stats);
+	metrics->add(METRIC_SQL_QUERIES, NULL, sql_stats.queries);
+	metrics->add(METRIC_SQL_ERRORS, NULL, sql_stats.errors);
+	metrics->add(METRIC_SQL_SECONDS, NULL, sql_stats.time_us);
+
+	metrics_collect_loop();
+}
+
+/// @copydoc metrics_interface::send()
+static void metrics_send(int fd, const struct PACKET_API_PROXY *request, const char *world_name, int servers)
+{
+	int start = 0;
+
+	nullpo_retv(request);
+	nullpo_retv(world_name);
+
+	if (!sockt->session_is_active(fd)) {
+		metrics->clear();
+		return;
+	}
+
+	do {
+		const int count = min(VECTOR_LENGTH(metrics->samples) - start, (int)METRICS_PACKET_SAMPLES);
+		const int len = (int)(sizeof(struct PACKET_API_PROXY) + sizeof(struct PACKET_API_REPLY_metrics) + count * sizeof(struct metrics_sample));
+		struct PACKET_API_PROXY *packet;
+		struct PACKET_API_REPLY_metrics *data;
+
+		WFIFOHEAD(fd, len);
+		packet = WFIFOP(fd, 0);
+		memcpy(packet, request, sizeof(struct PACKET_API_PROXY));
+		packet->packet_id = HEADER_API_PROXY_REPLY;
+		packet->packet_len = len;
+		data = WFIFOP(fd, sizeof(struct PACKET_API_PROXY));
+		data->server_type = (uint8)SERVER_TYPE;
+		safestrncpy(data->world_name, world_name, sizeof(data->world_name));
+		data->servers = (uint8)servers;
+		data->count = (uint16)count;
+		if (count > 0)
+			memcpy(data->samples, &VECTOR_INDEX(metrics->samples, start), count * sizeof(struct metrics_sample));
+		start += count;
+		data->last = (start >= VECTOR_LENGTH(metrics->samples)) ? 1 : 0;
+		WFIFOSET(fd, len);
+	} while (start < VECTOR_LENGTH(metrics->samples));
+
+	metrics->clear();
+}
+
+void metrics_defaults(void)
+{
+	metrics = &metrics_s;
+
+	VECTOR_INIT(metrics->samples);
+
+	metrics->final = metrics_final;
+	metrics->definition = metrics_definition;
+	metrics->clear = metrics_clear;
+	metrics->add = metrics_add;
+	metrics->collect = metrics_collect;
+	metrics->send = metrics_send;
+}
@@ -0,0 +1,121 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2023 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef COMMON_METRICS_H
+#define COMMON_METRICS_H
+
+#include "common/hercules.h"
+#include "common/apipackets.h"
+#include "common/db.h"
+
+/** @file
+ * Runtime metrics, gathered by the api server from all the servers and
+ * exposed in Prometheus text format.
+ */
+
+/**
+ * Metric list.
+ *
+ * X(id, sample name, family name, type, label name, scale, help)
+ * - The family name is used for the HELP and TYPE lines, and groups the
+ *   samples of a histogram.
+ * - The label name is NULL for metrics without a label.
+ * - The value is divided by scale when shown (1000000 for values in us shown in seconds).
+ */
+#define METRICS_LIST(X) \
+	X(METRIC_UPTIME,             "hercules_uptime_seconds",                    "hercules_uptime_seconds",          "gauge",     NULL,    1,       "Time since the server started.") \
+	X(METRIC_SESSIONS,           "hercules_sessions",                          "hercules_sessions",                "gauge",     NULL,    1,       "Open connections.") \
+	X(METRIC_WFIFO_BYTES,        "hercules_wfifo_bytes",                       "hercules_wfifo_bytes",             "gauge",     NULL,    1,       "Bytes queued in the write buffers of all the connections.") \
+	X(METRIC_TIMERS,             "hercules_timers",                            "hercules_timers",                  "gauge",     NULL,    1,       "Timers waiting to be executed.") \
+	X(METRIC_MEMMGR_BYTES,       "hercules_memmgr_bytes",                      "hercules_memmgr_bytes",            "gauge",     NULL,    1,       "Memory in use through the memory manager.") \
+	X(METRIC_ERS_USED_BYTES,     "hercules_ers_used_bytes",                    "hercules_ers_used_bytes",          "gauge",     NULL,    1,       "Memory of the entry reusage system entries being used.") \
+	X(METRIC_ERS_BYTES,          "hercules_ers_allocated_bytes",               "hercules_ers_allocated_bytes",     "gauge",     NULL,    1,       "Memory allocated by the entry reusage system.") \
+	X(METRIC_SQL_QUERIES,        "hercules_sql_queries_total",                 "hercules_sql_queries_total",       "counter",   NULL,    1,       "SQL queries and statement executions.") \
+	X(METRIC_SQL_ERRORS,         "hercules_sql_errors_total",                  "hercules_sql_errors_total",        "counter",   NULL,    1,       "SQL queries and statement executions that failed.") \
+	X(METRIC_SQL_SECONDS,        "hercules_sql_query_seconds_total",           "hercules_sql_query_seconds_total", "counter",   NULL,    1000000, "Time spent on SQL queries and statement executions.") \
+	X(METRIC_LOOP_SECONDS,       "hercules_main_loop_seconds_total",           "hercules_main_loop_seconds_total", "counter",   "phase", 1000000, "Time spent on each main loop phase since the statistics were reset.") \
+	X(METRIC_LOOP_MAX_SECONDS,   "hercules_main_loop_max_seconds",             "hercules_main_loop_max_seconds",   "gauge",     "phase", 1000000, "Longest main loop phase since the statistics were reset.") \
+	X(METRIC_LOOP_BUCKET,        "hercules_main_loop_duration_seconds_bucket", "hercules_main_loop_duration_seconds", "histogram", "le", 1,       "Main loop iteration durations since the statistics were reset.") \
+	X(METRIC_LOOP_SUM,           "hercules_main_loop_duration_seconds_sum",    "hercules_main_loop_duration_seconds", "histogram", NULL, 1000000, NULL) \
+	X(METRIC_LOOP_COUNT,         "hercules_main_loop_duration_seconds_count",  "hercules_main_loop_duration_seconds", "histogram", NULL, 1,       NULL) \
+	X(METRIC_ONLINE_USERS,       "hercules_online_users",                      "hercules_online_users",            "gauge",     NULL,    1,       "Online users.") \
+	X(METRIC_MAP_USERS,          "hercules_map_users",                         "hercules_map_users",               "gauge",     "map",   1,       "Online users per map, maps without users are omitted.")
+
+enum metrics_id {
+#define METRICS_ENUM(id, name, family, type, label, scale, help) id,
+	METRICS_LIST(METRICS_ENUM)
+#undef METRICS_ENUM
+	METRIC_MAX
+};
+
+/// Description of a metric (@see METRICS_LIST)
+struct metrics_definition {
+	const char *name;
+	const char *family;
+	const char *type;
+	const char *label;
+	int64 scale;
+	const char *help;
+};
+
+/// Maximum number of samples in a single reply packet.
+#define METRICS_PACKET_SAMPLES ((UINT16_MAX - sizeof(struct PACKET_API_PROXY) - sizeof(struct PACKET_API_REPLY_metrics)) / sizeof(struct metrics_sample))
+
+/// Metrics interface.
+struct metrics_interface {
+	/// Samples collected for the current request.
+	VECTOR_DECL(struct metrics_sample) samples;
+
+	/// Interface finalization.
+	void (*final) (void);
+
+	/// Returns the description of a metric, or NULL if id is unknown.
+	const struct metrics_definition *(*definition) (int id);
+
+	/// Discards the collected samples.
+	void (*clear) (void);
+
+	/**
+	 * Adds a sample.
+	 *
+	 * @param id    The metric.
+	 * @param label Value of the metric label, or NULL if it has none.
+	 * @param value The value, in the unit of the metric before scaling.
+	 */
+	void (*add) (enum metrics_id id, const char *label, int64 value);
+
+	/// Adds the samples of the common subsystems (sessions, timers, memory, SQL, main loop).
+	void (*collect) (void);
+
+	/**
+	 * Sends the collected samples as replies to an api server metrics request, and discards them.
+	 *
+	 * @param fd         Connection towards the api server (directly or through other servers).
+	 * @param request    The request being answered.
+	 * @param world_name World name to reply with.
+	 * @param servers    Number of servers that also answer the request through this one.
+	 */
+	void (*send) (int fd, const struct PACKET_API_PROXY *request, const char *world_name, int servers);
+};
+
+#ifdef HERCULES_CORE
+void metrics_defaults(void);
+#endif // HERCULES_CORE
+
+HPShared struct metrics_interface *metrics;
+
+#endif /* COMMON_METRICS_H */
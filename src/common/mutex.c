@@ -26,7 +26,6 @@
 #include "common/memmgr.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
-#include "common/timer.h"
 
 #ifdef WIN32
 #include "common/winapi.h"
@@ -212,11 +211,17 @@ static void cond_wait(struct cond_data *c, struct mutex_data *m, sysint timeout_
 	if (timeout_ticks < 0) {
 		pthread_cond_wait(&c->hCond,  &m->hMutex);
 	} else {
+		struct timeval now;
 		struct timespec wtime;
-		int64 exact_timeout = timer->gettick() + timeout_ticks;
 
-		wtime.tv_sec = exact_timeout/1000;
-		wtime.tv_nsec = (exact_timeout%1000)*1000000;
+		// the deadline is an absolute time of the realtime clock, not a server tick
+		gettimeofday(&now, NULL);
+		wtime.tv_sec = now.tv_sec + timeout_ticks / 1000;
+		wtime.tv_nsec = now.tv_usec * 1000 + (timeout_ticks % 1000) * 1000000;
+		if (wtime.tv_nsec >= 1000000000) {
+			wtime.tv_sec++;
+			wtime.tv_nsec -= 1000000000;
+		}
 
 		pthread_cond_timedwait( &c->hCond,  &m->hMutex,  &wtime);
 	}
@@ -68,8 +68,8 @@ packetLen(0x2b24, 2)   /* H->M, chrif_keepalive_ack. charserver ping reply. */
 packetLen(0x2b25, 14)  /* H->M, chrif_deadopt -> 'Removes baby from Father ID and Mother ID' */
 packetLen(0x2b26, 19)  /* M->H, chrif_authreq -> 'client authentication request' */
 packetLen(0x2b27, 19)  /* H->M, chrif_authfail -> 'client authentication failed' */
-packetLen(0x2b28, 0)   /* FREE */
-packetLen(0x2b29, 0)   /* FREE */
+packetLen(0x2b28, -1)  /* M->H, chrif_save_delta -> 'charsave of char XY account XY (changed sections only)' */
+packetLen(0x2b29, 10)  /* H->M, chrif_save_delta_nack -> 'delta save could not be applied, send a complete struct' */
 packetLen(0x2b2a, 0)   /* FREE */
 packetLen(0x2b2b, 0)   /* FREE */
 packetLen(0x2b2c, 0)   /* FREE */
@@ -26,21 +26,29 @@
 #include "common/HPM.h"
 #include "common/cbasetypes.h"
 #include "common/conf.h"
+#include "common/core.h"
 #include "common/db.h"
 #include "common/memmgr.h"
 #include "common/mmo.h"
 #include "common/nullpo.h"
 #include "common/packets.h"
+#include "common/random.h"
 #include "common/showmsg.h"
 #include "common/strlib.h"
 #include "common/timer.h"
 
+#ifdef SOCKET_EPOLL
+#include "common/atomic.h"
+#include "common/mutex.h"
+#include "common/thread.h"
+#endif  // SOCKET_EPOLL
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 
 #ifndef MAXCONN
-#ifdef SOCKET_EPOLL
+#if defined(SOCKET_EPOLL) || defined(SOCKET_IO_URING)
 #define MAXCONN 3072
 #else  // SOCKET_EPOLL
 #define MAXCONN FD_SETSIZE
@@ -49,8 +57,22 @@
 
 #ifdef SOCKET_EPOLL
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif  // SOCKET_EPOLL
 
+#ifndef WIN32
+#include <sys/uio.h> // struct iovec
+#endif  // WIN32
+
+#ifdef SOCKET_IO_URING
+#include "common/ers.h"
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif  // SOCKET_IO_URING
+
 #ifdef WIN32
 #	include "common/winapi.h"
 #else  // WIN32
@@ -262,7 +284,74 @@ static char *sErr(int code)
 	#define MSG_NOSIGNAL 0
 #endif  // MSG_NOSIGNAL
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+// io_uring based Event Dispatcher:
+// Every connection has a multishot recv request, which picks buffers from a
+// ring of provided buffers, and listening sockets have a multishot accept
+// request. Received data that doesn't fit in the RFIFO is kept in a backlog
+// of at most one RFIFO and the recv request is stopped until the backlog is
+// moved, so that a peer sending faster than the server parses is held back by
+// TCP like with the other dispatchers. The data to send is handed over to a
+// send request (swapping the WFIFO buffer), and all the requests queued during
+// a cycle are submitted with the same io_uring_enter call that waits for
+// completions.
+#define SOCKET_URING_ENTRIES 4096       // size of the submission queue
+#define SOCKET_URING_BUFFER_COUNT 2048  // number of provided receive buffers (power of 2)
+#define SOCKET_URING_BUFFER_SIZE 4096   // size of each provided receive buffer
+#define SOCKET_URING_BGID 0             // buffer group id of the provided receive buffers
+
+/// Type of an io_uring request.
+enum socket_uring_op {
+	SOCKET_URING_RECV,   ///< Multishot recv (connections)
+	SOCKET_URING_ACCEPT, ///< Multishot accept (listening sockets)
+	SOCKET_URING_SEND,   ///< Send of a WFIFO buffer
+};
+
+/// An io_uring request, used as the user_data of its submissions.
+struct socket_uring_req {
+	enum socket_uring_op op;
+	int fd;
+	uint32 gen;           ///< Generation of the fd when the request was made
+	uint8 *buf;           ///< (send) Buffer being sent, owned by the request
+	size_t len, pos;      ///< (send) Size of the data and amount already sent
+	struct socket_uring_req *prev, *next; ///< List of requests in flight
+};
+
+/// io_uring state of a fd.
+struct socket_uring_conn {
+	uint32 gen;                   ///< Incremented when the fd is closed, to ignore stale completions
+	struct socket_uring_req *req; ///< The multishot recv/accept request
+	bool armed;                   ///< req is in flight
+	bool paused;                  ///< (recv) req is stopped until rbuf is moved to the RFIFO
+	bool sending;                 ///< A send request is in flight
+	bool backlog;                 ///< In socket_uring_backlog
+	uint8 *rbuf;                  ///< Received data that didn't fit in the RFIFO
+	size_t rbuf_size, max_rbuf;
+	uint8 *spare;                 ///< Spare WFIFO buffer, recycled from a finished send
+	size_t max_spare;
+};
+
+static int uring_fd = SOCKET_ERROR;
+static unsigned int *uring_sq_head, *uring_sq_tail, *uring_sq_mask, *uring_sq_array;
+static unsigned int *uring_cq_head, *uring_cq_tail, *uring_cq_mask;
+static unsigned int uring_sq_entries;
+static unsigned int uring_sq_local_tail;  ///< Tail including the queued submissions
+static unsigned int uring_to_submit = 0;  ///< Number of queued submissions
+static struct io_uring_sqe *uring_sqes = NULL;
+static struct io_uring_cqe *uring_cqes = NULL;
+static void *uring_sq_ring = NULL, *uring_cq_ring = NULL;
+static size_t uring_sq_ring_size, uring_cq_ring_size, uring_sqes_size;
+static struct io_uring_buf_ring *uring_buf_ring = NULL;
+static size_t uring_buf_ring_size;
+static uint8 *uring_buffers = NULL;
+static uint16 uring_buf_tail;             ///< Tail including the recycled buffers not published yet
+static struct socket_uring_conn *uring_conns = NULL; ///< io_uring state of each fd (MAXCONN entries)
+static struct socket_uring_req *uring_reqs = NULL;   ///< Requests in flight
+static struct eri *uring_req_ers = NULL;
+static int socket_uring_backlog[MAXCONN]; ///< Connections with received data that didn't fit in the RFIFO
+static int socket_uring_backlog_count = 0;
+
+#elif !defined(SOCKET_EPOLL)
 // Select based Event Dispatcher:
 static fd_set readfds;
 
@@ -273,6 +362,74 @@ static int epfd = SOCKET_ERROR;
 static struct epoll_event epevent;
 static struct epoll_event *epevents = NULL;
 
+// Network I/O threads:
+// When enabled (io_threads in the socket configuration), the client and
+// server connections are owned by a pool of I/O threads, each one with its
+// own epoll set. The I/O threads do all the recv/send calls on them, while
+// the main thread only moves data between its FIFOs and the buffers of the
+// I/O threads. The threads notify each other of connections that need work
+// through single producer/single consumer lock-free queues and eventfds.
+// Listening sockets are still handled by the main thread.
+#define SOCKET_IO_MAX_THREADS 16
+#define SOCKET_IO_MAX_EVENTS 256
+// size of the buffer used by each I/O thread for a single recv/send call
+#define SOCKET_IO_BUFFER_SIZE (64*1024)
+// initial size of the receive buffer of each connection (grows to the size of the RFIFO)
+#define SOCKET_IO_RBUF_SIZE (16*1024)
+
+/// Reads a value shared with other threads.
+#define socket_io_atomic_read(p) InterlockedCompareExchange((p), 0, 0)
+
+/// State of a connection owned by an I/O thread.
+enum socket_io_state {
+	SOCKET_IO_NONE = 0, ///< Not owned by an I/O thread
+	SOCKET_IO_ACTIVE,   ///< Connected
+	SOCKET_IO_EOF,      ///< Closed by the remote end (or failed), waiting for the main thread to notice
+	SOCKET_IO_CLOSE,    ///< Session deleted, the I/O thread must close the socket
+};
+
+/// I/O buffers of a connection owned by an I/O thread.
+/// The buffers are only (re)allocated by the main thread.
+struct socket_io {
+	struct mutex_data *lock; ///< Protects everything except the queue flags
+	uint8 *rbuf;             ///< Data received by the I/O thread, not yet moved to the RFIFO
+	uint8 *wbuf;             ///< Data moved from the WFIFO, not yet sent by the I/O thread
+	size_t max_rbuf, max_wbuf;
+	size_t rbuf_size, wbuf_size;
+	enum socket_io_state state;
+	bool read_blocked;       ///< The receive buffer got full, the I/O thread stopped reading
+	bool read_resume;        ///< The main thread made room in the receive buffer
+	bool backlog;            ///< (main thread only) in socket_io_backlog
+	volatile int32 ready;    ///< Queued in the ready queue of its I/O thread
+	volatile int32 pending;  ///< Queued in the command queue of its I/O thread
+};
+
+/// Single producer/single consumer queue of fds.
+struct socket_io_queue {
+	int *data;
+	volatile int32 head; ///< Next position to read (written by the consumer)
+	volatile int32 tail; ///< Next position to write (written by the producer)
+};
+
+/// An I/O thread.
+struct socket_io_thread {
+	struct thread_handle *handle;
+	int epfd;                        ///< epoll set of the connections owned by this thread
+	int evfd;                        ///< eventfd used to wake up the thread
+	struct socket_io_queue commands; ///< main -> I/O: connections with data to send, to resume reading or to close
+	struct socket_io_queue ready;    ///< I/O -> main: connections with received data or eof
+	uint8 *buf;                      ///< Buffer for recv/send calls
+};
+
+static int socket_io_thread_count = 0; ///< Number of I/O threads, 0 when disabled
+static struct socket_io_thread *socket_io_threads = NULL;
+static struct socket_io *socket_io_data = NULL; ///< I/O state of each fd (MAXCONN entries)
+static int socket_io_queue_size = 0;            ///< Size of the queues (a power of two bigger than MAXCONN)
+static int socket_io_evfd = SOCKET_ERROR;       ///< eventfd used to wake up the main thread
+static volatile int32 socket_io_running = 0;
+static int socket_io_backlog[MAXCONN];          ///< Connections with received data that didn't fit in the RFIFO
+static int socket_io_backlog_count = 0;
+
 #endif  // SOCKET_EPOLL
 
 // Maximum packet size in bytes, which the client is able to handle.
@@ -308,6 +465,8 @@ static uint32 send_shortlist_set[(MAXCONN + 31) / 32]; // to know if specific fd
 
 static int ip_rules = 1;
 static int connect_check(uint32 ip);
+static int connect_client_setup(int fd, const struct sockaddr_in *client_address);
+static void wrefs_clear(struct socket_data *s);
 
 static const char *error_msg(void)
 {
@@ -454,103 +613,1749 @@ static void set_eof(int fd)
 	}
 }
 
-static int recv_to_fifo(int fd)
+/*======================================
+ * CORE : Traffic capture and replay
+ *--------------------------------------*/
+// The capture file starts with a header (magic, version, PACKETVER, seed of
+// the random number generator) followed by one record per event, in the
+// order they happened:
+//   type (B), connection (L), tick relative to the start of the capture (Q),
+//   data length (L), data
+// Ticks are relative so that the replay can run on its own virtual clock.
+// The connection is the fd the server used, which is only unique among the
+// connections open at the same time.
+#define SOCKET_TRAFFIC_MAGIC "HTRAFFIC"
+#define SOCKET_TRAFFIC_VERSION 1
+#define SOCKET_TRAFFIC_HEADER_SIZE (8 + 4 + 4 + 4)
+#define SOCKET_TRAFFIC_RECORD_SIZE (1 + 4 + 8 + 4)
+/// Delay (ms) after which a recorded outgoing connection is dropped if the replayed server doesn't open it.
+#define SOCKET_TRAFFIC_CONNECT_TIMEOUT 60000
+
+enum socket_traffic_type {
+	SOCKET_TRAFFIC_ACCEPT = 1,  ///< Accepted client connection, data: ip (L)
+	SOCKET_TRAFFIC_CONNECT = 2, ///< Outgoing connection, data: ip (L), port (W)
+	SOCKET_TRAFFIC_DATA = 3,    ///< Received data
+	SOCKET_TRAFFIC_CLOSE = 4,   ///< Closed connection
+};
+
+struct socket_traffic_event {
+	enum socket_traffic_type type;
+	int fd;
+	int64 tick;
+	uint32 len;
+	uint8 *data;
+};
+
+static FILE *traffic_fp = NULL;
+static bool traffic_recording = false;
+static bool traffic_replaying = false;
+static int64 traffic_start_tick = 0;       ///< Tick the capture (or the replay) started at
+static uint64 traffic_events = 0;
+static uint64 traffic_bytes_in = 0;
+static uint64 traffic_bytes_out = 0;
+static int64 traffic_replay_start_us = 0;
+static struct socket_traffic_event traffic_next = { 0 }; ///< Next event of the replay
+static bool traffic_has_next = false;
+static int64 traffic_connect_wait = 0;     ///< Tick the replay started waiting for the server to open a connection, 0 if not waiting
+static int traffic_fds[MAXCONN];           ///< (replay) Recorded connection -> replayed fd, 0 if none, -1 if dropped
+static int traffic_connections[MAXCONN];   ///< (replay) Replayed fd -> recorded connection + 1, 0 if none
+static VECTOR_DECL(int) traffic_pending;   ///< (replay) Outgoing connections waiting for their recorded counterpart
+
+/// Writes an event to the capture file.
+static void socket_traffic_record(enum socket_traffic_type type, int fd, const void *data, size_t len)
+{
+	uint8 head[SOCKET_TRAFFIC_RECORD_SIZE];
+
+	if (!traffic_recording)
+		return;
+
+	WBUFB(head, 0) = (uint8)type;
+	WBUFL(head, 1) = (uint32)fd;
+	WBUFQ(head, 5) = (uint64)(timer->gettick() - traffic_start_tick);
+	WBUFL(head, 13) = (uint32)len;
+	if (fwrite(head, sizeof(head), 1, traffic_fp) != 1 || (len > 0 && fwrite(data, len, 1, traffic_fp) != 1)) {
+		ShowError("socket_traffic_record: failed to write the capture file, capture stopped.\n");
+		fclose(traffic_fp);
+		traffic_fp = NULL;
+		traffic_recording = false;
+		return;
+	}
+	traffic_events++;
+	if (type == SOCKET_TRAFFIC_DATA)
+		traffic_bytes_in += len;
+}
+
+/**
+ * Starts capturing the traffic received by the server.
+ *
+ * The random number generator is reseeded with a seed stored in the capture,
+ * so that a replay started at the same point of the server's initialization
+ * draws the same numbers.
+ *
+ * @param filename Capture file (overwritten).
+ * @return false if the capture couldn't be started.
+ */
+static bool socket_traffic_start_record(const char *filename)
+{
+	uint8 head[SOCKET_TRAFFIC_HEADER_SIZE];
+	uint32 seed;
+
+	nullpo_retr(false, filename);
+
+	if (traffic_recording || traffic_replaying) {
+		ShowError("socket_traffic_start_record: a capture or a replay is already running.\n");
+		return false;
+	}
+	if ((traffic_fp = fopen(filename, "wb")) == NULL) {
+		ShowError("socket_traffic_start_record: unable to open '%s' for writing.\n", filename);
+		return false;
+	}
+
+	seed = (uint32)rnd->random() ^ (uint32)time(NULL);
+	rnd->seed(seed);
+
+	memcpy(head, SOCKET_TRAFFIC_MAGIC, 8);
+	WBUFL(head, 8) = SOCKET_TRAFFIC_VERSION;
+	WBUFL(head, 12) = PACKETVER;
+	WBUFL(head, 16) = seed;
+	if (fwrite(head, sizeof(head), 1, traffic_fp) != 1) {
+		ShowError("socket_traffic_start_record: unable to write to '%s'.\n", filename);
+		fclose(traffic_fp);
+		traffic_fp = NULL;
+		return false;
+	}
+
+	traffic_start_tick = timer->gettick();
+	traffic_recording = true;
+	ShowStatus("Capturing the received traffic to '"CL_WHITE"%s"CL_RESET"' (seed %u).\n", filename, seed);
+	return true;
+}
+
+/// Reads the next event of the replay, returns false at the end of the capture.
+static bool socket_traffic_read_next(void)
+{
+	uint8 head[SOCKET_TRAFFIC_RECORD_SIZE];
+	struct socket_traffic_event *ev = &traffic_next;
+
+	traffic_has_next = false;
+	if (fread(head, sizeof(head), 1, traffic_fp) != 1)
+		return false;
+
+	ev->type = (enum socket_traffic_type)RBUFB(head, 0);
+	ev->fd = (int)RBUFL(head, 1);
+	ev->tick = traffic_start_tick + (int64)RBUFQ(head, 5);
+	ev->len = RBUFL(head, 13);
+	if (ev->fd <= 0 || ev->fd >= MAXCONN) {
+		ShowError("socket_traffic_read_next: invalid connection %d in the capture, replay stopped.\n", ev->fd);
+		return false;
+	}
+	if (ev->len > 0) {
+		RECREATE(ev->data, uint8, ev->len);
+		if (fread(ev->data, ev->len, 1, traffic_fp) != 1) {
+			ShowError("socket_traffic_read_next: truncated capture, replay stopped.\n");
+			return false;
+		}
+	}
+	traffic_has_next = true;
+	return true;
+}
+
+/// RecvFunc of the replayed connections, the data comes from the capture.
+static int socket_traffic_recv(int fd)
+{
+	return 0;
+}
+
+/// SendFunc of the replayed connections, discards the data.
+static int socket_traffic_send(int fd)
+{
+	struct socket_data *s;
+	int i;
+
+	if (!sockt->session_is_valid(fd))
+		return -1;
+
+	s = sockt->session[fd];
+	traffic_bytes_out += s->wdata_size;
+	for (i = 0; i < s->wrefs_count; i++)
+		traffic_bytes_out += s->wrefs[i].buf->len - (i == 0 ? s->wrefs_sent : 0);
+#ifdef SHOW_SERVER_STATS
+	socket_data_qo -= s->wdata_size;
+#endif  // SHOW_SERVER_STATS
+	wrefs_clear(s);
+	s->wdata_size = 0;
+	s->wdata_tick = sockt->last_tick;
+	return 0;
+}
+
+/// Creates a session that isn't connected to anything, for the replay.
+static int socket_traffic_create_session(ParseFunc func_parse, ConnectedFunc func_client_connected, DeleteFunc func_delete)
+{
+	int fd = sSocket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd == -1) {
+		ShowError("socket_traffic_create_session: socket creation failed (%s)!\n", error_msg());
+		return -1;
+	}
+	if (fd == 0 || fd >= MAXCONN) {
+		ShowError("socket_traffic_create_session: invalid socket #%d (MAXCONN is %d).\n", fd, MAXCONN);
+		sClose(fd);
+		return -1;
+	}
+	if (sockt->fd_max <= fd)
+		sockt->fd_max = fd + 1;
+	sockt->create_session(fd, socket_traffic_recv, socket_traffic_send, func_parse, func_client_connected, func_delete);
+	return fd;
+}
+
+/// Forgets the recorded connection a replayed session was created for.
+static void socket_traffic_forget(int fd)
+{
+	if (!traffic_replaying || traffic_connections[fd] == 0)
+		return;
+	if (traffic_fds[traffic_connections[fd] - 1] == fd)
+		traffic_fds[traffic_connections[fd] - 1] = 0;
+	traffic_connections[fd] = 0;
+}
+
+static void socket_traffic_map(int recorded, int fd)
+{
+	traffic_fds[recorded] = fd;
+	if (fd > 0)
+		traffic_connections[fd] = recorded + 1;
+}
+
+/// Stops the replay and the server at the end of the capture.
+static void socket_traffic_end_replay(void)
+{
+	int64 elapsed = timer->gettick_us() - traffic_replay_start_us;
+
+	ShowStatus("Replay finished: %"PRIu64" events, %"PRIu64" bytes received, %"PRIu64" bytes sent, %"PRId64" ms of traffic replayed in %.3f s.\n",
+	           traffic_events, traffic_bytes_in, traffic_bytes_out, timer->gettick() - traffic_start_tick, elapsed / 1000000.);
+	traffic_has_next = false;
+	core->runflag = CORE_ST_STOP;
+}
+
+/**
+ * Applies an event of the replay.
+ *
+ * @return false if the replay must wait for the server to open the recorded outgoing connection.
+ */
+static bool socket_traffic_apply(const struct socket_traffic_event *ev)
+{
+	int fd;
+
+	nullpo_retr(true, ev);
+
+	switch (ev->type) {
+	case SOCKET_TRAFFIC_ACCEPT:
+		if ((fd = socket_traffic_create_session(default_func_parse, default_func_client_connected, default_func_delete)) == -1) {
+			socket_traffic_map(ev->fd, -1);
+			break;
+		}
+		socket_traffic_map(ev->fd, fd);
+		sockt->session[fd]->client_addr = ev->len >= 4 ? RBUFL(ev->data, 0) : 0;
+		sockt->session[fd]->flag.validate = sockt->validate;
+		sockt->session[fd]->func_client_connected(fd);
+		break;
+	case SOCKET_TRAFFIC_CONNECT:
+		if (VECTOR_LENGTH(traffic_pending) == 0) {
+			if (traffic_connect_wait == 0)
+				traffic_connect_wait = timer->gettick();
+			if (DIFF_TICK(timer->gettick(), traffic_connect_wait) < SOCKET_TRAFFIC_CONNECT_TIMEOUT)
+				return false;
+			ShowWarning("socket_traffic_apply: the server didn't open recorded connection #%d, dropping its traffic.\n", ev->fd);
+			socket_traffic_map(ev->fd, -1);
+			break;
+		}
+		fd = VECTOR_INDEX(traffic_pending, 0);
+		VECTOR_ERASE(traffic_pending, 0);
+		socket_traffic_map(ev->fd, sockt->session_is_valid(fd) ? fd : -1);
+		break;
+	case SOCKET_TRAFFIC_DATA:
+		fd = traffic_fds[ev->fd];
+		if (!sockt->session_is_active(fd))
+			break;
+		if (RFIFOSPACE(fd) < ev->len) {
+			// the replayed server parses differently than the recorded one, make room
+			struct socket_data *s = sockt->session[fd];
+			RFIFOFLUSH(fd);
+			if (s->max_rdata - s->rdata_size < ev->len) {
+				RECREATE(s->rdata, unsigned char, s->rdata_size + ev->len);
+				s->max_rdata = s->rdata_size + ev->len;
+			}
+		}
+		memcpy(sockt->session[fd]->rdata + sockt->session[fd]->rdata_size, ev->data, ev->len);
+		sockt->session[fd]->rdata_size += ev->len;
+		sockt->session[fd]->rdata_tick = sockt->last_tick;
+		traffic_bytes_in += ev->len;
+		break;
+	case SOCKET_TRAFFIC_CLOSE:
+		fd = traffic_fds[ev->fd];
+		if (fd > 0)
+			sockt->eof(fd);
+		traffic_fds[ev->fd] = 0;
+		break;
+	default:
+		ShowWarning("socket_traffic_apply: unknown event type %d in the capture, skipped.\n", (int)ev->type);
+		break;
+	}
+	traffic_connect_wait = 0;
+	traffic_events++;
+	return true;
+}
+
+/**
+ * Replaces the wait for network events during a replay: moves the virtual
+ * clock to the next event or timer, and applies the events that are due.
+ *
+ * @param next Time until the next timer (ms).
+ */
+static void socket_traffic_replay_step(int next)
+{
+	int64 tick = timer->gettick();
+	int64 target = tick + next;
+
+	if (traffic_has_next && traffic_connect_wait == 0 && DIFF_TICK(traffic_next.tick, target) < 0)
+		target = max(traffic_next.tick, tick);
+	timer->set_virtual_tick(target);
+
+	while (traffic_has_next && DIFF_TICK(traffic_next.tick, target) <= 0) {
+		if (!socket_traffic_apply(&traffic_next))
+			break; // waiting for an outgoing connection, let the timers run
+		if (!socket_traffic_read_next()) {
+			socket_traffic_end_replay();
+			return;
+		}
+	}
+}
+
+/**
+ * Replays a capture made by socket_traffic_start_record.
+ *
+ * The server doesn't listen nor connect to anything during the replay: the
+ * recorded connections are recreated and fed the recorded data, on a virtual
+ * clock that jumps from event to event (or to the next timer), and anything
+ * sent is discarded. The server stops at the end of the capture.
+ * Replays aren't deterministic: the completions of the asynchronous SQL
+ * queries are delivered on whatever virtual tick they finish by, and the
+ * game logic reading the real clock (time(), e.g. OnClock events and
+ * expirations) doesn't follow the virtual one.
+ *
+ * @param filename Capture file.
+ * @return false if the replay couldn't be started.
+ */
+static bool socket_traffic_start_replay(const char *filename)
+{
+	uint8 head[SOCKET_TRAFFIC_HEADER_SIZE];
+
+	nullpo_retr(false, filename);
+
+	if (traffic_recording || traffic_replaying) {
+		ShowError("socket_traffic_start_replay: a capture or a replay is already running.\n");
+		return false;
+	}
+	if ((traffic_fp = fopen(filename, "rb")) == NULL) {
+		ShowError("socket_traffic_start_replay: unable to open '%s'.\n", filename);
+		return false;
+	}
+	if (fread(head, sizeof(head), 1, traffic_fp) != 1 || memcmp(head, SOCKET_TRAFFIC_MAGIC, 8) != 0 || RBUFL(head, 8) != SOCKET_TRAFFIC_VERSION) {
+		ShowError("socket_traffic_start_replay: '%s' is not a traffic capture.\n", filename);
+		fclose(traffic_fp);
+		traffic_fp = NULL;
+		return false;
+	}
+	if (RBUFL(head, 12) != PACKETVER)
+		ShowWarning("socket_traffic_start_replay: '%s' was captured with PACKETVER %u (this server uses %d).\n", filename, RBUFL(head, 12), PACKETVER);
+
+	rnd->seed(RBUFL(head, 16));
+	traffic_start_tick = timer->gettick_nocache();
+	timer->set_virtual_tick(traffic_start_tick);
+	memset(traffic_fds, 0, sizeof(traffic_fds));
+	memset(traffic_connections, 0, sizeof(traffic_connections));
+	VECTOR_INIT(traffic_pending);
+	traffic_replaying = true;
+	traffic_replay_start_us = timer->gettick_us();
+
+	ShowStatus("Replaying the traffic captured in '"CL_WHITE"%s"CL_RESET"' (seed %u).\n", filename, RBUFL(head, 16));
+	if (!socket_traffic_read_next())
+		socket_traffic_end_replay();
+	return true;
+}
+
+static void socket_traffic_final(void)
+{
+	if (traffic_recording)
+		ShowStatus("Traffic capture finished: %"PRIu64" events, %"PRIu64" bytes received.\n", traffic_events, traffic_bytes_in);
+	if (traffic_fp != NULL) {
+		fclose(traffic_fp);
+		traffic_fp = NULL;
+	}
+	if (traffic_replaying)
+		VECTOR_CLEAR(traffic_pending);
+	aFree(traffic_next.data);
+	traffic_next.data = NULL;
+	traffic_recording = traffic_replaying = false;
+}
+
+static int recv_to_fifo(int fd)
+{
+	ssize_t len;
+
+	if (!sockt->session_is_active(fd))
+		return -1;
+
+	len = sRecv(fd, (char *) sockt->session[fd]->rdata + sockt->session[fd]->rdata_size, (int)RFIFOSPACE(fd), 0);
+
+	if( len == SOCKET_ERROR )
+	{//An exception has occurred
+		if( sErrno != S_EWOULDBLOCK ) {
+			//ShowDebug("recv_to_fifo: %s, closing connection #%d\n", error_msg(), fd);
+			sockt->eof(fd);
+		}
+		return 0;
+	}
+
+	if( len == 0 )
+	{//Normal connection end.
+		sockt->eof(fd);
+		return 0;
+	}
+
+	socket_traffic_record(SOCKET_TRAFFIC_DATA, fd, sockt->session[fd]->rdata + sockt->session[fd]->rdata_size, len);
+	sockt->session[fd]->rdata_size += len;
+	sockt->session[fd]->rdata_tick = sockt->last_tick;
+#ifdef SHOW_SERVER_STATS
+	socket_data_i += len;
+	socket_data_qi += len;
+	if (!sockt->session[fd]->flag.server)
+	{
+		socket_data_ci += len;
+	}
+#endif  // SHOW_SERVER_STATS
+	return (int)len;
+}
+
+/// Whether the session has data (copied or shared) waiting to be sent.
+static inline bool session_has_wdata(const struct socket_data *s)
+{
+	return (s->wdata_size > 0 || s->wrefs_count > 0);
+}
+
+/// Releases all the shared buffers queued in a session.
+static void wrefs_clear(struct socket_data *s)
+{
+	int i;
+
+	for (i = 0; i < s->wrefs_count; i++) {
+#ifdef SHOW_SERVER_STATS
+		socket_data_qo -= s->wrefs[i].buf->len - (i == 0 ? s->wrefs_sent : 0);
+#endif  // SHOW_SERVER_STATS
+		sockt->shared_release(s->wrefs[i].buf);
+	}
+	s->wrefs_count = 0;
+	s->wrefs_sent = 0;
+}
+
+#ifndef WIN32
+/// Maximum number of pieces handed to a single sendmsg call.
+#define SEND_IOV_MAX 64
+
+/// Sends the queue of a session that contains shared buffers, interleaving
+/// them with the copied data without flattening anything.
+static int send_from_fifo_shared(int fd)
+{
+	struct socket_data *s = sockt->session[fd];
+
+	while (session_has_wdata(s)) {
+		struct iovec iov[SEND_IOV_MAX];
+		struct msghdr msg = { 0 };
+		size_t wpos = 0, total = 0, skip = s->wrefs_sent;
+		int n = 0, i;
+		ssize_t len;
+
+		for (i = 0; i < s->wrefs_count && n < SEND_IOV_MAX - 1; i++) {
+			struct socket_wref *ref = &s->wrefs[i];
+			if (ref->wpos > wpos) {
+				iov[n].iov_base = s->wdata + wpos;
+				iov[n].iov_len = ref->wpos - wpos;
+				total += iov[n++].iov_len;
+				wpos = ref->wpos;
+			}
+			iov[n].iov_base = ref->buf->data + skip;
+			iov[n].iov_len = ref->buf->len - skip;
+			total += iov[n++].iov_len;
+			skip = 0;
+		}
+		if (i == s->wrefs_count && s->wdata_size > wpos && n < SEND_IOV_MAX) {
+			iov[n].iov_base = s->wdata + wpos;
+			iov[n].iov_len = s->wdata_size - wpos;
+			total += iov[n++].iov_len;
+		}
+
+		msg.msg_iov = iov;
+		msg.msg_iovlen = n;
+		len = sendmsg(fd, &msg, MSG_NOSIGNAL);
+
+		if (len == SOCKET_ERROR) {
+			if (sErrno != S_EWOULDBLOCK) {
+#ifdef SHOW_SERVER_STATS
+				socket_data_qo -= s->wdata_size;
+#endif  // SHOW_SERVER_STATS
+				s->wdata_size = 0; // Clear the send queue as we can't send anymore.
+				wrefs_clear(s);
+				sockt->eof(fd);
+			}
+			return 0;
+		}
+		if (len <= 0)
+			return 0;
+
+		s->wdata_tick = sockt->last_tick;
+#ifdef SHOW_SERVER_STATS
+		socket_data_o += len;
+		socket_data_qo -= len;
+		if (!s->flag.server)
+			socket_data_co += len;
+#endif  // SHOW_SERVER_STATS
+
+		// consume the sent bytes: copied data before each reference, then the reference itself
+		{
+			size_t left = (size_t)len, copied = 0;
+			int done = 0;
+
+			while (left > 0) {
+				if (done < s->wrefs_count) {
+					struct socket_wref *ref = &s->wrefs[done];
+					size_t before = ref->wpos - copied, rest;
+					if (left <= before) {
+						copied += left;
+						break;
+					}
+					copied += before;
+					left -= before;
+					rest = ref->buf->len - s->wrefs_sent;
+					if (left < rest) {
+						s->wrefs_sent += left;
+						break;
+					}
+					left -= rest;
+					s->wrefs_sent = 0;
+					sockt->shared_release(ref->buf);
+					done++;
+				} else {
+					copied += left;
+					break;
+				}
+			}
+
+			if (copied > 0) {
+				if (copied < s->wdata_size)
+					memmove(s->wdata, s->wdata + copied, s->wdata_size - copied);
+				s->wdata_size -= copied;
+			}
+			if (done > 0) {
+				s->wrefs_count -= done;
+				if (s->wrefs_count > 0)
+					memmove(s->wrefs, s->wrefs + done, s->wrefs_count * sizeof(*s->wrefs));
+			}
+			for (i = 0; i < s->wrefs_count; i++)
+				s->wrefs[i].wpos -= copied;
+		}
+
+		if ((size_t)len < total)
+			break; // kernel buffer is full
+	}
+
+	return 0;
+}
+#endif  // WIN32
+
+static int send_from_fifo(int fd)
+{
+	ssize_t len;
+
+	if (!sockt->session_is_valid(fd))
+		return -1;
+
+#ifndef WIN32
+	if (sockt->session[fd]->wrefs_count > 0)
+		return send_from_fifo_shared(fd);
+#endif  // WIN32
+
+	if( sockt->session[fd]->wdata_size == 0 )
+		return 0; // nothing to send
+
+	len = sSend(fd, (const char *) sockt->session[fd]->wdata, (int)sockt->session[fd]->wdata_size, MSG_NOSIGNAL);
+
+	if( len == SOCKET_ERROR )
+	{ //An exception has occurred
+		if( sErrno != S_EWOULDBLOCK ) {
+			//ShowDebug("send_from_fifo: %s, ending connection #%d\n", error_msg(), fd);
+#ifdef SHOW_SERVER_STATS
+			socket_data_qo -= sockt->session[fd]->wdata_size;
+#endif  // SHOW_SERVER_STATS
+			sockt->session[fd]->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
+			sockt->eof(fd);
+		}
+		return 0;
+	}
+
+	if (len > 0)
+	{
+		sockt->session[fd]->wdata_tick = sockt->last_tick;
+		// some data could not be transferred?
+		// shift unsent data to the beginning of the queue
+		if ((size_t)len < sockt->session[fd]->wdata_size)
+			memmove(sockt->session[fd]->wdata, sockt->session[fd]->wdata + len, sockt->session[fd]->wdata_size - len);
+
+		sockt->session[fd]->wdata_size -= len;
+#ifdef SHOW_SERVER_STATS
+		socket_data_o += len;
+		socket_data_qo -= len;
+		if (!sockt->session[fd]->flag.server)
+		{
+			socket_data_co += len;
+		}
+#endif  // SHOW_SERVER_STATS
+	}
+
+	return 0;
+}
+
+/// Best effort - there's no warranty that the data will be sent.
+static void flush_fifo(int fd)
+{
+	if(sockt->session[fd] != NULL)
+		sockt->session[fd]->func_send(fd);
+}
+
+static void flush_fifos(void)
+{
+	int i;
+	for(i = 1; i < sockt->fd_max; i++)
+		sockt->flush(i);
+}
+
+#ifdef SOCKET_EPOLL
+/*======================================
+ * CORE : Network I/O threads
+ *--------------------------------------*/
+
+/// Adds a fd to a queue.
+/// @return true if the consumer drained the queue up to the new fd (it needs to be woken up).
+static bool socket_io_queue_push(struct socket_io_queue *queue, int fd)
+{
+	int32 tail = queue->tail;
+
+	// can't overflow, each fd is at most once in each queue and the size is bigger than MAXCONN
+	queue->data[tail] = fd;
+	InterlockedCompareExchange(&queue->tail, (tail + 1) & (socket_io_queue_size - 1), tail);
+	// head is read after tail is published (both are full barriers): either the
+	// consumer sees the new fd before it sleeps, or the producer sees it drained
+	// everything before the new fd and wakes it up
+	return (socket_io_atomic_read(&queue->head) == tail);
+}
+
+/// Removes the first fd of a queue.
+/// @return the fd, or -1 if the queue is empty.
+static int socket_io_queue_pop(struct socket_io_queue *queue)
+{
+	int32 head = queue->head;
+	int fd;
+
+	if (head == socket_io_atomic_read(&queue->tail))
+		return -1;
+	fd = queue->data[head];
+	InterlockedCompareExchange(&queue->head, (head + 1) & (socket_io_queue_size - 1), head);
+	return fd;
+}
+
+static void socket_io_wakeup(int evfd)
+{
+	uint64 value = 1;
+	if (write(evfd, &value, sizeof(value)) < 0) {
+		// the counter can't overflow in practice, nothing to do
+	}
+}
+
+static void socket_io_clear_wakeup(int evfd)
+{
+	uint64 value;
+	if (read(evfd, &value, sizeof(value)) < 0) {
+		// already cleared
+	}
+}
+
+static struct socket_io_thread *socket_io_thread_of(int fd)
+{
+	return &socket_io_threads[fd % socket_io_thread_count];
+}
+
+/// (I/O thread) Notifies the main thread that a connection has data or eof.
+static void socket_io_notify(struct socket_io_thread *t, int fd)
+{
+	if (InterlockedCompareExchange(&socket_io_data[fd].ready, 1, 0) != 0)
+		return; // already queued
+	if (socket_io_queue_push(&t->ready, fd))
+		socket_io_wakeup(socket_io_evfd);
+}
+
+/// (main thread) Asks the I/O thread of a connection to process it.
+static void socket_io_command(int fd)
+{
+	struct socket_io_thread *t = socket_io_thread_of(fd);
+
+	if (InterlockedCompareExchange(&socket_io_data[fd].pending, 1, 0) != 0)
+		return; // already queued
+	if (socket_io_queue_push(&t->commands, fd))
+		socket_io_wakeup(t->evfd);
+}
+
+/// (I/O thread) Receives data until the socket has no more or the receive buffer is full.
+static void socket_io_read(struct socket_io_thread *t, int fd)
+{
+	struct socket_io *io = &socket_io_data[fd];
+	bool notify = false;
+
+	while (true) {
+		size_t space;
+		ssize_t len;
+
+		mutex->lock(io->lock);
+		if (io->state != SOCKET_IO_ACTIVE) {
+			mutex->unlock(io->lock);
+			break;
+		}
+		space = io->max_rbuf - io->rbuf_size;
+		if (space == 0)
+			io->read_blocked = true;
+		mutex->unlock(io->lock);
+		if (space == 0)
+			break; // the main thread resumes reading once it makes room
+
+		len = sRecv(fd, (char *)t->buf, (int)min(space, SOCKET_IO_BUFFER_SIZE), 0);
+		if (len == SOCKET_ERROR && sErrno == S_EINTR)
+			continue;
+		if (len == SOCKET_ERROR && sErrno == S_EWOULDBLOCK)
+			break;
+
+		mutex->lock(io->lock);
+		if (io->state == SOCKET_IO_ACTIVE) {
+			if (len == SOCKET_ERROR || len == 0) {
+				// error or normal connection end
+				io->state = SOCKET_IO_EOF;
+			} else {
+				// only this thread appends to the buffer, so there is still enough room
+				memcpy(io->rbuf + io->rbuf_size, t->buf, len);
+				io->rbuf_size += len;
+			}
+			notify = true;
+		}
+		mutex->unlock(io->lock);
+		if (len == SOCKET_ERROR || len == 0)
+			break;
+	}
+
+	if (notify)
+		socket_io_notify(t, fd);
+}
+
+/// (I/O thread) Sends data until the send buffer is empty or the socket can't take more.
+static void socket_io_write(struct socket_io_thread *t, int fd)
+{
+	struct socket_io *io = &socket_io_data[fd];
+
+	while (true) {
+		size_t len;
+		ssize_t sent;
+
+		mutex->lock(io->lock);
+		if (io->state != SOCKET_IO_ACTIVE && io->state != SOCKET_IO_CLOSE)
+			io->wbuf_size = 0; // can't send anymore
+		len = min(io->wbuf_size, SOCKET_IO_BUFFER_SIZE);
+		if (len > 0)
+			memcpy(t->buf, io->wbuf, len);
+		mutex->unlock(io->lock);
+		if (len == 0)
+			break;
+
+		sent = sSend(fd, (const char *)t->buf, (int)len, MSG_NOSIGNAL);
+		if (sent == SOCKET_ERROR && sErrno == S_EINTR)
+			continue;
+		if (sent == SOCKET_ERROR && sErrno == S_EWOULDBLOCK)
+			break; // continues on EPOLLOUT
+
+		mutex->lock(io->lock);
+		if (sent == SOCKET_ERROR) {
+			io->wbuf_size = 0;
+			if (io->state == SOCKET_IO_ACTIVE)
+				io->state = SOCKET_IO_EOF;
+		} else {
+			// only this thread removes data from the buffer
+			memmove(io->wbuf, io->wbuf + sent, io->wbuf_size - sent);
+			io->wbuf_size -= sent;
+		}
+		mutex->unlock(io->lock);
+
+		if (sent == SOCKET_ERROR) {
+			socket_io_notify(t, fd);
+			break;
+		}
+		if ((size_t)sent < len)
+			break; // socket buffer is full
+	}
+}
+
+/// (I/O thread) Closes a connection after trying to send what's left.
+static void socket_io_close(struct socket_io_thread *t, int fd)
+{
+	struct socket_io *io = &socket_io_data[fd];
+	struct epoll_event ev = { 0 };
+
+	socket_io_write(t, fd);
+	epoll_ctl(t->epfd, EPOLL_CTL_DEL, fd, &ev);
+
+	// reset the state before closing, the fd can be reused right after that
+	mutex->lock(io->lock);
+	io->state = SOCKET_IO_NONE;
+	io->rbuf_size = io->wbuf_size = 0;
+	io->read_blocked = io->read_resume = false;
+	mutex->unlock(io->lock);
+
+	sShutdown(fd, SHUT_RDWR);
+	sClose(fd);
+}
+
+/// (I/O thread) Processes the requests of the main thread.
+static void socket_io_do_commands(struct socket_io_thread *t)
+{
+	int fd;
+
+	while ((fd = socket_io_queue_pop(&t->commands)) != -1) {
+		struct socket_io *io = &socket_io_data[fd];
+		enum socket_io_state state;
+		bool resume;
+
+		InterlockedExchange(&io->pending, 0);
+
+		mutex->lock(io->lock);
+		state = io->state;
+		resume = io->read_resume;
+		io->read_resume = false;
+		mutex->unlock(io->lock);
+
+		if (state == SOCKET_IO_CLOSE) {
+			socket_io_close(t, fd);
+			continue;
+		}
+		socket_io_write(t, fd);
+		if (resume)
+			socket_io_read(t, fd);
+	}
+}
+
+/// Entry point of the I/O threads.
+static void *socket_io_thread_main(void *param)
+{
+	struct socket_io_thread *t = param;
+	struct epoll_event events[SOCKET_IO_MAX_EVENTS];
+
+	while (socket_io_atomic_read(&socket_io_running) != 0) {
+		int i;
+		int ret = epoll_wait(t->epfd, events, SOCKET_IO_MAX_EVENTS, -1);
+
+		if (ret == SOCKET_ERROR) {
+			if (sErrno == S_EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < ret; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == t->evfd) {
+				socket_io_clear_wakeup(fd);
+				continue;
+			}
+			if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) != 0)
+				socket_io_read(t, fd);
+			if ((events[i].events & EPOLLOUT) != 0)
+				socket_io_write(t, fd);
+		}
+
+		socket_io_do_commands(t);
+	}
+
+	// close the connections that were deleted during shutdown
+	socket_io_do_commands(t);
+	return NULL;
+}
+
+/// (main thread) Hands a new connection over to its I/O thread.
+static bool socket_io_attach(int fd)
+{
+	struct socket_io *io = &socket_io_data[fd];
+	struct epoll_event ev = { 0 };
+
+	if (io->lock == NULL)
+		io->lock = mutex->create();
+	if (io->rbuf == NULL) {
+		CREATE(io->rbuf, uint8, SOCKET_IO_RBUF_SIZE);
+		io->max_rbuf = SOCKET_IO_RBUF_SIZE;
+	}
+	if (io->wbuf == NULL) {
+		CREATE(io->wbuf, uint8, WFIFO_SIZE);
+		io->max_wbuf = WFIFO_SIZE;
+	}
+
+	mutex->lock(io->lock);
+	io->state = SOCKET_IO_ACTIVE;
+	io->rbuf_size = io->wbuf_size = 0;
+	io->read_blocked = io->read_resume = false;
+	mutex->unlock(io->lock);
+
+	// edge triggered, the I/O thread always reads/sends until the call would block
+	ev.data.fd = fd;
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	if (epoll_ctl(socket_io_thread_of(fd)->epfd, EPOLL_CTL_ADD, fd, &ev) == SOCKET_ERROR) {
+		mutex->lock(io->lock);
+		io->state = SOCKET_IO_NONE;
+		mutex->unlock(io->lock);
+		return false;
+	}
+	return true;
+}
+
+/// (main thread) Asks the I/O thread to close a connection.
+/// The session is deleted right away, the socket is closed by the I/O thread.
+static void socket_io_detach(int fd)
+{
+	struct socket_io *io = &socket_io_data[fd];
+
+	sockt->flush(fd); // hand over what's left in the WFIFO
+
+	mutex->lock(io->lock);
+	io->state = SOCKET_IO_CLOSE;
+	io->rbuf_size = 0;
+	mutex->unlock(io->lock);
+	socket_io_command(fd);
+
+	if (sockt->session[fd])
+		sockt->delete_session(fd);
+}
+
+static void socket_io_backlog_add(int fd)
+{
+	if (socket_io_data[fd].backlog)
+		return;
+	socket_io_data[fd].backlog = true;
+	socket_io_backlog[socket_io_backlog_count++] = fd;
+}
+
+/// (main thread) RecvFunc of the connections owned by I/O threads.
+/// Moves the received data to the RFIFO.
+static int socket_io_recv(int fd)
+{
+	struct socket_data *s;
+	struct socket_io *io = &socket_io_data[fd];
+	size_t len;
+	bool eof, resume, remaining;
+
+	if (!sockt->session_is_active(fd))
+		return -1;
+
+	s = sockt->session[fd];
+	mutex->lock(io->lock);
+	len = min(io->rbuf_size, RFIFOSPACE(fd));
+	if (len > 0) {
+		memcpy(s->rdata + s->rdata_size, io->rbuf, len);
+		io->rbuf_size -= len;
+		memmove(io->rbuf, io->rbuf + len, io->rbuf_size);
+	}
+	resume = (io->read_blocked && io->rbuf_size < io->max_rbuf);
+	if (resume) {
+		if (io->max_rbuf < s->max_rdata) { // server connections
+			RECREATE(io->rbuf, uint8, s->max_rdata);
+			io->max_rbuf = s->max_rdata;
+		}
+		io->read_blocked = false;
+		io->read_resume = true;
+	}
+	remaining = (io->rbuf_size > 0);
+	eof = (io->state == SOCKET_IO_EOF && !remaining);
+	mutex->unlock(io->lock);
+
+	if (len > 0) {
+		socket_traffic_record(SOCKET_TRAFFIC_DATA, fd, s->rdata + s->rdata_size, len);
+		s->rdata_size += len;
+		s->rdata_tick = sockt->last_tick;
+#ifdef SHOW_SERVER_STATS
+		socket_data_i += len;
+		socket_data_qi += len;
+		if (!s->flag.server)
+			socket_data_ci += len;
+#endif  // SHOW_SERVER_STATS
+	}
+	if (remaining)
+		socket_io_backlog_add(fd);
+	if (resume)
+		socket_io_command(fd);
+	if (eof)
+		sockt->eof(fd);
+	return (int)len;
+}
+
+/// (main thread) SendFunc of the connections owned by I/O threads.
+/// Hands the content of the WFIFO over to the I/O thread.
+static int socket_io_send(int fd)
+{
+	struct socket_data *s;
+	struct socket_io *io = &socket_io_data[fd];
+	bool queued = false;
+
+	if (!sockt->session_is_valid(fd))
+		return -1;
+
+	s = sockt->session[fd];
+	if (s->wdata_size == 0)
+		return 0; // nothing to send
+
+	mutex->lock(io->lock);
+	if (io->state == SOCKET_IO_ACTIVE) {
+		if (io->wbuf_size + s->wdata_size > io->max_wbuf) {
+			size_t newsize = io->max_wbuf;
+			while (io->wbuf_size + s->wdata_size > newsize)
+				newsize *= 2;
+			RECREATE(io->wbuf, uint8, newsize);
+			io->max_wbuf = newsize;
+		} else if (io->wbuf_size == 0 && io->max_wbuf > 4 * WFIFO_SIZE && s->wdata_size <= WFIFO_SIZE) {
+			// shrink back after a burst
+			RECREATE(io->wbuf, uint8, WFIFO_SIZE);
+			io->max_wbuf = WFIFO_SIZE;
+		}
+		memcpy(io->wbuf + io->wbuf_size, s->wdata, s->wdata_size);
+		io->wbuf_size += s->wdata_size;
+		queued = true;
+	}
+	mutex->unlock(io->lock);
+
+#ifdef SHOW_SERVER_STATS
+	socket_data_o += s->wdata_size;
+	socket_data_qo -= s->wdata_size;
+	if (!s->flag.server)
+		socket_data_co += s->wdata_size;
+#endif  // SHOW_SERVER_STATS
+	s->wdata_size = 0;
+	s->wdata_tick = sockt->last_tick;
+
+	if (queued)
+		socket_io_command(fd);
+	return 0;
+}
+
+/// (main thread) Moves the data received by the I/O threads to the RFIFOs.
+static void socket_io_do_recv(void)
+{
+	int i, count = socket_io_backlog_count;
+
+	// connections that still had data that didn't fit in the RFIFO
+	socket_io_backlog_count = 0;
+	for (i = 0; i < count; i++) {
+		int fd = socket_io_backlog[i];
+
+		socket_io_data[fd].backlog = false;
+		if (sockt->session[fd] != NULL && sockt->session[fd]->func_recv == socket_io_recv)
+			sockt->session[fd]->func_recv(fd);
+	}
+
+	for (i = 0; i < socket_io_thread_count; i++) {
+		int fd;
+
+		while ((fd = socket_io_queue_pop(&socket_io_threads[i].ready)) != -1) {
+			InterlockedExchange(&socket_io_data[fd].ready, 0);
+			// the session might be gone already (or be a new one, which is harmless)
+			if (sockt->session[fd] != NULL && sockt->session[fd]->func_recv == socket_io_recv)
+				sockt->session[fd]->func_recv(fd);
+		}
+	}
+}
+
+/// Starts the I/O threads.
+static void socket_io_init(void)
+{
+	struct epoll_event ev = { 0 };
+	int i;
+
+	socket_io_queue_size = 1;
+	while (socket_io_queue_size <= MAXCONN)
+		socket_io_queue_size <<= 1;
+	CREATE(socket_io_data, struct socket_io, MAXCONN);
+
+	socket_io_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (socket_io_evfd == SOCKET_ERROR) {
+		ShowFatalError("socket_io_init: failed to create eventfd: %s\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	ev.data.fd = socket_io_evfd;
+	ev.events = EPOLLIN;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, socket_io_evfd, &ev) == SOCKET_ERROR) {
+		ShowFatalError("socket_io_init: failed to add eventfd to epoll event dispatcher: %s\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+
+	InterlockedExchange(&socket_io_running, 1);
+	CREATE(socket_io_threads, struct socket_io_thread, socket_io_thread_count);
+	for (i = 0; i < socket_io_thread_count; i++) {
+		struct socket_io_thread *t = &socket_io_threads[i];
+
+		t->epfd = epoll_create(MAXCONN);
+		t->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (t->epfd == SOCKET_ERROR || t->evfd == SOCKET_ERROR) {
+			ShowFatalError("socket_io_init: failed to create I/O thread #%d: %s\n", i, error_msg());
+			exit(EXIT_FAILURE);
+		}
+		ev.data.fd = t->evfd;
+		ev.events = EPOLLIN;
+		if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, t->evfd, &ev) == SOCKET_ERROR) {
+			ShowFatalError("socket_io_init: failed to add eventfd to I/O thread #%d: %s\n", i, error_msg());
+			exit(EXIT_FAILURE);
+		}
+		CREATE(t->commands.data, int, socket_io_queue_size);
+		CREATE(t->ready.data, int, socket_io_queue_size);
+		CREATE(t->buf, uint8, SOCKET_IO_BUFFER_SIZE);
+
+		if ((t->handle = thread->create(socket_io_thread_main, t)) == NULL) {
+			ShowFatalError("socket_io_init: failed to start I/O thread #%d\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	ShowInfo("Server uses '" CL_WHITE "%d" CL_RESET "' network I/O threads\n", socket_io_thread_count);
+}
+
+/// Stops the I/O threads, after they close the remaining connections.
+static void socket_io_final(void)
+{
+	int i;
+
+	if (socket_io_threads == NULL)
+		return;
+
+	InterlockedExchange(&socket_io_running, 0);
+	for (i = 0; i < socket_io_thread_count; i++) {
+		socket_io_wakeup(socket_io_threads[i].evfd);
+		thread->wait(socket_io_threads[i].handle, NULL);
+	}
+
+	for (i = 0; i < socket_io_thread_count; i++) {
+		struct socket_io_thread *t = &socket_io_threads[i];
+
+		close(t->epfd);
+		close(t->evfd);
+		aFree(t->commands.data);
+		aFree(t->ready.data);
+		aFree(t->buf);
+	}
+	aFree(socket_io_threads);
+	socket_io_threads = NULL;
+
+	for (i = 0; i < MAXCONN; i++) {
+		struct socket_io *io = &socket_io_data[i];
+
+		if (io->lock != NULL)
+			mutex->destroy(io->lock);
+		if (io->rbuf != NULL)
+			aFree(io->rbuf);
+		if (io->wbuf != NULL)
+			aFree(io->wbuf);
+	}
+	aFree(socket_io_data);
+	socket_io_data = NULL;
+	socket_io_backlog_count = 0;
+
+	close(socket_io_evfd);
+	socket_io_evfd = SOCKET_ERROR;
+}
+#endif  // SOCKET_EPOLL
+
+#ifdef SOCKET_IO_URING
+/*======================================
+ * CORE : io_uring Event Dispatcher
+ *--------------------------------------*/
+
+#define socket_uring_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define socket_uring_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static int socket_uring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags, const void *arg, size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, uring_fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+/// Submits the queued requests without waiting for completions.
+static void socket_uring_submit(void)
+{
+	while (uring_to_submit > 0) {
+		int ret = socket_uring_enter(uring_to_submit, 0, 0, NULL, 0);
+		if (ret < 0) {
+			if (sErrno == S_EINTR || sErrno == EAGAIN || sErrno == EBUSY)
+				continue;
+			ShowFatalError("socket_uring_submit: io_uring_enter() failed, %s!\n", error_msg());
+			exit(EXIT_FAILURE);
+		}
+		uring_to_submit -= ret;
+	}
+}
+
+/// Gets a new submission queue entry, submitting the queued ones if the queue is full.
+static struct io_uring_sqe *socket_uring_get_sqe(void)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int index;
+
+	if (uring_sq_local_tail - socket_uring_load_acquire(uring_sq_head) >= uring_sq_entries)
+		socket_uring_submit();
+
+	index = uring_sq_local_tail & *uring_sq_mask;
+	sqe = &uring_sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	uring_sq_array[index] = index;
+	return sqe;
+}
+
+/// Queues a submission queue entry obtained with socket_uring_get_sqe.
+static void socket_uring_queue_sqe(void)
+{
+	uring_sq_local_tail++;
+	uring_to_submit++;
+	socket_uring_store_release(uring_sq_tail, uring_sq_local_tail);
+}
+
+static struct socket_uring_req *socket_uring_req_create(enum socket_uring_op op, int fd)
+{
+	struct socket_uring_req *req = ers_alloc(uring_req_ers, struct socket_uring_req);
+
+	memset(req, 0, sizeof(*req));
+	req->op = op;
+	req->fd = fd;
+	req->gen = uring_conns[fd].gen;
+	req->next = uring_reqs;
+	if (uring_reqs != NULL)
+		uring_reqs->prev = req;
+	uring_reqs = req;
+	return req;
+}
+
+static void socket_uring_req_delete(struct socket_uring_req *req)
+{
+	if (req->prev != NULL)
+		req->prev->next = req->next;
+	else
+		uring_reqs = req->next;
+	if (req->next != NULL)
+		req->next->prev = req->prev;
+	if (req->buf != NULL)
+		aFree(req->buf);
+	ers_free(uring_req_ers, req);
+}
+
+/// Queues the (multishot) request that receives the data or connections of a socket.
+static void socket_uring_arm(struct socket_uring_req *req)
+{
+	struct io_uring_sqe *sqe = socket_uring_get_sqe();
+
+	sqe->fd = req->fd;
+	if (req->op == SOCKET_URING_ACCEPT) {
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	} else {
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = SOCKET_URING_BGID;
+	}
+	sqe->user_data = (uint64)(uintptr_t)req;
+	socket_uring_queue_sqe();
+	uring_conns[req->fd].armed = true;
+}
+
+/// Queues the cancellation of the (multishot) request of a socket.
+static void socket_uring_cancel(struct socket_uring_req *req)
+{
+	struct io_uring_sqe *sqe = socket_uring_get_sqe();
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uint64)(uintptr_t)req;
+	sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+	sqe->user_data = 0;
+	socket_uring_queue_sqe();
+}
+
+/// Queues the send of the remaining data of a send request.
+static void socket_uring_queue_send(struct socket_uring_req *req)
+{
+	struct io_uring_sqe *sqe = socket_uring_get_sqe();
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = req->fd;
+	sqe->addr = (uint64)(uintptr_t)(req->buf + req->pos);
+	sqe->len = (uint32)(req->len - req->pos);
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = (uint64)(uintptr_t)req;
+	socket_uring_queue_sqe();
+}
+
+/// Starts receiving data (or connections) on a new socket.
+static void socket_uring_add(int fd, bool listener)
+{
+	struct socket_uring_conn *conn = &uring_conns[fd];
+
+	conn->sending = false;
+	conn->paused = false;
+	conn->rbuf_size = 0;
+	conn->req = socket_uring_req_create(listener ? SOCKET_URING_ACCEPT : SOCKET_URING_RECV, fd);
+	socket_uring_arm(conn->req);
+}
+
+/// Stops using a socket, which is about to be closed.
+static void socket_uring_remove(int fd)
+{
+	struct socket_uring_conn *conn = &uring_conns[fd];
+
+	if (conn->req != NULL) {
+		if (conn->armed)
+			socket_uring_cancel(conn->req); // deleted by its last completion
+		else
+			socket_uring_req_delete(conn->req); // paused recv
+		conn->req = NULL;
+	}
+	// requests using the fd must be submitted before it's closed (and maybe reused)
+	socket_uring_submit();
+
+	// completions of the requests still in flight are ignored from now on
+	conn->gen++;
+	conn->armed = false;
+	conn->paused = false;
+	conn->sending = false;
+	conn->rbuf_size = 0;
+}
+
+static void socket_uring_backlog_add(int fd)
+{
+	if (uring_conns[fd].backlog)
+		return;
+	uring_conns[fd].backlog = true;
+	socket_uring_backlog[socket_uring_backlog_count++] = fd;
+}
+
+/**
+ * Moves received data to the RFIFO, keeping what doesn't fit for later and
+ * stopping the recv request until it's moved.
+ *
+ * @return false if the backlog is full (the peer ignored the backpressure).
+ */
+static bool socket_uring_deliver(int fd, const uint8 *data, size_t len)
+{
+	struct socket_data *s = sockt->session[fd];
+	struct socket_uring_conn *conn = &uring_conns[fd];
+	// at least one provided buffer, so that a single completion always fits
+	size_t max_backlog = max(s->max_rdata, (size_t)SOCKET_URING_BUFFER_SIZE);
+	size_t space = (conn->rbuf_size == 0) ? RFIFOSPACE(fd) : 0;
+	size_t direct = min(len, space);
+
+	if (direct > 0) {
+		memcpy(s->rdata + s->rdata_size, data, direct);
+		socket_traffic_record(SOCKET_TRAFFIC_DATA, fd, s->rdata + s->rdata_size, direct);
+		s->rdata_size += direct;
+	}
+	if (len > direct) {
+		// completions already posted before the recv request was stopped
+		if (conn->rbuf_size + len - direct > max_backlog) {
+			ShowWarning("socket_uring_deliver: Receive backlog of session #%d is full (%"PRIuS" bytes), closing it.\n", fd, conn->rbuf_size);
+			return false;
+		}
+		if (conn->rbuf_size + len - direct > conn->max_rbuf) {
+			conn->max_rbuf = max_backlog;
+			RECREATE(conn->rbuf, uint8, conn->max_rbuf);
+		}
+		memcpy(conn->rbuf + conn->rbuf_size, data + direct, len - direct);
+		conn->rbuf_size += len - direct;
+		socket_uring_backlog_add(fd);
+		if (!conn->paused) {
+			conn->paused = true;
+			if (conn->armed) {
+				socket_uring_cancel(conn->req);
+				socket_uring_submit(); // the sooner it's stopped the less data piles up
+			}
+		}
+	}
+	s->rdata_tick = sockt->last_tick;
+#ifdef SHOW_SERVER_STATS
+	socket_data_i += len;
+	socket_data_qi += len;
+	if (!s->flag.server)
+		socket_data_ci += len;
+#endif  // SHOW_SERVER_STATS
+	return true;
+}
+
+/// RecvFunc of the connections handled by io_uring.
+/// Moves the data that didn't fit in the RFIFO before, and restarts the recv request once it's all moved.
+static int socket_uring_recv(int fd)
+{
+	struct socket_data *s;
+	struct socket_uring_conn *conn = &uring_conns[fd];
+	size_t len;
+
+	if (!sockt->session_is_active(fd))
+		return -1;
+
+	s = sockt->session[fd];
+	len = min(conn->rbuf_size, RFIFOSPACE(fd));
+	if (len > 0) {
+		memcpy(s->rdata + s->rdata_size, conn->rbuf, len);
+		socket_traffic_record(SOCKET_TRAFFIC_DATA, fd, s->rdata + s->rdata_size, len);
+		s->rdata_size += len;
+		conn->rbuf_size -= len;
+		memmove(conn->rbuf, conn->rbuf + len, conn->rbuf_size);
+	}
+	if (conn->rbuf_size > 0) {
+		socket_uring_backlog_add(fd);
+	} else if (conn->paused) {
+		conn->paused = false;
+		if (!conn->armed && conn->req != NULL)
+			socket_uring_arm(conn->req); // otherwise rearmed by the last completion of the cancelled request
+	}
+	return (int)len;
+}
+
+/// SendFunc of the connections handled by io_uring.
+/// Hands the WFIFO buffer over to a send request, the WFIFO gets a new buffer.
+static int socket_uring_send(int fd)
+{
+	struct socket_data *s;
+	struct socket_uring_conn *conn = &uring_conns[fd];
+	struct socket_uring_req *req;
+
+	if (!sockt->session_is_valid(fd))
+		return -1;
+
+	s = sockt->session[fd];
+	if (s->wdata_size == 0)
+		return 0; // nothing to send
+	if (conn->sending)
+		return 0; // only one send in flight, the rest waits in the WFIFO
+
+	req = socket_uring_req_create(SOCKET_URING_SEND, fd);
+	req->buf = s->wdata;
+	req->len = s->wdata_size;
+	if (conn->spare != NULL && conn->max_spare == s->max_wdata) {
+		s->wdata = conn->spare;
+		conn->spare = NULL;
+	} else {
+		CREATE(s->wdata, uint8, s->max_wdata);
+	}
+#ifdef SHOW_SERVER_STATS
+	socket_data_o += s->wdata_size;
+	socket_data_qo -= s->wdata_size;
+	if (!s->flag.server)
+		socket_data_co += s->wdata_size;
+#endif  // SHOW_SERVER_STATS
+	s->wdata_size = 0;
+	s->wdata_tick = sockt->last_tick;
+
+	conn->sending = true;
+	socket_uring_queue_send(req);
+	return 0;
+}
+
+/// Returns a provided buffer to the ring (published by socket_uring_dispatch).
+static void socket_uring_recycle_buffer(uint16 bid)
 {
-	ssize_t len;
+	struct io_uring_buf *buf = &uring_buf_ring->bufs[uring_buf_tail & (SOCKET_URING_BUFFER_COUNT - 1)];
 
-	if (!sockt->session_is_active(fd))
-		return -1;
+	buf->addr = (uint64)(uintptr_t)(uring_buffers + (size_t)bid * SOCKET_URING_BUFFER_SIZE);
+	buf->len = SOCKET_URING_BUFFER_SIZE;
+	buf->bid = bid;
+	uring_buf_tail++;
+}
 
-	len = sRecv(fd, (char *) sockt->session[fd]->rdata + sockt->session[fd]->rdata_size, (int)RFIFOSPACE(fd), 0);
+static void socket_uring_complete_recv(struct socket_uring_req *req, const struct io_uring_cqe *cqe)
+{
+	int fd = req->fd;
+	bool current = (req->gen == uring_conns[fd].gen && sockt->session_is_active(fd));
 
-	if( len == SOCKET_ERROR )
-	{//An exception has occurred
-		if( sErrno != S_EWOULDBLOCK ) {
-			//ShowDebug("recv_to_fifo: %s, closing connection #%d\n", error_msg(), fd);
+	if ((cqe->flags & IORING_CQE_F_BUFFER) != 0) {
+		uint16 bid = (uint16)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+		if (current && cqe->res > 0
+		 && !socket_uring_deliver(fd, uring_buffers + (size_t)bid * SOCKET_URING_BUFFER_SIZE, (size_t)cqe->res)) {
 			sockt->eof(fd);
+			current = false;
 		}
-		return 0;
+		socket_uring_recycle_buffer(bid);
 	}
 
-	if( len == 0 )
-	{//Normal connection end.
+	if (current && (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED))) {
+		// normal connection end or error
 		sockt->eof(fd);
-		return 0;
+		current = false;
 	}
 
-	sockt->session[fd]->rdata_size += len;
-	sockt->session[fd]->rdata_tick = sockt->last_tick;
-#ifdef SHOW_SERVER_STATS
-	socket_data_i += len;
-	socket_data_qi += len;
-	if (!sockt->session[fd]->flag.server)
-	{
-		socket_data_ci += len;
+	if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
+		// the multishot request ended (no buffers were left, it was stopped, or the socket is done)
+		if (current) {
+			uring_conns[fd].armed = false;
+			if (!uring_conns[fd].paused)
+				socket_uring_arm(req);
+		} else {
+			if (uring_conns[fd].req == req)
+				uring_conns[fd].req = NULL;
+			socket_uring_req_delete(req);
+		}
 	}
-#endif  // SHOW_SERVER_STATS
-	return (int)len;
 }
 
-static int send_from_fifo(int fd)
+static void socket_uring_complete_accept(struct socket_uring_req *req, const struct io_uring_cqe *cqe)
 {
-	ssize_t len;
+	int fd = req->fd;
+	bool current = (req->gen == uring_conns[fd].gen && sockt->session_is_valid(fd));
+
+	if (cqe->res >= 0) {
+		struct sockaddr_in client_address = { 0 };
+		socklen_t len = sizeof(client_address);
+
+		if (!current || getpeername(cqe->res, (struct sockaddr *)&client_address, &len) == SOCKET_ERROR)
+			sClose(cqe->res);
+		else
+			connect_client_setup(cqe->res, &client_address);
+	} else if (current && cqe->res != -ECANCELED) {
+		ShowError("connect_client: accept failed (%s)!\n", strerror(-cqe->res));
+	}
 
-	if (!sockt->session_is_valid(fd))
-		return -1;
+	if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
+		if (current) {
+			socket_uring_arm(req);
+		} else {
+			if (uring_conns[fd].req == req)
+				uring_conns[fd].req = NULL;
+			socket_uring_req_delete(req);
+		}
+	}
+}
 
-	if( sockt->session[fd]->wdata_size == 0 )
-		return 0; // nothing to send
+static void socket_uring_complete_send(struct socket_uring_req *req, const struct io_uring_cqe *cqe)
+{
+	int fd = req->fd;
+	struct socket_uring_conn *conn = &uring_conns[fd];
 
-	len = sSend(fd, (const char *) sockt->session[fd]->wdata, (int)sockt->session[fd]->wdata_size, MSG_NOSIGNAL);
+	if (req->gen != conn->gen || !sockt->session_is_valid(fd)) {
+		socket_uring_req_delete(req); // connection already closed
+		return;
+	}
 
-	if( len == SOCKET_ERROR )
-	{ //An exception has occurred
-		if( sErrno != S_EWOULDBLOCK ) {
-			//ShowDebug("send_from_fifo: %s, ending connection #%d\n", error_msg(), fd);
-#ifdef SHOW_SERVER_STATS
-			socket_data_qo -= sockt->session[fd]->wdata_size;
-#endif  // SHOW_SERVER_STATS
-			sockt->session[fd]->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
-			sockt->eof(fd);
+	if (cqe->res < 0) {
+		sockt->eof(fd);
+	} else {
+		req->pos += cqe->res;
+		if (req->pos < req->len) {
+			// partial send, the rest must go before anything else
+			socket_uring_queue_send(req);
+			return;
 		}
-		return 0;
 	}
 
-	if (len > 0)
-	{
-		sockt->session[fd]->wdata_tick = sockt->last_tick;
-		// some data could not be transferred?
-		// shift unsent data to the beginning of the queue
-		if ((size_t)len < sockt->session[fd]->wdata_size)
-			memmove(sockt->session[fd]->wdata, sockt->session[fd]->wdata + len, sockt->session[fd]->wdata_size - len);
+	conn->sending = false;
+	// keep the buffer for the next send
+	if (conn->spare == NULL) {
+		conn->spare = req->buf;
+		conn->max_spare = sockt->session[fd]->max_wdata; // can't be smaller than the buffer was
+		req->buf = NULL;
+	}
+	socket_uring_req_delete(req);
+}
 
-		sockt->session[fd]->wdata_size -= len;
-#ifdef SHOW_SERVER_STATS
-		socket_data_o += len;
-		socket_data_qo -= len;
-		if (!sockt->session[fd]->flag.server)
-		{
-			socket_data_co += len;
+/// Processes the completions.
+static void socket_uring_dispatch(void)
+{
+	unsigned int head = *uring_cq_head;
+	uint16 buf_tail = uring_buf_tail;
+
+	while (head != socket_uring_load_acquire(uring_cq_tail)) {
+		const struct io_uring_cqe *cqe = &uring_cqes[head & *uring_cq_mask];
+		struct socket_uring_req *req = (struct socket_uring_req *)(uintptr_t)cqe->user_data;
+
+		if (req != NULL) {
+			switch (req->op) {
+			case SOCKET_URING_RECV:
+				socket_uring_complete_recv(req, cqe);
+				break;
+			case SOCKET_URING_ACCEPT:
+				socket_uring_complete_accept(req, cqe);
+				break;
+			case SOCKET_URING_SEND:
+				socket_uring_complete_send(req, cqe);
+				break;
+			}
 		}
-#endif  // SHOW_SERVER_STATS
+		head++;
+		socket_uring_store_release(uring_cq_head, head);
 	}
 
+	if (buf_tail != uring_buf_tail)
+		socket_uring_store_release(&uring_buf_ring->tail, uring_buf_tail);
+}
+
+/// Submits the queued requests and waits for completions.
+/// @return SOCKET_ERROR if interrupted by a signal.
+static int socket_uring_wait(int next)
+{
+	struct __kernel_timespec ts = { 0 };
+	struct io_uring_getevents_arg arg = { 0 };
+	int ret;
+
+	if (socket_uring_backlog_count > 0)
+		next = 0; // there's received data waiting for room in the RFIFOs
+	ts.tv_sec = next / 1000;
+	ts.tv_nsec = (next % 1000) * 1000000LL;
+	arg.ts = (uint64)(uintptr_t)&ts;
+
+	ret = socket_uring_enter(uring_to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	if (ret >= 0) {
+		uring_to_submit -= ret;
+	} else if (sErrno != ETIME && sErrno != EBUSY && sErrno != EAGAIN) {
+		if (sErrno != S_EINTR) {
+			ShowFatalError("do_sockets: io_uring_enter() failed, %s!\n", error_msg());
+			exit(EXIT_FAILURE);
+		}
+		return SOCKET_ERROR;
+	}
 	return 0;
 }
 
-/// Best effort - there's no warranty that the data will be sent.
-static void flush_fifo(int fd)
+/// Moves the data that didn't fit in the RFIFOs in previous cycles.
+static void socket_uring_do_backlog(void)
 {
-	if(sockt->session[fd] != NULL)
-		sockt->session[fd]->func_send(fd);
+	int i, count = socket_uring_backlog_count;
+
+	socket_uring_backlog_count = 0;
+	for (i = 0; i < count; i++) {
+		int fd = socket_uring_backlog[i];
+
+		uring_conns[fd].backlog = false;
+		if (sockt->session[fd] != NULL && sockt->session[fd]->func_recv == socket_uring_recv)
+			sockt->session[fd]->func_recv(fd);
+	}
 }
 
-static void flush_fifos(void)
+static void socket_uring_init(void)
 {
+	struct io_uring_params params = { 0 };
+	struct io_uring_buf_reg reg = { 0 };
 	int i;
-	for(i = 1; i < sockt->fd_max; i++)
-		sockt->flush(i);
+
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = 4 * SOCKET_URING_ENTRIES;
+	uring_fd = (int)syscall(__NR_io_uring_setup, SOCKET_URING_ENTRIES, &params);
+	if (uring_fd == SOCKET_ERROR) {
+		ShowFatalError("Failed to Create io_uring Event Dispatcher: %s\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || (params.features & IORING_FEAT_NODROP) == 0 || (params.features & IORING_FEAT_EXT_ARG) == 0) {
+		ShowFatalError("Failed to Create io_uring Event Dispatcher: the kernel is too old (5.11 or newer is required).\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// submission and completion queues share the same mapping
+	uring_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	uring_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (uring_cq_ring_size > uring_sq_ring_size)
+		uring_sq_ring_size = uring_cq_ring_size;
+	uring_sq_ring = mmap(NULL, uring_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQ_RING);
+	uring_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring_sqes = mmap(NULL, uring_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring_fd, IORING_OFF_SQES);
+	if (uring_sq_ring == MAP_FAILED || uring_sqes == MAP_FAILED) {
+		ShowFatalError("Failed to map io_uring queues: %s\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	uring_cq_ring = uring_sq_ring;
+
+	uring_sq_head = (unsigned int *)((uint8 *)uring_sq_ring + params.sq_off.head);
+	uring_sq_tail = (unsigned int *)((uint8 *)uring_sq_ring + params.sq_off.tail);
+	uring_sq_mask = (unsigned int *)((uint8 *)uring_sq_ring + params.sq_off.ring_mask);
+	uring_sq_array = (unsigned int *)((uint8 *)uring_sq_ring + params.sq_off.array);
+	uring_sq_entries = params.sq_entries;
+	uring_sq_local_tail = *uring_sq_tail;
+	uring_cq_head = (unsigned int *)((uint8 *)uring_cq_ring + params.cq_off.head);
+	uring_cq_tail = (unsigned int *)((uint8 *)uring_cq_ring + params.cq_off.tail);
+	uring_cq_mask = (unsigned int *)((uint8 *)uring_cq_ring + params.cq_off.ring_mask);
+	uring_cqes = (struct io_uring_cqe *)((uint8 *)uring_cq_ring + params.cq_off.cqes);
+
+	// ring of provided receive buffers
+	uring_buf_ring_size = SOCKET_URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+	uring_buf_ring = mmap(NULL, uring_buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (uring_buf_ring == MAP_FAILED) {
+		ShowFatalError("Failed to allocate io_uring buffer ring: %s\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	reg.ring_addr = (uint64)(uintptr_t)uring_buf_ring;
+	reg.ring_entries = SOCKET_URING_BUFFER_COUNT;
+	reg.bgid = SOCKET_URING_BGID;
+	if (syscall(__NR_io_uring_register, uring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == SOCKET_ERROR) {
+		ShowFatalError("Failed to register io_uring buffer ring: %s (5.19 or newer is required)\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	CREATE(uring_buffers, uint8, (size_t)SOCKET_URING_BUFFER_COUNT * SOCKET_URING_BUFFER_SIZE);
+	uring_buf_tail = 0;
+	for (i = 0; i < SOCKET_URING_BUFFER_COUNT; i++)
+		socket_uring_recycle_buffer((uint16)i);
+	socket_uring_store_release(&uring_buf_ring->tail, uring_buf_tail);
+
+	CREATE(uring_conns, struct socket_uring_conn, MAXCONN);
+	uring_req_ers = ers_new(sizeof(struct socket_uring_req), "socket.c::uring_req_ers", ERS_OPT_CLEAN);
+
+	ShowInfo("Server uses '" CL_WHITE "io_uring" CL_RESET "' with " CL_WHITE "%d" CL_RESET " receive buffers as event dispatcher\n", SOCKET_URING_BUFFER_COUNT);
+}
+
+static void socket_uring_final(void)
+{
+	int i;
+
+	if (uring_fd == SOCKET_ERROR)
+		return;
+
+	// wait (for a bit) until the requests of the closed sockets finish
+	for (i = 0; i < 10 && uring_reqs != NULL; i++) {
+		if (socket_uring_wait(100) == 0)
+			socket_uring_dispatch();
+	}
+
+	close(uring_fd); // cancels anything left
+	uring_fd = SOCKET_ERROR;
+	while (uring_reqs != NULL)
+		socket_uring_req_delete(uring_reqs);
+	ers_destroy(uring_req_ers);
+	uring_req_ers = NULL;
+
+	for (i = 0; i < MAXCONN; i++) {
+		if (uring_conns[i].rbuf != NULL)
+			aFree(uring_conns[i].rbuf);
+		if (uring_conns[i].spare != NULL)
+			aFree(uring_conns[i].spare);
+	}
+	aFree(uring_conns);
+	uring_conns = NULL;
+	aFree(uring_buffers);
+	uring_buffers = NULL;
+
+	munmap(uring_buf_ring, uring_buf_ring_size);
+	munmap(uring_sqes, uring_sqes_size);
+	munmap(uring_sq_ring, uring_sq_ring_size);
+	uring_to_submit = 0;
+	socket_uring_backlog_count = 0;
 }
+#endif  // SOCKET_IO_URING
 
 /*======================================
  * CORE : Connection functions
@@ -568,6 +2373,15 @@ static int connect_client(int listen_fd)
 		ShowError("connect_client: accept failed (%s)!\n", error_msg());
 		return -1;
 	}
+	return connect_client_setup(fd, &client_address);
+}
+
+/// Sets up a session for an accepted connection.
+static int connect_client_setup(int fd, const struct sockaddr_in *client_address)
+{
+	RecvFunc func_recv = recv_to_fifo;
+	SendFunc func_send = send_from_fifo;
+
 	if( fd == 0 ) { // reserved
 		ShowError("connect_client: Socket #0 is reserved - Please report this!!!\n");
 		sClose(fd);
@@ -582,33 +2396,52 @@ static int connect_client(int listen_fd)
 	setsocketopts(fd,NULL);
 	sockt->set_nonblocking(fd, 1);
 
-	if( ip_rules && !connect_check(ntohl(client_address.sin_addr.s_addr)) ) {
+	if( ip_rules && !connect_check(ntohl(client_address->sin_addr.s_addr)) ) {
 		sockt->close(fd);
 		return -1;
 	}
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_add(fd, false);
+	func_recv = socket_uring_recv;
+	func_send = socket_uring_send;
+
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 
 #else  // SOCKET_EPOLL
-	// Epoll based Event Dispatcher
-	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
+	if (socket_io_thread_count > 0) {
+		// Owned by an I/O thread
+		if (!socket_io_attach(fd)) {
+			ShowError("connect_client: New Socket #%d failed to add to I/O thread: %s\n", fd, error_msg());
+			sClose(fd);
+			return -1;
+		}
+		func_recv = socket_io_recv;
+		func_send = socket_io_send;
+	} else {
+		// Epoll based Event Dispatcher
+		epevent.data.fd = fd;
+		epevent.events = EPOLLIN;
 
-	if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epevent) == SOCKET_ERROR){
-		ShowError("connect_client: New Socket #%d failed to add to epoll event dispatcher: %s\n", fd, error_msg());
-		sClose(fd);
-		return -1;
+		if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epevent) == SOCKET_ERROR){
+			ShowError("connect_client: New Socket #%d failed to add to epoll event dispatcher: %s\n", fd, error_msg());
+			sClose(fd);
+			return -1;
+		}
 	}
 
 #endif  // SOCKET_EPOLL
 
 	if( sockt->fd_max <= fd ) sockt->fd_max = fd + 1;
 
-	sockt->create_session(fd, recv_to_fifo, send_from_fifo, default_func_parse, default_func_client_connected, default_func_delete);
-	sockt->session[fd]->client_addr = ntohl(client_address.sin_addr.s_addr);
+	sockt->create_session(fd, func_recv, func_send, default_func_parse, default_func_client_connected, default_func_delete);
+	sockt->session[fd]->client_addr = ntohl(client_address->sin_addr.s_addr);
 	sockt->session[fd]->flag.validate = sockt->validate;
+	if (traffic_recording)
+		socket_traffic_record(SOCKET_TRAFFIC_ACCEPT, fd, &sockt->session[fd]->client_addr, sizeof(uint32));
 	sockt->session[fd]->func_client_connected(fd);
 	return fd;
 }
@@ -619,6 +2452,17 @@ static int make_listen_bind(uint32 ip, uint16 port)
 	int fd;
 	int result;
 
+	if (traffic_replaying) {
+		// nothing is accepted during a replay, the connections come from the capture
+		if ((fd = socket_traffic_create_session(null_parse, null_client_connected, null_delete)) == -1)
+			exit(EXIT_FAILURE);
+		sockt->session[fd]->func_recv = sockt->connect_client;
+		sockt->session[fd]->client_addr = 0; // just listens
+		sockt->session[fd]->rdata_tick = 0; // disable timeouts on this socket
+		sockt->session[fd]->wdata_tick = 0;
+		return fd;
+	}
+
 	fd = sSocket(AF_INET, SOCK_STREAM, 0);
 
 	if( fd == -1 ) {
@@ -655,7 +2499,11 @@ static int make_listen_bind(uint32 ip, uint16 port)
 	}
 
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_add(fd, true);
+
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 
@@ -687,6 +2535,18 @@ static int make_connection(uint32 ip, uint16 port, struct hSockOpt *opt)
 	struct sockaddr_in remote_address = { 0 };
 	int fd;
 	int result;
+	RecvFunc func_recv = recv_to_fifo;
+	SendFunc func_send = send_from_fifo;
+
+	if (traffic_replaying) {
+		// the other side's data comes from the capture
+		if ((fd = socket_traffic_create_session(default_func_parse, null_parse, null_delete)) == -1)
+			return -1;
+		sockt->session[fd]->client_addr = ip;
+		VECTOR_ENSURE(traffic_pending, 1, 4);
+		VECTOR_PUSH(traffic_pending, fd);
+		return fd;
+	}
 
 	fd = sSocket(AF_INET, SOCK_STREAM, 0);
 
@@ -725,27 +2585,50 @@ static int make_connection(uint32 ip, uint16 port, struct hSockOpt *opt)
 	sockt->set_nonblocking(fd, 1);
 
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_add(fd, false);
+	func_recv = socket_uring_recv;
+	func_send = socket_uring_send;
+
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 
 #else  // SOCKET_EPOLL
-	// Epoll based Event Dispatcher
-	epevent.data.fd = fd;
-	epevent.events = EPOLLIN;
+	if (socket_io_thread_count > 0) {
+		// Owned by an I/O thread
+		if (!socket_io_attach(fd)) {
+			ShowError("make_connection: failed to add socket #%d to I/O thread: %s\n", fd, error_msg());
+			sClose(fd);
+			return -1;
+		}
+		func_recv = socket_io_recv;
+		func_send = socket_io_send;
+	} else {
+		// Epoll based Event Dispatcher
+		epevent.data.fd = fd;
+		epevent.events = EPOLLIN;
 
-	if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epevent) == SOCKET_ERROR){
-		ShowError("make_connection: failed to add socket #%d to epoll event dispatcher: %s\n", fd, error_msg());
-		sClose(fd);
-		return -1;
+		if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epevent) == SOCKET_ERROR){
+			ShowError("make_connection: failed to add socket #%d to epoll event dispatcher: %s\n", fd, error_msg());
+			sClose(fd);
+			return -1;
+		}
 	}
 
 #endif  // SOCKET_EPOLL
 
 	if(sockt->fd_max <= fd) sockt->fd_max = fd + 1;
 
-	sockt->create_session(fd, recv_to_fifo, send_from_fifo, default_func_parse, null_parse, null_delete);
+	sockt->create_session(fd, func_recv, func_send, default_func_parse, null_parse, null_delete);
 	sockt->session[fd]->client_addr = ntohl(remote_address.sin_addr.s_addr);
+	if (traffic_recording) {
+		uint8 data[6];
+		WBUFL(data, 0) = ip;
+		WBUFW(data, 4) = port;
+		socket_traffic_record(SOCKET_TRAFFIC_CONNECT, fd, data, sizeof(data));
+	}
 
 	return fd;
 }
@@ -776,7 +2659,12 @@ static void delete_session(int fd)
 		socket_data_qi -= sockt->session[fd]->rdata_size - sockt->session[fd]->rdata_pos;
 		socket_data_qo -= sockt->session[fd]->wdata_size;
 #endif  // SHOW_SERVER_STATS
+		if (traffic_recording && sockt->session[fd]->func_recv != sockt->connect_client)
+			socket_traffic_record(SOCKET_TRAFFIC_CLOSE, fd, NULL, 0);
+		socket_traffic_forget(fd);
 		sockt->session[fd]->func_delete(fd);
+		wrefs_clear(sockt->session[fd]);
+		aFree(sockt->session[fd]->wrefs);
 		aFree(sockt->session[fd]->rdata);
 		aFree(sockt->session[fd]->wdata);
 		if( sockt->session[fd]->session_data )
@@ -931,6 +2819,9 @@ static int wfifoset(int fd, size_t len, bool validate)
 	if (validate && s->flag.validate == 1)
 		sockt->validateWfifo(fd, len);
 
+	if (sockt->on_packet_sent != NULL && !s->flag.server)
+		sockt->on_packet_sent(fd, s->wdata + s->wdata_size, len);
+
 	s->wdata_size += len;
 #ifdef SHOW_SERVER_STATS
 	socket_data_qo += len;
@@ -962,29 +2853,130 @@ static void wfifohead(int fd, size_t len)
 		sockt->realloc_writefifo(fd, len);
 }
 
-static int do_sockets(int next)
+/// Creates a shared packet buffer holding a copy of data, with one reference owned by the caller.
+static struct socket_shared_buffer *socket_shared_create(const void *data, size_t len)
 {
-#ifndef SOCKET_EPOLL
-	fd_set rfd;
-	struct timeval timeout;
-#endif  // SOCKET_EPOLL
-	int ret,i;
+	struct socket_shared_buffer *buf;
 
-	// PRESEND Timers are executed before do_sendrecv and can send packets and/or set sessions to eof.
-	// Send remaining data and process client-side disconnects here.
-#ifdef SEND_SHORTLIST
-	send_shortlist_do_sends();
-#else  // SEND_SHORTLIST
-	for (i = 1; i < sockt->fd_max; i++) {
-		if (sockt->session[i] == NULL)
-			continue;
+	nullpo_retr(NULL, data);
+	Assert_retr(NULL, len <= 0xFFFF);
 
-		if (sockt->session[i]->wdata_size > 0)
-			sockt->session[i]->func_send(i);
+	buf = aMalloc(sizeof(*buf) + len);
+	buf->refcount = 1;
+	buf->len = (uint32)len;
+	memcpy(buf->data, data, len);
+	return buf;
+}
+
+/// Drops a reference to a shared packet buffer, freeing it when it was the last one.
+static void socket_shared_release(struct socket_shared_buffer *buf)
+{
+	nullpo_retv(buf);
+
+	Assert_retv(buf->refcount > 0);
+	if (--buf->refcount == 0)
+		aFree(buf);
+}
+
+/// Queues a shared packet buffer for sending, after everything already in the WFIFO.
+/// The session takes its own reference, the caller keeps its one.
+/// Sessions that can't send it directly (small packets, custom send functions, I/O threads,
+/// io_uring, Windows) get a regular copy instead.
+static void wfifoset_shared(int fd, struct socket_shared_buffer *buf)
+{
+	struct socket_data *s;
+
+	nullpo_retv(buf);
+	if (!sockt->session_is_valid(fd))
+		return;
+
+	s = sockt->session[fd];
+	if (buf->len == 0)
+		return;
+	if (!s->flag.server && buf->len > socket_max_client_packet) {
+		ShowError("WFIFOSET: Dropped too large client packet 0x%04x (length=%u, max=%"PRIuS").\n",
+		          RBUFW(buf->data, 0), buf->len, socket_max_client_packet);
+		return;
 	}
+
+#ifndef WIN32
+	if (buf->len >= SOCKET_SHARED_MIN_LEN && s->func_send == send_from_fifo && s->flag.validate == 0) {
+		if (s->wrefs_count == s->max_wrefs) {
+			s->max_wrefs += 8;
+			RECREATE(s->wrefs, struct socket_wref, s->max_wrefs);
+		}
+		s->wrefs[s->wrefs_count].wpos = s->wdata_size;
+		s->wrefs[s->wrefs_count].buf = buf;
+		s->wrefs_count++;
+		buf->refcount++;
+		if (sockt->on_packet_sent != NULL && !s->flag.server)
+			sockt->on_packet_sent(fd, buf->data, buf->len);
+#ifdef SHOW_SERVER_STATS
+		socket_data_qo += buf->len;
+#endif  // SHOW_SERVER_STATS
+#ifdef SEND_SHORTLIST
+		send_shortlist_add_fd(fd);
 #endif  // SEND_SHORTLIST
+		return;
+	}
+#endif  // WIN32
+
+	WFIFOHEAD(fd, buf->len);
+	memcpy(WFIFOP(fd, 0), buf->data, buf->len);
+	WFIFOSET(fd, buf->len);
+}
 
-#ifndef SOCKET_EPOLL
+/**
+ * Marks the main thread as idle while it waits for network events.
+ *
+ * @return The time the wait started (us).
+ * @see core->busy_since
+ */
+static int64 socket_wait_begin(void)
+{
+	core->busy_since = 0;
+	return timer->gettick_us();
+}
+
+/**
+ * Marks the main thread as busy again after waiting for network events.
+ *
+ * @param wait_start The value returned by socket_wait_begin().
+ */
+static void socket_wait_end(int64 wait_start)
+{
+	int64 now = timer->gettick_us();
+	core->idle_us += now - wait_start;
+	core->busy_since = now;
+}
+
+/**
+ * Waits up to next ms for network events and hands them to the sessions.
+ *
+ * @return false if the wait was interrupted by a signal.
+ */
+static bool socket_dispatch_events(int next)
+{
+#if !defined(SOCKET_EPOLL) && !defined(SOCKET_IO_URING)
+	fd_set rfd;
+	struct timeval timeout;
+#endif  // !defined(SOCKET_EPOLL) && !defined(SOCKET_IO_URING)
+#if !defined(SOCKET_IO_URING)
+	int i;
+#endif  // !defined(SOCKET_IO_URING)
+	int ret;
+	int64 wait_start;
+
+	wait_start = socket_wait_begin();
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher:
+	// submits everything queued since the last cycle and waits for completions
+	ret = socket_uring_wait(next);
+	socket_wait_end(wait_start);
+	if (ret == SOCKET_ERROR)
+		return false; // interrupted by a signal, just loop and try again
+	ret = 0;
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher:
 
 	// can timeout until the next tick
@@ -993,6 +2985,7 @@ static int do_sockets(int next)
 
 	memcpy(&rfd, &readfds, sizeof(rfd));
 	ret = sSelect(sockt->fd_max, &rfd, NULL, NULL, &timeout);
+	socket_wait_end(wait_start);
 
 	if( ret == SOCKET_ERROR )
 	{
@@ -1001,12 +2994,15 @@ static int do_sockets(int next)
 			ShowFatalError("do_sockets: select() failed, %s!\n", error_msg());
 			exit(EXIT_FAILURE);
 		}
-		return 0; // interrupted by a signal, just loop and try again
+		return false; // interrupted by a signal, just loop and try again
 	}
 #else  // SOCKET_EPOLL
 	// Epoll based Event Dispatcher
 
+	if (socket_io_backlog_count > 0)
+		next = 0; // there's received data waiting for room in the RFIFOs
 	ret = epoll_wait(epfd, epevents, epoll_maxevents, next);
+	socket_wait_end(wait_start);
 	if(ret == SOCKET_ERROR)
 	{
 		if( sErrno != S_EINTR )
@@ -1014,7 +3010,7 @@ static int do_sockets(int next)
 			ShowFatalError("do_sockets: epoll_wait() failed, %s!\n", error_msg());
 			exit(EXIT_FAILURE);
 		}
-		return 0; // interrupted by a signal, just loop and try again
+		return false; // interrupted by a signal, just loop and try again
 	}
 #endif  // SOCKET_EPOLL
 
@@ -1028,14 +3024,26 @@ static int do_sockets(int next)
 		if( sockt->session[fd] )
 			sockt->session[fd]->func_recv(fd);
 	}
+#elif defined(SOCKET_IO_URING)
+	// io_uring based completions
+	socket_uring_do_backlog();
+	socket_uring_dispatch();
+	(void)ret;
 #elif defined(SOCKET_EPOLL)
 	// epoll based selection
 
 	for( i = 0; i < ret; i++ )
 	{
 		struct epoll_event *it = &epevents[i];
-		struct socket_data *sock = sockt->session[ it->data.fd ];
+		struct socket_data *sock;
+
+		if (it->data.fd == socket_io_evfd) {
+			// woken up by an I/O thread
+			socket_io_clear_wakeup(socket_io_evfd);
+			continue;
+		}
 
+		sock = sockt->session[ it->data.fd ];
 		if(!sock)
 			continue;
 
@@ -1054,6 +3062,9 @@ static int do_sockets(int next)
 
 	}
 
+	if (socket_io_thread_count > 0)
+		socket_io_do_recv();
+
 #else  // defined(SOCKET_EPOLL)
 	// otherwise assume that the fd_set is a bit-array and enumerate it in a standard way
 	for( i = 1; ret && i < sockt->fd_max; ++i )
@@ -1066,6 +3077,35 @@ static int do_sockets(int next)
 	}
 #endif  // defined(SOCKET_EPOLL)
 
+	return true;
+}
+
+static int do_sockets(int next)
+{
+	int i;
+
+	// PRESEND Timers are executed before do_sendrecv and can send packets and/or set sessions to eof.
+	// Send remaining data and process client-side disconnects here.
+#ifdef SEND_SHORTLIST
+	send_shortlist_do_sends();
+#else  // SEND_SHORTLIST
+	for (i = 1; i < sockt->fd_max; i++) {
+		if (sockt->session[i] == NULL)
+			continue;
+
+		if (session_has_wdata(sockt->session[i]))
+			sockt->session[i]->func_send(i);
+	}
+#endif  // SEND_SHORTLIST
+
+	if (traffic_replaying) {
+		// nothing to wait for, the events come from the capture
+		socket_traffic_replay_step(next);
+		sockt->last_tick = time(NULL);
+	} else if (!socket_dispatch_events(next)) {
+		return 0;
+	}
+
 	// POSTSEND Send remaining data and handle eof sessions.
 #ifdef SEND_SHORTLIST
 	send_shortlist_do_sends();
@@ -1075,7 +3115,7 @@ static int do_sockets(int next)
 		if(!sockt->session[i])
 			continue;
 
-		if(sockt->session[i]->wdata_size)
+		if (session_has_wdata(sockt->session[i]))
 			sockt->session[i]->func_send(i);
 
 		if (sockt->session[i]->flag.eof) { //func_send can't free a session, this is safe.
@@ -1091,7 +3131,8 @@ static int do_sockets(int next)
 		if(!sockt->session[i])
 			continue;
 
-		if (sockt->session[i]->rdata_tick && DIFF_TICK(sockt->last_tick, sockt->session[i]->rdata_tick) > sockt->stall_time) {
+		// (the replayed connections are closed when the capture says so)
+		if (!traffic_replaying && sockt->session[i]->rdata_tick && DIFF_TICK(sockt->last_tick, sockt->session[i]->rdata_tick) > sockt->stall_time) {
 			if( sockt->session[i]->flag.server ) {/* server is special */
 				if( sockt->session[i]->flag.ping != 2 )/* only update if necessary otherwise it'd resend the ping unnecessarily */
 					sockt->session[i]->flag.ping = 1;
@@ -1520,6 +3561,15 @@ static bool socket_config_read(const char *filename, bool imported)
 			i32 = 16; // minimum that seems to be useful
 		epoll_maxevents = i32;
 	}
+
+	if (libconfig->setting_lookup_int(setting, "io_threads", &i32) == CONFIG_TRUE) {
+		if (i32 < 0 || i32 > SOCKET_IO_MAX_THREADS) {
+			ShowWarning("socket_config_read: Invalid io_threads value %d, must be between 0 and %d. Defaulting to 0...\n", i32, SOCKET_IO_MAX_THREADS);
+			i32 = 0;
+		}
+		if (socket_io_threads == NULL) // can't be changed once the threads are running
+			socket_io_thread_count = i32;
+	}
 #endif  // SOCKET_EPOLL
 
 	{
@@ -1560,6 +3610,14 @@ static void socket_final(void)
 	for( i = 1; i < sockt->fd_max; i++ )
 		if(sockt->session[i])
 			sockt->close(i);
+	socket_traffic_final();
+
+#ifdef SOCKET_EPOLL
+	socket_io_final();
+#endif  // SOCKET_EPOLL
+#ifdef SOCKET_IO_URING
+	socket_uring_final();
+#endif  // SOCKET_IO_URING
 
 	// sockt->session[0]
 	aFree(sockt->session[0]->rdata);
@@ -1591,9 +3649,29 @@ static void socket_close(int fd)
 	if (fd <= 0 ||fd >= MAXCONN)
 		return;// invalid
 
+	if (traffic_replaying) {
+		// replayed sessions aren't known to the event dispatcher
+		sockt->flush(fd);
+		sClose(fd);
+		if (sockt->session[fd])
+			sockt->delete_session(fd);
+		return;
+	}
+
+#ifdef SOCKET_EPOLL
+	if (sockt->session[fd] != NULL && sockt->session[fd]->func_recv == socket_io_recv) {
+		// Owned by an I/O thread, which closes the socket
+		socket_io_detach(fd);
+		return;
+	}
+#endif  // SOCKET_EPOLL
+
 	sockt->flush(fd); // Try to send what's left (although it might not succeed since it's a nonblocking socket)
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_remove(fd); // this needs to be done before closing the socket
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher
 	sFD_CLR(fd, &readfds);// this needs to be done before closing the socket
 #else  // SOCKET_EPOLL
@@ -1749,7 +3827,11 @@ static void socket_init(void)
 
 	socket_config_read(sockt->SOCKET_CONF_FILENAME, false);
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher:
+	socket_uring_init();
+
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher:
 	sFD_ZERO(&readfds);
 	ShowInfo("Server uses '" CL_WHITE "select" CL_RESET "' as event dispatcher\n");
@@ -1767,6 +3849,9 @@ static void socket_init(void)
 
 	ShowInfo("Server uses '" CL_WHITE "epoll" CL_RESET "' with up to " CL_WHITE "%d" CL_RESET " events per cycle as event dispatcher\n", epoll_maxevents);
 
+	if (socket_io_thread_count > 0)
+		socket_io_init();
+
 #endif  // SOCKET_EPOLL
 
 #if defined(SEND_SHORTLIST)
@@ -1968,7 +4053,7 @@ static void send_shortlist_do_sends(void)
 		if( sockt->session[fd] )
 		{
 			// Send data
-			if( sockt->session[fd]->wdata_size )
+			if (session_has_wdata(sockt->session[fd]))
 				sockt->session[fd]->func_send(fd);
 
 			// If it's been marked as eof, call the parse func on it so that
@@ -1978,7 +4063,7 @@ static void send_shortlist_do_sends(void)
 
 			// If the session still exists, is not eof and has things left to
 			// be sent from it we'll re-add it to the shortlist.
-			if( sockt->session[fd] && !sockt->session[fd]->flag.eof && sockt->session[fd]->wdata_size )
+			if( sockt->session[fd] && !sockt->session[fd]->flag.eof && session_has_wdata(sockt->session[fd]) )
 				send_shortlist_add_fd(fd);
 		}
 	}
@@ -2186,6 +4271,7 @@ void socket_defaults(void)
 	memset(&sockt->addr_, 0, sizeof(sockt->addr_));
 	sockt->naddr_ = 0;
 	sockt->validate = false;
+	sockt->on_packet_sent = NULL;
 	/* */
 	VECTOR_INIT(sockt->lan_subnets);
 	VECTOR_INIT(sockt->allowed_ips);
@@ -2204,6 +4290,9 @@ void socket_defaults(void)
 	sockt->realloc_writefifo = realloc_writefifo;
 	sockt->wfifoset = wfifoset;
 	sockt->wfifohead = wfifohead;
+	sockt->shared_create = socket_shared_create;
+	sockt->shared_release = socket_shared_release;
+	sockt->wfifoset_shared = wfifoset_shared;
 	sockt->rfifoskip = rfifoskip;
 	sockt->close = socket_close;
 	/* */
@@ -2232,4 +4321,6 @@ void socket_defaults(void)
 	sockt->net_config_read_sub = socket_net_config_read_sub;
 	sockt->net_config_read = socket_net_config_read;
 	sockt->validateWfifo = socket_validateWfifo;
+	sockt->traffic_record = socket_traffic_start_record;
+	sockt->traffic_replay = socket_traffic_start_replay;
 }
@@ -116,6 +116,22 @@ typedef int (*ParseFunc)(int fd);
 typedef int (*ConnectedFunc)(int fd);
 typedef int (*DeleteFunc)(int fd);
 
+/// Packets shorter than this are always copied into the WFIFO, even when shared.
+#define SOCKET_SHARED_MIN_LEN 64
+
+/// Reference-counted packet buffer that can be queued to several sessions without copying it.
+struct socket_shared_buffer {
+	int32 refcount;
+	uint32 len;
+	uint8 data[];
+};
+
+/// Shared buffer queued in a WFIFO, sent right after the first `wpos` bytes of wdata.
+struct socket_wref {
+	size_t wpos;
+	struct socket_shared_buffer *buf;
+};
+
 struct socket_data {
 	struct {
 		unsigned char eof : 1;
@@ -131,6 +147,9 @@ struct socket_data {
 	size_t rdata_size, wdata_size;
 	size_t rdata_pos;
 	uint32 last_head_size;
+	struct socket_wref *wrefs; ///< Shared buffers queued after wdata (ordered by position)
+	int wrefs_count, max_wrefs;
+	size_t wrefs_sent; ///< Bytes of the first queued shared buffer that were already sent
 	time_t rdata_tick; // time of last recv (for detecting timeouts); zero when timeout is disabled
 	time_t wdata_tick; // time of last send (for detecting timeouts);
 
@@ -191,6 +210,9 @@ struct socket_interface {
 
 	struct socket_data **session;
 
+	/// Optional callback invoked for every packet queued to a client (non-server) session, NULL when unused.
+	void (*on_packet_sent) (int fd, const uint8 *data, size_t len);
+
 	struct s_subnet_vector lan_subnets; ///< LAN subnets.
 	struct s_subnet_vector trusted_ips; ///< Trusted IP ranges
 	struct s_subnet_vector allowed_ips; ///< Allowed server IP ranges
@@ -209,6 +231,9 @@ struct socket_interface {
 	int (*realloc_writefifo) (int fd, size_t addition);
 	int (*wfifoset) (int fd, size_t len, bool validate);
 	void (*wfifohead) (int fd, size_t len);
+	struct socket_shared_buffer *(*shared_create) (const void *data, size_t len);
+	void (*shared_release) (struct socket_shared_buffer *buf);
+	void (*wfifoset_shared) (int fd, struct socket_shared_buffer *buf);
 	int (*rfifoskip) (int fd, size_t len);
 	void (*close) (int fd);
 	void (*validateWfifo) (int fd, size_t len);
@@ -241,6 +266,11 @@ struct socket_interface {
 	bool (*trusted_ip_check) (uint32 ip);
 	int (*net_config_read_sub) (struct config_setting_t *t, struct s_subnet_vector *list, const char *filename, const char *groupname);
 	void (*net_config_read) (const char *filename);
+
+	/// Starts capturing the received traffic to a file (see socket_traffic_start_record).
+	bool (*traffic_record) (const char *filename);
+	/// Replays a capture instead of using the network (see socket_traffic_start_replay).
+	bool (*traffic_replay) (const char *filename);
 };
 
 #ifdef HERCULES_CORE
@@ -24,12 +24,15 @@
 
 #include "sql.h"
 
+#include "common/atomic.h"
 #include "common/cbasetypes.h"
 #include "common/conf.h"
 #include "common/memmgr.h"
+#include "common/mutex.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/strlib.h"
+#include "common/thread.h"
 #include "common/timer.h"
 
 #ifdef WIN32
@@ -54,6 +57,12 @@ struct Sql {
 	MYSQL_ROW row;
 	unsigned long* lengths;
 	int keepalive;
+	// connection parameters, to open the connections of asynchronous pools
+	char *host, *user, *passwd, *db, *encoding;
+	uint16 port;
+	// result handle of asynchronous queries
+	bool async_result;
+	uint64 async_insert_id;
 };
 
 // Column length receiver.
@@ -92,6 +101,10 @@ static struct Sql *Sql_Malloc(void)
 	self->lengths = NULL;
 	self->result = NULL;
 	self->keepalive = INVALID_TIMER;
+	self->host = self->user = self->passwd = self->db = self->encoding = NULL;
+	self->port = 0;
+	self->async_result = false;
+	self->async_insert_id = 0;
 	{
 		my_bool reconnect = 1;
 		mysql_options(&self->handle, MYSQL_OPT_RECONNECT, &reconnect);
@@ -117,6 +130,16 @@ static int Sql_Connect(struct Sql *self, const char *user, const char *passwd, c
 		return SQL_ERROR;
 	}
 
+	aFree(self->host);
+	aFree(self->user);
+	aFree(self->passwd);
+	aFree(self->db);
+	self->host = host != NULL ? aStrdup(host) : NULL;
+	self->user = user != NULL ? aStrdup(user) : NULL;
+	self->passwd = passwd != NULL ? aStrdup(passwd) : NULL;
+	self->db = db != NULL ? aStrdup(db) : NULL;
+	self->port = port;
+
 	self->keepalive = Sql_P_Keepalive(self);
 	if( self->keepalive == INVALID_TIMER )
 	{
@@ -176,8 +199,11 @@ static int Sql_GetColumnNames(struct Sql *self, const char *table, char *out_buf
 /// Changes the encoding of the connection.
 static int Sql_SetEncoding(struct Sql *self, const char *encoding)
 {
-	if( self && mysql_set_character_set(&self->handle, encoding) == 0 )
+	if( self && mysql_set_character_set(&self->handle, encoding) == 0 ) {
+		aFree(self->encoding);
+		self->encoding = aStrdup(encoding);
 		return SQL_SUCCESS;
+	}
 	return SQL_ERROR;
 }
 
@@ -255,18 +281,37 @@ static int Sql_Query(struct Sql *self, const char *query, ...)
 	return res;
 }
 
-/// Executes a query.
-static int Sql_QueryV(struct Sql *self, const char *query, va_list args) __attribute__((format(printf, 2, 0)));
-static int Sql_QueryV(struct Sql *self, const char *query, va_list args)
+/// Query statistics, updated by the main thread and the asynchronous pool workers.
+static volatile int64 sql_stats_queries = 0;
+static volatile int64 sql_stats_errors = 0;
+static volatile int64 sql_stats_time_us = 0;
+
+/// Accounts a query or statement execution that started at start_us.
+static void Sql_P_StatsRecord(int64 start_us, bool error)
 {
-	if( self == NULL )
-		return SQL_ERROR;
+	InterlockedIncrement64(&sql_stats_queries);
+	if (error)
+		InterlockedIncrement64(&sql_stats_errors);
+	InterlockedExchangeAdd64(&sql_stats_time_us, timer->gettick_us() - start_us);
+}
+
+/// Retrieves the query statistics of all the connections since startup.
+static void Sql_QueryStats(struct SqlQueryStats *stats)
+{
+	nullpo_retv(stats);
+	stats->queries = InterlockedExchangeAdd64(&sql_stats_queries, 0);
+	stats->errors = InterlockedExchangeAdd64(&sql_stats_errors, 0);
+	stats->time_us = InterlockedExchangeAdd64(&sql_stats_time_us, 0);
+}
+
+/// Sends the query in self->buf and stores its result.
+static int Sql_P_RealQuery(struct Sql *self)
+{
+	const int64 start = timer->gettick_us();
 
-	SQL->FreeResult(self);
-	StrBuf->Clear(&self->buf);
-	StrBuf->Vprintf(&self->buf, query, args);
 	if( mysql_real_query(&self->handle, StrBuf->Value(&self->buf), (unsigned long)StrBuf->Length(&self->buf)) )
 	{
+		Sql_P_StatsRecord(start, true);
 		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
 		hercules_mysql_error_handler(mysql_errno(&self->handle));
 		return SQL_ERROR;
@@ -274,10 +319,27 @@ static int Sql_QueryV(struct Sql *self, const char *query, va_list args)
 	self->result = mysql_store_result(&self->handle);
 	if( mysql_errno(&self->handle) != 0 )
 	{
+		Sql_P_StatsRecord(start, true);
 		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
 		hercules_mysql_error_handler(mysql_errno(&self->handle));
 		return SQL_ERROR;
 	}
+	Sql_P_StatsRecord(start, false);
+	return SQL_SUCCESS;
+}
+
+/// Executes a query.
+static int Sql_QueryV(struct Sql *self, const char *query, va_list args) __attribute__((format(printf, 2, 0)));
+static int Sql_QueryV(struct Sql *self, const char *query, va_list args)
+{
+	if( self == NULL )
+		return SQL_ERROR;
+
+	SQL->FreeResult(self);
+	StrBuf->Clear(&self->buf);
+	StrBuf->Vprintf(&self->buf, query, args);
+	if (Sql_P_RealQuery(self) != SQL_SUCCESS)
+		return SQL_ERROR;
 	return SQL_SUCCESS;
 }
 
@@ -290,19 +352,8 @@ static int Sql_QueryStr(struct Sql *self, const char *query)
 	SQL->FreeResult(self);
 	StrBuf->Clear(&self->buf);
 	StrBuf->AppendStr(&self->buf, query);
-	if( mysql_real_query(&self->handle, StrBuf->Value(&self->buf), (unsigned long)StrBuf->Length(&self->buf)) )
-	{
-		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
-		hercules_mysql_error_handler(mysql_errno(&self->handle));
+	if (Sql_P_RealQuery(self) != SQL_SUCCESS)
 		return SQL_ERROR;
-	}
-	self->result = mysql_store_result(&self->handle);
-	if( mysql_errno(&self->handle) != 0 )
-	{
-		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
-		hercules_mysql_error_handler(mysql_errno(&self->handle));
-		return SQL_ERROR;
-	}
 	return SQL_SUCCESS;
 }
 
@@ -314,19 +365,8 @@ static int Sql_QueryStrFetch(struct Sql *self, const char *query)
 	SQL->FreeResult(self);
 	StrBuf->Clear(&self->buf);
 	StrBuf->AppendStr(&self->buf, query);
-	if( mysql_real_query(&self->handle, StrBuf->Value(&self->buf), (unsigned long)StrBuf->Length(&self->buf)) )
-	{
-		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
-		hercules_mysql_error_handler(mysql_errno(&self->handle));
-		return SQL_ERROR;
-	}
-	self->result = mysql_store_result(&self->handle);
-	if( mysql_errno(&self->handle) != 0 )
-	{
-		ShowSQL("DB error - %s\n", mysql_error(&self->handle));
-		hercules_mysql_error_handler(mysql_errno(&self->handle));
+	if (Sql_P_RealQuery(self) != SQL_SUCCESS)
 		return SQL_ERROR;
-	}
 
 	if (self->result != NULL) {
 		self->row = mysql_fetch_row(self->result);
@@ -344,6 +384,8 @@ static int Sql_QueryStrFetch(struct Sql *self, const char *query)
 /// Returns the number of the AUTO_INCREMENT column of the last INSERT/UPDATE query.
 static uint64 Sql_LastInsertId(struct Sql *self)
 {
+	if (self != NULL && self->async_result)
+		return self->async_insert_id;
 	if (self != NULL)
 		return (uint64)mysql_insert_id(&self->handle);
 	else
@@ -429,6 +471,11 @@ static void Sql_Free(struct Sql *self)
 		StrBuf->Destroy(&self->buf);
 		if( self->keepalive != INVALID_TIMER ) timer->delete(self->keepalive, Sql_P_KeepaliveTimer);
 		mysql_close(&self->handle);
+		aFree(self->host);
+		aFree(self->user);
+		aFree(self->passwd);
+		aFree(self->db);
+		aFree(self->encoding);
 		aFree(self);
 	}
 }
@@ -767,10 +814,13 @@ static int SqlStmt_Execute(struct SqlStmt *self)
 	if( self == NULL )
 		return SQL_ERROR;
 
+	const int64 start = timer->gettick_us();
+
 	SQL->StmtFreeResult(self);
 	if( (self->bind_params && mysql_stmt_bind_param(self->stmt, self->params)) ||
 		mysql_stmt_execute(self->stmt) )
 	{
+		Sql_P_StatsRecord(start, true);
 		ShowSQL("DB error - %s\n", mysql_stmt_error(self->stmt));
 		hercules_mysql_error_handler(mysql_stmt_errno(self->stmt));
 		return SQL_ERROR;
@@ -778,11 +828,13 @@ static int SqlStmt_Execute(struct SqlStmt *self)
 	self->bind_columns = false;
 	if( mysql_stmt_store_result(self->stmt) )// store all the data
 	{
+		Sql_P_StatsRecord(start, true);
 		ShowSQL("DB error - %s\n", mysql_stmt_error(self->stmt));
 		hercules_mysql_error_handler(mysql_stmt_errno(self->stmt));
 		return SQL_ERROR;
 	}
 
+	Sql_P_StatsRecord(start, false);
 	return SQL_SUCCESS;
 }
 
@@ -960,6 +1012,468 @@ static void SqlStmt_Free(struct SqlStmt *self)
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Asynchronous queries
+///////////////////////////////////////////////////////////////////////////////
+// The worker threads only use their own connection and the job being run:
+// jobs are allocated and freed in the main thread, since the memory manager
+// isn't thread-safe, and errors are reported when the completion is
+// delivered in the main thread.
+
+/// Interval between deliveries of completed queries (ms).
+#define SQL_ASYNC_DELIVERY_INTERVAL 10
+
+/// Asynchronous query or prepared statement
+struct SqlAsyncJob {
+	struct SqlAsyncJob *next;
+	struct SqlAsync *pool;
+	char *query;
+	size_t query_len;
+	// prepared statement parameters, buffers are owned by the job
+	bool is_stmt;
+	MYSQL_BIND *params;
+	size_t param_count;
+	// completion
+	SqlAsyncCallback callback;
+	void *data;
+	int status;
+	MYSQL_RES *result;
+	uint64 insert_id;
+	unsigned int errnum;
+	char error[256];
+};
+
+/// Worker thread of an asynchronous pool
+struct SqlAsyncWorker {
+	struct SqlAsync *pool;
+	struct Sql *conn;
+	struct thread_handle *thread;
+	struct cond_data *cond;
+	struct SqlAsyncJob *queue_head, *queue_tail; ///< Jobs waiting to be run
+	bool busy;                                   ///< Whether a job is being run
+};
+
+/// Asynchronous query pool
+struct SqlAsync {
+	struct mutex_data *mutex;      ///< Protects the queues, the done list and the worker states
+	struct cond_data *done_cond;   ///< Signaled whenever a job is done
+	struct SqlAsyncWorker *workers;
+	int worker_count;
+	bool running;
+	struct SqlAsyncJob *done_head, *done_tail; ///< Jobs waiting for their completion to be delivered
+	int pending;                   ///< Submitted jobs whose completion wasn't delivered yet (main thread only)
+	int timer;
+	struct Sql *result;            ///< Result handle given to the callbacks
+};
+
+/// Copies the error of a connection or statement into a job.
+///
+/// @private
+static void Sql_P_AsyncJobError(struct SqlAsyncJob *job, unsigned int errnum, const char *error)
+{
+	job->status = SQL_ERROR;
+	job->errnum = errnum;
+	safestrncpy(job->error, error != NULL ? error : "unknown error", sizeof(job->error));
+}
+
+/// Runs a job on a worker connection. Called in the worker thread.
+///
+/// @private
+static void Sql_P_AsyncJobRun(struct Sql *conn, struct SqlAsyncJob *job)
+{
+	MYSQL_STMT *stmt;
+
+	job->status = SQL_SUCCESS;
+	if (!job->is_stmt) {
+		if (mysql_real_query(&conn->handle, job->query, (unsigned long)job->query_len) != 0) {
+			Sql_P_AsyncJobError(job, mysql_errno(&conn->handle), mysql_error(&conn->handle));
+			return;
+		}
+		job->result = mysql_store_result(&conn->handle);
+		if (mysql_errno(&conn->handle) != 0) {
+			Sql_P_AsyncJobError(job, mysql_errno(&conn->handle), mysql_error(&conn->handle));
+			return;
+		}
+		job->insert_id = (uint64)mysql_insert_id(&conn->handle);
+		return;
+	}
+
+	if ((stmt = mysql_stmt_init(&conn->handle)) == NULL) {
+		Sql_P_AsyncJobError(job, mysql_errno(&conn->handle), mysql_error(&conn->handle));
+		return;
+	}
+	if (mysql_stmt_prepare(stmt, job->query, (unsigned long)job->query_len) != 0) {
+		Sql_P_AsyncJobError(job, mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+	} else if ((size_t)mysql_stmt_param_count(stmt) > job->param_count) {
+		Sql_P_AsyncJobError(job, 0, "not all the statement parameters were bound");
+	} else if ((job->param_count > 0 && mysql_stmt_bind_param(stmt, job->params)) || mysql_stmt_execute(stmt) != 0) {
+		Sql_P_AsyncJobError(job, mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+	} else {
+		job->insert_id = (uint64)mysql_stmt_insert_id(stmt);
+		mysql_stmt_free_result(stmt);
+	}
+	mysql_stmt_close(stmt);
+}
+
+/// Worker thread main function.
+///
+/// @private
+static void *Sql_P_AsyncWorker(void *param)
+{
+	struct SqlAsyncWorker *worker = param;
+	struct SqlAsync *pool = worker->pool;
+
+	mysql_thread_init();
+	mutex->lock(pool->mutex);
+	while (true) {
+		struct SqlAsyncJob *job;
+		int64 start;
+
+		while (worker->queue_head == NULL && pool->running)
+			mutex->cond_wait(worker->cond, pool->mutex, -1);
+		if ((job = worker->queue_head) == NULL)
+			break; // stopped, and all the jobs are done
+		if ((worker->queue_head = job->next) == NULL)
+			worker->queue_tail = NULL;
+		job->next = NULL;
+		worker->busy = true;
+		mutex->unlock(pool->mutex);
+
+		start = timer->gettick_us();
+		Sql_P_AsyncJobRun(worker->conn, job);
+		Sql_P_StatsRecord(start, job->status != SQL_SUCCESS);
+
+		mutex->lock(pool->mutex);
+		worker->busy = false;
+		if (pool->done_tail != NULL)
+			pool->done_tail->next = job;
+		else
+			pool->done_head = job;
+		pool->done_tail = job;
+		mutex->cond_broadcast(pool->done_cond);
+	}
+	mutex->unlock(pool->mutex);
+	mysql_thread_end();
+	return NULL;
+}
+
+/// Frees a job.
+///
+/// @private
+static void Sql_P_AsyncJobFree(struct SqlAsyncJob *job)
+{
+	size_t i;
+
+	if (job->result != NULL)
+		mysql_free_result(job->result);
+	for (i = 0; i < job->param_count; ++i)
+		aFree(job->params[i].buffer);
+	aFree(job->params);
+	aFree(job->query);
+	aFree(job);
+}
+
+/// Delivers the completions of the jobs that are done.
+///
+/// @private
+static void Sql_P_AsyncDeliver(struct SqlAsync *pool)
+{
+	struct SqlAsyncJob *job;
+	struct Sql *result = pool->result;
+
+	mutex->lock(pool->mutex);
+	job = pool->done_head;
+	pool->done_head = pool->done_tail = NULL;
+	mutex->unlock(pool->mutex);
+
+	while (job != NULL) {
+		struct SqlAsyncJob *next = job->next;
+
+		StrBuf->Clear(&result->buf);
+		StrBuf->AppendStr(&result->buf, job->query);
+		if (job->status == SQL_ERROR) {
+			ShowSQL("DB error - %s\n", job->error);
+			Sql_ShowDebug(result);
+			if (job->errnum != 0)
+				hercules_mysql_error_handler(job->errnum);
+		}
+		result->result = job->result;
+		result->row = NULL;
+		result->lengths = NULL;
+		result->async_insert_id = job->insert_id;
+		job->result = NULL;
+
+		pool->pending--;
+		if (job->callback != NULL)
+			job->callback(result, job->status, job->data);
+
+		SQL->FreeResult(result);
+		Sql_P_AsyncJobFree(job);
+		job = next;
+	}
+}
+
+/// Timer delivering the completions of a pool.
+///
+/// @private
+static int Sql_P_AsyncTimer(int tid, int64 tick, int id, intptr_t data)
+{
+	Sql_P_AsyncDeliver((struct SqlAsync *)data);
+	return 0;
+}
+
+/// Creates a pool of worker threads.
+static struct SqlAsync *Sql_AsyncCreate(struct Sql *sql, int workers)
+{
+	struct SqlAsync *pool;
+	int i;
+
+	nullpo_retr(NULL, sql);
+	if (workers < 1) {
+		ShowError("Sql_AsyncCreate: invalid number of workers (%d).\n", workers);
+		return NULL;
+	}
+
+	CREATE(pool, struct SqlAsync, 1);
+	CREATE(pool->workers, struct SqlAsyncWorker, workers);
+	pool->timer = INVALID_TIMER;
+	pool->mutex = mutex->create();
+	pool->done_cond = mutex->cond_create();
+	pool->result = SQL->Malloc();
+	pool->result->async_result = true;
+	pool->running = true;
+
+	for (i = 0; i < workers; ++i) {
+		struct SqlAsyncWorker *worker = &pool->workers[i];
+
+		worker->pool = pool;
+		worker->conn = SQL->Malloc();
+		worker->cond = mutex->cond_create();
+		pool->worker_count++;
+		// connected from the main thread so that failures are reported right away,
+		// without keepalive timer (the connection reconnects when needed)
+		if (!mysql_real_connect(&worker->conn->handle, sql->host, sql->user, sql->passwd, sql->db, (unsigned int)sql->port, NULL, 0)) {
+			ShowSQL("%s\n", mysql_error(&worker->conn->handle));
+			break;
+		}
+		if (sql->encoding != NULL && mysql_set_character_set(&worker->conn->handle, sql->encoding) != 0) {
+			ShowSQL("%s\n", mysql_error(&worker->conn->handle));
+			break;
+		}
+		if ((worker->thread = thread->create(Sql_P_AsyncWorker, worker)) == NULL) {
+			ShowError("Sql_AsyncCreate: failed to start worker thread %d.\n", i);
+			break;
+		}
+	}
+	if (i < workers) {
+		SQL->AsyncFree(pool);
+		return NULL;
+	}
+
+	pool->timer = timer->add_interval(timer->gettick() + SQL_ASYNC_DELIVERY_INTERVAL, Sql_P_AsyncTimer, 0, (intptr_t)pool, SQL_ASYNC_DELIVERY_INTERVAL);
+	return pool;
+}
+
+/// Waits until all the queued jobs are done and delivers their completions.
+static void Sql_AsyncFlush(struct SqlAsync *pool)
+{
+	nullpo_retv(pool);
+
+	while (pool->pending > 0) {
+		mutex->lock(pool->mutex);
+		while (pool->done_head == NULL)
+			mutex->cond_wait(pool->done_cond, pool->mutex, -1);
+		mutex->unlock(pool->mutex);
+		Sql_P_AsyncDeliver(pool);
+	}
+}
+
+/// Waits for the pending jobs, delivers their completions and frees the pool.
+static void Sql_AsyncFree(struct SqlAsync *pool)
+{
+	int i;
+
+	if (pool == NULL)
+		return;
+
+	SQL->AsyncFlush(pool);
+
+	mutex->lock(pool->mutex);
+	pool->running = false;
+	for (i = 0; i < pool->worker_count; ++i)
+		mutex->cond_signal(pool->workers[i].cond);
+	mutex->unlock(pool->mutex);
+
+	for (i = 0; i < pool->worker_count; ++i) {
+		struct SqlAsyncWorker *worker = &pool->workers[i];
+		if (worker->thread != NULL)
+			thread->wait(worker->thread, NULL);
+		mutex->cond_destroy(worker->cond);
+		SQL->Free(worker->conn);
+	}
+	if (pool->timer != INVALID_TIMER)
+		timer->delete(pool->timer, Sql_P_AsyncTimer);
+	SQL->Free(pool->result);
+	mutex->cond_destroy(pool->done_cond);
+	mutex->destroy(pool->mutex);
+	aFree(pool->workers);
+	aFree(pool);
+}
+
+/// Queues a job on the worker selected by the key.
+///
+/// @private
+static int Sql_P_AsyncSubmit(struct SqlAsync *pool, struct SqlAsyncJob *job, int key, SqlAsyncCallback callback, void *data)
+{
+	struct SqlAsyncWorker *worker = &pool->workers[(unsigned int)key % (unsigned int)pool->worker_count];
+
+	job->callback = callback;
+	job->data = data;
+	pool->pending++;
+
+	mutex->lock(pool->mutex);
+	if (worker->queue_tail != NULL)
+		worker->queue_tail->next = job;
+	else
+		worker->queue_head = job;
+	worker->queue_tail = job;
+	mutex->cond_signal(worker->cond);
+	mutex->unlock(pool->mutex);
+
+	return SQL_SUCCESS;
+}
+
+/// Allocates a job.
+///
+/// @private
+static struct SqlAsyncJob *Sql_P_AsyncJobCreate(struct SqlAsync *pool, const char *query, size_t query_len)
+{
+	struct SqlAsyncJob *job;
+
+	CREATE(job, struct SqlAsyncJob, 1);
+	job->pool = pool;
+	job->query = aMalloc(query_len + 1);
+	memcpy(job->query, query, query_len);
+	job->query[query_len] = '\0';
+	job->query_len = query_len;
+	return job;
+}
+
+/// Queues a query.
+static int Sql_AsyncQuery(struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query, ...) __attribute__((format(printf, 5, 6)));
+static int Sql_AsyncQuery(struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query, ...)
+{
+	int res;
+	va_list args;
+
+	va_start(args, query);
+	res = SQL->AsyncQueryV(pool, key, callback, data, query, args);
+	va_end(args);
+
+	return res;
+}
+
+/// Queues a query.
+static int Sql_AsyncQueryV(struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query, va_list args) __attribute__((format(printf, 5, 0)));
+static int Sql_AsyncQueryV(struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query, va_list args)
+{
+	StringBuf buf;
+	int res;
+
+	if (pool == NULL)
+		return SQL_ERROR;
+
+	StrBuf->Init(&buf);
+	StrBuf->Vprintf(&buf, query, args);
+	res = Sql_P_AsyncSubmit(pool, Sql_P_AsyncJobCreate(pool, StrBuf->Value(&buf), (size_t)StrBuf->Length(&buf)), key, callback, data);
+	StrBuf->Destroy(&buf);
+
+	return res;
+}
+
+/// Queues a query.
+static int Sql_AsyncQueryStr(struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query)
+{
+	if (pool == NULL)
+		return SQL_ERROR;
+	nullpo_retr(SQL_ERROR, query);
+
+	return Sql_P_AsyncSubmit(pool, Sql_P_AsyncJobCreate(pool, query, strlen(query)), key, callback, data);
+}
+
+/// Creates a prepared statement job.
+static struct SqlAsyncJob *Sql_AsyncStmtPrepare(struct SqlAsync *pool, const char *query)
+{
+	struct SqlAsyncJob *job;
+
+	if (pool == NULL)
+		return NULL;
+	nullpo_retr(NULL, query);
+
+	job = Sql_P_AsyncJobCreate(pool, query, strlen(query));
+	job->is_stmt = true;
+	return job;
+}
+
+/// Binds a parameter of a prepared statement job, copying the buffer data.
+static int Sql_AsyncStmtBindParam(struct SqlAsyncJob *job, size_t idx, enum SqlDataType buffer_type, const void *buffer, size_t buffer_len)
+{
+	void *copy = NULL;
+
+	if (job == NULL || !job->is_stmt)
+		return SQL_ERROR;
+
+	if (idx >= job->param_count) {
+		size_t i;
+
+		RECREATE(job->params, MYSQL_BIND, idx + 1);
+		memset(job->params + job->param_count, 0, (idx + 1 - job->param_count) * sizeof(MYSQL_BIND));
+		for (i = job->param_count; i <= idx; ++i)
+			job->params[i].buffer_type = MYSQL_TYPE_NULL;
+		job->param_count = idx + 1;
+	}
+	aFree(job->params[idx].buffer);
+	job->params[idx].buffer = NULL;
+
+	if (buffer != NULL && buffer_len > 0) {
+		copy = aMalloc(buffer_len);
+		memcpy(copy, buffer, buffer_len);
+	}
+	if (Sql_P_BindSqlDataType(job->params + idx, buffer_type, copy, buffer_len, NULL, NULL) == SQL_ERROR) {
+		aFree(copy);
+		memset(job->params + idx, 0, sizeof(MYSQL_BIND));
+		job->params[idx].buffer_type = MYSQL_TYPE_NULL;
+		return SQL_ERROR;
+	}
+	return SQL_SUCCESS;
+}
+
+/// Queues a prepared statement job.
+static int Sql_AsyncStmtExecute(struct SqlAsyncJob *job, int key, SqlAsyncCallback callback, void *data)
+{
+	if (job == NULL || !job->is_stmt)
+		return SQL_ERROR;
+
+	return Sql_P_AsyncSubmit(job->pool, job, key, callback, data);
+}
+
+/// Frees a prepared statement job that wasn't queued.
+static void Sql_AsyncStmtFree(struct SqlAsyncJob *job)
+{
+	if (job == NULL)
+		return;
+
+	Sql_P_AsyncJobFree(job);
+}
+
+/// Returns the number of jobs whose completion wasn't delivered yet.
+static int Sql_AsyncPending(struct SqlAsync *pool)
+{
+	if (pool == NULL)
+		return 0;
+	return pool->pending;
+}
+
 /* receives mysql error codes during runtime (not on first-time-connects) */
 static void hercules_mysql_error_handler(unsigned int ecode)
 {
@@ -1130,6 +1644,7 @@ void Sql_HerculesUpdateSkip(struct Sql *self, const char *filename)
 
 void Sql_Init(void)
 {
+	timer->add_func_list(Sql_P_AsyncTimer, "Sql_P_AsyncTimer");
 	Sql_inter_server_read("conf/common/inter-server.conf", false); // FIXME: Hardcoded path
 }
 
@@ -1174,4 +1689,18 @@ void sql_defaults(void)
 	SQL->StmtPrepareStr = SqlStmt_PrepareStr;
 	SQL->StmtPrepareV = SqlStmt_PrepareV;
 	SQL->StmtShowDebug_ = SqlStmt_ShowDebug_;
+
+	/* Asynchronous queries */
+	SQL->AsyncCreate = Sql_AsyncCreate;
+	SQL->AsyncFree = Sql_AsyncFree;
+	SQL->AsyncQuery = Sql_AsyncQuery;
+	SQL->AsyncQueryV = Sql_AsyncQueryV;
+	SQL->AsyncQueryStr = Sql_AsyncQueryStr;
+	SQL->AsyncStmtPrepare = Sql_AsyncStmtPrepare;
+	SQL->AsyncStmtBindParam = Sql_AsyncStmtBindParam;
+	SQL->AsyncStmtExecute = Sql_AsyncStmtExecute;
+	SQL->AsyncStmtFree = Sql_AsyncStmtFree;
+	SQL->AsyncFlush = Sql_AsyncFlush;
+	SQL->AsyncPending = Sql_AsyncPending;
+	SQL->QueryStats = Sql_QueryStats;
 }
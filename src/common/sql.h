@@ -73,8 +73,25 @@ enum SqlDataType {
 	SQLDT_LASTID
 };
 
-struct Sql;     ///< Sql handle (private access)
-struct SqlStmt; ///< Sql statement (private access)
+struct Sql;         ///< Sql handle (private access)
+struct SqlStmt;     ///< Sql statement (private access)
+struct SqlAsync;    ///< Asynchronous query pool (private access)
+struct SqlAsyncJob; ///< Asynchronous query or statement (private access)
+
+/// Query statistics (@see sql_interface::QueryStats)
+struct SqlQueryStats {
+	int64 queries; ///< Queries and statement executions
+	int64 errors;  ///< Queries and statement executions that failed
+	int64 time_us; ///< Time spent on them (us)
+};
+
+/// Completion callback of an asynchronous query, invoked in the main thread.
+///
+/// @param result Read-only handle with the result of the query (rows of a
+///               SELECT, LastInsertId), freed after the callback returns.
+/// @param status SQL_SUCCESS or SQL_ERROR (the error was already reported).
+/// @param data   The data given when the query was submitted.
+typedef void (*SqlAsyncCallback) (struct Sql *result, int status, void *data);
 
 struct sql_interface {
 	/// Establishes a connection.
@@ -262,6 +279,75 @@ struct sql_interface {
 
 	void (*StmtShowDebug_)(struct SqlStmt *self, const char *debug_file, const unsigned long debug_line);
 
+	///////////////////////////////////////////////////////////////////////////////
+	// Asynchronous queries
+	///////////////////////////////////////////////////////////////////////////////
+	// A pool of worker threads, each with its own connection, runs queries
+	// in the background. Completion callbacks are invoked in the main thread.
+	//
+	// Each query is submitted with a key (e.g. an account or character id):
+	// queries with the same key run on the same worker, in submission order.
+
+	/// Creates a pool of worker threads.
+	/// Each worker opens its own connection, with the same parameters and
+	/// encoding as the given (connected) handle.
+	///
+	/// @return Pool handle or NULL if an error occurred
+	struct SqlAsync *(*AsyncCreate) (struct Sql *sql, int workers);
+
+	/// Waits for the pending queries, delivers their completions and frees the pool.
+	void (*AsyncFree) (struct SqlAsync *pool);
+
+	/// Queues a query.
+	/// The query is constructed as if it was sprintf.
+	/// The callback can be NULL.
+	///
+	/// @return SQL_SUCCESS or SQL_ERROR
+	int (*AsyncQuery) (struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query, ...) __attribute__((format(printf, 5, 6)));
+
+	/// Queues a query.
+	/// The query is constructed as if it was svprintf.
+	///
+	/// @return SQL_SUCCESS or SQL_ERROR
+	int (*AsyncQueryV) (struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query, va_list args) __attribute__((format(printf, 5, 0)));
+
+	/// Queues a query.
+	/// The query is used directly.
+	///
+	/// @return SQL_SUCCESS or SQL_ERROR
+	int (*AsyncQueryStr) (struct SqlAsync *pool, int key, SqlAsyncCallback callback, void *data, const char *query);
+
+	/// Creates a prepared statement job, to be queued with AsyncStmtExecute.
+	/// The query is used directly.
+	///
+	/// @return Job handle or NULL if an error occurred
+	struct SqlAsyncJob *(*AsyncStmtPrepare) (struct SqlAsync *pool, const char *query);
+
+	/// Binds a parameter of a prepared statement job.
+	/// Unlike StmtBindParam, the buffer data is copied.
+	///
+	/// @return SQL_SUCCESS or SQL_ERROR
+	int (*AsyncStmtBindParam) (struct SqlAsyncJob *job, size_t idx, enum SqlDataType buffer_type, const void *buffer, size_t buffer_len);
+
+	/// Queues a prepared statement job. The pool takes ownership of the job.
+	/// Statements don't return rows, only LastInsertId is available in the callback.
+	/// The callback can be NULL.
+	///
+	/// @return SQL_SUCCESS or SQL_ERROR
+	int (*AsyncStmtExecute) (struct SqlAsyncJob *job, int key, SqlAsyncCallback callback, void *data);
+
+	/// Frees a prepared statement job that won't be queued (e.g. binding failed).
+	void (*AsyncStmtFree) (struct SqlAsyncJob *job);
+
+	/// Waits until all the queued queries are done and delivers their completions.
+	void (*AsyncFlush) (struct SqlAsync *pool);
+
+	/// Returns the number of queries whose completion wasn't delivered yet.
+	int (*AsyncPending) (struct SqlAsync *pool);
+
+	/// Retrieves the number of queries and statement executions done by all
+	/// the connections since startup, and the time spent on them.
+	void (*QueryStats) (struct SqlQueryStats *stats);
 };
 
 #ifdef HERCULES_CORE
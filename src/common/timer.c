@@ -23,6 +23,7 @@
 #include "timer.h"
 
 #include "common/cbasetypes.h"
+#include "common/core.h" // SERVER_NAME
 #include "common/db.h"
 #include "common/memmgr.h"
 #include "common/nullpo.h"
@@ -67,8 +68,44 @@ static int free_timer_list_pos = 0;
 /// @return negative if tid1 is top, positive if tid2 is top, 0 if equal
 #define DIFFTICK_MINTOPCMP(tid1,tid2) DIFF_TICK(timer_data[tid1].tick,timer_data[tid2].tick)
 
+#ifdef TIMER_USE_WHEEL
+// Hierarchical timing wheel.
+// Level 0 has one slot per millisecond for the next 256ms, and each one of the
+// upper levels has 64 slots, each slot covering a whole turn of the level
+// below it. Timers in an upper level are moved down (cascaded) when the level
+// below wraps around. Timers further away than the whole wheel are placed in
+// its last slot and cascaded again until they get close enough. Timers added
+// for a tick that was already processed go to a separate list of expired
+// timers, which is always processed first.
+#define TIMER_WHEEL_BITS0 8
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE0 (1 << TIMER_WHEEL_BITS0)
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SPAN(level) (INT64_C(1) << (TIMER_WHEEL_BITS0 + (level) * TIMER_WHEEL_BITS))
+#define TIMER_WHEEL_MAX_SPAN (TIMER_WHEEL_SPAN(TIMER_WHEEL_LEVELS) - 1)
+
+/// Position of a timer in the wheel (the slots are doubly linked lists of tid's, 0 terminated)
+struct timer_wheel_link {
+	int prev;     ///< Previous timer in the slot, 0 if it's the first one
+	int next;     ///< Next timer in the slot, 0 if it's the last one
+	int *slot;    ///< Slot the timer is linked to, NULL if it's not in the wheel
+};
+
+// timer links (array, same size as timer_data)
+static struct timer_wheel_link *timer_links = NULL;
+
+// timer wheel slots
+static int wheel_slots0[TIMER_WHEEL_SIZE0];
+static int wheel_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+static int wheel_expired = 0;     ///< Timers whose tick was already processed
+static int wheel_count = 0;       ///< Number of timers in the wheel
+static int64 wheel_tick = 0;      ///< Next tick to be processed
+static bool wheel_started = false;
+#else  // TIMER_USE_WHEEL
 // timer heap (binary heap of tid's)
 static BHEAP_VAR(int, timer_heap);
+#endif  // TIMER_USE_WHEEL
 
 
 // server startup time
@@ -120,6 +157,26 @@ static char *search_timer_func_list(TimerFunc func)
 	return "unknown timer function";
 }
 
+/// Timer function being executed, NULL when no timer is running.
+static volatile TimerFunc timer_running_func = NULL;
+
+/**
+ * Returns the name of the timer function being executed.
+ *
+ * Meant to be called by the main loop watchdog while the main thread is
+ * busy, so it only reads the timer function list.
+ *
+ * @return The timer function name, NULL if no timer is running.
+ */
+static const char *timer_running(void)
+{
+	TimerFunc func = timer_running_func;
+
+	if (func == NULL)
+		return NULL;
+	return search_timer_func_list(func);
+}
+
 /*----------------------------
  * Get tick time
  *----------------------------*/
@@ -164,12 +221,17 @@ static void rdtsc_calibrate(void)
 
 #endif
 
+static bool timer_virtual = false;   ///< Whether the tick comes from timer_virtual_tick instead of the system clock
+static int64 timer_virtual_tick = 0;
+
 /**
  * platform-abstracted tick retrieval
  * @return server's current tick
  */
 static int64 sys_tick(void)
 {
+	if (timer_virtual)
+		return timer_virtual_tick;
 #if defined(WIN32)
 	// Windows: GetTickCount/GetTickCount64: Return the number of
 	//   milliseconds that have elapsed since the system was started.
@@ -259,6 +321,126 @@ static int64 timer_gettick(void)
 #endif
 //////////////////////////////////////////////////////////////////////////
 
+/**
+ * Replaces the system clock by a virtual one, which only moves when this is
+ * called again (used to replay recorded traffic, see socket.c).
+ *
+ * @param tick The tick gettick and gettick_nocache return from now on.
+ */
+static void timer_set_virtual_tick(int64 tick)
+{
+	timer_virtual = true;
+	timer_virtual_tick = tick;
+#if defined(TICK_CACHE) && TICK_CACHE > 1
+	gettick_count = 1; // refresh the cache on the next call
+#endif
+}
+
+/**
+ * Monotonic time with microsecond resolution, for profiling purposes.
+ * Not cached and unrelated to the value of gettick.
+ * @return time in microseconds since some unspecified starting point
+ */
+static int64 timer_gettick_us(void)
+{
+#if defined(WIN32)
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (int64)(counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+#elif defined(HAVE_MONOTONIC_CLOCK)
+	struct timespec tval;
+	clock_gettime(CLOCK_MONOTONIC, &tval);
+	return (int64)tval.tv_sec * 1000000 + tval.tv_nsec / 1000;
+#else
+	struct timeval tval;
+	gettimeofday(&tval, NULL);
+	return (int64)tval.tv_sec * 1000000 + tval.tv_usec;
+#endif
+}
+
+#ifdef TIMER_USE_WHEEL
+/*======================================
+ * CORE : Timer Wheel
+ *--------------------------------------*/
+
+/// Links a timer to the wheel slot matching its tick.
+static void push_timer_heap(int tid)
+{
+	struct timer_wheel_link *link = &timer_links[tid];
+	int64 expire = timer_data[tid].tick;
+	int64 delta;
+	int *slot;
+
+	if (!wheel_started) {
+		wheel_tick = timer->gettick();
+		wheel_started = true;
+	}
+
+	delta = expire - wheel_tick;
+	if (delta < 0) {
+		slot = &wheel_expired;
+	} else if (delta < TIMER_WHEEL_SIZE0) {
+		slot = &wheel_slots0[expire & (TIMER_WHEEL_SIZE0 - 1)];
+	} else {
+		int level;
+
+		if (delta > TIMER_WHEEL_MAX_SPAN) {
+			expire = wheel_tick + TIMER_WHEEL_MAX_SPAN;
+			delta = TIMER_WHEEL_MAX_SPAN;
+		}
+		for (level = 0; level < TIMER_WHEEL_LEVELS - 1 && delta >= TIMER_WHEEL_SPAN(level + 1); level++)
+			;
+		slot = &wheel_slots[level][(expire >> (TIMER_WHEEL_BITS0 + level * TIMER_WHEEL_BITS)) & (TIMER_WHEEL_SIZE - 1)];
+	}
+
+	link->slot = slot;
+	link->prev = 0;
+	link->next = *slot;
+	if (*slot != 0)
+		timer_links[*slot].prev = tid;
+	*slot = tid;
+	wheel_count++;
+}
+
+/// Unlinks a timer from its wheel slot.
+static void pop_timer_heap(int tid)
+{
+	struct timer_wheel_link *link = &timer_links[tid];
+
+	if (link->prev != 0)
+		timer_links[link->prev].next = link->next;
+	else
+		*link->slot = link->next;
+	if (link->next != 0)
+		timer_links[link->next].prev = link->prev;
+	link->prev = link->next = 0;
+	link->slot = NULL;
+	wheel_count--;
+}
+
+/// Moves all the timers of an upper level slot to the levels below it.
+/// Returns the index of the slot, the next level must also be cascaded when it's 0.
+static int cascade_timer_wheel(int level)
+{
+	int index = (int)((wheel_tick >> (TIMER_WHEEL_BITS0 + level * TIMER_WHEEL_BITS)) & (TIMER_WHEEL_SIZE - 1));
+	int tid = wheel_slots[level][index];
+
+	wheel_slots[level][index] = 0;
+	while (tid != 0) {
+		int next = timer_links[tid].next;
+
+		wheel_count--;
+		timer_links[tid].slot = NULL;
+		push_timer_heap(tid);
+		tid = next;
+	}
+	return index;
+}
+#else  // TIMER_USE_WHEEL
 /*======================================
  * CORE : Timer Heap
  *--------------------------------------*/
@@ -269,6 +451,7 @@ static void push_timer_heap(int tid)
 	BHEAP_ENSURE(timer_heap, 1, 256);
 	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, swap);
 }
+#endif  // TIMER_USE_WHEEL
 
 /*==========================
  * Timer Management
@@ -299,6 +482,13 @@ static int acquire_timer(void)
 		else
 			CREATE(timer_data, struct TimerData, timer_data_max);
 		memset(timer_data + (timer_data_max - 256), 0, sizeof(struct TimerData)*256);
+#ifdef TIMER_USE_WHEEL
+		if (timer_links)
+			RECREATE(timer_links, struct timer_wheel_link, timer_data_max);
+		else
+			CREATE(timer_links, struct timer_wheel_link, timer_data_max);
+		memset(timer_links + (timer_data_max - 256), 0, sizeof(struct timer_wheel_link)*256);
+#endif  // TIMER_USE_WHEEL
 	}
 
 	if( tid >= timer_data_num )
@@ -434,11 +624,20 @@ static int64 timer_addtick(int tid, int64 tick)
  */
 static int64 timer_settick(int tid, int64 tick)
 {
+#ifdef TIMER_USE_WHEEL
+	if (tid < 1 || tid >= timer_data_num) {
+		ShowError("timer_settick error : no such timer [%d]\n", tid);
+		Assert_retr(-1, 0);
+		return -1;
+	}
+	if (timer_links[tid].slot == NULL) {
+#else  // TIMER_USE_WHEEL
 	int i;
 
 	// search timer position
 	ARR_FIND(0, BHEAP_LENGTH(timer_heap), i, BHEAP_DATA(timer_heap)[i] == tid);
 	if (i == BHEAP_LENGTH(timer_heap)) {
+#endif  // TIMER_USE_WHEEL
 		ShowError("timer_settick: no such timer [%d](%p(%s))\n", tid, timer_data[tid].func, search_timer_func_list(timer_data[tid].func));
 		Assert_retr(-1, 0);
 		return -1;
@@ -462,12 +661,308 @@ static int64 timer_settick(int tid, int64 tick)
 		return tick; // nothing to do, already in proper position
 
 	// pop and push adjusted timer
+#ifdef TIMER_USE_WHEEL
+	pop_timer_heap(tid);
+	timer_data[tid].tick = tick;
+	push_timer_heap(tid);
+#else  // TIMER_USE_WHEEL
 	BHEAP_POPINDEX(timer_heap, i, DIFFTICK_MINTOPCMP, swap);
 	timer_data[tid].tick = tick;
 	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, swap);
+#endif  // TIMER_USE_WHEEL
 	return tick;
 }
 
+/*======================================
+ * Timer profiling
+ *--------------------------------------
+ * When enabled, every timer function call is measured and accumulated
+ * per TimerFunc: number of calls, total and maximum wall time and a
+ * histogram of the call durations. The collected data can be shown in
+ * the console and is periodically appended to log/<server>-timers.log,
+ * starting a new measurement window after each dump.
+ */
+
+/// Default seconds between dumps to the log file.
+#define TIMER_PROFILE_DUMP_INTERVAL 60
+
+struct timer_profile_entry {
+	TimerFunc func;
+	struct duration_histogram calls;
+};
+
+static struct DBMap *timer_profile_db = NULL; // TimerFunc -> struct timer_profile_entry *
+static bool timer_profile_enabled = false;
+static int64 timer_profile_window_start = 0; ///< Start of the current measurement window (us)
+static int timer_profile_dump_tid = INVALID_TIMER;
+
+/// Accounts a call of func that took duration microseconds.
+static void timer_profile_record(TimerFunc func, int64 duration)
+{
+	struct timer_profile_entry *entry = ui64db_get(timer_profile_db, (uint64)(uintptr_t)func);
+
+	if (entry == NULL) {
+		CREATE(entry, struct timer_profile_entry, 1);
+		entry->func = func;
+		ui64db_put(timer_profile_db, (uint64)(uintptr_t)func, entry);
+	}
+	duration_histogram_record(&entry->calls, duration);
+}
+
+static int timer_profile_compare(const void *a, const void *b)
+{
+	const struct timer_profile_entry *ea = *(const struct timer_profile_entry * const *)a;
+	const struct timer_profile_entry *eb = *(const struct timer_profile_entry * const *)b;
+
+	if (ea->calls.total_us != eb->calls.total_us)
+		return (ea->calls.total_us < eb->calls.total_us) ? 1 : -1;
+	return 0;
+}
+
+/**
+ * Reports the data collected in the current window, sorted by total time.
+ *
+ * @param fp File to write to, or NULL to show it in the console.
+ */
+static void timer_profile_report(FILE *fp)
+{
+	struct timer_profile_entry **list;
+	struct timer_profile_entry *entry;
+	struct DBIterator *iter;
+	int64 window;
+	int count = 0, i;
+
+	if (timer_profile_db == NULL || db_size(timer_profile_db) == 0) {
+		if (fp == NULL)
+			ShowInfo("Timer profiling: no data collected%s.\n", timer_profile_enabled ? "" : " (profiling is disabled)");
+		return;
+	}
+
+	CREATE(list, struct timer_profile_entry *, db_size(timer_profile_db));
+	iter = db_iterator(timer_profile_db);
+	for (entry = dbi_first(iter); dbi_exists(iter); entry = dbi_next(iter))
+		list[count++] = entry;
+	dbi_destroy(iter);
+	qsort(list, count, sizeof(*list), timer_profile_compare);
+
+	window = timer_gettick_us() - timer_profile_window_start;
+	if (fp == NULL) {
+		ShowInfo("Timer profiling over the last %.1f seconds:\n", (double)window / 1000000);
+		ShowMessage("%-40s %10s %10s %9s %9s %9s %9s\n", "function", "calls", "total ms", "avg us", "max us", "p50 us", "p99 us");
+	} else {
+		time_t now = time(NULL);
+		char timestring[32];
+		strftime(timestring, sizeof(timestring), "%Y-%m-%d %H:%M:%S", localtime(&now));
+		fprintf(fp, "[%s] timer profiling over %.1f seconds\n", timestring, (double)window / 1000000);
+		fprintf(fp, "%-40s %10s %10s %9s %9s %9s %9s  histogram (<us:calls)\n", "function", "calls", "total ms", "avg us", "max us", "p50 us", "p99 us");
+	}
+
+	for (i = 0; i < count; i++) {
+		char line[256];
+
+		entry = list[i];
+		snprintf(line, sizeof(line), "%-40.40s %10"PRIu64" %10.3f %9"PRId64" %9"PRId64" %9"PRId64" %9"PRId64,
+		         search_timer_func_list(entry->func), entry->calls.count, (double)entry->calls.total_us / 1000,
+		         entry->calls.total_us / (int64)entry->calls.count, entry->calls.max_us,
+		         duration_histogram_percentile(&entry->calls, 500), duration_histogram_percentile(&entry->calls, 990));
+		if (fp == NULL) {
+			ShowMessage("%s\n", line);
+		} else {
+			int j;
+			fprintf(fp, "%s ", line);
+			for (j = 0; j < DURATION_HISTOGRAM_BUCKETS; j++) {
+				if (entry->calls.buckets[j] != 0)
+					fprintf(fp, " %"PRId64":%"PRIu64, INT64_C(1) << j, entry->calls.buckets[j]);
+			}
+			fprintf(fp, "\n");
+		}
+	}
+	if (fp != NULL)
+		fprintf(fp, "\n");
+
+	aFree(list);
+}
+
+/// Discards the collected data and starts a new measurement window.
+static void timer_profile_reset(void)
+{
+	if (timer_profile_db != NULL)
+		db_clear(timer_profile_db);
+	timer_profile_window_start = timer_gettick_us();
+}
+
+/// Appends the collected data to the log file and starts a new window.
+static int timer_profile_dump_timer(int tid, int64 tick, int id, intptr_t data)
+{
+	char filename[256];
+	FILE *fp;
+
+	snprintf(filename, sizeof(filename), "log/%s-timers.log", SERVER_NAME);
+	if ((fp = fopen(filename, "a")) == NULL) {
+		ShowError("timer_profile_dump_timer: unable to open '%s' for writing.\n", filename);
+		return 0;
+	}
+	timer_profile_report(fp);
+	fclose(fp);
+	timer_profile_reset();
+	return 0;
+}
+
+/**
+ * Starts collecting timer profiling data.
+ *
+ * @param dump_interval Seconds between dumps to the log file (0 to disable them).
+ */
+static void timer_profile_start(int dump_interval)
+{
+	if (timer_profile_db == NULL)
+		timer_profile_db = ui64db_alloc(DB_OPT_RELEASE_DATA);
+	if (!timer_profile_enabled)
+		timer_profile_reset();
+	timer_profile_enabled = true;
+
+	if (timer_profile_dump_tid != INVALID_TIMER) {
+		timer->delete(timer_profile_dump_tid, timer_profile_dump_timer);
+		timer_profile_dump_tid = INVALID_TIMER;
+	}
+	if (dump_interval > 0)
+		timer_profile_dump_tid = timer->add_interval(timer->gettick() + dump_interval * 1000, timer_profile_dump_timer, 0, 0, dump_interval * 1000);
+}
+
+/// Stops collecting timer profiling data (the data collected so far is kept).
+static void timer_profile_stop(void)
+{
+	timer_profile_enabled = false;
+	if (timer_profile_dump_tid != INVALID_TIMER) {
+		timer->delete(timer_profile_dump_tid, timer_profile_dump_timer);
+		timer_profile_dump_tid = INVALID_TIMER;
+	}
+}
+
+/**
+ * Executes a timer that was removed from the timer queue, and frees it or
+ * adds it back to the queue afterwards.
+ *
+ * @param tid  The timer ID.
+ * @param tick The current tick.
+ * @param diff How much the timer is overdue (negative).
+ */
+static void do_timer_execute(int tid, int64 tick, int64 diff)
+{
+	timer_data[tid].type |= TIMER_REMOVE_HEAP;
+
+	if( timer_data[tid].func ) {
+		TimerFunc func = timer_data[tid].func;
+		int64 start = timer_profile_enabled ? timer_gettick_us() : 0;
+
+		timer_running_func = func;
+		if( diff < -1000 )
+			// timer was delayed for more than 1 second, use current tick instead
+			func(tid, tick, timer_data[tid].id, timer_data[tid].data);
+		else
+			func(tid, timer_data[tid].tick, timer_data[tid].id, timer_data[tid].data);
+		timer_running_func = NULL;
+
+		if (start != 0 && timer_profile_enabled)
+			timer_profile_record(func, timer_gettick_us() - start);
+	}
+
+	// in the case the function didn't change anything...
+	if( timer_data[tid].type & TIMER_REMOVE_HEAP ) {
+		timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
+
+		switch( timer_data[tid].type ) {
+			default:
+			case TIMER_ONCE_AUTODEL:
+				timer_data[tid].type = 0;
+				timer_data[tid].func = NULL;
+				if (free_timer_list_pos >= free_timer_list_max) {
+					free_timer_list_max += 256;
+					RECREATE(free_timer_list,int,free_timer_list_max);
+					memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int));
+				}
+				free_timer_list[free_timer_list_pos++] = tid;
+			break;
+			case TIMER_INTERVAL:
+				if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
+					timer_data[tid].tick = tick + timer_data[tid].interval;
+				else
+					timer_data[tid].tick += timer_data[tid].interval;
+				push_timer_heap(tid);
+			break;
+		}
+	}
+}
+
+#ifdef TIMER_USE_WHEEL
+/**
+ * Executes all expired timers.
+ *
+ * The wheel is advanced one millisecond at a time up to the current tick,
+ * executing the timers of each level 0 slot. Timers added while executing
+ * for an expired tick (including interval timers that are behind schedule)
+ * land in the slot being processed or in the expired list, so they are
+ * executed in the same call.
+ *
+ * @param tick The current tick.
+ * @return The time until the next timer in the wheel is due (or 1 second if there aren't any).
+ */
+static int do_timer(int64 tick)
+{
+	int64 diff = TIMER_MAX_INTERVAL; // return value
+	int i;
+
+	if (!wheel_started) {
+		wheel_tick = tick;
+		wheel_started = true;
+	}
+
+	while (true) {
+		int *slot = &wheel_expired;
+
+		if (wheel_tick <= tick) {
+			int index = (int)(wheel_tick & (TIMER_WHEEL_SIZE0 - 1));
+
+			if (index == 0) {
+				int level;
+				for (level = 0; level < TIMER_WHEEL_LEVELS && cascade_timer_wheel(level) == 0; level++)
+					;
+			}
+			slot = &wheel_slots0[index];
+		}
+
+		// process all timers one by one
+		while (*slot != 0 || wheel_expired != 0) {
+			int tid = (wheel_expired != 0) ? wheel_expired : *slot;
+
+			pop_timer_heap(tid);
+			do_timer_execute(tid, tick, DIFF_TICK(timer_data[tid].tick, tick));
+		}
+
+		if (wheel_tick > tick)
+			break;
+		wheel_tick++;
+		if (wheel_count == 0) {
+			// nothing to wait for, the wheel can jump straight to the current tick
+			wheel_tick = tick + 1;
+			break;
+		}
+	}
+	if (wheel_count == 0)
+		return TIMER_MAX_INTERVAL;
+
+	// find the next non-empty slot (anything in upper levels is cascaded once level 0 wraps around)
+	for (i = 0; i < TIMER_WHEEL_SIZE0; i++) {
+		int64 next = wheel_tick + i;
+		if (wheel_slots0[next & (TIMER_WHEEL_SIZE0 - 1)] != 0 || (next & (TIMER_WHEEL_SIZE0 - 1)) == 0) {
+			diff = DIFF_TICK(next, tick);
+			break;
+		}
+	}
+
+	return (int)cap_value(diff, TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
+}
+#else  // TIMER_USE_WHEEL
 /**
  * Executes all expired timers.
  *
@@ -488,51 +983,28 @@ static int do_timer(int64 tick)
 
 		// remove timer
 		BHEAP_POP(timer_heap, DIFFTICK_MINTOPCMP, swap);
-		timer_data[tid].type |= TIMER_REMOVE_HEAP;
-
-		if( timer_data[tid].func ) {
-			if( diff < -1000 )
-				// timer was delayed for more than 1 second, use current tick instead
-				timer_data[tid].func(tid, tick, timer_data[tid].id, timer_data[tid].data);
-			else
-				timer_data[tid].func(tid, timer_data[tid].tick, timer_data[tid].id, timer_data[tid].data);
-		}
-
-		// in the case the function didn't change anything...
-		if( timer_data[tid].type & TIMER_REMOVE_HEAP ) {
-			timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
-
-			switch( timer_data[tid].type ) {
-				default:
-				case TIMER_ONCE_AUTODEL:
-					timer_data[tid].type = 0;
-					timer_data[tid].func = NULL;
-					if (free_timer_list_pos >= free_timer_list_max) {
-						free_timer_list_max += 256;
-						RECREATE(free_timer_list,int,free_timer_list_max);
-						memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int));
-					}
-					free_timer_list[free_timer_list_pos++] = tid;
-				break;
-				case TIMER_INTERVAL:
-					if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
-						timer_data[tid].tick = tick + timer_data[tid].interval;
-					else
-						timer_data[tid].tick += timer_data[tid].interval;
-					push_timer_heap(tid);
-				break;
-			}
-		}
+		do_timer_execute(tid, tick, diff);
 	}
 
 	return (int)cap_value(diff, TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
 }
+#endif  // TIMER_USE_WHEEL
 
 static unsigned long timer_get_uptime(void)
 {
 	return (unsigned long)difftime(time(NULL), start_time);
 }
 
+/// Returns the number of timers waiting to be executed.
+static int timer_queue_size(void)
+{
+#ifdef TIMER_USE_WHEEL
+	return wheel_count;
+#else  // TIMER_USE_WHEEL
+	return BHEAP_LENGTH(timer_heap);
+#endif  // TIMER_USE_WHEEL
+}
+
 static void timer_init(void)
 {
 #if defined(ENABLE_RDTSC)
@@ -540,6 +1012,8 @@ static void timer_init(void)
 #endif
 
 	time(&start_time);
+
+	timer->add_func_list(timer_profile_dump_timer, "timer_profile_dump_timer");
 }
 
 static void timer_final(void)
@@ -554,8 +1028,24 @@ static void timer_final(void)
 	}
 
 	if (timer_data) aFree(timer_data);
+#ifdef TIMER_USE_WHEEL
+	if (timer_links) aFree(timer_links);
+	memset(wheel_slots0, 0, sizeof(wheel_slots0));
+	memset(wheel_slots, 0, sizeof(wheel_slots));
+	wheel_expired = 0;
+	wheel_count = 0;
+	wheel_started = false;
+#else  // TIMER_USE_WHEEL
 	BHEAP_CLEAR(timer_heap);
+#endif  // TIMER_USE_WHEEL
 	if (free_timer_list) aFree(free_timer_list);
+
+	timer_profile_enabled = false;
+	timer_profile_dump_tid = INVALID_TIMER;
+	if (timer_profile_db != NULL) {
+		db_destroy(timer_profile_db);
+		timer_profile_db = NULL;
+	}
 }
 
 #ifdef BUILDBOT
@@ -657,11 +1147,19 @@ void timer_defaults(void)
 	timer->delete = timer_do_delete;
 	timer->addtick = timer_addtick;
 	timer->settick = timer_settick;
+	timer->gettick_us = timer_gettick_us;
+	timer->set_virtual_tick = timer_set_virtual_tick;
 	timer->get_uptime = timer_get_uptime;
+	timer->queue_size = timer_queue_size;
 	timer->perform = do_timer;
 	timer->init = timer_init;
 	timer->final = timer_final;
 	timer->check_timers = timer_check_timers;
 	timer->get_current_clocksource = timer_get_current_clocksource;
 	timer->get_available_clocksource = timer_get_available_clocksource;
+	timer->running = timer_running;
+	timer->profile_start = timer_profile_start;
+	timer->profile_stop = timer_profile_stop;
+	timer->profile_reset = timer_profile_reset;
+	timer->profile_report = timer_profile_report;
 }
@@ -23,6 +23,8 @@
 
 #include "common/hercules.h"
 
+#include <stdio.h> // FILE*
+
 #define DIFF_TICK(a,b) ((a)-(b))
 #define DIFF_TICK32(a,b) ((int32)((a)-(b)))
 
@@ -72,7 +74,10 @@ struct timer_interface {
 
 	int (*add_func_list) (TimerFunc func, char* name);
 
+	int64 (*gettick_us) (void);
+	void (*set_virtual_tick) (int64 tick);
 	unsigned long (*get_uptime) (void);
+	int (*queue_size) (void);
 
 	int (*perform) (int64 tick);
 	void (*init) (void);
@@ -80,6 +85,13 @@ struct timer_interface {
 	void (*check_timers) (void);
 	bool (*get_current_clocksource) (char *buf, int buf_size);
 	bool (*get_available_clocksource) (char *buf, int buf_size);
+	const char *(*running) (void);
+
+	/* profiling */
+	void (*profile_start) (int dump_interval);
+	void (*profile_stop) (void);
+	void (*profile_reset) (void);
+	void (*profile_report) (FILE *fp);
 };
 
 #ifdef HERCULES_CORE
@@ -421,6 +421,71 @@ uint64 get_percentage64(const uint64 A, const uint64 B)
 	return (uint64)floor(result);
 }
 
+/**
+ * Accounts a duration in a histogram.
+ *
+ * @param hist     The histogram.
+ * @param duration The duration (in us), negative values are counted as 0.
+ */
+void duration_histogram_record(struct duration_histogram *hist, int64 duration)
+{
+	int bucket = 0;
+
+	nullpo_retv(hist);
+	if (duration < 0)
+		duration = 0;
+	if (hist->count == 0 || duration < hist->min_us)
+		hist->min_us = duration;
+	if (duration > hist->max_us)
+		hist->max_us = duration;
+	hist->count++;
+	hist->total_us += duration;
+	while (bucket < DURATION_HISTOGRAM_BUCKETS - 1 && duration >= (INT64_C(1) << bucket))
+		bucket++;
+	hist->buckets[bucket]++;
+}
+
+/**
+ * Estimates a percentile of the durations accounted in a histogram.
+ *
+ * @param hist     The histogram.
+ * @param permille The percentile, in permille (990 for p99).
+ * @return The upper bound (in us) of the bucket where the percentile falls.
+ */
+int64 duration_histogram_percentile(const struct duration_histogram *hist, int permille)
+{
+	uint64 target, count = 0;
+	int i;
+
+	nullpo_ret(hist);
+	target = (hist->count * permille + 999) / 1000;
+	for (i = 0; i < DURATION_HISTOGRAM_BUCKETS - 1; i++) {
+		count += hist->buckets[i];
+		if (count >= target)
+			break;
+	}
+	return INT64_C(1) << i;
+}
+
+/**
+ * Counts the durations accounted in the first buckets of a histogram.
+ *
+ * @param hist   The histogram.
+ * @param bucket The last bucket counted.
+ * @return The number of durations under 2^bucket us.
+ */
+uint64 duration_histogram_count_under(const struct duration_histogram *hist, int bucket)
+{
+	uint64 count = 0;
+	int i;
+
+	nullpo_ret(hist);
+	Assert_ret(bucket >= 0 && bucket < DURATION_HISTOGRAM_BUCKETS);
+	for (i = 0; i <= bucket; i++)
+		count += hist->buckets[i];
+	return count;
+}
+
 /**
  * Applies a percentual rate modifier.
  *
@@ -42,6 +42,16 @@
 //Caps values to min/max
 #define cap_value(a, min, max) (((a) >= (max)) ? (max) : ((a) <= (min)) ? (min) : (a))
 
+/// Duration histogram buckets, bucket 0 counts durations under 1us and bucket i durations under 2^i us (the last one is unbounded).
+#define DURATION_HISTOGRAM_BUCKETS 24
+
+/// Count, total, extremes and log2 histogram of a series of durations (in us).
+struct duration_histogram {
+	uint64 count;
+	int64 total_us, min_us, max_us;
+	uint64 buckets[DURATION_HISTOGRAM_BUCKETS];
+};
+
 #ifdef HERCULES_CORE
 // generate a hex dump of the first 'length' bytes of 'buffer'
 void WriteDump(FILE* fp, const void* buffer, size_t length);
@@ -60,6 +70,10 @@ int apply_percentrate(int value, int rate, int maxrate);
 
 const char* timestamp2string(char* str, size_t size, time_t timestamp, const char* format);
 
+void duration_histogram_record(struct duration_histogram *hist, int64 duration);
+int64 duration_histogram_percentile(const struct duration_histogram *hist, int permille);
+uint64 duration_histogram_count_under(const struct duration_histogram *hist, int bucket);
+
 //////////////////////////////////////////////////////////////////////////
 // byte word dword access [Shinomori]
 //////////////////////////////////////////////////////////////////////////
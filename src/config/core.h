@@ -91,6 +91,12 @@
 /// Uncomment to enable real-time server stats (in and out data and ram usage). [Ai4rei]
 //#define SHOW_SERVER_STATS
 
+/// Comment to use a binary heap for the timers instead of a hierarchical timing wheel.
+/// The timing wheel adds, deletes and reschedules timers in constant time, while the
+/// binary heap needs O(log n) operations and a linear search to reschedule a timer,
+/// which shows on busy servers with hundreds of thousands of live timers.
+#define TIMER_USE_WHEEL
+
 /// Comment to disable autotrade persistency (where autotrading merchants survive server restarts)
 #define AUTOTRADE_PERSISTENCY
 
@@ -26,18 +26,24 @@
 #include "login/loginlog.h"
 #include "common/cbasetypes.h"
 #include "common/conf.h"
+#include "common/db.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/sql.h"
 #include "common/strlib.h"
 #include "common/timer.h"
 
+#include <limits.h>
 #include <stdlib.h>
+#include <time.h>
 
 static struct ipban_interface ipban_s;
 struct ipban_interface *ipban;
 static struct s_ipban_dbs ipbandbs;
 
+/// Key of a ban in ipban->bans
+#define IPBAN_KEY(ip, prefix) ( ((uint64)(prefix) << 32) | ((prefix) == 0 ? 0 : ((ip) & (0xFFFFFFFFU << (32 - (prefix))))) )
+
 // initialize
 static void ipban_init(void)
 {
@@ -57,13 +63,21 @@ static void ipban_init(void)
 	if (ipban->dbs->codepage[0] != '\0' && SQL_ERROR == SQL->SetEncoding(ipban->sql_handle, ipban->dbs->codepage))
 		Sql_ShowDebug(ipban->sql_handle);
 
+	// without the index every connection is refused, until a reload succeeds
+	if (!ipban->load())
+		ShowError("ipban_init: Failed to load the active IP bans, connections will be refused until they are loaded.\n");
+
+	// read the bans added to the table by other tools periodically (removals are picked up by the cleanup)
+	timer->add_func_list(ipban->reload, "ipban_reload");
+	ipban->reload_timer_id = timer->add_interval(timer->gettick() + (int64)login->config->ipban_reload_interval * 1000, ipban->reload, 0, 0, (int)login->config->ipban_reload_interval * 1000);
+
 	if (login->config->ipban_cleanup_interval > 0) {
 		// set up periodic cleanup of connection history and active bans
 		timer->add_func_list(ipban->cleanup, "ipban_cleanup");
 		ipban->cleanup_timer_id = timer->add_interval(timer->gettick()+10, ipban->cleanup, 0, 0, login->config->ipban_cleanup_interval*1000);
 	} else {
 		// make sure it gets cleaned up on login-server start regardless of interval-based cleanups
-		ipban->cleanup(0,0,0,0);
+		ipban->cleanup(INVALID_TIMER,0,0,0);
 	}
 }
 
@@ -76,12 +90,18 @@ static void ipban_final(void)
 	if (login->config->ipban_cleanup_interval > 0)
 		// release data
 		timer->delete(ipban->cleanup_timer_id, ipban->cleanup);
+	timer->delete(ipban->reload_timer_id, ipban->reload);
+	ipban->reload_timer_id = INVALID_TIMER;
 
-	ipban->cleanup(0,0,0,0); // always clean up on login-server stop
+	ipban->cleanup(INVALID_TIMER,0,0,0); // always clean up on login-server stop
 
 	// close connections
 	SQL->Free(ipban->sql_handle);
 	ipban->sql_handle = NULL;
+
+	if (ipban->bans != NULL)
+		db_destroy(ipban->bans);
+	ipban->bans = NULL;
 }
 
 /**
@@ -222,6 +242,16 @@ static bool ipban_config_read(const char *filename, struct config_t *config, boo
 
 	libconfig->setting_lookup_bool_real(setting, "enabled", &login->config->ipban);
 	libconfig->setting_lookup_uint32(setting, "cleanup_interval", &login->config->ipban_cleanup_interval);
+	if (libconfig->setting_lookup_uint32(setting, "reload_interval", &login->config->ipban_reload_interval) == CONFIG_TRUE) {
+		if (login->config->ipban_reload_interval == 0) {
+			ShowWarning("ipban_config_read: reload_interval can't be 0, defaulting to 5.\n");
+			login->config->ipban_reload_interval = 5;
+		} else if (login->config->ipban_reload_interval > INT_MAX / 1000) {
+			// the timer interval is in milliseconds and must fit an int
+			ShowWarning("ipban_config_read: reload_interval %u is too high, capping to %d.\n", login->config->ipban_reload_interval, INT_MAX / 1000);
+			login->config->ipban_reload_interval = INT_MAX / 1000;
+		}
+	}
 
 	if (!ipban_config_read_inter("conf/common/inter-server.conf", imported))
 		retval = false;
@@ -233,32 +263,177 @@ static bool ipban_config_read(const char *filename, struct config_t *config, boo
 	return retval;
 }
 
-// check ip against active bans list
-static bool ipban_check(uint32 ip)
+/**
+ * Parses a ban list entry ("a.*.*.*", "a.b.*.*", "a.b.c.*" or "a.b.c.d").
+ *
+ * @param list The entry.
+ * @param ip   The banned address, in host byte order (wildcard octets are 0).
+ * @return The prefix length in bits (8, 16, 24 or 32), -1 if the entry is malformed.
+ */
+static int ipban_parse_list(const char *list, uint32 *ip)
 {
-	uint8* p = (uint8*)&ip;
-	char* data = NULL;
-	int matches;
+	int octets = 0, wildcards = 0;
+	const char *p = list;
+
+	nullpo_retr(-1, list);
+	nullpo_retr(-1, ip);
+
+	*ip = 0;
+	while (octets + wildcards < 4) {
+		if (*p == '*' && octets > 0) {
+			wildcards++;
+			p++;
+		} else if (ISDIGIT(*p) && wildcards == 0) {
+			unsigned int value = 0;
+
+			while (ISDIGIT(*p) && value <= 255)
+				value = value * 10 + (unsigned int)(*p++ - '0');
+			if (value > 255)
+				return -1;
+			*ip |= value << (8 * (3 - octets));
+			octets++;
+		} else {
+			return -1;
+		}
+		if (octets + wildcards < 4 && *p++ != '.')
+			return -1;
+	}
+	if (*p != '\0')
+		return -1;
 
-	if (!login->config->ipban)
-		return false;// ipban disabled
+	return octets * 8;
+}
 
-	if( SQL_ERROR == SQL->Query(ipban->sql_handle, "SELECT count(*) FROM `%s` WHERE `rtime` > NOW() AND (`list` = '%u.*.*.*' OR `list` = '%u.%u.*.*' OR `list` = '%u.%u.%u.*' OR `list` = '%u.%u.%u.%u')",
-		ipban->dbs->table, p[3], p[3], p[2], p[3], p[2], p[1], p[3], p[2], p[1], p[0]) )
-	{
+/**
+ * Adds a ban to the in-memory index (the longest expiration is kept).
+ *
+ * @param ip         The banned address, in host byte order.
+ * @param prefix     Number of leading bits of the address covered by the ban (8, 16, 24 or 32).
+ * @param expiration Expiration timestamp of the ban.
+ * @retval false if the index already had the ban (or there's no index).
+ */
+static bool ipban_add(uint32 ip, int prefix, uint32 expiration)
+{
+	uint64 key = IPBAN_KEY(ip, prefix);
+
+	if (ipban->bans == NULL)
+		return false;
+
+	if (ui64db_uiget(ipban->bans, key) >= expiration)
+		return false;
+	ui64db_uiput(ipban->bans, key, expiration);
+	return true;
+}
+
+/**
+ * Adds the bans of the current result set to the in-memory index.
+ * Columns: `list`, UNIX_TIMESTAMP(`rtime`), UNIX_TIMESTAMP(`btime`)
+ *
+ * @return The number of bans that changed the index.
+ */
+static int ipban_add_rows(void)
+{
+	char *data = NULL;
+	int count = 0;
+
+	while (SQL_SUCCESS == SQL->NextRow(ipban->sql_handle)) {
+		uint32 ip, expiration, btime;
+		int prefix;
+
+		SQL->GetData(ipban->sql_handle, 0, &data, NULL);
+		if ((prefix = ipban->parse_list(data, &ip)) < 0) {
+			ShowWarning("ipban_add_rows: Ignoring malformed entry '%s' in `%s`.\n", data, ipban->dbs->table);
+			continue;
+		}
+		SQL->GetData(ipban->sql_handle, 1, &data, NULL);
+		expiration = (uint32)strtoul(data, NULL, 10);
+		SQL->GetData(ipban->sql_handle, 2, &data, NULL);
+		btime = (uint32)strtoul(data, NULL, 10);
+
+		if (btime > ipban->last_btime)
+			ipban->last_btime = btime;
+		if (ipban->add(ip, prefix, expiration))
+			count++;
+	}
+	SQL->FreeResult(ipban->sql_handle);
+
+	return count;
+}
+
+/**
+ * Replaces the in-memory index with the active bans from the database.
+ *
+ * @retval false in case of error (the previous index is kept, if there's none
+ *         every connection is refused).
+ */
+static bool ipban_load(void)
+{
+	struct DBMap *previous;
+	int count;
+
+	if (SQL_ERROR == SQL->Query(ipban->sql_handle, "SELECT `list`, UNIX_TIMESTAMP(`rtime`), UNIX_TIMESTAMP(`btime`) FROM `%s` WHERE `rtime` > NOW()", ipban->dbs->table)) {
 		Sql_ShowDebug(ipban->sql_handle);
-		// close connection because we can't verify their connectivity.
-		return true;
+		return false;
 	}
 
-	if( SQL_SUCCESS != SQL->NextRow(ipban->sql_handle) )
+	previous = ipban->bans;
+	ipban->bans = ui64db_alloc(DB_OPT_BASE);
+	count = ipban_add_rows();
+
+	if (previous != NULL)
+		db_destroy(previous);
+	if (previous == NULL || count != ipban->count)
+		ShowInfo("Loaded '"CL_WHITE"%d"CL_RESET"' active IP bans.\n", count);
+	ipban->count = count;
+	return true;
+}
+
+/**
+ * Adds the bans inserted in the database since the last load to the in-memory
+ * index (bans are never updated in place, only inserted or deleted).
+ *
+ * @retval false in case of error.
+ */
+static bool ipban_load_new(void)
+{
+	int count;
+
+	if (ipban->bans == NULL)
+		return ipban->load(); // the initial load failed
+
+	// bans inserted in the same second as the newest one read are read again, adding them is harmless
+	if (SQL_ERROR == SQL->Query(ipban->sql_handle, "SELECT `list`, UNIX_TIMESTAMP(`rtime`), UNIX_TIMESTAMP(`btime`) FROM `%s` WHERE `rtime` > NOW() AND `btime` >= FROM_UNIXTIME(%u)",
+	                            ipban->dbs->table, ipban->last_btime)) {
+		Sql_ShowDebug(ipban->sql_handle);
 		return false;
+	}
 
-	SQL->GetData(ipban->sql_handle, 0, &data, NULL);
-	matches = atoi(data);
-	SQL->FreeResult(ipban->sql_handle);
+	count = ipban_add_rows();
+	if (count > 0) {
+		ipban->count += count;
+		ShowInfo("Loaded '"CL_WHITE"%d"CL_RESET"' new IP bans.\n", count);
+	}
+	return true;
+}
 
-	return( matches > 0 );
+// check ip against active bans list
+static bool ipban_check(uint32 ip)
+{
+	uint32 now = (uint32)time(NULL);
+	int prefix;
+
+	if (!login->config->ipban)
+		return false;// ipban disabled
+
+	if (ipban->bans == NULL)
+		return true; // can't verify their connectivity.
+
+	for (prefix = 8; prefix <= 32; prefix += 8) {
+		if (ui64db_uiget(ipban->bans, IPBAN_KEY(ip, prefix)) > now)
+			return true;
+	}
+
+	return false;
 }
 
 // log failed attempt
@@ -280,6 +455,10 @@ static void ipban_log(uint32 ip)
 		{
 			Sql_ShowDebug(ipban->sql_handle);
 		}
+		else if (ipban->add(ip, 24, (uint32)time(NULL) + login->config->dynamic_pass_failure_ban_duration * 60))
+		{
+			ipban->count++;
+		}
 	}
 }
 
@@ -291,6 +470,19 @@ static int ipban_cleanup(int tid, int64 tick, int id, intptr_t data)
 
 	if( SQL_ERROR == SQL->Query(ipban->sql_handle, "DELETE FROM `%s` WHERE `rtime` <= NOW()", ipban->dbs->table) )
 		Sql_ShowDebug(ipban->sql_handle);
+	else if (tid != INVALID_TIMER)
+		ipban->load(); // drops the expired bans from the index, and the ones removed from the table by other tools
+
+	return 0;
+}
+
+// refresh the in-memory index with the bans added to the table by other tools
+static int ipban_reload(int tid, int64 tick, int id, intptr_t data)
+{
+	if (!login->config->ipban)
+		return 0;// ipban disabled
+
+	ipban->load_new();
 
 	return 0;
 }
@@ -303,7 +495,11 @@ void ipban_defaults(void)
 
 	ipban->sql_handle = NULL;
 	ipban->cleanup_timer_id = INVALID_TIMER;
+	ipban->reload_timer_id = INVALID_TIMER;
 	ipban->inited = false;
+	ipban->bans = NULL;
+	ipban->count = 0;
+	ipban->last_btime = 0;
 
 	// Sql settings
 	strcpy(ipban->dbs->db_hostname, "127.0.0.1");
@@ -317,10 +513,15 @@ void ipban_defaults(void)
 	ipban->init = ipban_init;
 	ipban->final = ipban_final;
 	ipban->cleanup = ipban_cleanup;
+	ipban->reload = ipban_reload;
 	ipban->config_read_inter = ipban_config_read_inter;
 	ipban->config_read_connection = ipban_config_read_connection;
 	ipban->config_read_dynamic = ipban_config_read_dynamic;
 	ipban->config_read = ipban_config_read;
 	ipban->check = ipban_check;
 	ipban->log = ipban_log;
+	ipban->load = ipban_load;
+	ipban->load_new = ipban_load_new;
+	ipban->add = ipban_add;
+	ipban->parse_list = ipban_parse_list;
 }
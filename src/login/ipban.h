@@ -26,6 +26,7 @@
 
 /* Forward Declarations */
 struct config_t; // common/conf.h
+struct DBMap; // common/db.h
 
 struct s_ipban_dbs {
 	char   db_hostname[32];
@@ -44,16 +45,25 @@ struct ipban_interface {
 	struct s_ipban_dbs *dbs;
 	struct Sql *sql_handle;
 	int cleanup_timer_id;
+	int reload_timer_id;
 	bool inited;
+	struct DBMap *bans; ///< Active bans: uint64 (prefix length << 32 | masked ip) -> uint32 expiration timestamp
+	int count; ///< Number of bans in the index
+	uint32 last_btime; ///< Newest ban time read from the database
 	void (*init) (void);
 	void (*final) (void);
 	int (*cleanup) (int tid, int64 tick, int id, intptr_t data);
+	int (*reload) (int tid, int64 tick, int id, intptr_t data);
 	bool (*config_read_inter) (const char *filename, bool imported);
 	bool (*config_read_connection) (const char *filename, struct config_t *config, bool imported);
 	bool (*config_read_dynamic) (const char *filename, struct config_t *config, bool imported);
 	bool (*config_read) (const char *filename, struct config_t *config, bool imported);
 	bool (*check) (uint32 ip);
 	void (*log) (uint32 ip);
+	bool (*load) (void);
+	bool (*load_new) (void);
+	bool (*add) (uint32 ip, int prefix, uint32 expiration);
+	int (*parse_list) (const char *list, uint32 *ip);
 };
 
 #ifdef HERCULES_CORE
@@ -26,8 +26,10 @@
 #include "login/login.h"
 #include "login/packets_ac_struct.h"
 
+#include "common/api.h"
 #include "common/cbasetypes.h"
 #include "common/apipackets.h"
+#include "common/metrics.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/socket.h"
@@ -214,6 +216,9 @@ static int lapiif_parse_fromapi_api_proxy(int fd)
 	}
 
 	switch (msg) {
+		case API_MSG_metrics:
+			lapiif->parse_metrics(fd);
+			break;
 		default:
 			ShowError("Unknown proxy packet 0x%04x received from api-server, disconnecting.\n", msg);
 			sockt->eof(fd);
@@ -256,6 +261,15 @@ static void lapiif_parse_proxy_api_from_char(int fd)
 	WFIFOSET(api_fd, len);
 }
 
+static void lapiif_parse_metrics(int fd)
+{
+	RFIFO_API_PROXY_PACKET(p);
+
+	metrics->collect();
+	metrics->add(METRIC_ONLINE_USERS, NULL, db_size(login->online_db));
+	metrics->send(fd, p, "", 0);
+}
+
 static void lapiif_pong(int fd)
 {
 	WFIFOHEAD(fd, 2);
@@ -401,6 +415,7 @@ void lapiif_defaults(void)
 	lapiif->parse_fromapi_api_proxy = lapiif_parse_fromapi_api_proxy;
 	lapiif->parse_ping = lapiif_parse_ping;
 	lapiif->parse_proxy_api_to_char = lapiif_parse_proxy_api_to_char;
+	lapiif->parse_metrics = lapiif_parse_metrics;
 	lapiif->parse_proxy_api_from_char = lapiif_parse_proxy_api_from_char;
 	lapiif->add_char_server = lapiif_add_char_server;
 	lapiif->add_char_server_to = lapiif_add_char_server_to;
@@ -58,6 +58,7 @@ struct lapiif_interface {
 	void (*parse_ping) (int fd);
 	void (*parse_proxy_api_to_char) (int fd);
 	void (*parse_proxy_api_from_char) (int fd);
+	void (*parse_metrics) (int fd);
 };
 
 #ifdef HERCULES_CORE
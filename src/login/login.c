@@ -1587,6 +1587,7 @@ static void login_config_set_defaults(void)
 	login->config->login_ip = INADDR_ANY;
 	login->config->login_port = 6900;
 	login->config->ipban_cleanup_interval = 60;
+	login->config->ipban_reload_interval = 5;
 	login->config->ip_sync_interval = 0;
 	login->config->log_login = true;
 	safestrncpy(login->config->date_format, "%Y-%m-%d %H:%M:%S", sizeof(login->config->date_format));
@@ -1684,6 +1685,7 @@ static bool login_config_read_console(const char *filename, struct config_t *con
 	}
 	libconfig->setting_lookup_mutable_string(setting, "timestamp_format", showmsg->timestamp_format, sizeof(showmsg->timestamp_format));
 	libconfig->setting_lookup_int(setting, "console_msg_log", &showmsg->console_log);
+	libconfig->setting_lookup_int(setting, "watchdog_threshold", &core->watchdog_threshold);
 
 	return true;
 }
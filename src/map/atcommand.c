@@ -10526,6 +10526,16 @@ ACMD(enchantui)
 #endif
 }
 
+/**
+ * Per-opcode packet profiling
+ * Usage: @packetprofile [on|off|reset]
+ **/
+ACMD(packetprofile)
+{
+	clif->packet_profile(fd, message);
+	return true;
+}
+
 /**
  * Fills the reference of available commands in atcommand DBMap
  **/
@@ -10822,6 +10832,7 @@ static void atcommand_basecommands(void)
 		ACMD_DEF(reloadgradedb),
 		ACMD_DEF(itemreform),
 		ACMD_DEF(enchantui),
+		ACMD_DEF(packetprofile),
 	};
 	int i;
 
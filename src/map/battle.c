@@ -7697,6 +7697,10 @@ static const struct config_data_old battle_data[] = {
 	{ "day_duration",                       &battle_config.day_duration,                    0,      0,      INT_MAX,        },
 	{ "night_duration",                     &battle_config.night_duration,                  0,      0,      INT_MAX,        },
 	{ "mob_remove_delay",                   &battle_config.mob_remove_delay,                60000,  1000,   INT_MAX,        },
+	{ "mob_dormant_maps",                   &battle_config.mob_dormant_maps,                0,      0,      1,              },
+	{ "mob_dormant_delay",                  &battle_config.mob_dormant_delay,               60000,  0,      INT_MAX,        },
+	{ "mob_ai_budget",                      &battle_config.mob_ai_budget,                   0,      0,      MIN_MOBTHINKTIME,},
+	{ "mob_ai_threads",                     &battle_config.mob_ai_threads,                  0,      0,      MOB_AI_MAX_THREADS,},
 	{ "mob_active_time",                    &battle_config.mob_active_time,                 0,      0,      INT_MAX,        },
 	{ "boss_active_time",                   &battle_config.boss_active_time,                0,      0,      INT_MAX,        },
 	{ "slave_chase_masters_chasetarget",    &battle_config.slave_chase_masters_chasetarget, 1,      0,      1,              },
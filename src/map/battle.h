@@ -414,6 +414,10 @@ struct Battle_Config {
 	int dynamic_mobs; // Dynamic Mobs [Wizputer] - battle.conf flag implemented by [random]
 	int mob_remove_damaged; // Dynamic Mobs - Remove mobs even if damaged [Wizputer]
 	int mob_remove_delay; // Dynamic Mobs - delay before removing mobs from a map [Skotlex]
+	int mob_dormant_maps; // Freeze the mobs of maps without players
+	int mob_dormant_delay; // Delay before an empty map goes dormant
+	int mob_ai_budget; // Time (ms) the active mob AI may take per tick
+	int mob_ai_threads; // Worker threads of the mob AI decide phase
 	int mob_active_time; //Duration through which mobs execute their Hard AI after players leave their area of sight.
 	int boss_active_time;
 	int slave_chase_masters_chasetarget;
@@ -50,11 +50,25 @@
 #include "common/timer.h"
 #include "common/packets.h"
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 
 static struct chrif_interface chrif_s;
+
+/// A range of struct mmo_charstatus compared and sent by delta saves.
+struct chrif_save_section {
+	enum chrif_save_section_type type;
+	size_t offset;    ///< Start of the range
+	size_t length;    ///< Length of the range
+	size_t slot_size; ///< Changes are sent one slot of this size at a time (0: whole range)
+};
+
+#define CHRIF_SAVE_SECTIONS_MAX 32
+static struct chrif_save_section chrif_save_sections[CHRIF_SAVE_SECTIONS_MAX];
+static int chrif_save_section_count = 0;
+static int chrif_save_delta_maxlen = 0; ///< Length of a delta save in which every slot changed
 struct chrif_interface *chrif;
 
 //This define should spare writing the check in every function. [Skotlex]
@@ -236,6 +250,126 @@ static int chrif_isconnected(void)
 	return (chrif->fd > 0 && sockt->session[chrif->fd] != NULL && chrif->state == 2);
 }
 
+static int chrif_save_section_cmp(const void *a, const void *b)
+{
+	const struct chrif_save_section *sa = a, *sb = b;
+
+	if (sa->offset != sb->offset)
+		return sa->offset < sb->offset ? -1 : 1;
+	return 0;
+}
+
+/*==========================================
+ * Builds the section table of delta saves.
+ * The named sections are listed explicitly, the
+ * gaps between them form the status section.
+ *------------------------------------------*/
+static void chrif_save_sections_init(void)
+{
+#define CHRIF_SAVE_SECTION(t, field, slot) \
+	(struct chrif_save_section){ (t), offsetof(struct mmo_charstatus, field), sizeof(((struct mmo_charstatus *)NULL)->field), (slot) }
+	const struct chrif_save_section named[] = {
+		CHRIF_SAVE_SECTION(CHRIF_SAVE_POSITION, last_point, 0),
+		CHRIF_SAVE_SECTION(CHRIF_SAVE_POSITION, save_point, 0),
+		CHRIF_SAVE_SECTION(CHRIF_SAVE_POSITION, memo_point, 0),
+		CHRIF_SAVE_SECTION(CHRIF_SAVE_INVENTORY, inventory, sizeof(struct item)),
+		CHRIF_SAVE_SECTION(CHRIF_SAVE_CART, cart, sizeof(struct item)),
+		CHRIF_SAVE_SECTION(CHRIF_SAVE_SKILLS, skill, 0),
+		CHRIF_SAVE_SECTION(CHRIF_SAVE_HOTKEYS, hotkeys, 0),
+	};
+#undef CHRIF_SAVE_SECTION
+	struct chrif_save_section sorted[ARRAYLENGTH(named)];
+	size_t offset = 0;
+	int i, count = 0;
+
+	STATIC_ASSERT(ARRAYLENGTH(named) * 2 + 1 <= CHRIF_SAVE_SECTIONS_MAX, "CHRIF_SAVE_SECTIONS_MAX is too small");
+
+	memcpy(sorted, named, sizeof(named));
+	qsort(sorted, ARRAYLENGTH(sorted), sizeof(sorted[0]), chrif_save_section_cmp);
+
+	for (i = 0; i < (int)ARRAYLENGTH(sorted); i++) {
+		if (sorted[i].offset > offset)
+			chrif_save_sections[count++] = (struct chrif_save_section){ CHRIF_SAVE_STATUS, offset, sorted[i].offset - offset, 0 };
+		chrif_save_sections[count++] = sorted[i];
+		offset = sorted[i].offset + sorted[i].length;
+	}
+	if (offset < sizeof(struct mmo_charstatus))
+		chrif_save_sections[count++] = (struct chrif_save_section){ CHRIF_SAVE_STATUS, offset, sizeof(struct mmo_charstatus) - offset, 0 };
+	chrif_save_section_count = count;
+
+	chrif_save_delta_maxlen = 12;
+	for (i = 0; i < count; i++) {
+		const struct chrif_save_section *section = &chrif_save_sections[i];
+		size_t slots = section->slot_size != 0 ? section->length / section->slot_size : 1;
+
+		chrif_save_delta_maxlen += (int)(section->length + 6 * slots);
+	}
+}
+
+/*==========================================
+ * Sends the sections of the character data that changed
+ * since the last save (autosaves only).
+ * Returns false when a complete save is needed instead.
+ *------------------------------------------*/
+static bool chrif_save_delta(struct map_session_data *sd)
+{
+	const uint8 *cur, *old;
+	int i, len = 12;
+
+	nullpo_retr(false, sd);
+
+	if (sd->save_snapshot == NULL || sd->save_snapshot_generation != chrif->save_generation)
+		return false; // The char-server may not hold the snapshot data.
+
+	cur = (const uint8 *)&sd->status;
+	old = (const uint8 *)sd->save_snapshot;
+
+	WFIFOHEAD(chrif->fd, chrif_save_delta_maxlen);
+	for (i = 0; i < chrif_save_section_count; i++) {
+		const struct chrif_save_section *section = &chrif_save_sections[i];
+		size_t slot = section->slot_size != 0 ? section->slot_size : section->length;
+		size_t offset;
+
+		for (offset = section->offset; offset < section->offset + section->length; offset += slot) {
+			if (memcmp(cur + offset, old + offset, slot) == 0)
+				continue;
+			WFIFOL(chrif->fd,len) = (uint32)offset;
+			WFIFOW(chrif->fd,len+4) = (uint16)slot;
+			memcpy(WFIFOP(chrif->fd,len+6), cur + offset, slot);
+			len += 6 + (int)slot;
+		}
+	}
+
+	if (len == 12)
+		return true; // Nothing changed.
+	if (len >= (int)sizeof(sd->status) + 13)
+		return false; // Not smaller than a complete save.
+
+	WFIFOW(chrif->fd,0) = 0x2b28;
+	WFIFOW(chrif->fd,2) = len;
+	WFIFOL(chrif->fd,4) = sd->status.account_id;
+	WFIFOL(chrif->fd,8) = sd->status.char_id;
+	WFIFOSET(chrif->fd,len);
+
+	memcpy(sd->save_snapshot, &sd->status, sizeof(sd->status));
+	return true;
+}
+
+/*==========================================
+ * The char-server couldn't apply a delta save,
+ * the next save sends the complete data.
+ *------------------------------------------*/
+static void chrif_save_delta_nack(int fd)
+{
+	struct map_session_data *sd = map->charid2sd(RFIFOL(fd,6));
+
+	if (sd == NULL || sd->status.account_id != RFIFOL(fd,2) || sd->save_snapshot == NULL)
+		return;
+
+	aFree(sd->save_snapshot);
+	sd->save_snapshot = NULL;
+}
+
 /*==========================================
  * Saves character data.
  * Flag = 1: Character is quitting
@@ -269,14 +403,23 @@ static bool chrif_save(struct map_session_data *sd, int flag)
 	if (sd->vars_dirty)
 		intif->saveregistry(sd);
 
-	WFIFOHEAD(chrif->fd, sizeof(sd->status) + 13);
-	WFIFOW(chrif->fd,0) = 0x2b01;
-	WFIFOW(chrif->fd,2) = sizeof(sd->status) + 13;
-	WFIFOL(chrif->fd,4) = sd->status.account_id;
-	WFIFOL(chrif->fd,8) = sd->status.char_id;
-	WFIFOB(chrif->fd,12) = (flag==1)?1:0; //Flag to tell char-server this character is quitting.
-	memcpy(WFIFOP(chrif->fd,13), &sd->status, sizeof(sd->status));
-	WFIFOSET(chrif->fd, WFIFOW(chrif->fd,2));
+	if (flag != 0 || !map->delta_save || !chrif->save_delta(sd)) {
+		WFIFOHEAD(chrif->fd, sizeof(sd->status) + 13);
+		WFIFOW(chrif->fd,0) = 0x2b01;
+		WFIFOW(chrif->fd,2) = sizeof(sd->status) + 13;
+		WFIFOL(chrif->fd,4) = sd->status.account_id;
+		WFIFOL(chrif->fd,8) = sd->status.char_id;
+		WFIFOB(chrif->fd,12) = (flag==1)?1:0; //Flag to tell char-server this character is quitting.
+		memcpy(WFIFOP(chrif->fd,13), &sd->status, sizeof(sd->status));
+		WFIFOSET(chrif->fd, WFIFOW(chrif->fd,2));
+
+		if (flag == 0 && map->delta_save) { // Base of the next delta save
+			if (sd->save_snapshot == NULL)
+				CREATE(sd->save_snapshot, struct mmo_charstatus, 1);
+			memcpy(sd->save_snapshot, &sd->status, sizeof(sd->status));
+			sd->save_snapshot_generation = chrif->save_generation;
+		}
+	}
 
 	if( sd->status.pet_id > 0 && sd->pd )
 		intif->save_petdata(sd->status.account_id,&sd->pd->pet);
@@ -1234,6 +1377,7 @@ static void chrif_on_disconnect(void)
 	if( chrif->connected != 1 )
 		ShowWarning("Connection to Char Server lost.\n\n");
 	chrif->connected = 0;
+	chrif->save_generation++; // Delta saves need a complete save first.
 
 	//Attempt to reconnect in a second. [Skotlex]
 	timer->add(timer->gettick() + 1000, chrif->check_connect_char_server, 0, 0);
@@ -1381,6 +1525,7 @@ static int chrif_parse(int fd)
 			case 0x2b24: chrif->keepalive_ack(fd); break;
 			case 0x2b25: chrif->deadopt(RFIFOL(fd,2), RFIFOL(fd,6), RFIFOL(fd,10)); break;
 			case 0x2b27: chrif->authfail(fd); break;
+			case 0x2b29: chrif->save_delta_nack(fd); break;
 			default:
 				ShowError("chrif_parse : unknown packet (session #%d): 0x%x. Disconnecting.\n", fd, (unsigned int)cmd);
 				sockt->eof(fd);
@@ -1578,6 +1723,7 @@ static void do_init_chrif(bool minimal)
 
 	chrif->auth_db = idb_alloc(DB_OPT_BASE);
 	chrif->auth_db_ers = ers_new(sizeof(struct auth_node),"chrif.c::auth_db_ers",ERS_OPT_NONE);
+	chrif->save_sections_init();
 
 	timer->add_func_list(chrif->check_connect_char_server, "check_connect_char_server");
 	timer->add_func_list(chrif->auth_db_cleanup, "auth_db_cleanup");
@@ -1613,6 +1759,7 @@ void chrif_defaults(void)
 	memset(chrif->userid,0,sizeof(chrif->userid));
 	memset(chrif->passwd,0,sizeof(chrif->passwd));
 	chrif->state = 0;
+	chrif->save_generation = 0;
 
 	/* */
 	chrif->auth_db = NULL;
@@ -1640,6 +1787,9 @@ void chrif_defaults(void)
 	chrif->authok = chrif_authok;
 	chrif->scdata_request = chrif_scdata_request;
 	chrif->save = chrif_save;
+	chrif->save_delta = chrif_save_delta;
+	chrif->save_delta_nack = chrif_save_delta_nack;
+	chrif->save_sections_init = chrif_save_sections_init;
 	chrif->charselectreq = chrif_charselectreq;
 
 	chrif->searchcharid = chrif_searchcharid;
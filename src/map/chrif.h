@@ -42,6 +42,17 @@ struct status_change_entry;
  **/
 enum sd_state { ST_LOGIN, ST_LOGOUT, ST_MAPCHANGE };
 
+/// Sections of the character data compared and sent by delta saves.
+enum chrif_save_section_type {
+	CHRIF_SAVE_STATUS,    ///< Everything not covered by another section
+	CHRIF_SAVE_POSITION,  ///< Last, save and memo points
+	CHRIF_SAVE_INVENTORY, ///< Inventory, one slot at a time
+	CHRIF_SAVE_CART,      ///< Cart, one slot at a time
+	CHRIF_SAVE_SKILLS,    ///< Skills
+	CHRIF_SAVE_HOTKEYS,   ///< Hotkeys
+	CHRIF_SAVE_SECTION_MAX
+};
+
 /**
  * Structures
  **/
@@ -78,6 +89,7 @@ struct chrif_interface {
 	uint16 port;
 	char userid[NAME_LENGTH], passwd[NAME_LENGTH];
 	int state;
+	unsigned int save_generation; // Bumped on disconnection, invalidates the delta save snapshots.
 	/* */
 	void (*init) (bool minimal);
 	void (*final) (void);
@@ -100,6 +112,9 @@ struct chrif_interface {
 	void (*authok) (int fd);
 	bool (*scdata_request) (int account_id, int char_id);
 	bool (*save) (struct map_session_data* sd, int flag);
+	bool (*save_delta) (struct map_session_data *sd);
+	void (*save_delta_nack) (int fd);
+	void (*save_sections_init) (void);
 	bool (*charselectreq) (struct map_session_data* sd, uint32 s_ip);
 
 	bool (*searchcharid) (int char_id);
@@ -408,6 +408,31 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 	return clif->send_actual(fd, buf, len);
 }
 
+/// Broadcast being delivered by clif_send, whose recipients share one buffer instead of getting a copy each.
+struct clif_send_shared {
+	const void *buf;
+	int len;
+	int count; ///< Recipients so far.
+	struct socket_shared_buffer *sbuf; ///< Created on the second recipient.
+};
+static struct clif_send_shared send_shared;
+
+/// Queues a packet to a session.
+/// The first recipient of the current broadcast gets a plain copy, the next ones share a buffer.
+static void clif_send_buffer(int fd, const void *buf, int len)
+{
+	if (buf == send_shared.buf && len == send_shared.len && len >= SOCKET_SHARED_MIN_LEN && send_shared.count++ > 0) {
+		if (send_shared.sbuf == NULL)
+			send_shared.sbuf = sockt->shared_create(buf, len);
+		sockt->wfifoset_shared(fd, send_shared.sbuf);
+		return;
+	}
+
+	WFIFOHEAD(fd, len);
+	memcpy(WFIFOP(fd, 0), buf, len);
+	WFIFOSET(fd, len);
+}
+
 static int clif_send_actual(int fd, void *buf, int len)
 {
 	nullpo_retr(0, buf);
@@ -422,8 +447,7 @@ static int clif_send_actual(int fd, void *buf, int len)
 		return 0;
 	}
 
-	memcpy(WFIFOP(fd,0), buf, len);
-	WFIFOSET(fd,len);
+	clif_send_buffer(fd, buf, len);
 
 	return 0;
 }
@@ -432,7 +456,7 @@ static int clif_send_actual(int fd, void *buf, int len)
  * Packet Delegation (called on all packets that require data to be sent to more than one client)
  * functions that are sent solely to one use whose ID it posses use WFIFOSET
  *------------------------------------------*/
-static bool clif_send(const void *buf, int len, struct block_list *bl, enum send_target type)
+static bool clif_send_targets(const void *buf, int len, struct block_list *bl, enum send_target type)
 {
 	if (type != ALL_CLIENT)
 		nullpo_retr(false, bl);
@@ -459,23 +483,16 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 		case ALL_CLIENT: //All player clients.
 			iter = mapit_getallusers();
 			while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
-				WFIFOHEAD(tsd->fd, len);
-				memcpy(WFIFOP(tsd->fd,0), buf, len);
-				WFIFOSET(tsd->fd,len);
+				clif_send_buffer(tsd->fd, buf, len);
 			}
 			mapit->free(iter);
 			break;
 
 		case ALL_SAMEMAP: //All players on the same map
-			iter = mapit_getallusers();
-			while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
-				if (bl && bl->m == tsd->bl.m) {
-					WFIFOHEAD(tsd->fd, len);
-					memcpy(WFIFOP(tsd->fd,0), buf, len);
-					WFIFOSET(tsd->fd,len);
-				}
-			}
-			mapit->free(iter);
+			if (bl == NULL || bl->m < 0 || bl->m >= map->count)
+				break;
+			for (tsd = map->list[bl->m].pc_list; tsd != NULL; tsd = tsd->map_next)
+				clif_send_buffer(tsd->fd, buf, len);
 			break;
 
 		case AREA:
@@ -516,9 +533,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 					if (type == CHAT_WOS && cd->usersd[i] == sd)
 						continue;
 					if ((fd=cd->usersd[i]->fd) >0 && sockt->session[fd]) { // Added check to see if session exists [PoW]
-						WFIFOHEAD(fd,len);
-						memcpy(WFIFOP(fd,0), buf, len);
-						WFIFOSET(fd,len);
+						clif_send_buffer(fd, buf, len);
 					}
 				}
 			}
@@ -556,9 +571,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 					if( (type == PARTY_AREA || type == PARTY_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 						continue;
 
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					clif_send_buffer(fd, buf, len);
 				}
 				if (!map->enable_spy) //Skip unnecessary parsing. [Skotlex]
 					break;
@@ -566,9 +579,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				iter = mapit_getallusers();
 				while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
 					if( tsd->partyspy == p->party.party_id ) {
-						WFIFOHEAD(tsd->fd, len);
-						memcpy(WFIFOP(tsd->fd,0), buf, len);
-						WFIFOSET(tsd->fd,len);
+						clif_send_buffer(tsd->fd, buf, len);
 					}
 				}
 				mapit->free(iter);
@@ -584,9 +595,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				if( type == DUEL_WOS && bl->id == tsd->bl.id )
 					continue;
 				if( sd->duel_group == tsd->duel_group ) {
-					WFIFOHEAD(tsd->fd, len);
-					memcpy(WFIFOP(tsd->fd,0), buf, len);
-					WFIFOSET(tsd->fd,len);
+					clif_send_buffer(tsd->fd, buf, len);
 				}
 			}
 			mapit->free(iter);
@@ -594,9 +603,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 
 		case SELF:
 			if (sd && (fd=sd->fd) != 0) {
-				WFIFOHEAD(fd,len);
-				memcpy(WFIFOP(fd,0), buf, len);
-				WFIFOSET(fd,len);
+				clif_send_buffer(fd, buf, len);
 			}
 			break;
 
@@ -634,9 +641,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 
 						if( (type == GUILD_AREA || type == GUILD_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 							continue;
-						WFIFOHEAD(fd,len);
-						memcpy(WFIFOP(fd,0), buf, len);
-						WFIFOSET(fd,len);
+						clif_send_buffer(fd, buf, len);
 					}
 				}
 				if (!map->enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -645,9 +650,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				iter = mapit_getallusers();
 				while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
 					if( tsd->guildspy == g->guild_id ) {
-						WFIFOHEAD(tsd->fd, len);
-						memcpy(WFIFOP(tsd->fd,0), buf, len);
-						WFIFOSET(tsd->fd,len);
+						clif_send_buffer(tsd->fd, buf, len);
 					}
 				}
 				mapit->free(iter);
@@ -676,9 +679,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 						continue;
 					if( (type == BG_AREA || type == BG_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 						continue;
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					clif_send_buffer(fd, buf, len);
 				}
 			}
 			break;
@@ -691,9 +692,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 					struct map_session_data *qsd = map->id2sd(VECTOR_INDEX(queue->entries, i));
 
 					if (qsd != NULL) {
-						WFIFOHEAD(qsd->fd,len);
-						memcpy(WFIFOP(qsd->fd,0), buf, len);
-						WFIFOSET(qsd->fd,len);
+						clif_send_buffer(qsd->fd, buf, len);
 					}
 				}
 			}
@@ -708,9 +707,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				for (i = 0; i < VECTOR_LENGTH(c->members); i++) {
 					if (VECTOR_INDEX(c->members, i).online == 0 || (sd = VECTOR_INDEX(c->members, i).sd) == NULL || (fd = sd->fd) <= 0)
 						continue;
-					WFIFOHEAD(fd, len);
-					memcpy(WFIFOP(fd, 0), buf, len);
-					WFIFOSET(fd, len);
+					clif_send_buffer(fd, buf, len);
 				}
 			}
 			break;
@@ -723,6 +720,25 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 	return true;
 }
 
+static bool clif_send(const void *buf, int len, struct block_list *bl, enum send_target type)
+{
+	struct clif_send_shared outer = send_shared; // clif_send nests (AREA first sends to SELF)
+	bool ret;
+
+	send_shared.buf = buf;
+	send_shared.len = len;
+	send_shared.count = 0;
+	send_shared.sbuf = NULL;
+
+	ret = clif_send_targets(buf, len, bl, type);
+
+	// each recipient holds its own reference now
+	if (send_shared.sbuf != NULL)
+		sockt->shared_release(send_shared.sbuf);
+	send_shared = outer;
+	return ret;
+}
+
 /// Notifies the client, that it's connection attempt was accepted.
 /// 0073 <start time>.L <position>.3B <x size>.B <y size>.B (ZC_ACCEPT_ENTER)
 /// 02eb <start time>.L <position>.3B <x size>.B <y size>.B <font>.W (ZC_ACCEPT_ENTER2)
@@ -1563,11 +1579,9 @@ static void clif_weather(int16 m)
 	struct s_mapiterator* iter;
 	struct map_session_data *sd=NULL;
 
-	iter = mapit_getallusers();
-	for (sd = BL_UCAST(BL_PC, mapit->first(iter)); mapit->exists(iter); sd = BL_UCAST(BL_PC, mapit->next(iter))) {
-		if( sd->bl.m == m )
-			clif->weather_check(sd);
-	}
+	iter = mapit_getmapusers(m);
+	for (sd = BL_UCAST(BL_PC, mapit->first(iter)); mapit->exists(iter); sd = BL_UCAST(BL_PC, mapit->next(iter)))
+		clif->weather_check(sd);
 	mapit->free(iter);
 }
 
@@ -11256,8 +11270,11 @@ static void clif_parse_LoadEndAck(int fd, struct map_session_data *sd)
 	if (battle_config.pc_invincible_time > 0)
 		pc->setinvincibletimer(sd, battle_config.pc_invincible_time);
 
-	if (map->list[sd->bl.m].users++ == 0 && battle_config.dynamic_mobs != 0)
-		map->spawnmobs(sd->bl.m);
+	if (map->list[sd->bl.m].users++ == 0) {
+		map->wakeup(sd->bl.m);
+		if (battle_config.dynamic_mobs != 0)
+			map->spawnmobs(sd->bl.m);
+	}
 
 	if (map->list[sd->bl.m].instance_id >= 0) {
 		instance->list[map->list[sd->bl.m].instance_id].users++;
@@ -25950,6 +25967,185 @@ static void clif_parse_adventuterAgencyJoinResult(int fd, struct map_session_dat
 #endif
 }
 
+/*==========================================
+ * Packet profiling
+ *------------------------------------------
+ * While enabled, counts the packets and bytes received per opcode and the
+ * time spent in their handlers, and the packets and bytes sent per opcode.
+ */
+
+struct packet_profile_in {
+	uint64 bytes;
+	struct duration_histogram handler; ///< handler times
+};
+
+struct packet_profile_out {
+	uint64 count, bytes;
+};
+
+static struct packet_profile_in *packet_profile_in = NULL;   ///< MAX_PACKET_DB + 1 entries while profiling
+static struct packet_profile_out *packet_profile_out = NULL; ///< UINT16_MAX + 1 entries while profiling
+static int64 packet_profile_start;
+
+/// Accounts a packet sent to a client (socket on_packet_sent callback).
+static void clif_packet_profile_sent(int fd, const uint8 *data, size_t len)
+{
+	struct packet_profile_out *entry;
+
+	if (packet_profile_out == NULL || len < 2)
+		return;
+	entry = &packet_profile_out[RBUFW(data, 0)];
+	entry->count++;
+	entry->bytes += len;
+}
+
+/// Accounts a received packet and the time its handler took.
+static void clif_packet_profile_received(int cmd, int len, int64 duration)
+{
+	struct packet_profile_in *entry;
+
+	if (packet_profile_in == NULL || cmd < 0 || cmd > MAX_PACKET_DB)
+		return;
+
+	entry = &packet_profile_in[cmd];
+	entry->bytes += len;
+	duration_histogram_record(&entry->handler, duration);
+}
+
+/// Sends a line of the profiling report to the console (fd 0) or to a player.
+static void clif_packet_profile_output(int fd, const char *line)
+{
+	if (fd == 0)
+		ShowMessage("%s\n", line);
+	else
+		clif->message(fd, line);
+}
+
+static int clif_packet_profile_compare_in(const void *a, const void *b)
+{
+	const struct packet_profile_in *ea = &packet_profile_in[*(const int *)a];
+	const struct packet_profile_in *eb = &packet_profile_in[*(const int *)b];
+
+	if (ea->handler.total_us != eb->handler.total_us)
+		return (ea->handler.total_us < eb->handler.total_us) ? 1 : -1;
+	return 0;
+}
+
+static int clif_packet_profile_compare_out(const void *a, const void *b)
+{
+	const struct packet_profile_out *ea = &packet_profile_out[*(const int *)a];
+	const struct packet_profile_out *eb = &packet_profile_out[*(const int *)b];
+
+	if (ea->bytes != eb->bytes)
+		return (ea->bytes < eb->bytes) ? 1 : -1;
+	return 0;
+}
+
+/**
+ * Shows the most expensive received packets (by handler time) and the
+ * biggest sent packets (by bytes).
+ *
+ * @param fd    Session to send the report to, 0 for the console.
+ * @param limit Maximum number of opcodes listed in each table.
+ */
+static void clif_packet_profile_report(int fd, int limit)
+{
+	char line[CHAT_SIZE_MAX];
+	int *list;
+	int count = 0, i;
+
+	if (packet_profile_in == NULL) {
+		clif_packet_profile_output(fd, "Packet profiling is disabled.");
+		return;
+	}
+
+	CREATE(list, int, UINT16_MAX + 1);
+
+	snprintf(line, sizeof(line), "Packet profiling over the last %.1f seconds, received:",
+	         (double)(timer->gettick_us() - packet_profile_start) / 1000000);
+	clif_packet_profile_output(fd, line);
+	snprintf(line, sizeof(line), "%-8s %10s %12s %10s %8s %8s %8s %8s", "opcode", "count", "bytes", "total ms", "min us", "avg us", "max us", "p99 us");
+	clif_packet_profile_output(fd, line);
+	for (i = 0; i <= MAX_PACKET_DB; i++) {
+		if (packet_profile_in[i].handler.count != 0)
+			list[count++] = i;
+	}
+	qsort(list, count, sizeof(*list), clif_packet_profile_compare_in);
+	for (i = 0; i < count && i < limit; i++) {
+		const struct duration_histogram *handler = &packet_profile_in[list[i]].handler;
+
+		snprintf(line, sizeof(line), "0x%04x   %10"PRIu64" %12"PRIu64" %10.3f %8"PRId64" %8"PRId64" %8"PRId64" %8"PRId64,
+		         (unsigned int)list[i], handler->count, packet_profile_in[list[i]].bytes, (double)handler->total_us / 1000,
+		         handler->min_us, handler->total_us / (int64)handler->count, handler->max_us,
+		         duration_histogram_percentile(handler, 990));
+		clif_packet_profile_output(fd, line);
+	}
+
+	clif_packet_profile_output(fd, "Sent:");
+	snprintf(line, sizeof(line), "%-8s %10s %12s", "opcode", "count", "bytes");
+	clif_packet_profile_output(fd, line);
+	count = 0;
+	for (i = 0; i <= UINT16_MAX; i++) {
+		if (packet_profile_out[i].count != 0)
+			list[count++] = i;
+	}
+	qsort(list, count, sizeof(*list), clif_packet_profile_compare_out);
+	for (i = 0; i < count && i < limit; i++) {
+		snprintf(line, sizeof(line), "0x%04x   %10"PRIu64" %12"PRIu64, (unsigned int)list[i],
+		         packet_profile_out[list[i]].count, packet_profile_out[list[i]].bytes);
+		clif_packet_profile_output(fd, line);
+	}
+
+	aFree(list);
+}
+
+/// Stops profiling and discards the collected data.
+static void clif_packet_profile_stop(void)
+{
+	if (packet_profile_in == NULL)
+		return;
+
+	sockt->on_packet_sent = NULL;
+	aFree(packet_profile_in);
+	aFree(packet_profile_out);
+	packet_profile_in = NULL;
+	packet_profile_out = NULL;
+}
+
+/**
+ * Handles the packet profiling console command and atcommand.
+ * Arguments: none to show the report, "on", "off" or "reset".
+ *
+ * @param fd   Session that issued the command, 0 for the console.
+ * @param args Command arguments.
+ */
+static void clif_packet_profile(int fd, const char *args)
+{
+	if (args == NULL || *args == '\0') {
+		clif_packet_profile_report(fd, fd == 0 ? 40 : 15);
+	} else if (strcmpi(args, "on") == 0) {
+		if (packet_profile_in == NULL) {
+			CREATE(packet_profile_in, struct packet_profile_in, MAX_PACKET_DB + 1);
+			CREATE(packet_profile_out, struct packet_profile_out, UINT16_MAX + 1);
+			packet_profile_start = timer->gettick_us();
+			sockt->on_packet_sent = clif_packet_profile_sent;
+		}
+		clif_packet_profile_output(fd, "Packet profiling enabled.");
+	} else if (strcmpi(args, "off") == 0) {
+		clif_packet_profile_stop();
+		clif_packet_profile_output(fd, "Packet profiling disabled.");
+	} else if (strcmpi(args, "reset") == 0) {
+		if (packet_profile_in != NULL) {
+			memset(packet_profile_in, 0, (MAX_PACKET_DB + 1) * sizeof(*packet_profile_in));
+			memset(packet_profile_out, 0, (UINT16_MAX + 1) * sizeof(*packet_profile_out));
+			packet_profile_start = timer->gettick_us();
+		}
+		clif_packet_profile_output(fd, "Packet profiling data discarded.");
+	} else {
+		clif_packet_profile_output(fd, "Usage: packet_profile [on|off|reset]");
+	}
+}
+
 /*==========================================
  * Main client packet processing function
  *------------------------------------------*/
@@ -25964,6 +26160,7 @@ static int clif_parse(int fd)
 
 	for( pnum = 0; pnum < 3; ++pnum ) { // Limit max packets per cycle to 3 (delay packet spammers) [FlavioJS]  -- This actually aids packet spammers, but stuff like /str+ gets slow without it [Ai4rei]
 		unsigned short (*parse_cmd_func)(int fd, struct map_session_data *sd);
+		int64 profile_start;
 		// begin main client packet processing loop
 
 		sd = sockt->session[fd]->session_data;
@@ -26054,6 +26251,8 @@ static int clif_parse(int fd)
 			}
 		}
 
+		profile_start = (packet_profile_in != NULL) ? timer->gettick_us() : 0;
+
 		if( packet_db[cmd].func == clif->pDebug )
 			packet_db[cmd].func(fd, sd);
 		else if( packet_db[cmd].func != NULL ) {
@@ -26097,7 +26296,11 @@ static int clif_parse(int fd)
 #endif
 		}
 
+		if (profile_start != 0)
+			clif_packet_profile_received(cmd, packet_len, timer->gettick_us() - profile_start);
+
 		RFIFOSKIP(fd, packet_len);
+		clif->cmd = -1;
 
 	}; // main loop end
 
@@ -26244,6 +26447,8 @@ static void do_final_clif(void)
 {
 	unsigned char i;
 
+	clif_packet_profile_stop();
+
 	ers_destroy(clif->delay_clearunit_ers);
 	ers_destroy(clif->delayed_damage_ers);
 
@@ -26287,6 +26492,7 @@ void clif_defaults(void)
 	clif->parse_cmd = clif_parse_cmd_optional;
 	clif->decrypt_cmd = clif_decrypt_cmd;
 	clif->packet = clif_packet;
+	clif->packet_profile = clif_packet_profile;
 	/* auth */
 	clif->authok = clif_authok;
 	clif->auth_error = clif_auth_error;
@@ -958,6 +958,7 @@ struct clif_interface {
 	int (*send_actual) (int fd, void *buf, int len);
 	int (*parse) (int fd);
 	const struct s_packet_db *(*packet) (int packet_id);
+	void (*packet_profile) (int fd, const char *args);
 	unsigned short (*parse_cmd) ( int fd, struct map_session_data *sd );
 	unsigned short (*decrypt_cmd) ( int cmd, struct map_session_data *sd );
 	/* auth */
@@ -261,12 +261,20 @@ static int instance_add_map(const char *name, int instance_id, bool usebasename,
 	size = map->list[im].bxs * map->list[im].bys * sizeof(struct block_list*);
 	map->list[im].block = (struct block_list**)aCalloc(size, 1);
 	map->list[im].block_mob = (struct block_list**)aCalloc(size, 1);
+	map->list[im].pc_list = NULL;
+	map->list[im].block_pcs = NULL;
+	map->list[im].active_blocks = NULL;
+	map->list[im].active_block_pos = NULL;
+	map->list[im].active_block_count = 0;
 
 	memset(map->list[im].npc, 0x00, sizeof(map->list[i].npc));
 	map->list[im].npc_num = 0;
 
 	memset(map->list[im].moblist, 0x00, sizeof(map->list[im].moblist));
 	map->list[im].mob_delete_timer = INVALID_TIMER;
+	map->list[im].dormant_timer = INVALID_TIMER;
+	map->list[im].dormant = false;
+	VECTOR_INIT(map->list[im].dormant_spawns);
 
 	//Mimic unit
 	if( map->list[m].unit_count ) {
@@ -493,6 +501,8 @@ static void instance_del_map(int16 m)
 
 	if( map->list[m].mob_delete_timer != INVALID_TIMER )
 		timer->delete(map->list[m].mob_delete_timer, map->removemobs_timer);
+	if (map->list[m].dormant_timer != INVALID_TIMER)
+		timer->delete(map->list[m].dormant_timer, map->sleep_timer);
 
 	mapindex->removemap(map_id2index(m));
 
@@ -500,6 +510,11 @@ static void instance_del_map(int16 m)
 	aFree(map->list[m].cell);
 	aFree(map->list[m].block);
 	aFree(map->list[m].block_mob);
+	if (map->list[m].block_pcs != NULL) {
+		aFree(map->list[m].block_pcs);
+		aFree(map->list[m].active_blocks);
+		aFree(map->list[m].active_block_pos);
+	}
 
 	if (map->list[m].unit_count && map->list[m].units) {
 		for(i = 0; i < map->list[m].unit_count; i++) {
@@ -523,6 +538,7 @@ static void instance_del_map(int16 m)
 	}
 
 	VECTOR_CLEAR(map->list[m].qi_list);
+	VECTOR_CLEAR(map->list[m].dormant_spawns);
 
 	// Remove from instance
 	for( i = 0; i < instance->list[map->list[m].instance_id].num_map; i++ ) {
@@ -547,6 +563,7 @@ static void instance_del_map(int16 m)
 	map->list[m].name[0] = 0;
 	map->list[m].instance_id = -1;
 	map->list[m].mob_delete_timer = INVALID_TIMER;
+	map->list[m].dormant_timer = INVALID_TIMER;
 }
 
 /*--------------------------------------
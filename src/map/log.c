@@ -34,6 +34,8 @@
 #include "common/sql.h" // SQL_INNODB
 #include "common/strlib.h"
 #include "common/HPM.h"
+#include "common/timer.h"
+#include "common/utils.h" // cap_value
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,6 +44,28 @@
 static struct log_interface log_s;
 struct log_interface *logs;
 
+/// Maximum length of a batch query, kept well under the default max_allowed_packet.
+#define LOG_SQL_BATCH_MAX_LENGTH (512 * 1024)
+
+/// Rows waiting to be written to a log table
+struct log_sql_batch {
+	StringBuf query; ///< INSERT query being built
+	int count;       ///< Number of rows in the query
+};
+
+static struct log_sql_batch log_sql_batches[LOG_SQL_MAX];
+static int log_sql_flush_tid = INVALID_TIMER;
+
+/// Batched writer statistics
+static struct {
+	uint64 entries;  ///< Rows logged
+	uint64 batches;  ///< Queries submitted
+	uint64 bytes;    ///< Total length of the submitted queries
+	uint64 failed;   ///< Queries that failed
+	uint64 waits;    ///< Times the main thread had to wait for the writer to catch up
+	int max_pending; ///< Highest number of queries in flight
+} log_sql_stats;
+
 /// obtain log type character for item/zeny logs
 static char log_picktype2char(e_log_pick_type type)
 {
@@ -137,21 +161,174 @@ static bool should_log_item(int nameid, int amount, int refine_level, struct ite
 
 	return false;
 }
-static void log_branch_sub_sql(struct map_session_data *sd)
+/// Returns the table name and columns of a batched log table.
+static const char *log_sql_table(enum log_sql_table table, const char **columns)
 {
-	struct SqlStmt *stmt;
+	switch (table) {
+	case LOG_SQL_BRANCH:
+		*columns = "`branch_date`, `account_id`, `char_id`, `char_name`, `map`";
+		return logs->config.log_branch;
+	case LOG_SQL_PICK:
+		*columns = "`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `grade`, `card0`, `card1`, `card2`, `card3`, "
+			"`opt_idx0`, `opt_val0`, `opt_idx1`, `opt_val1`, `opt_idx2`, `opt_val2`, `opt_idx3`, `opt_val3`, `opt_idx4`, `opt_val4`, `map`, `unique_id`";
+		return logs->config.log_pick;
+	case LOG_SQL_ZENY:
+		*columns = "`time`, `char_id`, `src_id`, `type`, `amount`, `map`";
+		return logs->config.log_zeny;
+	case LOG_SQL_MVPDROP:
+		*columns = "`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`";
+		return logs->config.log_mvpdrop;
+	case LOG_SQL_ATCOMMAND:
+		*columns = "`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`";
+		return logs->config.log_gm;
+	case LOG_SQL_NPC:
+		*columns = "`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`";
+		return logs->config.log_npc;
+	case LOG_SQL_CHAT:
+		*columns = "`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`";
+		return logs->config.log_chat;
+	case LOG_SQL_MAX:
+		break;
+	}
+	*columns = NULL;
+	return NULL;
+}
 
-	nullpo_retv(sd);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if( SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`branch_date`, `account_id`, `char_id`, `char_name`, `map`) VALUES (NOW(), '%d', '%d', ?, '%s')", logs->config.log_branch, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-	   ||  SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-	   ||  SQL_SUCCESS != SQL->StmtExecute(stmt) )
-	{
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
+/// Appends a quoted, escaped string to a log row.
+static void log_sql_escape(StringBuf *row, const char *str, size_t len)
+{
+	char esc_str[CHAT_SIZE_MAX * 2 + 1];
+
+	len = min(len, CHAT_SIZE_MAX);
+	SQL->EscapeStringLen(logs->mysql_handle, esc_str, str, len);
+	StrBuf->Printf(row, "'%s'", esc_str);
+}
+
+/// Completion of a batch query.
+static void log_sql_batch_done(struct Sql *result, int result_status, void *data)
+{
+	if (result_status != SQL_SUCCESS)
+		log_sql_stats.failed++;
+}
+
+/**
+ * Submits the rows waiting to be written to a log table.
+ *
+ * If too many queries are already in flight, waits for the writer to catch
+ * up first (log entries are never dropped).
+ *
+ * @param table The log table.
+ */
+static void log_sql_flush_table(enum log_sql_table table)
+{
+	struct log_sql_batch *batch;
+	int pending;
+
+	Assert_retv(table >= 0 && table < LOG_SQL_MAX);
+	batch = &log_sql_batches[table];
+	if (batch->count == 0)
+		return;
+
+	if (SQL->AsyncPending(logs->async_pool) >= logs->config.batch_max_pending) {
+		log_sql_stats.waits++;
+		SQL->AsyncFlush(logs->async_pool);
+	}
+
+	SQL->AsyncQueryStr(logs->async_pool, table, log_sql_batch_done, NULL, StrBuf->Value(&batch->query));
+	log_sql_stats.batches++;
+	log_sql_stats.bytes += StrBuf->Length(&batch->query);
+	if ((pending = SQL->AsyncPending(logs->async_pool)) > log_sql_stats.max_pending)
+		log_sql_stats.max_pending = pending;
+
+	StrBuf->Clear(&batch->query);
+	batch->count = 0;
+}
+
+/// Submits the rows waiting to be written to all the log tables.
+static void log_sql_flush(void)
+{
+	int i;
+
+	if (logs->async_pool == NULL)
+		return;
+	for (i = 0; i < LOG_SQL_MAX; i++)
+		log_sql_flush_table(i);
+}
+
+/// Timer submitting the log rows waiting for longer than batch_interval.
+static int log_sql_flush_timer(int tid, int64 tick, int id, intptr_t data)
+{
+	logs->sql_flush();
+	return 0;
+}
+
+/**
+ * Writes a row to a log table.
+ *
+ * The row is added to the batch of the table, written in the background
+ * once it reaches batch_size rows or every batch_interval milliseconds.
+ * Without batching, the row is inserted right away.
+ *
+ * @param table The log table.
+ * @param row   The values of the row, in parentheses, escaped.
+ */
+static void log_sql_append(enum log_sql_table table, const char *row)
+{
+	struct log_sql_batch *batch;
+	const char *columns = NULL;
+	const char *table_name;
+
+	nullpo_retv(row);
+	Assert_retv(table >= 0 && table < LOG_SQL_MAX);
+	table_name = log_sql_table(table, &columns);
+
+	if (logs->async_pool == NULL) {
+		if (SQL_ERROR == SQL->Query(logs->mysql_handle, LOG_QUERY " INTO `%s` (%s) VALUES %s", table_name, columns, row))
+			Sql_ShowDebug(logs->mysql_handle);
 		return;
 	}
-	SQL->StmtFree(stmt);
+
+	batch = &log_sql_batches[table];
+	if (batch->count == 0)
+		StrBuf->Printf(&batch->query, LOG_QUERY " INTO `%s` (%s) VALUES %s", table_name, columns, row);
+	else
+		StrBuf->Printf(&batch->query, ", %s", row);
+	batch->count++;
+	log_sql_stats.entries++;
+
+	if (batch->count >= logs->config.batch_size || StrBuf->Length(&batch->query) >= LOG_SQL_BATCH_MAX_LENGTH)
+		log_sql_flush_table(table);
+}
+
+/// Shows the batched writer statistics.
+static void log_sql_report(void)
+{
+	int i, buffered = 0;
+
+	if (logs->async_pool == NULL) {
+		ShowInfo("Log batching is disabled.\n");
+		return;
+	}
+	for (i = 0; i < LOG_SQL_MAX; i++)
+		buffered += log_sql_batches[i].count;
+
+	ShowInfo("Log writer: %"PRIu64" rows in %"PRIu64" queries (%"PRIu64" KB), %"PRIu64" failed.\n",
+	         log_sql_stats.entries, log_sql_stats.batches, log_sql_stats.bytes / 1024, log_sql_stats.failed);
+	ShowInfo("Log writer: %d rows buffered, %d queries in flight (max %d), main thread waited %"PRIu64" times.\n",
+	         buffered, SQL->AsyncPending(logs->async_pool), log_sql_stats.max_pending, log_sql_stats.waits);
+}
+
+static void log_branch_sub_sql(struct map_session_data *sd)
+{
+	StringBuf row;
+
+	nullpo_retv(sd);
+	StrBuf->Init(&row);
+	StrBuf->Printf(&row, "(FROM_UNIXTIME(%"PRId64"), '%d', '%d', ", (int64)time(NULL), sd->status.account_id, sd->status.char_id);
+	log_sql_escape(&row, sd->status.name, strnlen(sd->status.name, NAME_LENGTH));
+	StrBuf->Printf(&row, ", '%s')", mapindex_id2name(sd->mapindex));
+	logs->sql_append(LOG_SQL_BRANCH, StrBuf->Value(&row));
+	StrBuf->Destroy(&row);
 }
 static void log_branch_sub_txt(struct map_session_data *sd)
 {
@@ -180,19 +357,17 @@ static void log_branch(struct map_session_data *sd)
 }
 static void log_pick_sub_sql(int id, int16 m, e_log_pick_type type, int amount, struct item *itm, struct item_data *data)
 {
+	StringBuf row;
+
 	nullpo_retv(itm);
-	if (SQL_ERROR == SQL->Query(logs->mysql_handle,
-	    LOG_QUERY " INTO `%s` (`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `grade`, `card0`, `card1`, `card2`, `card3`, "
-		"`opt_idx0`, `opt_val0`, `opt_idx1`, `opt_val1`, `opt_idx2`, `opt_val2`, `opt_idx3`, `opt_val3`, `opt_idx4`, `opt_val4`, `map`, `unique_id`) "
-	    "VALUES (NOW(), '%d', '%c', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%s', '%"PRIu64"')",
-	    logs->config.log_pick, id, logs->picktype2char(type), itm->nameid, amount, itm->refine, itm->grade, itm->card[0], itm->card[1], itm->card[2], itm->card[3],
+	StrBuf->Init(&row);
+	StrBuf->Printf(&row, "(FROM_UNIXTIME(%"PRId64"), '%d', '%c', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%s', '%"PRIu64"')",
+	    (int64)time(NULL), id, logs->picktype2char(type), itm->nameid, amount, itm->refine, itm->grade, itm->card[0], itm->card[1], itm->card[2], itm->card[3],
 		itm->option[0].index, itm->option[0].value, itm->option[1].index, itm->option[1].value, itm->option[2].index, itm->option[2].value,
 		itm->option[3].index, itm->option[3].value, itm->option[4].index, itm->option[4].value,
-	    map->list[m].name, itm->unique_id))
-	{
-		Sql_ShowDebug(logs->mysql_handle);
-		return;
-	}
+	    map->list[m].name, itm->unique_id);
+	logs->sql_append(LOG_SQL_PICK, StrBuf->Value(&row));
+	StrBuf->Destroy(&row);
 }
 static void log_pick_sub_txt(int id, int16 m, e_log_pick_type type, int amount, struct item *itm, struct item_data *data)
 {
@@ -241,14 +416,13 @@ static void log_pick_mob(struct mob_data *md, e_log_pick_type type, int amount,
 }
 static void log_zeny_sub_sql(struct map_session_data *sd, e_log_pick_type type, struct map_session_data *src_sd, int amount)
 {
+	char row[256];
+
 	nullpo_retv(sd);
 	nullpo_retv(src_sd);
-	if( SQL_ERROR == SQL->Query(logs->mysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `src_id`, `type`, `amount`, `map`) VALUES (NOW(), '%d', '%d', '%c', '%d', '%s')",
-							   logs->config.log_zeny, sd->status.char_id, src_sd->status.char_id, logs->picktype2char(type), amount, mapindex_id2name(sd->mapindex)) )
-	{
-		Sql_ShowDebug(logs->mysql_handle);
-		return;
-	}
+	snprintf(row, sizeof(row), "(FROM_UNIXTIME(%"PRId64"), '%d', '%d', '%c', '%d', '%s')",
+	         (int64)time(NULL), sd->status.char_id, src_sd->status.char_id, logs->picktype2char(type), amount, mapindex_id2name(sd->mapindex));
+	logs->sql_append(LOG_SQL_ZENY, row);
 }
 static void log_zeny_sub_txt(struct map_session_data *sd, e_log_pick_type type, struct map_session_data *src_sd, int amount)
 {
@@ -277,14 +451,13 @@ static void log_zeny(struct map_session_data *sd, e_log_pick_type type, struct m
 }
 static void log_mvpdrop_sub_sql(struct map_session_data *sd, int monster_id, int *log_mvp)
 {
+	char row[256];
+
 	nullpo_retv(sd);
 	nullpo_retv(log_mvp);
-	if( SQL_ERROR == SQL->Query(logs->mysql_handle, LOG_QUERY " INTO `%s` (`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`) VALUES (NOW(), '%d', '%d', '%d', '%d', '%s') ",
-							   logs->config.log_mvpdrop, sd->status.char_id, monster_id, log_mvp[0], log_mvp[1], mapindex_id2name(sd->mapindex)) )
-	{
-		Sql_ShowDebug(logs->mysql_handle);
-		return;
-	}
+	snprintf(row, sizeof(row), "(FROM_UNIXTIME(%"PRId64"), '%d', '%d', '%d', '%d', '%s')",
+	         (int64)time(NULL), sd->status.char_id, monster_id, log_mvp[0], log_mvp[1], mapindex_id2name(sd->mapindex));
+	logs->sql_append(LOG_SQL_MVPDROP, row);
 }
 static void log_mvpdrop_sub_txt(struct map_session_data *sd, int monster_id, int *log_mvp)
 {
@@ -314,21 +487,18 @@ static void log_mvpdrop(struct map_session_data *sd, int monster_id, int *log_mv
 
 static void log_atcommand_sub_sql(struct map_session_data *sd, const char *message)
 {
-	struct SqlStmt *stmt;
+	StringBuf row;
 
 	nullpo_retv(sd);
 	nullpo_retv(message);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if( SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", logs->config.log_gm, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-	   ||  SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-	   ||  SQL_SUCCESS != SQL->StmtBindParam(stmt, 1, SQLDT_STRING, message, safestrnlen(message, 255))
-	   ||  SQL_SUCCESS != SQL->StmtExecute(stmt) )
-	{
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
-		return;
-	}
-	SQL->StmtFree(stmt);
+	StrBuf->Init(&row);
+	StrBuf->Printf(&row, "(FROM_UNIXTIME(%"PRId64"), '%d', '%d', ", (int64)time(NULL), sd->status.account_id, sd->status.char_id);
+	log_sql_escape(&row, sd->status.name, strnlen(sd->status.name, NAME_LENGTH));
+	StrBuf->Printf(&row, ", '%s', ", mapindex_id2name(sd->mapindex));
+	log_sql_escape(&row, message, safestrnlen(message, 255));
+	StrBuf->AppendStr(&row, ")");
+	logs->sql_append(LOG_SQL_ATCOMMAND, StrBuf->Value(&row));
+	StrBuf->Destroy(&row);
 }
 static void log_atcommand_sub_txt(struct map_session_data *sd, const char *message)
 {
@@ -359,21 +529,18 @@ static void log_atcommand(struct map_session_data *sd, const char *message)
 
 static void log_npc_sub_sql(struct map_session_data *sd, const char *message)
 {
-	struct SqlStmt *stmt;
+	StringBuf row;
 
 	nullpo_retv(sd);
 	nullpo_retv(message);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if (SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", logs->config.log_npc, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 1, SQLDT_STRING, message, safestrnlen(message, 255))
-	 || SQL_SUCCESS != SQL->StmtExecute(stmt)
-	) {
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
-		return;
-	}
-	SQL->StmtFree(stmt);
+	StrBuf->Init(&row);
+	StrBuf->Printf(&row, "(FROM_UNIXTIME(%"PRId64"), '%d', '%d', ", (int64)time(NULL), sd->status.account_id, sd->status.char_id);
+	log_sql_escape(&row, sd->status.name, strnlen(sd->status.name, NAME_LENGTH));
+	StrBuf->Printf(&row, ", '%s', ", mapindex_id2name(sd->mapindex));
+	log_sql_escape(&row, message, safestrnlen(message, 255));
+	StrBuf->AppendStr(&row, ")");
+	logs->sql_append(LOG_SQL_NPC, StrBuf->Value(&row));
+	StrBuf->Destroy(&row);
 }
 static void log_npc_sub_txt(struct map_session_data *sd, const char *message)
 {
@@ -416,21 +583,19 @@ static void log_npc(struct map_session_data *sd, const char *message)
  */
 static void log_chat_sub_sql(e_log_chat_type type, int type_id, int src_charid, int src_accid, const char *mapname, int x, int y, const char *dst_charname, const char *message)
 {
-	struct SqlStmt* stmt;
+	StringBuf row;
 
 	nullpo_retv(dst_charname);
 	nullpo_retv(message);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if( SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`) VALUES (NOW(), '%c', '%d', '%d', '%d', '%s', '%d', '%d', ?, ?)", logs->config.log_chat, logs->chattype2char(type), type_id, src_charid, src_accid, mapname, x, y)
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, dst_charname, safestrnlen(dst_charname, NAME_LENGTH))
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 1, SQLDT_STRING, message, safestrnlen(message, CHAT_SIZE_MAX))
-	 || SQL_SUCCESS != SQL->StmtExecute(stmt)
-	) {
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
-		return;
-	}
-	SQL->StmtFree(stmt);
+	StrBuf->Init(&row);
+	StrBuf->Printf(&row, "(FROM_UNIXTIME(%"PRId64"), '%c', '%d', '%d', '%d', '%s', '%d', '%d', ",
+	               (int64)time(NULL), logs->chattype2char(type), type_id, src_charid, src_accid, mapname, x, y);
+	log_sql_escape(&row, dst_charname, safestrnlen(dst_charname, NAME_LENGTH));
+	StrBuf->AppendStr(&row, ", ");
+	log_sql_escape(&row, message, safestrnlen(message, CHAT_SIZE_MAX));
+	StrBuf->AppendStr(&row, ")");
+	logs->sql_append(LOG_SQL_CHAT, StrBuf->Value(&row));
+	StrBuf->Destroy(&row);
 }
 
 /**
@@ -507,9 +672,40 @@ static void log_sql_init(void)
 	if (map->default_codepage[0] != '\0')
 		if ( SQL_ERROR == SQL->SetEncoding(logs->mysql_handle, map->default_codepage) )
 			Sql_ShowDebug(logs->mysql_handle);
+
+	if (logs->config.batch_size > 1) {
+		int i;
+
+		if ((logs->async_pool = SQL->AsyncCreate(logs->mysql_handle, logs->config.batch_workers)) == NULL) {
+			ShowError("log_sql_init: failed to start the log writer, logging synchronously.\n");
+			return;
+		}
+		for (i = 0; i < LOG_SQL_MAX; i++) {
+			StrBuf->Init(&log_sql_batches[i].query);
+			log_sql_batches[i].count = 0;
+		}
+		memset(&log_sql_stats, 0, sizeof(log_sql_stats));
+		timer->add_func_list(log_sql_flush_timer, "log_sql_flush_timer");
+		log_sql_flush_tid = timer->add_interval(timer->gettick() + logs->config.batch_interval, log_sql_flush_timer, 0, 0, logs->config.batch_interval);
+		ShowStatus("Log writer started (%d rows per query, flushed every %d ms).\n", logs->config.batch_size, logs->config.batch_interval);
+	}
 }
 static void log_sql_final(void)
 {
+	if (logs->async_pool != NULL) {
+		int i;
+
+		logs->sql_flush();
+		SQL->AsyncFree(logs->async_pool); // waits for all the queries
+		logs->async_pool = NULL;
+		logs->sql_report();
+		for (i = 0; i < LOG_SQL_MAX; i++)
+			StrBuf->Destroy(&log_sql_batches[i].query);
+		if (log_sql_flush_tid != INVALID_TIMER) {
+			timer->delete(log_sql_flush_tid, log_sql_flush_timer);
+			log_sql_flush_tid = INVALID_TIMER;
+		}
+	}
 	ShowStatus("Close Log DB Connection....\n");
 	SQL->Free(logs->mysql_handle);
 	logs->mysql_handle = NULL;
@@ -528,6 +724,10 @@ static void log_set_defaults(void)
 
 	//map_log/database default values
 	logs->config.sql_logs = true;
+	logs->config.batch_size = 100;
+	logs->config.batch_interval = 1000;
+	logs->config.batch_workers = 1;
+	logs->config.batch_max_pending = 64;
 	// file/table names defaults are defined inside log_config_read_database
 
 	//map_log/filter/item default values
@@ -561,6 +761,13 @@ static bool log_config_read_database(const char *filename, struct config_t *conf
 		return false;
 	}
 	libconfig->setting_lookup_bool_real(setting, "use_sql", &logs->config.sql_logs);
+	libconfig->setting_lookup_int(setting, "batch_size", &logs->config.batch_size);
+	if (libconfig->setting_lookup_int(setting, "batch_interval", &logs->config.batch_interval) == CONFIG_TRUE)
+		logs->config.batch_interval = cap_value(logs->config.batch_interval, 10, 60000);
+	if (libconfig->setting_lookup_int(setting, "batch_workers", &logs->config.batch_workers) == CONFIG_TRUE)
+		logs->config.batch_workers = cap_value(logs->config.batch_workers, 1, 16);
+	if (libconfig->setting_lookup_int(setting, "batch_max_pending", &logs->config.batch_max_pending) == CONFIG_TRUE)
+		logs->config.batch_max_pending = max(logs->config.batch_max_pending, 1);
 
 	// map_log.database defaults are defined in order to not make unecessary calls to safestrncpy [Panikon]
 	if (libconfig->setting_lookup_mutable_string(setting, "log_branch_db",
@@ -789,6 +996,7 @@ void log_defaults(void)
 
 	logs->db_port = 3306;
 	logs->mysql_handle = NULL;
+	logs->async_pool = NULL;
 	/* */
 
 	logs->pick_pc = log_pick_pc;
@@ -813,6 +1021,9 @@ void log_defaults(void)
 	logs->config_done = log_config_complete;
 	logs->sql_init = log_sql_init;
 	logs->sql_final = log_sql_final;
+	logs->sql_append = log_sql_append;
+	logs->sql_flush = log_sql_flush;
+	logs->sql_report = log_sql_report;
 
 	logs->picktype2char = log_picktype2char;
 	logs->chattype2char = log_chattype2char;
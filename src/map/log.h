@@ -27,6 +27,7 @@
  * Declarations
  **/
 struct Sql; // common/sql.h
+struct SqlAsync; // common/sql.h
 struct item;
 struct item_data;
 struct map_session_data;
@@ -96,6 +97,18 @@ typedef enum e_log_pick_type {
 	LOG_TYPE_ALL              = 0xFFFFFFFF,
 } e_log_pick_type;
 
+/// log tables written through the batched writer
+enum log_sql_table {
+	LOG_SQL_BRANCH,
+	LOG_SQL_PICK,
+	LOG_SQL_ZENY,
+	LOG_SQL_MVPDROP,
+	LOG_SQL_ATCOMMAND,
+	LOG_SQL_NPC,
+	LOG_SQL_CHAT,
+	LOG_SQL_MAX
+};
+
 /// filters for item logging
 typedef enum e_log_filter {
 	LOG_FILTER_NONE     = 0x000,
@@ -119,6 +132,7 @@ struct log_interface {
 		e_log_pick_type enable_logs;
 		int filter;
 		bool sql_logs;
+		int batch_size, batch_interval, batch_workers, batch_max_pending;
 		bool log_chat_woe_disable;
 		int rare_items_log,refine_items_log,price_items_log,amount_items_log;
 		int zeny, chat;
@@ -132,6 +146,7 @@ struct log_interface {
 	char db_pw[100];
 	char db_name[32];
 	struct Sql *mysql_handle;
+	struct SqlAsync *async_pool; ///< Batched writer, NULL when logging synchronously
 	/* */
 	void (*pick_pc) (struct map_session_data* sd, e_log_pick_type type, int amount, struct item* itm, struct item_data *data);
 	void (*pick_mob) (struct mob_data* md, e_log_pick_type type, int amount, struct item* itm, struct item_data *data);
@@ -154,6 +169,9 @@ struct log_interface {
 	void (*config_done) (void);
 	void (*sql_init) (void);
 	void (*sql_final) (void);
+	void (*sql_append) (enum log_sql_table table, const char *row);
+	void (*sql_flush) (void);
+	void (*sql_report) (void);
 
 	char (*picktype2char) (e_log_pick_type type);
 	char (*chattype2char) (e_log_chat_type type);
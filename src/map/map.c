@@ -250,6 +250,59 @@ static void map_update_cell_bl(struct block_list *bl, bool increase)
 	return;
 }
 
+/**
+ * Updates the counters of players within mob activation range of the blocks
+ * around a player's block, and the list of the blocks that have any.
+ *
+ * The range is rounded up to whole blocks, so that the counters only change
+ * when a player changes blocks.
+ *
+ * @param m Map id
+ * @param pos Block of the player
+ * @param delta 1 when the player enters the block, -1 when they leave it
+ */
+static void map_update_block_pcs(int16 m, int pos, int delta)
+{
+	struct map_data *mapdata = &map->list[m];
+	int bx, by, x, y, range;
+
+	if (mapdata->block_pcs == NULL) {
+		int size = mapdata->bxs * mapdata->bys;
+		CREATE(mapdata->block_pcs, uint16, size);
+		CREATE(mapdata->active_blocks, int, size);
+		CREATE(mapdata->active_block_pos, int, size);
+		mapdata->active_block_count = 0;
+	}
+	if (delta > 0 && mapdata->active_block_count == 0) // all counters are 0, picks up area_size changes
+		mapdata->active_block_range = (AREA_SIZE + ACTIVE_AI_RANGE + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+	range = mapdata->active_block_range;
+	bx = pos % mapdata->bxs;
+	by = pos / mapdata->bxs;
+	for (y = max(by - range, 0); y <= min(by + range, mapdata->bys - 1); y++) {
+		for (x = max(bx - range, 0); x <= min(bx + range, mapdata->bxs - 1); x++) {
+			int b = x + y * mapdata->bxs;
+
+			if (delta > 0) {
+				if (mapdata->block_pcs[b]++ == 0) {
+					mapdata->active_blocks[mapdata->active_block_count++] = b;
+					mapdata->active_block_pos[b] = mapdata->active_block_count;
+				}
+			} else {
+				Assert_retv(mapdata->block_pcs[b] > 0);
+				if (--mapdata->block_pcs[b] == 0) {
+					int i = mapdata->active_block_pos[b] - 1;
+					int last = mapdata->active_blocks[--mapdata->active_block_count];
+
+					mapdata->active_blocks[i] = last;
+					mapdata->active_block_pos[last] = i + 1;
+					mapdata->active_block_pos[b] = 0;
+				}
+			}
+		}
+	}
+}
+
 /*==========================================
  * Adds a block to the map.
  * Returns 0 on success, 1 on failure (illegal coordinates).
@@ -294,6 +347,9 @@ static int map_addblock(struct block_list *bl)
 		map->list[m].block[pos] = bl;
 	}
 
+	if (bl->type == BL_PC)
+		map_update_block_pcs(m, pos, 1);
+
 #ifdef CELL_NOSTACK
 	map->update_cell_bl(bl, true);
 #endif
@@ -341,9 +397,57 @@ static int map_delblock(struct block_list *bl)
 	bl->next = NULL;
 	bl->prev = NULL;
 
+	if (bl->type == BL_PC)
+		map_update_block_pcs(bl->m, pos, -1);
+
 	return 0;
 }
 
+/**
+ * Links a player in the player list of its map (map_data::pc_list).
+ * Done as soon as the player is assigned to the map, before it's placed on
+ * the block grid, so that map-wide sends reach players still loading the map.
+ * @see map_delpclist
+ */
+static void map_addpclist(struct map_session_data *sd)
+{
+	int16 m;
+
+	nullpo_retv(sd);
+	m = sd->bl.m;
+	Assert_retv(m >= 0 && m < map->count);
+	if (sd->pc_list_m == m)
+		return;
+	map->delpclist(sd);
+
+	sd->map_prev = NULL;
+	sd->map_next = map->list[m].pc_list;
+	if (sd->map_next != NULL)
+		sd->map_next->map_prev = sd;
+	map->list[m].pc_list = sd;
+	sd->pc_list_m = m;
+}
+
+/**
+ * Unlinks a player from the player list of the map it was linked in, when it
+ * changes map or quits.
+ */
+static void map_delpclist(struct map_session_data *sd)
+{
+	nullpo_retv(sd);
+	if (sd->pc_list_m < 0)
+		return;
+
+	if (sd->map_prev != NULL)
+		sd->map_prev->map_next = sd->map_next;
+	else
+		map->list[sd->pc_list_m].pc_list = sd->map_next;
+	if (sd->map_next != NULL)
+		sd->map_next->map_prev = sd->map_prev;
+	sd->map_prev = sd->map_next = NULL;
+	sd->pc_list_m = -1;
+}
+
 /*==========================================
  * Moves a block a x/y target position. [Skotlex]
  * Pass flag as 1 to prevent doing skill->unit_move checks
@@ -630,7 +734,19 @@ static int map_vforeachinmap(int (*func)(struct block_list*, va_list), int16 m,
 	Assert_ret(m < map->count);
 	Assert_ret(map->list[m].block != NULL);
 
-	bsize = map->list[m].bxs * map->list[m].bys;
+	if (type == BL_PC) { // players are also kept in a per-map list, no need to scan the whole grid
+		struct map_session_data *sd;
+		for (sd = map->list[m].pc_list; sd != NULL; sd = sd->map_next) {
+			if (sd->bl.prev == NULL)
+				continue; // still loading the map, not on the grid yet
+			if (map->bl_list_count >= map->bl_list_size)
+				map_bl_list_expand();
+			map->bl_list[map->bl_list_count++] = &sd->bl;
+		}
+		bsize = 0;
+	} else {
+		bsize = map->list[m].bxs * map->list[m].bys;
+	}
 	for (i = 0; i < bsize; i++) {
 		if (type&~BL_MOB) {
 			for (bl = map->list[m].block[i]; bl != NULL; bl = bl->next) {
@@ -679,6 +795,60 @@ static int map_foreachinmap(int (*func)(struct block_list*, va_list), int16 m, i
 	return returnCount;
 }
 
+/**
+ * Applies func to every mob within activation range of a player, on all maps.
+ * Each mob is visited once however many players are around it.
+ * Returns the sum of values returned by func.
+ * @param func Function to be applied
+ * @param args Extra arguments for func
+ * @return Sum of the values returned by func
+ */
+static int map_vforeachactivemob(int (*func)(struct block_list*, va_list), va_list args)
+{
+	int returnCount;
+	int blockcount = map->bl_list_count;
+	va_list argscopy;
+
+	for (int m = 0; m < map->count; m++) {
+		const struct map_data *mapdata = &map->list[m];
+
+		for (int i = 0; i < mapdata->active_block_count; i++) {
+			struct block_list *bl;
+
+			for (bl = mapdata->block_mob[mapdata->active_blocks[i]]; bl != NULL; bl = bl->next) {
+				if (map->bl_list_count >= map->bl_list_size)
+					map_bl_list_expand();
+				map->bl_list[map->bl_list_count++] = bl;
+			}
+		}
+	}
+
+	va_copy(argscopy, args);
+	returnCount = bl_vforeach(func, blockcount, INT_MAX, argscopy);
+	va_end(argscopy);
+
+	return returnCount;
+}
+
+/**
+ * Applies func to every mob within activation range of a player, on all maps.
+ * @see map_vforeachactivemob
+ * @param func Function to be applied
+ * @param ... Extra arguments for func
+ * @return Sum of the values returned by func
+ */
+static int map_foreachactivemob(int (*func)(struct block_list*, va_list), ...)
+{
+	int returnCount;
+	va_list ap;
+
+	va_start(ap, func);
+	returnCount = map->vforeachactivemob(func, ap);
+	va_end(ap);
+
+	return returnCount;
+}
+
 static int map_forcountinmap(int (*func)(struct block_list*, va_list), int16 m, int count, int type, ...)
 {
 	int returnCount = 0;
@@ -2640,7 +2810,10 @@ static void map_foreachiddb(int (*func)(struct block_list *bl, va_list args), ..
 struct s_mapiterator {
 	enum e_mapitflags flags; ///< flags for special behaviour
 	enum bl_type types;      ///< what bl types to return
-	struct DBIterator *dbi;  ///< database iterator
+	struct DBIterator *dbi;  ///< database iterator (NULL when iterating the players of a map)
+	int16 m;                 ///< map whose players are iterated (-1 when using dbi)
+	int *ids;                ///< snapshot of the ids of the players on the map
+	int count, pos;          ///< number of ids and current position in the snapshot
 };
 
 /// Returns true if the block_list matches the description in the iterator.
@@ -2651,6 +2824,20 @@ struct s_mapiterator {
 #define MAPIT_MATCHES(_mapit_,_bl_) \
 	( (_bl_)->type & (_mapit_)->types /* type matches */ )
 
+/// Returns the player at position pos of the snapshot of a map iterator,
+/// or NULL if it already left the map.
+static struct block_list *mapit_map_get(struct s_mapiterator *iter, int pos)
+{
+	struct map_session_data *sd;
+
+	if (pos < 0 || pos >= iter->count)
+		return NULL;
+	sd = map->id2sd(iter->ids[pos]);
+	if (sd == NULL || sd->bl.m != iter->m || sd->bl.prev == NULL)
+		return NULL;
+	return &sd->bl;
+}
+
 /// Allocates a new iterator.
 /// Returns the new iterator.
 /// types can represent several BL's as a bit field.
@@ -2666,12 +2853,52 @@ static struct s_mapiterator *mapit_alloc(enum e_mapitflags flags, enum bl_type t
 	iter = ers_alloc(map->iterator_ers, struct s_mapiterator);
 	iter->flags = flags;
 	iter->types = types;
+	iter->m = -1;
+	iter->ids = NULL;
+	iter->count = iter->pos = 0;
 	if( types == BL_PC )       iter->dbi = db_iterator(map->pc_db);
 	else if( types == BL_MOB ) iter->dbi = db_iterator(map->mobid_db);
 	else                       iter->dbi = db_iterator(map->id_db);
 	return iter;
 }
 
+/// Allocates a new iterator over the players placed on map m.
+/// Only touches the players of that map, players that leave the map
+/// during the iteration are skipped and players that enter it are not returned.
+///
+/// @param flags Flags of the iterator
+/// @param m Map id
+/// @return Iterator
+static struct s_mapiterator *mapit_alloc_map(enum e_mapitflags flags, int16 m)
+{
+	struct s_mapiterator *iter;
+	struct map_session_data *sd;
+	int count = 0;
+
+	iter = ers_alloc(map->iterator_ers, struct s_mapiterator);
+	iter->flags = flags;
+	iter->types = BL_PC;
+	iter->dbi = NULL;
+	iter->m = m;
+	iter->ids = NULL;
+	iter->count = 0;
+	iter->pos = -1;
+
+	Assert_retr(iter, m >= -1 && m < map->count);
+	if (m < 0)
+		return iter;
+
+	for (sd = map->list[m].pc_list; sd != NULL; sd = sd->map_next)
+		count++;
+	if (count == 0)
+		return iter;
+
+	CREATE(iter->ids, int, count);
+	for (sd = map->list[m].pc_list; sd != NULL; sd = sd->map_next)
+		iter->ids[iter->count++] = sd->bl.id;
+	return iter;
+}
+
 /// Frees the iterator.
 ///
 /// @param iter Iterator
@@ -2679,7 +2906,10 @@ static void mapit_free(struct s_mapiterator *iter)
 {
 	nullpo_retv(iter);
 
-	dbi_destroy(iter->dbi);
+	if (iter->dbi != NULL)
+		dbi_destroy(iter->dbi);
+	if (iter->ids != NULL)
+		aFree(iter->ids);
 	ers_free(map->iterator_ers, iter);
 }
 
@@ -2694,6 +2924,11 @@ static struct block_list *mapit_first(struct s_mapiterator *iter)
 
 	nullpo_retr(NULL,iter);
 
+	if (iter->dbi == NULL) {
+		iter->pos = -1;
+		return mapit->next(iter);
+	}
+
 	for (bl = dbi_first(iter->dbi); bl != NULL; bl = dbi_next(iter->dbi) ) {
 		if( MAPIT_MATCHES(iter,bl) )
 			break;// found match
@@ -2712,6 +2947,11 @@ static struct block_list *mapit_last(struct s_mapiterator *iter)
 
 	nullpo_retr(NULL,iter);
 
+	if (iter->dbi == NULL) {
+		iter->pos = iter->count;
+		return mapit->prev(iter);
+	}
+
 	for (bl = dbi_last(iter->dbi); bl != NULL; bl = dbi_prev(iter->dbi)) {
 		if( MAPIT_MATCHES(iter,bl) )
 			break;// found match
@@ -2730,6 +2970,13 @@ static struct block_list *mapit_next(struct s_mapiterator *iter)
 
 	nullpo_retr(NULL,iter);
 
+	if (iter->dbi == NULL) {
+		bl = NULL;
+		while (bl == NULL && iter->pos < iter->count)
+			bl = mapit_map_get(iter, ++iter->pos);
+		return bl;
+	}
+
 	for( ; ; ) {
 		bl = dbi_next(iter->dbi);
 		if( bl == NULL )
@@ -2752,6 +2999,13 @@ static struct block_list *mapit_prev(struct s_mapiterator *iter)
 
 	nullpo_retr(NULL,iter);
 
+	if (iter->dbi == NULL) {
+		bl = NULL;
+		while (bl == NULL && iter->pos >= 0)
+			bl = mapit_map_get(iter, --iter->pos);
+		return bl;
+	}
+
 	for( ; ; ) {
 		bl = dbi_prev(iter->dbi);
 		if( bl == NULL )
@@ -2771,6 +3025,8 @@ static bool mapit_exists(struct s_mapiterator *iter)
 {
 	nullpo_retr(false,iter);
 
+	if (iter->dbi == NULL)
+		return (mapit_map_get(iter, iter->pos) != NULL);
 	return dbi_exists(iter->dbi);
 }
 
@@ -2895,6 +3151,73 @@ static void map_removemobs(int16 m)
 	map->list[m].mob_delete_timer = timer->add(timer->gettick()+battle_config.mob_remove_delay, map->removemobs_timer, m, 0);
 }
 
+/**
+ * Puts an empty map to sleep: its mobs stop moving and attacking, are skipped
+ * by the idle AI and don't respawn until a player enters the map again.
+ * @see map_wakeup
+ */
+static int map_sleep_timer(int tid, int64 tick, int id, intptr_t data)
+{
+	const int16 m = id;
+
+	if (m < 0 || m >= map->count) {
+		ShowError("map_sleep_timer error: timer %d points to invalid map %d\n", tid, m);
+		return 0;
+	}
+	if (map->list[m].dormant_timer != tid) {
+		ShowError("map_sleep_timer mismatch: %d != %d (map %s)\n", map->list[m].dormant_timer, tid, map->list[m].name);
+		return 0;
+	}
+	map->list[m].dormant_timer = INVALID_TIMER;
+	if (map->list[m].users > 0 || battle_config.mob_dormant_maps == 0)
+		return 0;
+
+	map->list[m].dormant = true;
+	map->list[m].dormant_tick = tick;
+	map->foreachinmap(mob->sleep_sub, m, BL_MOB, tick);
+
+	return 1;
+}
+
+/**
+ * Schedules an empty map to go dormant after mob_dormant_delay.
+ * @param m Map id
+ */
+static void map_sleep(int16 m)
+{
+	Assert_retv(m >= 0 && m < map->count);
+	if (map->list[m].dormant || map->list[m].dormant_timer != INVALID_TIMER)
+		return;
+
+	map->list[m].dormant_timer = timer->add(timer->gettick() + battle_config.mob_dormant_delay, map->sleep_timer, m, 0);
+}
+
+/**
+ * Wakes a map up when a player enters it, catching its mobs up in one pass:
+ * the respawns that were held back are done and the mobs that were wandering
+ * are moved within their spawn area.
+ * @param m Map id
+ */
+static void map_wakeup(int16 m)
+{
+	int64 tick;
+
+	Assert_retv(m >= 0 && m < map->count);
+	if (map->list[m].dormant_timer != INVALID_TIMER) {
+		timer->delete(map->list[m].dormant_timer, map->sleep_timer);
+		map->list[m].dormant_timer = INVALID_TIMER;
+	}
+	if (!map->list[m].dormant)
+		return;
+
+	map->list[m].dormant = false;
+	tick = timer->gettick();
+	map->foreachinmap(mob->wakeup_sub, m, BL_MOB, map->list[m].dormant_tick, tick);
+	for (int i = 0; i < VECTOR_LENGTH(map->list[m].dormant_spawns); i++)
+		mob->wakeup_spawn(VECTOR_INDEX(map->list[m].dormant_spawns, i));
+	VECTOR_TRUNCATE(map->list[m].dormant_spawns);
+}
+
 /*==========================================
  * Hookup, get map_id from map_name
  *------------------------------------------*/
@@ -3699,6 +4022,14 @@ static void map_clean(int i)
 		aFree(map->list[i].block);
 	if (map->list[i].block_mob)
 		aFree(map->list[i].block_mob);
+	if (map->list[i].block_pcs) {
+		aFree(map->list[i].block_pcs);
+		aFree(map->list[i].active_blocks);
+		aFree(map->list[i].active_block_pos);
+	}
+
+	if (map->list[i].dormant_timer != INVALID_TIMER)
+		timer->delete(map->list[i].dormant_timer, map->sleep_timer);
 
 	if (battle_config.dynamic_mobs != 0) { //Dynamic mobs flag by [random]
 		if (map->list[i].mob_delete_timer != INVALID_TIMER)
@@ -3751,6 +4082,7 @@ static void map_clean(int i)
 		channel->delete(map->list[i].channel);
 
 	VECTOR_CLEAR(map->list[i].qi_list);
+	VECTOR_CLEAR(map->list[i].dormant_spawns);
 	HPM->data_store_destroy(&map->list[i].hdata);
 }
 static void do_final_maps(void)
@@ -4022,6 +4354,8 @@ static int map_readallmaps(void)
 
 		memset(map->list[i].moblist, 0, sizeof(map->list[i].moblist)); //Initialize moblist [Skotlex]
 		map->list[i].mob_delete_timer = INVALID_TIMER; //Initialize timer [Skotlex]
+		map->list[i].dormant_timer = INVALID_TIMER;
+		VECTOR_INIT(map->list[i].dormant_spawns);
 
 		map->list[i].bxs = (map->list[i].xs + BLOCK_SIZE - 1) / BLOCK_SIZE;
 		map->list[i].bys = (map->list[i].ys + BLOCK_SIZE - 1) / BLOCK_SIZE;
@@ -4077,6 +4411,7 @@ static bool map_config_read_console(const char *filename, struct config_t *confi
 	}
 	libconfig->setting_lookup_mutable_string(setting, "timestamp_format", showmsg->timestamp_format, sizeof(showmsg->timestamp_format));
 	libconfig->setting_lookup_int(setting, "console_msg_log", &showmsg->console_log);
+	libconfig->setting_lookup_int(setting, "watchdog_threshold", &core->watchdog_threshold);
 
 	return true;
 }
@@ -4189,6 +4524,8 @@ static bool map_config_read_database(const char *filename, struct config_t *conf
 	libconfig->setting_lookup_mutable_string(setting, "db_path", map->db_path, sizeof(map->db_path));
 	libconfig->set_db_path(map->db_path);
 	libconfig->setting_lookup_int(setting, "save_settings", &map->save_settings);
+	libconfig->setting_lookup_bool_real(setting, "delta_save", &map->delta_save);
+	libconfig->setting_lookup_bool_real(setting, "mapreg_async_save", &mapreg->async_save);
 
 	if (libconfig->setting_lookup_int(setting, "autosave_time", &map->autosave_interval) == CONFIG_TRUE) {
 		if (map->autosave_interval < 1) // Revert to default saving
@@ -6697,6 +7034,58 @@ static CPCMD(gm_use)
 
 	map->cpsd_active = false;
 }
+/**
+ * Per-opcode packet profiling
+ * Usage: server packet_profile [on|off|reset]
+ **/
+static CPCMD(packet_profile)
+{
+	clif->packet_profile(0, line);
+}
+/**
+ * Log writer statistics
+ * Usage: server log_stats
+ **/
+static CPCMD(log_stats)
+{
+	if (logs->mysql_handle == NULL)
+		ShowInfo("SQL logging is disabled.\n");
+	else
+		logs->sql_report();
+}
+
+/**
+ * Describes what the map server is doing, for the main loop watchdog.
+ * Called from the watchdog thread while the main thread is busy.
+ *
+ * @param buf  Buffer to write the description to.
+ * @param size Size of the buffer.
+ */
+static void map_watchdog_context(char *buf, size_t size)
+{
+	const char *npc_name = script->running_npc;
+	int cmd = clif->cmd;
+
+	nullpo_retv(buf);
+	if (cmd > 0 && npc_name != NULL)
+		snprintf(buf, size, "packet: 0x%04x, script: %s", (unsigned int)cmd, npc_name);
+	else if (cmd > 0)
+		snprintf(buf, size, "packet: 0x%04x", (unsigned int)cmd);
+	else if (npc_name != NULL)
+		snprintf(buf, size, "script: %s", npc_name);
+	else if (size > 0)
+		buf[0] = '\0';
+}
+
+/**
+ * Active mob AI statistics
+ * Usage: server mob_ai_stats [reset]
+ **/
+static CPCMD(mob_ai_stats)
+{
+	mob->ai_stats_report(line);
+}
+
 /* Hercules Console Parser */
 static void map_cp_defaults(void)
 {
@@ -6712,6 +7101,9 @@ static void map_cp_defaults(void)
 
 	console->input->addCommand("gm:info",CPCMD_A(gm_position));
 	console->input->addCommand("gm:use",CPCMD_A(gm_use));
+	console->input->addCommand("server:packet_profile",CPCMD_A(packet_profile));
+	console->input->addCommand("server:log_stats",CPCMD_A(log_stats));
+	console->input->addCommand("server:mob_ai_stats",CPCMD_A(mob_ai_stats));
 #endif
 }
 
@@ -7013,12 +7405,12 @@ int do_init(int argc, char *argv[])
 	}
 	script->config_read(map->SCRIPT_CONF_NAME, false);
 
-	map->id_db     = idb_alloc(DB_OPT_BASE);
+	map->id_db     = idb_alloc(DB_OPT_OPEN_ADDRESSING);
 	map->pc_db     = idb_alloc(DB_OPT_BASE); //Added for reliable map->id2sd() use. [Skotlex]
 	map->mobid_db  = idb_alloc(DB_OPT_BASE); //Added to lower the load of the lazy mob AI. [Skotlex]
 	map->bossid_db = idb_alloc(DB_OPT_BASE); // Used for Convex Mirror quick MVP search
 	map->nick_db   = idb_alloc(DB_OPT_BASE);
-	map->charid_db = idb_alloc(DB_OPT_BASE);
+	map->charid_db = idb_alloc(DB_OPT_OPEN_ADDRESSING);
 	map->regen_db  = idb_alloc(DB_OPT_BASE); // efficient status_natural_heal processing
 	map->iwall_db  = strdb_alloc(DB_OPT_DUP_KEY|DB_OPT_RELEASE_DATA, 2*NAME_LENGTH+2+1); // [Zephyrus] Invisible Walls
 	map->zone_db   = strdb_alloc(DB_OPT_DUP_KEY|DB_OPT_RELEASE_DATA, MAP_ZONE_NAME_LENGTH);
@@ -7057,6 +7449,7 @@ int do_init(int argc, char *argv[])
 		timer->add_func_list(map->freeblock_timer, "map_freeblock_timer");
 		timer->add_func_list(map->clearflooritem_timer, "map_clearflooritem_timer");
 		timer->add_func_list(map->removemobs_timer, "map_removemobs_timer");
+		timer->add_func_list(map->sleep_timer, "map_sleep_timer");
 		timer->add_interval(timer->gettick()+1000, map->freeblock_timer, 0, 0, 60*1000);
 
 	}
@@ -7122,6 +7515,11 @@ int do_init(int argc, char *argv[])
 	}
 
 	npc->event_do_oninit( false ); // Init npcs (OnInit)
+
+	if (battle_config.mob_dormant_maps != 0) { // No map has players yet
+		for (int m = 0; m < map->count; m++)
+			map->sleep(m);
+	}
 	npc->market_fromsql(); /* after OnInit */
 	npc->barter_fromsql(); /* after OnInit */
 	npc->expanded_barter_fromsql(); /* after OnInit */
@@ -7141,6 +7539,7 @@ int do_init(int argc, char *argv[])
 
 	if( core->runflag != CORE_ST_STOP ) {
 		core->shutdown_callback = map->do_shutdown;
+		core->watchdog_context = map_watchdog_context;
 		core->runflag = MAPSERVER_ST_RUNNING;
 	}
 
@@ -7179,6 +7578,7 @@ void map_defaults(void)
 	map->autosave_interval = DEFAULT_MAP_AUTOSAVE_INTERVAL;
 	map->minsave_interval = 100;
 	map->save_settings = 0xFFFF;
+	map->delta_save = true;
 	map->agit_flag = 0;
 	map->agit2_flag = 0;
 	map->night_flag = 0; // 0=day, 1=night [Yor]
@@ -7271,6 +7671,8 @@ PRAGMA_GCC9(GCC diagnostic pop)
 	// blocklist manipulation
 	map->addblock = map_addblock;
 	map->delblock = map_delblock;
+	map->addpclist = map_addpclist;
+	map->delpclist = map_delpclist;
 	map->moveblock = map_moveblock;
 	//blocklist nb in one cell
 	map->count_oncell = map_count_oncell;
@@ -7286,6 +7688,7 @@ PRAGMA_GCC9(GCC diagnostic pop)
 	// map item
 	map->clearflooritem_timer = map_clearflooritem_timer;
 	map->removemobs_timer = map_removemobs_timer;
+	map->sleep_timer = map_sleep_timer;
 	map->clearflooritem = map_clearflooritem;
 	map->addflooritem = map_addflooritem;
 	// player to map session
@@ -7325,6 +7728,8 @@ PRAGMA_GCC9(GCC diagnostic pop)
 	map->vforeachinmap = map_vforeachinmap;
 	map->foreachinmap = map_foreachinmap;
 	map->forcountinmap = map_forcountinmap;
+	map->vforeachactivemob = map_vforeachactivemob;
+	map->foreachactivemob = map_foreachactivemob;
 	map->vforeachininstance = map_vforeachininstance;
 	map->foreachininstance = map_foreachininstance;
 
@@ -7370,6 +7775,8 @@ PRAGMA_GCC9(GCC diagnostic pop)
 	map->addmobtolist = map_addmobtolist; // [Wizputer]
 	map->spawnmobs = map_spawnmobs; // [Wizputer]
 	map->removemobs = map_removemobs; // [Wizputer]
+	map->sleep = map_sleep;
+	map->wakeup = map_wakeup;
 	map->addmap2db = map_addmap2db;
 	map->removemapdb = map_removemapdb;
 	map->clean = map_clean;
@@ -7442,6 +7849,7 @@ void mapit_defaults(void)
 	mapit = &mapit_s;
 
 	mapit->alloc = mapit_alloc;
+	mapit->alloc_map = mapit_alloc_map;
 	mapit->free = mapit_free;
 	mapit->first = mapit_first;
 	mapit->last = mapit_last;
@@ -987,6 +987,12 @@ struct map_data {
 	int npc_num;
 	int users;
 	int users_pvp;
+	struct map_session_data *pc_list; ///< Players on this map, including those still loading it (linked through map_session_data::map_next)
+	uint16 *block_pcs; ///< Number of players within mob activation range of each block (NULL until a player enters the map)
+	int *active_blocks; ///< Blocks with players within mob activation range (active_block_count entries)
+	int *active_block_pos; ///< 1-based index of each block in active_blocks (0 when it isn't listed)
+	int active_block_count;
+	int active_block_range; ///< Activation range (in blocks) block_pcs was built with
 	int iwall_num; // Total of invisible walls in this map
 	struct map_flag {
 		unsigned town : 1; // [Suggestion to protect Mail System]
@@ -1057,6 +1063,10 @@ struct map_data {
 
 	struct spawn_data *moblist[MAX_MOB_LIST_PER_MAP]; // [Wizputer]
 	int mob_delete_timer; // [Skotlex]
+	int dormant_timer; ///< Timer putting the map to sleep after its last player left
+	bool dormant; ///< Whether the map is dormant (@see map_sleep)
+	int64 dormant_tick; ///< Tick at which the map went dormant
+	VECTOR_DECL(int) dormant_spawns; ///< Ids of the mobs whose respawn is held back until the map wakes up
 	int jexp; // map experience multiplicator
 	int bexp; // map experience multiplicator
 	int nocommand; //Blocks @/# commands for non-gms. [Skotlex]
@@ -1126,6 +1136,7 @@ struct s_mapiterator;
 /* temporary until the map.c "Hercules Renewal Phase One" design is complete. */
 struct mapit_interface {
 	struct s_mapiterator*   (*alloc) (enum e_mapitflags flags, enum bl_type types);
+	struct s_mapiterator*   (*alloc_map) (enum e_mapitflags flags, int16 m);
 	void                    (*free) (struct s_mapiterator* iter);
 	struct block_list*      (*first) (struct s_mapiterator* iter);
 	struct block_list*      (*last) (struct s_mapiterator* iter);
@@ -1139,6 +1150,7 @@ struct mapit_interface {
 #define mapit_geteachmob()  (mapit->alloc(MAPIT_NORMAL,BL_MOB))
 #define mapit_geteachnpc()  (mapit->alloc(MAPIT_NORMAL,BL_NPC))
 #define mapit_geteachiddb() (mapit->alloc(MAPIT_NORMAL,BL_ALL))
+#define mapit_getmapusers(m) (mapit->alloc_map(MAPIT_NORMAL,(m)))
 
 //Useful typedefs from jA [Skotlex]
 typedef struct map_session_data TBL_PC;
@@ -1283,6 +1295,7 @@ struct map_interface {
 	int autosave_interval;
 	int minsave_interval;
 	int save_settings;
+	bool delta_save; // Autosaves only send the character data sections that changed.
 	int agit_flag;
 	int agit2_flag;
 	int night_flag; // 0=day, 1=night [Yor]
@@ -1384,6 +1397,8 @@ END_ZEROED_BLOCK;
 	// blocklist manipulation
 	int (*addblock) (struct block_list* bl);
 	int (*delblock) (struct block_list* bl);
+	void (*addpclist) (struct map_session_data *sd);
+	void (*delpclist) (struct map_session_data *sd);
 	int (*moveblock) (struct block_list *bl, int x1, int y1, int64 tick);
 	//blocklist nb in one cell
 	int (*count_oncell) (int16 m,int16 x,int16 y,int type,int flag);
@@ -1399,6 +1414,7 @@ END_ZEROED_BLOCK;
 	// map item
 	int (*clearflooritem_timer) (int tid, int64 tick, int id, intptr_t data);
 	int (*removemobs_timer) (int tid, int64 tick, int id, intptr_t data);
+	int (*sleep_timer) (int tid, int64 tick, int id, intptr_t data);
 	void (*clearflooritem) (struct block_list* bl);
 	int (*addflooritem) (const struct block_list *bl, struct item *item_data, int amount, int16 m, int16 x, int16 y, int first_charid, int second_charid, int third_charid, int flags, bool showdropeffect);
 	// player to map session
@@ -1438,6 +1454,8 @@ END_ZEROED_BLOCK;
 	int (*vforeachinmap) (int (*func)(struct block_list*,va_list), int16 m, int type, va_list args);
 	int (*foreachinmap) (int (*func)(struct block_list*,va_list), int16 m, int type, ...);
 	int (*forcountinmap) (int (*func)(struct block_list*,va_list), int16 m, int count, int type, ...);
+	int (*vforeachactivemob) (int (*func)(struct block_list*,va_list), va_list args);
+	int (*foreachactivemob) (int (*func)(struct block_list*,va_list), ...);
 	int (*vforeachininstance)(int (*func)(struct block_list*,va_list), int16 instance_id, int type, va_list ap);
 	int (*foreachininstance)(int (*func)(struct block_list*,va_list), int16 instance_id, int type,...);
 
@@ -1483,6 +1501,8 @@ END_ZEROED_BLOCK;
 	int (*addmobtolist) (unsigned short m, struct spawn_data *spawn); // [Wizputer]
 	void (*spawnmobs) (int16 m); // [Wizputer]
 	void (*removemobs) (int16 m); // [Wizputer]
+	void (*sleep) (int16 m);
+	void (*wakeup) (int16 m);
 	//void (*do_reconnect_map) (void); //Invoked on map-char reconnection [Skotlex] Note used but still keeping it, just in case
 	void (*addmap2db) (struct map_data *m);
 	void (*removemapdb) (struct map_data *m);
@@ -29,6 +29,7 @@
 #include "common/core.h"
 #include "common/db.h"
 #include "common/memmgr.h"
+#include "common/metrics.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/socket.h"
@@ -67,6 +68,9 @@ static int mapiif_parse_fromchar_api_proxy(int fd)
 	case API_MSG_party_info:
 		mapiif->parse_adventurer_agency_info(fd);
 		break;
+	case API_MSG_metrics:
+		mapiif->parse_metrics(fd);
+		break;
 	default:
 		ShowError("Unknown proxy packet 0x%04x received from char-server, disconnecting.\n", msg);
 		sockt->eof(fd);
@@ -89,6 +93,20 @@ void mapiif_parse_adventurer_agency_info(int fd)
 	WFIFOSET(chrif->fd, packet->packet_len);
 }
 
+void mapiif_parse_metrics(int fd)
+{
+	RFIFO_API_DATA(data, metrics);
+	RFIFO_API_PROXY_PACKET(p);
+
+	metrics->collect();
+	metrics->add(METRIC_ONLINE_USERS, NULL, map->usercount());
+	for (int i = 0; i < map->count; i++) {
+		if (map->list[i].users > 0)
+			metrics->add(METRIC_MAP_USERS, map->list[i].name, map->list[i].users);
+	}
+	metrics->send(chrif->fd, p, data->world_name, 0);
+}
+
 static void do_init_mapiif(bool minimal)
 {
 }
@@ -104,4 +122,5 @@ void mapiif_defaults(void) {
 	mapiif->final = do_final_mapiif;
 	mapiif->parse_fromchar_api_proxy = mapiif_parse_fromchar_api_proxy;
 	mapiif->parse_adventurer_agency_info = mapiif_parse_adventurer_agency_info;
+	mapiif->parse_metrics = mapiif_parse_metrics;
 }
@@ -34,6 +34,7 @@ struct mapiif_interface {
 	void (*final) (void);
 	int (*parse_fromchar_api_proxy) (int fd);
 	void (*parse_adventurer_agency_info) (int fd);
+	void (*parse_metrics) (int fd);
 };
 
 #ifdef HERCULES_CORE
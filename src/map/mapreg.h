@@ -28,11 +28,17 @@
 /** Forward Declarations **/
 struct config_setting_t;
 struct eri;
+struct SqlAsync;
 
 #ifndef MAPREG_AUTOSAVE_INTERVAL
 #define MAPREG_AUTOSAVE_INTERVAL (300 * 1000) //!< Interval for auto-saving permanent global variables to the database in milliseconds.
 #endif /** MAPREG_AUTOSAVE_INTERVAL **/
 
+#ifndef MAPREG_BATCH_BITS
+#define MAPREG_BATCH_BITS 6 //!< Permanent global variables are saved in batches of up to 2^MAPREG_BATCH_BITS rows per query.
+#endif /** MAPREG_BATCH_BITS **/
+#define MAPREG_BATCH_SIZE (1 << MAPREG_BATCH_BITS)
+
 /** Global variable structure. **/
 struct mapreg_save {
 	int64 uid;         //!< The variable's unique ID.
@@ -49,8 +55,11 @@ struct mapreg_interface {
 	/** Interface variables. **/
 	struct eri *ers;    //!< Entry manager for global variables.
 	struct reg_db regs; //!< Generic database for global variables.
+	struct DBMap *deleted; //!< Permanent global variables to be deleted by the next save (int64 uid -> int is_string).
+	struct SqlAsync *async_pool; //!< Pool used to save permanent global variables off the main thread, if enabled.
 	bool dirty;         //!< Whether there are modified global variables to be saved.
 	bool skip_insert;   //!< Whether to skip inserting the variable into the SQL database in mapreg_set_*_db().
+	bool async_save;    //!< Whether to save permanent global variables off the main thread.
 	char num_db[32];    //!< Name of SQL table which holds permanent global integer variables.
 	char str_db[32];    //!< Name of SQL table which holds permanent global string variables.
 
@@ -69,6 +78,8 @@ struct mapreg_interface {
 	void (*save_num_db) (const char *name, unsigned int index, int value);
 	void (*save_str_db) (const char *name, unsigned int index, const char *value);
 	void (*save) (void);
+	void (*mark_saved) (struct mapreg_save *var);
+	void (*mark_deleted) (int64 uid, bool is_string);
 	int (*save_timer) (int tid, int64 tick, int id, intptr_t data);
 	int (*destroyreg) (union DBKey key, struct DBData *data, va_list ap);
 	void (*reload) (void);
@@ -41,6 +41,31 @@
 static struct mapreg_interface mapreg_s; //!< Private interface structure.
 struct mapreg_interface *mapreg; //!< Public interface structure.
 
+/** Batched write operations. **/
+enum mapreg_batch_op {
+	MAPREG_UPSERT_NUM,
+	MAPREG_UPSERT_STR,
+	MAPREG_DELETE_NUM,
+	MAPREG_DELETE_STR,
+	MAPREG_BATCH_OP_MAX
+};
+
+/** Rows of a batched write operation, waiting to be sent. **/
+struct mapreg_batch {
+	int64 uid[MAPREG_BATCH_SIZE];                    //!< The variables' unique IDs.
+	const char *name[MAPREG_BATCH_SIZE];             //!< The variables' names.
+	unsigned int index[MAPREG_BATCH_SIZE];           //!< The variables' array indexes.
+	const struct mapreg_save *var[MAPREG_BATCH_SIZE]; //!< The variables, NULL for deletions.
+	int count;                                       //!< Number of rows in the batch.
+};
+
+/**
+ * Queries of the batched write operations, query [op][n] writes 2^n rows.
+ * The statements are prepared once and reused across saves.
+ **/
+static char *mapreg_batch_query[MAPREG_BATCH_OP_MAX][MAPREG_BATCH_BITS + 1];
+static struct SqlStmt *mapreg_batch_stmt[MAPREG_BATCH_OP_MAX][MAPREG_BATCH_BITS + 1];
+
 /**
  * Looks up the value of a global integer variable using its unique ID.
  *
@@ -111,28 +136,8 @@ static bool mapreg_set_num_db(int64 uid, const char *name, unsigned int index, i
 	var->is_string = false;
 	i64db_put(mapreg->regs.vars, uid, var);
 
-	if (script->is_permanent_variable(name) && !mapreg->skip_insert) {
-		struct SqlStmt *stmt = SQL->StmtMalloc(map->mysql_handle);
-
-		if (stmt == NULL) {
-			SqlStmt_ShowDebug(stmt);
-			return false;
-		}
-
-		const char *query = "INSERT INTO `%s` (`key`, `index`, `value`) VALUES (?, ?, ?)";
-
-		if (SQL_ERROR == SQL->StmtPrepare(stmt, query, mapreg->num_db)
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 0, SQLDT_STRING, name, strlen(name))
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 1, SQLDT_UINT32, &index, sizeof(index))
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 2, SQLDT_INT32, &value, sizeof(value))
-		    || SQL_ERROR == SQL->StmtExecute(stmt)) {
-			SqlStmt_ShowDebug(stmt);
-			SQL->StmtFree(stmt);
-			return false;
-		}
-
-		SQL->StmtFree(stmt);
-	}
+	if (script->is_permanent_variable(name) && !mapreg->skip_insert)
+		mapreg->mark_saved(var);
 
 	return true;
 }
@@ -162,27 +167,8 @@ static bool mapreg_delete_num_db(int64 uid, const char *name, unsigned int index
 
 	i64db_remove(mapreg->regs.vars, uid);
 
-	if (script->is_permanent_variable(name)) {
-		struct SqlStmt *stmt = SQL->StmtMalloc(map->mysql_handle);
-
-		if (stmt == NULL) {
-			SqlStmt_ShowDebug(stmt);
-			return false;
-		}
-
-		const char *query = "DELETE FROM `%s` WHERE `key`=? AND `index`=?";
-
-		if (SQL_ERROR == SQL->StmtPrepare(stmt, query, mapreg->num_db)
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 0, SQLDT_STRING, name, strlen(name))
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 1, SQLDT_UINT32, &index, sizeof(index))
-		    || SQL_ERROR == SQL->StmtExecute(stmt)) {
-			SqlStmt_ShowDebug(stmt);
-			SQL->StmtFree(stmt);
-			return false;
-		}
-
-		SQL->StmtFree(stmt);
-	}
+	if (script->is_permanent_variable(name))
+		mapreg->mark_deleted(uid, false);
 
 	return true;
 }
@@ -256,28 +242,8 @@ static bool mapreg_set_str_db(int64 uid, const char *name, unsigned int index, c
 	var->is_string = true;
 	i64db_put(mapreg->regs.vars, uid, var);
 
-	if (script->is_permanent_variable(name) && !mapreg->skip_insert) {
-		struct SqlStmt *stmt = SQL->StmtMalloc(map->mysql_handle);
-
-		if (stmt == NULL) {
-			SqlStmt_ShowDebug(stmt);
-			return false;
-		}
-
-		const char *query = "INSERT INTO `%s` (`key`, `index`, `value`) VALUES (?, ?, ?)";
-
-		if (SQL_ERROR == SQL->StmtPrepare(stmt, query, mapreg->str_db)
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 0, SQLDT_STRING, name, strlen(name))
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 1, SQLDT_UINT32, &index, sizeof(index))
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 2, SQLDT_STRING, value, strlen(value))
-		    || SQL_ERROR == SQL->StmtExecute(stmt)) {
-			SqlStmt_ShowDebug(stmt);
-			SQL->StmtFree(stmt);
-			return false;
-		}
-
-		SQL->StmtFree(stmt);
-	}
+	if (script->is_permanent_variable(name) && !mapreg->skip_insert)
+		mapreg->mark_saved(var);
 
 	return true;
 }
@@ -311,27 +277,8 @@ static bool mapreg_delete_str_db(int64 uid, const char *name, unsigned int index
 
 	i64db_remove(mapreg->regs.vars, uid);
 
-	if (script->is_permanent_variable(name)) {
-		struct SqlStmt *stmt = SQL->StmtMalloc(map->mysql_handle);
-
-		if (stmt == NULL) {
-			SqlStmt_ShowDebug(stmt);
-			return false;
-		}
-
-		const char *query = "DELETE FROM `%s` WHERE `key`=? AND `index`=?";
-
-		if (SQL_ERROR == SQL->StmtPrepare(stmt, query, mapreg->str_db)
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 0, SQLDT_STRING, name, strlen(name))
-		    || SQL_ERROR == SQL->StmtBindParam(stmt, 1, SQLDT_UINT32, &index, sizeof(index))
-		    || SQL_ERROR == SQL->StmtExecute(stmt)) {
-			SqlStmt_ShowDebug(stmt);
-			SQL->StmtFree(stmt);
-			return false;
-		}
-
-		SQL->StmtFree(stmt);
-	}
+	if (script->is_permanent_variable(name))
+		mapreg->mark_deleted(uid, true);
 
 	return true;
 }
@@ -539,33 +486,376 @@ static void mapreg_save_str_db(const char *name, unsigned int index, const char
 	SQL->StmtFree(stmt);
 }
 
+/**
+ * Flags a permanent global variable to be written by the next save.
+ *
+ * @param var The variable.
+ *
+ **/
+static void mapreg_mark_saved(struct mapreg_save *var)
+{
+	nullpo_retv(var);
+
+	var->save = true;
+	mapreg->dirty = true;
+
+	if (mapreg->deleted != NULL)
+		i64db_remove(mapreg->deleted, var->uid);
+}
+
+/**
+ * Flags a permanent global variable to be deleted from the database by the next save.
+ *
+ * @param uid The variable's unique ID.
+ * @param is_string Whether the variable is a string variable.
+ *
+ **/
+static void mapreg_mark_deleted(int64 uid, bool is_string)
+{
+	if (mapreg->deleted == NULL)
+		return;
+
+	i64db_iput(mapreg->deleted, uid, is_string ? 1 : 0);
+	mapreg->dirty = true;
+}
+
+/**
+ * Returns the query of a batched write operation, building it on first use.
+ *
+ * @param op The write operation.
+ * @param bits The query writes 2^bits rows.
+ * @return The query.
+ *
+ **/
+static const char *mapreg_batch_get_query(enum mapreg_batch_op op, int bits)
+{
+	if (mapreg_batch_query[op][bits] != NULL)
+		return mapreg_batch_query[op][bits];
+
+	const char *table = (op == MAPREG_UPSERT_NUM || op == MAPREG_DELETE_NUM) ? mapreg->num_db : mapreg->str_db;
+	StringBuf buf;
+	int i;
+
+	StrBuf->Init(&buf);
+
+	if (op == MAPREG_UPSERT_NUM || op == MAPREG_UPSERT_STR) {
+		StrBuf->Printf(&buf, "INSERT INTO `%s` (`key`, `index`, `value`) VALUES ", table);
+		for (i = 0; i < (1 << bits); i++)
+			StrBuf->AppendStr(&buf, i == 0 ? "(?, ?, ?)" : ", (?, ?, ?)");
+		StrBuf->AppendStr(&buf, " ON DUPLICATE KEY UPDATE `value`=VALUES(`value`)");
+	} else {
+		StrBuf->Printf(&buf, "DELETE FROM `%s` WHERE (`key`, `index`) IN (", table);
+		for (i = 0; i < (1 << bits); i++)
+			StrBuf->AppendStr(&buf, i == 0 ? "(?, ?)" : ", (?, ?)");
+		StrBuf->AppendStr(&buf, ")");
+	}
+
+	mapreg_batch_query[op][bits] = aStrdup(StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
+	return mapreg_batch_query[op][bits];
+}
+
+/**
+ * Binds the parameters of a row of a batched write operation.
+ *
+ * @param stmt The statement (synchronous saves).
+ * @param job The job (asynchronous saves).
+ * @param batch The batch holding the row.
+ * @param row The row within the batch.
+ * @param param The first parameter of the row.
+ * @return SQL_SUCCESS or SQL_ERROR.
+ *
+ **/
+static int mapreg_batch_bind(struct SqlStmt *stmt, struct SqlAsyncJob *job, const struct mapreg_batch *batch, int row, size_t param)
+{
+	const char *name = batch->name[row];
+	const struct mapreg_save *var = batch->var[row];
+	enum SqlDataType type = SQLDT_NULL;
+	const void *value = NULL;
+	size_t len = 0;
+	int count = 2;
+
+	if (var != NULL) {
+		count = 3;
+		if (var->is_string) {
+			type = SQLDT_STRING;
+			value = var->u.str;
+			len = strlen(var->u.str);
+		} else {
+			type = SQLDT_INT32;
+			value = &var->u.i;
+			len = sizeof(var->u.i);
+		}
+	}
+
+	if (job != NULL) {
+		if (SQL_ERROR == SQL->AsyncStmtBindParam(job, param, SQLDT_STRING, name, strlen(name))
+		    || SQL_ERROR == SQL->AsyncStmtBindParam(job, param + 1, SQLDT_UINT32, &batch->index[row], sizeof(batch->index[row]))
+		    || (count == 3 && SQL_ERROR == SQL->AsyncStmtBindParam(job, param + 2, type, value, len)))
+			return SQL_ERROR;
+	} else {
+		if (SQL_ERROR == SQL->StmtBindParam(stmt, param, SQLDT_STRING, name, strlen(name))
+		    || SQL_ERROR == SQL->StmtBindParam(stmt, param + 1, SQLDT_UINT32, &batch->index[row], sizeof(batch->index[row]))
+		    || (count == 3 && SQL_ERROR == SQL->StmtBindParam(stmt, param + 2, type, value, len)))
+			return SQL_ERROR;
+	}
+
+	return SQL_SUCCESS;
+}
+
+/** Rows of a batched write operation queued to the asynchronous save pool, retried if it fails. **/
+struct mapreg_batch_job {
+	enum mapreg_batch_op op; //!< The write operation.
+	int count;               //!< Number of rows.
+	int64 uid[];             //!< The variables' unique IDs.
+};
+
+/**
+ * Flags the rows of a failed write to be written again by the next save.
+ *
+ * Rows whose variable changed since they were queued are skipped: the change is already pending.
+ *
+ * @param op The write operation.
+ * @param uid The variables' unique IDs.
+ * @param count Number of rows.
+ *
+ **/
+static void mapreg_batch_retry(enum mapreg_batch_op op, const int64 *uid, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		struct mapreg_save *var = i64db_get(mapreg->regs.vars, uid[i]);
+
+		if (op == MAPREG_UPSERT_NUM || op == MAPREG_UPSERT_STR) {
+			if (var != NULL && !var->save) {
+				var->save = true;
+				mapreg->dirty = true;
+			}
+		} else if (var == NULL && mapreg->deleted != NULL) {
+			i64db_iput(mapreg->deleted, uid[i], op == MAPREG_DELETE_STR ? 1 : 0);
+			mapreg->dirty = true;
+		}
+	}
+
+	ShowError("mapreg_batch_retry: Failed to save %d permanent global variable changes, they will be saved again by the next save.\n", count);
+}
+
+/**
+ * Completion of an asynchronous batched write, flags its rows again if it failed.
+ *
+ * @see SqlAsyncCallback
+ *
+ **/
+static void mapreg_batch_write_done(struct Sql *result, int status, void *data)
+{
+	struct mapreg_batch_job *bjob = data;
+
+	if (status == SQL_ERROR && mapreg->regs.vars != NULL)
+		mapreg_batch_retry(bjob->op, bjob->uid, bjob->count);
+	aFree(bjob);
+}
+
+/**
+ * Writes 2^bits rows of a batch to the database, using a single query.
+ *
+ * @param op The write operation.
+ * @param batch The batch.
+ * @param first The first row to write.
+ * @param bits The number of rows to write is 2^bits.
+ * @return True on success, otherwise false.
+ *
+ **/
+static bool mapreg_batch_write(enum mapreg_batch_op op, const struct mapreg_batch *batch, int first, int bits)
+{
+	size_t row_params = (op == MAPREG_UPSERT_NUM || op == MAPREG_UPSERT_STR) ? 3 : 2;
+	const char *query = mapreg_batch_get_query(op, bits);
+	int i;
+
+	if (mapreg->async_pool != NULL) {
+		struct SqlAsyncJob *job = SQL->AsyncStmtPrepare(mapreg->async_pool, query);
+		struct mapreg_batch_job *bjob;
+
+		if (job == NULL)
+			return false;
+
+		for (i = 0; i < (1 << bits); i++) {
+			if (SQL_ERROR == mapreg_batch_bind(NULL, job, batch, first + i, i * row_params)) {
+				ShowError("mapreg_batch_write: Failed to bind the parameters of row %d.\n", i);
+				SQL->AsyncStmtFree(job);
+				return false;
+			}
+		}
+
+		bjob = aMalloc(sizeof(*bjob) + sizeof(bjob->uid[0]) * (1 << bits));
+		bjob->op = op;
+		bjob->count = 1 << bits;
+		memcpy(bjob->uid, batch->uid + first, sizeof(bjob->uid[0]) * (1 << bits));
+
+		// Single key: the batches of consecutive saves are written in order.
+		if (SQL->AsyncStmtExecute(job, 0, mapreg_batch_write_done, bjob) != SQL_SUCCESS) {
+			aFree(bjob);
+			return false;
+		}
+		return true;
+	}
+
+	struct SqlStmt *stmt = mapreg_batch_stmt[op][bits];
+
+	if (stmt == NULL) {
+		stmt = SQL->StmtMalloc(map->mysql_handle);
+
+		if (stmt == NULL) {
+			SqlStmt_ShowDebug(stmt);
+			return false;
+		}
+
+		if (SQL_ERROR == SQL->StmtPrepareStr(stmt, query)) {
+			SqlStmt_ShowDebug(stmt);
+			SQL->StmtFree(stmt);
+			return false;
+		}
+
+		mapreg_batch_stmt[op][bits] = stmt;
+	}
+
+	for (i = 0; i < (1 << bits); i++) {
+		if (SQL_ERROR == mapreg_batch_bind(stmt, NULL, batch, first + i, i * row_params)) {
+			SqlStmt_ShowDebug(stmt);
+			return false;
+		}
+	}
+
+	if (SQL_ERROR == SQL->StmtExecute(stmt)) {
+		SqlStmt_ShowDebug(stmt);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Writes the rows of a batch to the database and empties it.
+ *
+ * A full batch is written with a single query, the remaining rows in power of two sized chunks,
+ * so the number of distinct prepared statements stays bounded.
+ * The rows of a failed query are flagged to be written again by the next save.
+ *
+ * @param op The write operation.
+ * @param batch The batch.
+ * @param rows Incremented by the number of rows written.
+ * @param queries Incremented by the number of queries sent.
+ *
+ **/
+static void mapreg_batch_flush(enum mapreg_batch_op op, struct mapreg_batch *batch, int *rows, int *queries)
+{
+	int first = 0;
+	int bits;
+
+	for (bits = MAPREG_BATCH_BITS; bits >= 0; bits--) {
+		if ((batch->count & (1 << bits)) == 0)
+			continue;
+
+		if (mapreg_batch_write(op, batch, first, bits))
+			*rows += 1 << bits;
+		else
+			mapreg_batch_retry(op, batch->uid + first, 1 << bits);
+
+		first += 1 << bits;
+		(*queries)++;
+	}
+
+	batch->count = 0;
+}
+
+/**
+ * Adds a row to a batch, writing the batch if it is full.
+ *
+ * @param op The write operation.
+ * @param batch The batch.
+ * @param uid The variable's unique ID.
+ * @param var The variable to write or NULL to delete it.
+ * @param rows Incremented by the number of rows written.
+ * @param queries Incremented by the number of queries sent.
+ *
+ **/
+static void mapreg_batch_add(enum mapreg_batch_op op, struct mapreg_batch *batch, int64 uid, const struct mapreg_save *var, int *rows, int *queries)
+{
+	batch->uid[batch->count] = uid;
+	batch->name[batch->count] = script->get_str(script_getvarid(uid));
+	batch->index[batch->count] = script_getvaridx(uid);
+	batch->var[batch->count] = var;
+
+	if (++batch->count == MAPREG_BATCH_SIZE)
+		mapreg_batch_flush(op, batch, rows, queries);
+}
+
 /**
  * Saves permanent global variables to the database.
  *
+ * Modified variables are written with batched upserts and deleted variables are removed with
+ * batched deletes. Since pending changes are kept per variable, each variable is written at most once.
+ * Changes whose write fails stay pending and are written again by the next save.
+ *
  **/
 static void mapreg_save(void)
 {
-	if (mapreg->dirty) {
-		struct DBIterator *iter = db_iterator(mapreg->regs.vars);
-		struct mapreg_save *var = NULL;
+	if (!mapreg->dirty)
+		return;
 
-		for (var = dbi_first(iter); dbi_exists(iter); var = dbi_next(iter)) {
-			if (var->save) {
-				int index = script_getvaridx(var->uid);
-				const char *name = script->get_str(script_getvarid(var->uid));
+	static struct mapreg_batch batch[MAPREG_BATCH_OP_MAX];
+	struct DBIterator *iter = db_iterator(mapreg->regs.vars);
+	struct mapreg_save *var = NULL;
+	int rows = 0;
+	int queries = 0;
+	int op;
+
+	mapreg->dirty = false; // set again by the writes that fail
+
+	for (var = dbi_first(iter); dbi_exists(iter); var = dbi_next(iter)) {
+		if (var->save) {
+			// Cleared first: a full batch is written right away and flags its rows again if it fails.
+			var->save = false;
+			op = var->is_string ? MAPREG_UPSERT_STR : MAPREG_UPSERT_NUM;
+			mapreg_batch_add(op, &batch[op], var->uid, var, &rows, &queries);
+		}
+	}
 
-				if (!var->is_string)
-					mapreg->save_num_db(name, index, var->u.i);
-				else
-					mapreg->save_str_db(name, index, var->u.str);
+	dbi_destroy(iter);
 
-				var->save = false;
-			}
+	if (mapreg->deleted != NULL && db_size(mapreg->deleted) > 0) {
+		// Failed deletes are put back in mapreg->deleted, it's emptied before writing.
+		int count = 0, i;
+		int64 *uids = aMalloc(sizeof(*uids) * db_size(mapreg->deleted));
+		bool *is_string = aMalloc(sizeof(*is_string) * db_size(mapreg->deleted));
+		union DBKey key;
+		struct DBData *data;
+
+		iter = db_iterator(mapreg->deleted);
+
+		for (data = iter->first(iter, &key); dbi_exists(iter); data = iter->next(iter, &key)) {
+			uids[count] = key.i64;
+			is_string[count++] = DB->data2i(data) != 0;
 		}
 
 		dbi_destroy(iter);
-		mapreg->dirty = false;
+		db_clear(mapreg->deleted);
+
+		for (i = 0; i < count; i++) {
+			op = is_string[i] ? MAPREG_DELETE_STR : MAPREG_DELETE_NUM;
+			mapreg_batch_add(op, &batch[op], uids[i], NULL, &rows, &queries);
+		}
+
+		aFree(uids);
+		aFree(is_string);
 	}
+
+	for (op = 0; op < MAPREG_BATCH_OP_MAX; op++)
+		mapreg_batch_flush(op, &batch[op], &rows, &queries);
+
+	if (queries > 0)
+		ShowInfo("Saved %d permanent global variable changes using %d queries%s.\n",
+			 rows, queries, (mapreg->async_pool != NULL) ? " (queued)" : "");
 }
 
 /**
@@ -625,6 +915,33 @@ static int mapreg_destroy_reg(union DBKey key, struct DBData *data, va_list ap)
 static void mapreg_reload(void)
 {
 	mapreg->save();
+
+	if (mapreg->async_pool != NULL) {
+		struct SqlAsync *pool = mapreg->async_pool;
+
+		SQL->AsyncFlush(pool); // Waits for the queued writes.
+		mapreg->async_pool = NULL;
+		mapreg->save(); // Retries the writes that failed, synchronously.
+		mapreg->async_pool = pool;
+	}
+
+	if (mapreg->dirty) {
+		struct DBIterator *iter = db_iterator(mapreg->regs.vars);
+		struct mapreg_save *var = NULL;
+		int count = (mapreg->deleted != NULL) ? db_size(mapreg->deleted) : 0;
+
+		for (var = dbi_first(iter); dbi_exists(iter); var = dbi_next(iter)) {
+			if (var->save)
+				count++;
+		}
+		dbi_destroy(iter);
+
+		ShowError("mapreg_reload: %d permanent global variable changes couldn't be saved and are lost.\n", count);
+		if (mapreg->deleted != NULL)
+			db_clear(mapreg->deleted);
+		mapreg->dirty = false;
+	}
+
 	mapreg->regs.vars->clear(mapreg->regs.vars, mapreg->destroyreg);
 
 	if (mapreg->regs.arrays != NULL) {
@@ -677,8 +994,33 @@ static bool mapreg_config_read_registry(const char *filename, const struct confi
  **/
 static void mapreg_final(void)
 {
+	int op, bits;
+
 	mapreg->save();
+
+	if (mapreg->async_pool != NULL) {
+		SQL->AsyncFree(mapreg->async_pool); // Waits for the queued writes.
+		mapreg->async_pool = NULL;
+		mapreg->save(); // Retries the writes that failed, synchronously.
+	}
+
+	for (op = 0; op < MAPREG_BATCH_OP_MAX; op++) {
+		for (bits = 0; bits <= MAPREG_BATCH_BITS; bits++) {
+			if (mapreg_batch_stmt[op][bits] != NULL) {
+				SQL->StmtFree(mapreg_batch_stmt[op][bits]);
+				mapreg_batch_stmt[op][bits] = NULL;
+			}
+			if (mapreg_batch_query[op][bits] != NULL) {
+				aFree(mapreg_batch_query[op][bits]);
+				mapreg_batch_query[op][bits] = NULL;
+			}
+		}
+	}
+
 	mapreg->regs.vars->destroy(mapreg->regs.vars, mapreg->destroyreg);
+	mapreg->regs.vars = NULL;
+	db_destroy(mapreg->deleted);
+	mapreg->deleted = NULL;
 	ers_destroy(mapreg->ers);
 
 	if (mapreg->regs.arrays != NULL)
@@ -687,13 +1029,18 @@ static void mapreg_final(void)
 
 /**
  * Allocates memory for permanent global variables, loads them from the database and initializes the auto-save timer.
+ * Starts the asynchronous save pool, if enabled.
  *
  **/
 static void mapreg_init(void)
 {
 	mapreg->regs.vars = i64db_alloc(DB_OPT_BASE);
+	mapreg->deleted = i64db_alloc(DB_OPT_BASE);
 	mapreg->ers = ers_new(sizeof(struct mapreg_save), "mapreg_sql.c::mapreg_ers", ERS_OPT_CLEAN);
 	mapreg->load();
+
+	if (mapreg->async_save && (mapreg->async_pool = SQL->AsyncCreate(map->mysql_handle, 1)) == NULL)
+		ShowWarning("mapreg_init: Failed to start the asynchronous save pool, permanent global variables will be saved synchronously.\n");
 	timer->add_func_list(mapreg->save_timer, "mapreg_save_timer");
 	timer->add_interval(timer->gettick() + MAPREG_AUTOSAVE_INTERVAL, mapreg->save_timer, 0, 0, MAPREG_AUTOSAVE_INTERVAL);
 }
@@ -711,8 +1058,11 @@ void mapreg_defaults(void)
 	mapreg->ers = NULL;
 	mapreg->regs.vars = NULL;
 	mapreg->regs.arrays = NULL;
+	mapreg->deleted = NULL;
+	mapreg->async_pool = NULL;
 	mapreg->dirty = false;
 	mapreg->skip_insert = false;
+	mapreg->async_save = false;
 	safestrncpy(mapreg->num_db, "map_reg_num_db", sizeof(mapreg->num_db));
 	safestrncpy(mapreg->str_db, "map_reg_str_db", sizeof(mapreg->str_db));
 
@@ -731,6 +1081,8 @@ void mapreg_defaults(void)
 	mapreg->save_num_db = mapreg_save_num_db;
 	mapreg->save_str_db = mapreg_save_str_db;
 	mapreg->save = mapreg_save;
+	mapreg->mark_saved = mapreg_mark_saved;
+	mapreg->mark_deleted = mapreg_mark_deleted;
 	mapreg->save_timer = mapreg_save_timer;
 	mapreg->destroyreg = mapreg_destroy_reg;
 	mapreg->reload = mapreg_reload;
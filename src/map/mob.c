@@ -46,16 +46,19 @@
 #include "map/status.h"
 #include "map/achievement.h"
 #include "common/HPM.h"
+#include "common/atomic.h"
 #include "common/cbasetypes.h"
 #include "common/conf.h"
 #include "common/db.h"
 #include "common/ers.h"
 #include "common/memmgr.h"
+#include "common/mutex.h"
 #include "common/nullpo.h"
 #include "common/random.h"
 #include "common/showmsg.h"
 #include "common/socket.h"
 #include "common/strlib.h"
+#include "common/thread.h"
 #include "common/timer.h"
 #include "common/utils.h"
 
@@ -68,8 +71,6 @@
 static struct mob_interface mob_s;
 struct mob_interface *mob;
 
-#define ACTIVE_AI_RANGE 2 //Distance added on top of 'AREA_SIZE' at which mobs enter active AI mode.
-
 #define IDLE_SKILL_INTERVAL 10 //Active idle skills should be triggered every 1 second (1000/MIN_MOBTHINKTIME)
 
 // Probability for mobs far from players from doing their IDLE skill. (rate of 1000 minute)
@@ -1043,12 +1044,21 @@ static int mob_delayspawn(int tid, int64 tick, int id, intptr_t data)
 
 	if( md )
 	{
+		struct map_data *mapdata;
+
 		if( md->spawn_timer != tid )
 		{
 			ShowError("mob_delayspawn: Timer mismatch: %d != %d\n", tid, md->spawn_timer);
 			return 0;
 		}
 		md->spawn_timer = INVALID_TIMER;
+		mapdata = &map->list[md->spawn != NULL ? md->spawn->m : md->bl.m];
+		if (mapdata->dormant) {
+			md->state.dormant_spawn = 1; // done by map->wakeup
+			VECTOR_ENSURE(mapdata->dormant_spawns, 1, 8);
+			VECTOR_PUSH(mapdata->dormant_spawns, md->bl.id);
+			return 0;
+		}
 		mob->spawn(md);
 	}
 	return 0;
@@ -1279,13 +1289,53 @@ static int mob_ai_sub_hard_activesearch(struct block_list *bl, va_list ap)
 	struct mob_data *md;
 	struct block_list **target;
 	uint32 mode;
-	int dist;
 
 	nullpo_ret(bl);
 	md=va_arg(ap,struct mob_data *);
 	target= va_arg(ap,struct block_list**);
 	mode = va_arg(ap, uint32);
+
+	return mob->ai_sub_hard_activesearch_check(md, bl, target, mode, false);
+}
+
+/**
+ * Checks whether a mob that scans its view range for targets can pick bl:
+ * attack range, line of sight and, with ACTIVEPATHSEARCH, a walk path.
+ * Only reads the map, it's also used by the AI decide phase workers.
+ */
+static bool mob_ai_sub_hard_reachable(struct mob_data *md, struct block_list *bl)
+{
+	nullpo_retr(false, md);
+	nullpo_retr(false, bl);
+
+	if (!battle->check_range(&md->bl, bl, md->db->range2))
+		return false;
+#ifdef ACTIVEPATHSEARCH
+	struct walkpath_data wpd;
+	bool is_standing = (md->ud.walktimer == INVALID_TIMER);
+	if (!path->search(&wpd, &md->bl, md->bl.m, md->bl.x, md->bl.y, bl->x, bl->y, 0, CELL_CHKNOPASS) // Count walk path cells
+	    || (is_standing && wpd.path_len > md->db->range2) //Standing monsters use range2, walking monsters use range3
+	    || (!is_standing && wpd.path_len > md->db->range3)) {
+		if (!check_distance_bl(&md->bl, bl, md->status.rhw.range)
+		    || !path->search_long(NULL, &md->bl, md->bl.m, md->bl.x, md->bl.y, bl->x, bl->y, CELL_CHKWALL))
+			return false;
+	}
+#endif
+	return true;
+}
+
+/**
+ * Target search of a mob: picks bl as target if it's an enemy closer than
+ * the current one.
+ * @param reachable Whether bl is already known to pass mob_ai_sub_hard_reachable
+ * @return 1 if bl was picked
+ */
+static int mob_ai_sub_hard_activesearch_check(struct mob_data *md, struct block_list *bl, struct block_list **target, uint32 mode, bool reachable)
+{
+	int dist;
+
 	nullpo_ret(md);
+	nullpo_ret(bl);
 	nullpo_ret(target);
 
 	//If can't seek yet, not an enemy, or you can't attack it, skip.
@@ -1322,19 +1372,8 @@ static int mob_ai_sub_hard_activesearch(struct block_list *bl, va_list ap)
 			dist = distance_bl(&md->bl, bl);
 			if(
 				((*target) == NULL || !check_distance_bl(&md->bl, *target, dist)) &&
-				battle->check_range(&md->bl,bl,md->db->range2)
+				(reachable || mob->ai_sub_hard_reachable(md, bl))
 			) { //Pick closest target?
-#ifdef ACTIVEPATHSEARCH
-				struct walkpath_data wpd;
-				bool is_standing = (md->ud.walktimer == INVALID_TIMER);
-				if (!path->search(&wpd, &md->bl, md->bl.m, md->bl.x, md->bl.y, bl->x, bl->y, 0, CELL_CHKNOPASS) // Count walk path cells
-				    || (is_standing && wpd.path_len > md->db->range2) //Standing monsters use range2, walking monsters use range3
-				    || (!is_standing && wpd.path_len > md->db->range3)) {
-					if (!check_distance_bl(&md->bl, bl, md->status.rhw.range)
-					    || !path->search_long(NULL, &md->bl, md->bl.m, md->bl.x, md->bl.y, bl->x, bl->y, CELL_CHKWALL))
-						return 0;
-				}
-#endif
 				(*target) = bl;
 				md->target_id=bl->id;
 				md->min_chase= dist + md->db->range3;
@@ -1846,7 +1885,8 @@ static bool mob_ai_sub_hard(struct mob_data *md, int64 tick)
 	}
 
 	if ((!tbl && mode&MD_AGGRESSIVE) || md->state.skillstate == MSS_FOLLOW) {
-		map->foreachinrange(mob->ai_sub_hard_activesearch, &md->bl, view_range, DEFAULT_ENEMY_TYPE(md), md, &tbl, mode);
+		if (!mob->ai_sub_hard_decided(md, tick, view_range, &tbl, mode))
+			map->foreachinrange(mob->ai_sub_hard_activesearch, &md->bl, view_range, DEFAULT_ENEMY_TYPE(md), md, &tbl, mode);
 	} else if ((mode&MD_CHANGECHASE && (md->state.skillstate == MSS_RUSH || md->state.skillstate == MSS_FOLLOW)) || (md->sc.count && md->sc.data[SC__CHAOS])) {
 		int search_size;
 		search_size = view_range<md->status.rhw.range ? view_range:md->status.rhw.range;
@@ -2000,6 +2040,145 @@ static int mob_ai_sub_hard_timer(struct block_list *bl, va_list ap)
 	return 0;
 }
 
+/// Mobs whose think was postponed on previous ticks (@see mob_ai_hard_overdue)
+static struct {
+	struct mob_ai_overdue {
+		int id;
+		int64 last_thinktime;
+	} *list;
+	int count, size;
+} mob_ai_overdue;
+
+/**
+ * Runs the active AI of a mob, counting how long its think was postponed.
+ */
+static void mob_ai_think(struct mob_data *md, int64 tick)
+{
+	nullpo_retv(md);
+
+	if (md->ai_deferred_tick != 0) {
+		int64 deferral = DIFF_TICK(tick, md->ai_deferred_tick);
+
+		if (deferral > mob->ai_stats.max_deferral)
+			mob->ai_stats.max_deferral = deferral;
+		md->ai_deferred_tick = 0;
+	}
+	if (mob->ai_sub_hard(md, tick)) {
+		//Hard AI triggered.
+		if(!md->state.spotted)
+			md->state.spotted = 1;
+		md->last_pcneartime = tick;
+	}
+}
+
+/// Postpones the think of a mob to a later tick.
+static void mob_ai_defer(struct mob_data *md, int64 tick)
+{
+	nullpo_retv(md);
+
+	if (md->ai_deferred_tick == 0)
+		md->ai_deferred_tick = tick;
+	mob->ai_stats.deferred++;
+}
+
+/**
+ * Collects the active mobs whose think was postponed on previous ticks
+ * (their last think is more than one AI interval ago).
+ * Arguments: int64 tick
+ */
+static int mob_ai_sub_hard_overdue(struct block_list *bl, va_list ap)
+{
+	struct mob_data *md = NULL;
+	int64 tick;
+
+	nullpo_ret(bl);
+	Assert_ret(bl->type == BL_MOB);
+	md = BL_UCAST(BL_MOB, bl);
+	tick = va_arg(ap, int64);
+
+	if (DIFF_TICK(tick, md->last_thinktime) < 2 * MIN_MOBTHINKTIME)
+		return 0;
+
+	if (mob_ai_overdue.count == mob_ai_overdue.size) {
+		mob_ai_overdue.size += 256;
+		RECREATE(mob_ai_overdue.list, struct mob_ai_overdue, mob_ai_overdue.size);
+	}
+	mob_ai_overdue.list[mob_ai_overdue.count].id = md->bl.id;
+	mob_ai_overdue.list[mob_ai_overdue.count].last_thinktime = md->last_thinktime;
+	mob_ai_overdue.count++;
+	return 1;
+}
+
+static int mob_ai_overdue_compare(const void *a, const void *b)
+{
+	const struct mob_ai_overdue *oa = a;
+	const struct mob_ai_overdue *ob = b;
+
+	if (oa->last_thinktime != ob->last_thinktime)
+		return oa->last_thinktime < ob->last_thinktime ? -1 : 1;
+	return 0;
+}
+
+/**
+ * Runs the active AI of the mobs whose think was postponed on previous ticks,
+ * the ones that have waited the longest first, until the tick's budget is
+ * spent. Under sustained overload this makes the mobs take turns, so no mob
+ * waits longer than the time it takes to serve all the active ones once.
+ * @return the number of mobs postponed again
+ */
+static int mob_ai_hard_overdue(int64 tick, int64 deadline)
+{
+	int deferred = 0;
+
+	mob_ai_overdue.count = 0;
+	if (map->foreachactivemob(mob->ai_sub_hard_overdue, tick) == 0)
+		return 0;
+	qsort(mob_ai_overdue.list, mob_ai_overdue.count, sizeof(*mob_ai_overdue.list), mob_ai_overdue_compare);
+
+	for (int i = 0; i < mob_ai_overdue.count; i++) {
+		struct mob_data *md = map->id2md(mob_ai_overdue.list[i].id);
+
+		// removed or already served (e.g. respawned) since it was collected
+		if (md == NULL || md->bl.prev == NULL || md->last_thinktime != mob_ai_overdue.list[i].last_thinktime)
+			continue;
+		if (timer->gettick_us() >= deadline) {
+			mob_ai_defer(md, tick);
+			deferred++;
+			continue;
+		}
+		mob_ai_think(md, tick);
+	}
+	return deferred;
+}
+
+/**
+ * Runs the active AI of a mob that wasn't postponed on previous ticks,
+ * unless the tick's budget is spent (@see mob_ai_hard_overdue).
+ * Arguments: int64 tick, int64 deadline (timer->gettick_us)
+ */
+static int mob_ai_sub_hard_budget(struct block_list *bl, va_list ap)
+{
+	struct mob_data *md = NULL;
+	int64 tick, deadline;
+
+	nullpo_ret(bl);
+	Assert_ret(bl->type == BL_MOB);
+	md = BL_UCAST(BL_MOB, bl);
+	tick = va_arg(ap, int64);
+	deadline = va_arg(ap, int64);
+
+	if (DIFF_TICK(tick, md->last_thinktime) >= 2 * MIN_MOBTHINKTIME
+	 || DIFF_TICK(tick, md->last_thinktime) < MIN_MOBTHINKTIME)
+		return 0;
+	if (timer->gettick_us() >= deadline) {
+		mob_ai_defer(md, tick);
+		return 1;
+	}
+
+	mob_ai_think(md, tick);
+	return 0;
+}
+
 /*==========================================
  * Serious processing for mob in PC field of view (foreachclient)
  *------------------------------------------*/
@@ -2025,6 +2204,9 @@ static int mob_ai_sub_lazy(struct mob_data *md, va_list args)
 	if(md->bl.prev == NULL)
 		return 0;
 
+	if (map->list[md->bl.m].dormant)
+		return 0;
+
 	tick = va_arg(args, int64);
 
 	if (battle_config.mob_ai&0x20 && map->list[md->bl.m].users>0)
@@ -2078,29 +2260,491 @@ static int mob_ai_sub_lazy(struct mob_data *md, va_list args)
 	return 0;
 }
 
+/// mob_ai_sub_lazy for map->foreachinmap
+static int mob_ai_sub_lazy_map(struct block_list *bl, va_list args)
+{
+	nullpo_ret(bl);
+	Assert_ret(bl->type == BL_MOB);
+	return mob->ai_sub_lazy(BL_UCAST(BL_MOB, bl), args);
+}
+
 /*==========================================
  * Negligent processing for mob outside PC field of view   (interval timer function)
+ * With dormant maps, only the mobs of the maps that are awake are visited.
  *------------------------------------------*/
 static int mob_ai_lazy(int tid, int64 tick, int id, intptr_t data)
 {
-	map->foreachmob(mob->ai_sub_lazy,tick);
+	if (battle_config.mob_dormant_maps) {
+		for (int m = 0; m < map->count; m++) {
+			if (map->list[m].block_mob != NULL && !map->list[m].dormant)
+				map->foreachinmap(mob->ai_sub_lazy_map, m, BL_MOB, tick);
+		}
+	} else {
+		map->foreachmob(mob->ai_sub_lazy,tick);
+	}
 	return 0;
 }
 
+/**
+ * Stops a mob whose map goes dormant (@see map_sleep_timer).
+ */
+static int mob_sleep_sub(struct block_list *bl, va_list ap)
+{
+	struct mob_data *md = NULL;
+
+	nullpo_ret(bl);
+	Assert_ret(bl->type == BL_MOB);
+	md = BL_UCAST(BL_MOB, bl);
+
+	mob_stop_attack(md);
+	mob_stop_walking(md, STOPWALKING_FLAG_NONE);
+	md->state.skillstate = MSS_IDLE;
+	md->attacked_id = 0;
+	if (md->target_id) {
+		md->target_id = 0;
+		md->ud.target_to = 0;
+		unit->set_target(&md->ud, 0);
+	}
+	return 1;
+}
+
+/**
+ * Catches up the wandering of a mob whose map wakes up (@see map_wakeup):
+ * mobs that would have kept walking around are moved to a random cell of
+ * their spawn area.
+ */
+static int mob_wakeup_sub(struct block_list *bl, va_list ap)
+{
+	struct mob_data *md = NULL;
+	int64 dormant_tick = va_arg(ap, int64);
+	int64 tick = va_arg(ap, int64);
+	int16 x, y;
+
+	nullpo_ret(bl);
+	Assert_ret(bl->type == BL_MOB);
+	md = BL_UCAST(BL_MOB, bl);
+
+	if (!md->state.spotted || md->master_id != 0 || md->spawn == NULL || md->spawn->m != md->bl.m)
+		return 0; // only lazily wandering mobs moved while their map was empty
+	if (DIFF_TICK(tick, dormant_tick) < MIN_RANDOMWALKTIME)
+		return 0;
+	if ((md->spawn->x != 0 || md->spawn->y != 0) && md->spawn->xs == 0 && md->spawn->ys == 0)
+		return 0; // fixed spawn point
+	if ((status_get_mode(&md->bl)&MD_CANMOVE) == 0 || !unit->can_move(&md->bl))
+		return 0;
+
+	x = md->spawn->x;
+	y = md->spawn->y;
+	if (map->search_free_cell(&md->bl, -1, &x, &y, md->spawn->xs, md->spawn->ys, SFC_DEFAULT) != 0)
+		return 0;
+	unit->move_pos(&md->bl, x, y, 0, false);
+	md->next_walktime = tick+rnd()%1000+MIN_RANDOMWALKTIME;
+
+	return 1;
+}
+
+/**
+ * Does the respawn of a mob that was held back while its map was dormant
+ * (@see map_wakeup).
+ * @param id Mob id, from the dormant spawns of the map (it may be gone since)
+ */
+static void mob_wakeup_spawn(int id)
+{
+	struct mob_data *md = map->id2md(id);
+
+	if (md == NULL || !md->state.dormant_spawn || md->bl.prev != NULL)
+		return;
+
+	md->state.dormant_spawn = 0;
+	mob->spawn(md);
+}
+
+/**
+ * Worker pool of the mob AI decide phase.
+ *
+ * Each AI tick, the target search of the active mobs (the area scan, range,
+ * line of sight and walk path checks of mob_ai_sub_hard_activesearch) is done
+ * first, by these workers and the main thread, one map at a time. The world
+ * isn't modified while they run, and they only read it: the decide phase
+ * doesn't allocate memory nor use the map's bl_list.
+ * mob_ai_sub_hard then runs on the main thread as usual (apply phase),
+ * checking the candidates the decide phase found instead of scanning its
+ * area again.
+ */
+static struct {
+	struct thread_handle *threads[MOB_AI_MAX_THREADS];
+	int requested; ///< Number of workers configured when they were started (mob_ai_threads)
+	int count; ///< Number of running workers
+	struct mutex_data *mutex;
+	struct cond_data *work_cond; ///< Signaled when a new decide phase starts
+	struct cond_data *done_cond; ///< Signaled when a worker is done with a decide phase
+	bool running;
+	int generation; ///< Decide phase number
+	int done; ///< Number of workers done with the current decide phase
+	int64 tick; ///< AI tick of the current decide phase
+	struct mob_data **mobs; ///< Mobs of the decide phase, grouped by map
+	int mob_count, mob_size;
+	struct mob_ai_job {
+		int first; ///< Index of the first mob of the map in mobs
+		int count;
+	} *jobs; ///< One per map
+	int job_count, job_size;
+	volatile int32 next_job;
+} mob_ai_workers;
+
+/// Runs the jobs of the current decide phase until there are none left.
+static void mob_ai_decide_jobs(void)
+{
+	int job;
+
+	while ((job = InterlockedIncrement(&mob_ai_workers.next_job) - 1) < mob_ai_workers.job_count) {
+		const struct mob_ai_job *j = &mob_ai_workers.jobs[job];
+		for (int i = j->first; i < j->first + j->count; i++)
+			mob->ai_decide_sub(mob_ai_workers.mobs[i], mob_ai_workers.tick);
+	}
+}
+
+/// Decide phase worker thread.
+static void *mob_ai_worker_main(void *param)
+{
+	int generation = 0;
+
+	mutex->lock(mob_ai_workers.mutex);
+	while (true) {
+		while (mob_ai_workers.running && mob_ai_workers.generation == generation)
+			mutex->cond_wait(mob_ai_workers.work_cond, mob_ai_workers.mutex, -1);
+		if (!mob_ai_workers.running)
+			break;
+		generation = mob_ai_workers.generation;
+		mutex->unlock(mob_ai_workers.mutex);
+
+		mob_ai_decide_jobs();
+
+		mutex->lock(mob_ai_workers.mutex);
+		if (++mob_ai_workers.done == mob_ai_workers.count)
+			mutex->cond_signal(mob_ai_workers.done_cond);
+	}
+	mutex->unlock(mob_ai_workers.mutex);
+	return NULL;
+}
+
+/// Starts count decide phase workers.
+static void mob_ai_workers_start(int count)
+{
+	mob_ai_workers.mutex = mutex->create();
+	mob_ai_workers.work_cond = mutex->cond_create();
+	mob_ai_workers.done_cond = mutex->cond_create();
+	mob_ai_workers.running = true;
+	for (int i = 0; i < count; i++) {
+		if ((mob_ai_workers.threads[i] = thread->create(mob_ai_worker_main, NULL)) == NULL) {
+			ShowError("mob_ai_workers_start: failed to start worker thread %d, the AI will use %d.\n", i, mob_ai_workers.count);
+			break;
+		}
+		mob_ai_workers.count++;
+	}
+}
+
+/// Stops the decide phase workers.
+static void mob_ai_workers_stop(void)
+{
+	if (mob_ai_workers.mutex == NULL)
+		return;
+
+	mutex->lock(mob_ai_workers.mutex);
+	mob_ai_workers.running = false;
+	mutex->cond_broadcast(mob_ai_workers.work_cond);
+	mutex->unlock(mob_ai_workers.mutex);
+	for (int i = 0; i < mob_ai_workers.count; i++)
+		thread->wait(mob_ai_workers.threads[i], NULL);
+
+	mutex->cond_destroy(mob_ai_workers.work_cond);
+	mutex->cond_destroy(mob_ai_workers.done_cond);
+	mutex->destroy(mob_ai_workers.mutex);
+	aFree(mob_ai_workers.mobs);
+	aFree(mob_ai_workers.jobs);
+	memset(&mob_ai_workers, 0, sizeof(mob_ai_workers));
+}
+
+/**
+ * Cheap checks of mob_ai_sub_hard_activesearch_check that only read the
+ * world, done before the (costly) walk path checks of the decide phase.
+ * @return false if bl can't be picked as target
+ */
+static bool mob_ai_decide_filter(struct mob_data *md, struct block_list *bl, uint32 mode)
+{
+	const struct status_change *tsc;
+
+	if (bl == &md->bl || status->isdead(bl))
+		return false;
+	if ((mode&MD_TARGETWEAK) && status->get_lv(bl) >= md->level-5)
+		return false;
+
+	tsc = status->get_sc(bl);
+	if (tsc != NULL && tsc->count > 0 && tsc->data[SC_TRICKDEAD] != NULL)
+		return false;
+	if (bl->type == BL_PC) {
+		const struct map_session_data *tsd = BL_UCCAST(BL_PC, bl);
+		bool is_boss = (mode&MD_BOSS) != 0;
+
+		if (pc_isinvisible(tsd) || (tsd->state.gangsterparadise && !is_boss))
+			return false;
+		if (tsc != NULL && tsc->option&(OPTION_HIDE|OPTION_CLOAK|OPTION_CHASEWALK) && !is_boss
+		 && (tsd->special_state.perfect_hiding || (mode&MD_DETECTOR) == 0 || tsc->data[SC_CLOAKINGEXCEED] != NULL || tsc->data[SC_NEWMOON] != NULL))
+			return false;
+	}
+	return true;
+}
+
+/// Adds a candidate target to the decision of a mob, keeping the nearest ones.
+static void mob_ai_decide_candidate(struct mob_data *md, struct block_list *bl, uint32 mode)
+{
+	struct mob_ai_decision *d = md->ai_decision;
+	int dist, i;
+
+#ifdef CIRCULAR_AREA
+	if (!check_distance_bl(&md->bl, bl, d->view_range))
+		return;
+#endif
+	dist = distance_bl(&md->bl, bl);
+	if (d->count == MOB_AI_MAX_CANDIDATES && dist >= d->dist[d->count - 1]) {
+		d->truncated = true; // farther than the ones kept, and found after them for the same distance
+		return;
+	}
+	if (!mob_ai_decide_filter(md, bl, mode) || !mob->ai_sub_hard_reachable(md, bl))
+		return;
+
+	if (d->count == MOB_AI_MAX_CANDIDATES) {
+		d->truncated = true;
+		d->count--; // drops the farthest
+	}
+	// after the ones at the same distance, in the order of the area scan
+	for (i = d->count; i > 0 && d->dist[i - 1] > dist; i--) {
+		d->id[i] = d->id[i - 1];
+		d->cx[i] = d->cx[i - 1];
+		d->cy[i] = d->cy[i - 1];
+		d->dist[i] = d->dist[i - 1];
+	}
+	d->id[i] = bl->id;
+	d->cx[i] = bl->x;
+	d->cy[i] = bl->y;
+	d->dist[i] = dist;
+	d->count++;
+}
+
+/**
+ * Decide phase of a mob (runs in the AI workers): lists the nearest enemies
+ * in its view range that it can reach (@see struct mob_ai_decision).
+ */
+static void mob_ai_decide_sub(struct mob_data *md, int64 tick)
+{
+	struct mob_ai_decision *d = md->ai_decision;
+	const struct map_data *mapdata = &map->list[md->bl.m];
+	int type = DEFAULT_ENEMY_TYPE(md);
+	uint32 mode = status_get_mode(&md->bl);
+	int x0, y0, x1, y1, bx, by;
+	struct block_list *bl;
+
+	d->tick = tick;
+	d->x = md->bl.x;
+	d->y = md->bl.y;
+	d->view_range = (md->sc.count && md->sc.data[SC_BLIND]) ? 3 : md->db->range2;
+	d->count = 0;
+	d->truncated = false;
+
+	x0 = min(max(d->x - d->view_range, 0), mapdata->xs - 1);
+	y0 = min(max(d->y - d->view_range, 0), mapdata->ys - 1);
+	x1 = min(max(d->x + d->view_range, 0), mapdata->xs - 1);
+	y1 = min(max(d->y + d->view_range, 0), mapdata->ys - 1);
+
+	if (type & ~BL_MOB) {
+		for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+			for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+				for (bl = mapdata->block[bx + by * mapdata->bxs]; bl != NULL; bl = bl->next) {
+					if (bl->type & type && bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1)
+						mob_ai_decide_candidate(md, bl, mode);
+				}
+			}
+		}
+	}
+	if (type & BL_MOB) {
+		for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+			for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+				for (bl = mapdata->block_mob[bx + by * mapdata->bxs]; bl != NULL; bl = bl->next) {
+					if (bl->x >= x0 && bl->x <= x1 && bl->y >= y0 && bl->y <= y1)
+						mob_ai_decide_candidate(md, bl, mode);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Decide phase of the active mob AI: runs the target search of the active
+ * mobs that will look for a target this tick across the AI workers,
+ * partitioned by map.
+ */
+static void mob_ai_decide(int64 tick)
+{
+	if (mob_ai_workers.requested != battle_config.mob_ai_threads) {
+		// fewer may have started, they're only restarted when the setting changes
+		mob->ai_workers_stop();
+		if (battle_config.mob_ai_threads > 0)
+			mob_ai_workers_start(battle_config.mob_ai_threads);
+		mob_ai_workers.requested = battle_config.mob_ai_threads;
+	}
+	if (mob_ai_workers.count == 0)
+		return;
+
+	mob_ai_workers.mob_count = 0;
+	mob_ai_workers.job_count = 0;
+	for (int m = 0; m < map->count; m++) {
+		const struct map_data *mapdata = &map->list[m];
+		int first = mob_ai_workers.mob_count;
+
+		if (mapdata->active_block_count == 0 || mapdata->cell == NULL || mapdata->cell == (struct mapcell *)0xdeadbeaf)
+			continue; // no active mobs, or cells not loaded yet (loaded on first access)
+		for (int i = 0; i < mapdata->active_block_count; i++) {
+			struct block_list *bl;
+
+			for (bl = mapdata->block_mob[mapdata->active_blocks[i]]; bl != NULL; bl = bl->next) {
+				struct mob_data *md = BL_UCAST(BL_MOB, bl);
+
+				// mobs that will search for a target in mob_ai_sub_hard
+				if (md->status.hp == 0 || md->ud.skilltimer != INVALID_TIMER
+				 || DIFF_TICK(tick, md->last_thinktime) < MIN_MOBTHINKTIME)
+					continue;
+				if (md->state.skillstate != MSS_FOLLOW && (md->target_id != 0 || (status_get_mode(&md->bl)&MD_AGGRESSIVE) == 0))
+					continue;
+
+				if (md->ai_decision == NULL)
+					CREATE(md->ai_decision, struct mob_ai_decision, 1);
+				if (mob_ai_workers.mob_count == mob_ai_workers.mob_size) {
+					mob_ai_workers.mob_size += 256;
+					RECREATE(mob_ai_workers.mobs, struct mob_data *, mob_ai_workers.mob_size);
+				}
+				mob_ai_workers.mobs[mob_ai_workers.mob_count++] = md;
+			}
+		}
+		if (mob_ai_workers.mob_count == first)
+			continue;
+		if (mob_ai_workers.job_count == mob_ai_workers.job_size) {
+			mob_ai_workers.job_size += 32;
+			RECREATE(mob_ai_workers.jobs, struct mob_ai_job, mob_ai_workers.job_size);
+		}
+		mob_ai_workers.jobs[mob_ai_workers.job_count].first = first;
+		mob_ai_workers.jobs[mob_ai_workers.job_count].count = mob_ai_workers.mob_count - first;
+		mob_ai_workers.job_count++;
+	}
+	if (mob_ai_workers.job_count == 0)
+		return;
+
+	mutex->lock(mob_ai_workers.mutex);
+	mob_ai_workers.tick = tick;
+	mob_ai_workers.next_job = 0;
+	mob_ai_workers.done = 0;
+	mob_ai_workers.generation++;
+	mutex->cond_broadcast(mob_ai_workers.work_cond);
+	mutex->unlock(mob_ai_workers.mutex);
+
+	mob_ai_decide_jobs(); // the main thread takes part
+
+	mutex->lock(mob_ai_workers.mutex);
+	while (mob_ai_workers.done < mob_ai_workers.count)
+		mutex->cond_wait(mob_ai_workers.done_cond, mob_ai_workers.mutex, -1);
+	mutex->unlock(mob_ai_workers.mutex);
+}
+
+/**
+ * Target search of mob_ai_sub_hard from the candidates of the decide phase.
+ * Candidates that moved since then (e.g. knocked back by an instant skill)
+ * are checked again in full.
+ * @return false when there's no decision for this tick, or when the target
+ *         could be one of the farther enemies the decision didn't keep: the
+ *         area has to be scanned
+ */
+static bool mob_ai_sub_hard_decided(struct mob_data *md, int64 tick, int view_range, struct block_list **target, uint32 mode)
+{
+	const struct mob_ai_decision *d;
+	bool picked = false;
+
+	nullpo_retr(false, md);
+	nullpo_retr(false, target);
+	d = md->ai_decision;
+	if (d == NULL || d->tick != tick || d->view_range != view_range || d->x != md->bl.x || d->y != md->bl.y)
+		return false;
+
+	for (int i = 0; i < d->count; i++) {
+		struct block_list *bl = map->id2bl(d->id[i]);
+		bool moved;
+
+		if (bl == NULL || bl->prev == NULL || bl->m != md->bl.m)
+			continue;
+		moved = (bl->x != d->cx[i] || bl->y != d->cy[i]);
+		if (moved && !check_distance_bl(&md->bl, bl, view_range))
+			continue;
+		if (mob->ai_sub_hard_activesearch_check(md, bl, target, mode, !moved) != 0)
+			picked = true;
+	}
+	// the enemies left out are at least as far as the last candidate
+	if (d->truncated && !picked && (*target == NULL || !check_distance_bl(&md->bl, *target, d->dist[d->count - 1])))
+		return false;
+	return true;
+}
+
 /*==========================================
  * Serious processing for mob in PC field of view   (interval timer function)
+ * Mobs are found through the per-block counters of nearby players kept by
+ * the map, so each one is processed once however many players are around.
  *------------------------------------------*/
 static int mob_ai_hard(int tid, int64 tick, int id, intptr_t data)
 {
+	int64 start = timer->gettick_us();
+	int64 elapsed;
 
-	if (battle_config.mob_ai&0x20)
+	if (battle_config.mob_ai&0x20) {
 		map->foreachmob(mob->ai_sub_lazy,tick);
-	else
-		map->foreachpc(mob->ai_sub_foreachclient,tick);
+	} else if (battle_config.mob_ai_budget == 0) {
+		mob->ai_decide(tick);
+		map->foreachactivemob(mob->ai_sub_hard_timer,tick);
+	} else {
+		int64 deadline = start + battle_config.mob_ai_budget * 1000;
+		int deferred;
+
+		mob->ai_decide(tick);
+		deferred = mob->ai_hard_overdue(tick, deadline);
+		deferred += map->foreachactivemob(mob->ai_sub_hard_budget, tick, deadline);
+		if (deferred > 0)
+			mob->ai_stats.over_budget++;
+	}
+
+	elapsed = timer->gettick_us() - start;
+	mob->ai_stats.runs++;
+	mob->ai_stats.total_us += elapsed;
+	if (elapsed > mob->ai_stats.max_us)
+		mob->ai_stats.max_us = elapsed;
 
 	return 0;
 }
 
+/**
+ * Shows (or resets, with "reset") the statistics of the active mob AI.
+ */
+static void mob_ai_stats_report(const char *args)
+{
+	const struct mob_ai_stats *stats = &mob->ai_stats;
+
+	if (args != NULL && strcmpi(args, "reset") == 0) {
+		memset(&mob->ai_stats, 0, sizeof(mob->ai_stats));
+		ShowInfo("Mob AI statistics reset.\n");
+		return;
+	}
+
+	ShowInfo("Mob AI: %"PRIu64" ticks, avg %"PRIu64" us, max %"PRId64" us (budget: %d ms)\n",
+		stats->runs, stats->runs > 0 ? stats->total_us / stats->runs : 0, stats->max_us, battle_config.mob_ai_budget);
+	ShowInfo("Mob AI: %"PRIu64" ticks over budget, %"PRIu64" thinks postponed, longest by %"PRId64" ms\n",
+		stats->over_budget, stats->deferred, stats->max_deferral);
+}
+
 /**
  * Adds random options of a given options drop group into item.
  *
@@ -6123,6 +6767,10 @@ static void mob_destroy_drop_groups(void)
 static int do_final_mob(void)
 {
 	int i;
+
+	mob->ai_workers_stop();
+	aFree(mob_ai_overdue.list);
+	memset(&mob_ai_overdue, 0, sizeof(mob_ai_overdue));
 	if (mob->dummy)
 	{
 		aFree(mob->dummy);
@@ -6244,6 +6892,12 @@ void mob_defaults(void)
 	mob->can_changetarget = mob_can_changetarget;
 	mob->target = mob_target;
 	mob->ai_sub_hard_activesearch = mob_ai_sub_hard_activesearch;
+	mob->ai_sub_hard_reachable = mob_ai_sub_hard_reachable;
+	mob->ai_sub_hard_activesearch_check = mob_ai_sub_hard_activesearch_check;
+	mob->ai_sub_hard_decided = mob_ai_sub_hard_decided;
+	mob->ai_decide = mob_ai_decide;
+	mob->ai_decide_sub = mob_ai_decide_sub;
+	mob->ai_workers_stop = mob_ai_workers_stop;
 	mob->ai_sub_hard_changechase = mob_ai_sub_hard_changechase;
 	mob->ai_sub_hard_bg_ally = mob_ai_sub_hard_bg_ally;
 	mob->ai_sub_hard_lootsearch = mob_ai_sub_hard_lootsearch;
@@ -6255,10 +6909,18 @@ void mob_defaults(void)
 	mob->warpchase = mob_warpchase;
 	mob->ai_sub_hard = mob_ai_sub_hard;
 	mob->ai_sub_hard_timer = mob_ai_sub_hard_timer;
+	mob->ai_sub_hard_overdue = mob_ai_sub_hard_overdue;
+	mob->ai_hard_overdue = mob_ai_hard_overdue;
+	mob->ai_sub_hard_budget = mob_ai_sub_hard_budget;
 	mob->ai_sub_foreachclient = mob_ai_sub_foreachclient;
 	mob->ai_sub_lazy = mob_ai_sub_lazy;
+	mob->ai_sub_lazy_map = mob_ai_sub_lazy_map;
+	mob->sleep_sub = mob_sleep_sub;
+	mob->wakeup_sub = mob_wakeup_sub;
+	mob->wakeup_spawn = mob_wakeup_spawn;
 	mob->ai_lazy = mob_ai_lazy;
 	mob->ai_hard = mob_ai_hard;
+	mob->ai_stats_report = mob_ai_stats_report;
 	mob->setdropitem_options = mob_setdropitem_options;
 	mob->setdropitem = mob_setdropitem;
 	mob->setlootitem = mob_setlootitem;
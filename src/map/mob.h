@@ -41,6 +41,12 @@ struct hplugin_data_store;
 
 //Min time between AI executions
 #define MIN_MOBTHINKTIME 100
+//Distance added on top of 'AREA_SIZE' at which mobs enter active AI mode.
+#define ACTIVE_AI_RANGE 2
+//Max number of worker threads of the mob AI decide phase (mob_ai_threads)
+#define MOB_AI_MAX_THREADS 32
+//Max number of targets the decide phase keeps per mob (the area is scanned again when there are more)
+#define MOB_AI_MAX_CANDIDATES 16
 //Min time before mobs do a check to call nearby friends for help (or for slaves to support their master)
 #define MIN_MOBLINKTIME 1000
 //Min time between random walks
@@ -242,6 +248,7 @@ struct mob_data {
 		unsigned int spotted: 1;
 		unsigned int npc_killmonster: 1; //for new killmonster behavior
 		unsigned int rebirth: 1; // NPC_Rebirth used
+		unsigned int dormant_spawn : 1; ///< Respawn held back until its map wakes up
 		enum MobSkillState skillstate;
 		unsigned char steal_flag; //number of steal tries (to prevent steal exploit on mobs with few items) [Lupus]
 		unsigned char attacked_count; //For rude attacked.
@@ -257,6 +264,8 @@ struct mob_data {
 	int dmg_taken_rate;
 	struct spawn_data *spawn; //Spawn data.
 	int spawn_timer; //Required for Convex Mirror
+	struct mob_ai_decision *ai_decision; ///< Result of the AI decide phase, allocated on first use
+	int64 ai_deferred_tick; ///< AI tick its think was first postponed at (mob_ai_budget), 0 if it isn't
 	struct item *lootitem;
 	int class_;
 	unsigned int tdmg; //Stores total damage given to the mob, for exp calculations. [Skotlex]
@@ -490,6 +499,33 @@ VECTOR_STRUCT_DECL(mob_group, int);
 #define mob_is_gvg(md) (map->list[(md)->bl.m].flag.gvg_castle && ( (md)->class_ == MOBID_EMPELIUM || (md)->class_ == MOBID_BARRICADE || (md)->class_ == MOBID_S_EMPEL_1 || (md)->class_ == MOBID_S_EMPEL_2))
 #define mob_is_treasure(md) (((md)->class_ >= MOBID_TREASURE_BOX1 && (md)->class_ <= MOBID_TREASURE_BOX40) || ((md)->class_ >= MOBID_TREASURE_BOX41 && (md)->class_ <= MOBID_TREASURE_BOX49))
 
+/**
+ * Targets found for a mob by the AI decide phase (@see mob_ai_decide).
+ * Lists the nearest enemies in its view range that it can reach, by
+ * distance, and in the order the area scan of mob_ai_sub_hard would visit
+ * them for the same distance.
+ */
+struct mob_ai_decision {
+	int64 tick; ///< AI tick the decision was made for
+	int16 x, y; ///< Position of the mob
+	int view_range;
+	int count; ///< Number of candidates
+	bool truncated; ///< There were more than MOB_AI_MAX_CANDIDATES, only the nearest were kept
+	int id[MOB_AI_MAX_CANDIDATES];
+	int16 cx[MOB_AI_MAX_CANDIDATES], cy[MOB_AI_MAX_CANDIDATES]; ///< Position of the candidates
+	int dist[MOB_AI_MAX_CANDIDATES]; ///< Distance of the candidates
+};
+
+/// Statistics of the active mob AI (@see mob_ai_hard)
+struct mob_ai_stats {
+	uint64 runs; ///< Number of AI ticks
+	uint64 total_us; ///< Time spent in the AI ticks
+	int64 max_us; ///< Longest AI tick
+	uint64 over_budget; ///< AI ticks that ran out of budget
+	uint64 deferred; ///< Thinks postponed to a later tick
+	int64 max_deferral; ///< Longest time (ms) a think was postponed for
+};
+
 struct mob_interface {
 	// Dynamic mob database, allows saving of memory when there's big gaps in the mob_db [Skotlex]
 	struct mob_db *db_data[MAX_MOB_DB + 1];
@@ -506,6 +542,7 @@ struct mob_interface {
 	int mora[5];
 	struct item_drop_ratio **item_drop_ratio_db;
 	struct DBMap *item_drop_ratio_other_db;
+	struct mob_ai_stats ai_stats;
 	/* */
 	int (*init) (bool mimimal);
 	int (*final) (void);
@@ -558,10 +595,24 @@ struct mob_interface {
 	int (*warpchase) (struct mob_data *md, struct block_list *target);
 	bool (*ai_sub_hard) (struct mob_data *md, int64 tick);
 	int (*ai_sub_hard_timer) (struct block_list *bl, va_list ap);
+	bool (*ai_sub_hard_reachable) (struct mob_data *md, struct block_list *bl);
+	int (*ai_sub_hard_activesearch_check) (struct mob_data *md, struct block_list *bl, struct block_list **target, uint32 mode, bool reachable);
+	bool (*ai_sub_hard_decided) (struct mob_data *md, int64 tick, int view_range, struct block_list **target, uint32 mode);
+	void (*ai_decide) (int64 tick);
+	void (*ai_decide_sub) (struct mob_data *md, int64 tick);
+	void (*ai_workers_stop) (void);
+	int (*ai_sub_hard_overdue) (struct block_list *bl, va_list ap);
+	int (*ai_hard_overdue) (int64 tick, int64 deadline);
+	int (*ai_sub_hard_budget) (struct block_list *bl, va_list ap);
 	int (*ai_sub_foreachclient) (struct map_session_data *sd, va_list ap);
 	int (*ai_sub_lazy) (struct mob_data *md, va_list args);
+	int (*ai_sub_lazy_map) (struct block_list *bl, va_list args);
+	int (*sleep_sub) (struct block_list *bl, va_list ap);
+	int (*wakeup_sub) (struct block_list *bl, va_list ap);
+	void (*wakeup_spawn) (int id);
 	int (*ai_lazy) (int tid, int64 tick, int id, intptr_t data);
 	int (*ai_hard) (int tid, int64 tick, int id, intptr_t data);
+	void (*ai_stats_report) (const char *args);
 	void (*setdropitem_options) (struct item *item, struct optdrop_group *options);
 	struct item_drop* (*setdropitem) (int nameid, struct optdrop_group *options, int qty, struct item_data *data);
 	struct item_drop* (*setlootitem) (struct item *item);
@@ -188,11 +188,13 @@ static bool path_search_long(struct shootpath_data *spd, struct block_list *bl,
 /// @{
 
 /// Pushes path_node to the binary node_heap.
-/// Ensures there is enough space in array to store new element.
-static void heap_push_node(struct node_heap *heap, struct path_node *node)
+/// The heap has a fixed capacity (see path_search), returns 1 when it's full.
+static int heap_push_node(struct node_heap *heap, struct path_node *node)
 {
-	BHEAP_ENSURE(*heap, 1, 256);
+	if (BHEAP_LENGTH(*heap) >= VECTOR_CAPACITY(*heap))
+		return 1;
 	BHEAP_PUSH2(*heap, node, NODE_MINTOPCMP, swap_ptr);
+	return 0;
 }
 
 /// Updates path_node in the binary node_heap.
@@ -221,7 +223,8 @@ static int add_path(struct node_heap *heap, struct path_node *tp, int16 x, int16
 			tp[i].parent = parent;
 			tp[i].f_cost = g_cost + h_cost;
 			if (tp[i].flag == SET_CLOSED) {
-				heap_push_node(heap, &tp[i]); // Put it in open set again
+				if (heap_push_node(heap, &tp[i])) // Put it in open set again
+					return 1;
 			}
 			else if (heap_update_node(heap, &tp[i])) {
 				return 1;
@@ -241,8 +244,7 @@ static int add_path(struct node_heap *heap, struct path_node *tp, int16 x, int16
 	tp[i].parent = parent;
 	tp[i].f_cost = g_cost + h_cost;
 	tp[i].flag = SET_OPEN;
-	heap_push_node(heap, &tp[i]);
-	return 0;
+	return heap_push_node(heap, &tp[i]);
 }
 ///@}
 
@@ -322,12 +324,15 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 		// We always use A* for finding walkpaths because it is what game client uses.
 		// Easy pathfinding cuts corners of non-walkable cells, but client always walks around it.
 
-		BHEAP_STRUCT_VAR(node_heap, open_set); // 'Open' set
-
 		// FIXME: This array is too small to ensure all paths shorter than MAX_WALKPATH
 		// can be found without node collision: calc_index(node1) = calc_index(node2).
 		// Figure out more proper size or another way to keep track of known nodes.
 		struct path_node tp[MAX_WALKPATH * MAX_WALKPATH];
+
+		// 'Open' set. A node of tp is never in it twice, so it's kept on the stack:
+		// path_search doesn't allocate memory, and can be used by the mob AI workers.
+		struct path_node *open_nodes[MAX_WALKPATH * MAX_WALKPATH];
+		struct node_heap open_set = { ARRAYLENGTH(open_nodes), 0, open_nodes };
 		struct path_node *current, *it;
 		int xs = md->xs - 1;
 		int ys = md->ys - 1;
@@ -360,7 +365,6 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 			int g_cost;
 
 			if (BHEAP_LENGTH(open_set) == 0) {
-				BHEAP_CLEAR(open_set);
 				return false;
 			}
 
@@ -374,7 +378,6 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 			current->flag = SET_CLOSED; // Add current node to 'closed' set
 
 			if (x == x1 && y == y1) {
-				BHEAP_CLEAR(open_set);
 				break;
 			}
 
@@ -403,7 +406,6 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 				e += add_path(&open_set, tp, x, y-1, g_cost + MOVE_COST, current, heuristic(x, y-1, x1, y1)); // (x, y-1) 4
 #undef chk_dir
 			if (e) {
-				BHEAP_CLEAR(open_set);
 				return false;
 			}
 		}
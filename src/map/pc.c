@@ -106,6 +106,7 @@ static struct map_session_data *pc_get_dummy_sd(void)
 	struct map_session_data *dummy_sd;
 	CREATE(dummy_sd, struct map_session_data, 1);
 	dummy_sd->group = pcg->get_dummy_group(); // map_session_data.group is expected to be non-NULL at all times
+	dummy_sd->pc_list_m = -1;
 	return dummy_sd;
 }
 
@@ -765,6 +766,7 @@ static int pc_setnewpc(struct map_session_data *sd, int account_id, int char_id,
 	sd->battle_status.speed = sd->base_status.speed = DEFAULT_WALK_SPEED;
 	sd->state.warp_clean = 1;
 	sd->catch_target_class = -1;
+	sd->pc_list_m = -1;
 	return 0;
 }
 
@@ -6128,6 +6130,7 @@ static int pc_setpos(struct map_session_data *sd, unsigned short map_index, int
 	sd->bl.y = y;
 	sd->ud.to_x = x;
 	sd->ud.to_y = y;
+	map->addpclist(sd);
 
 	if (sd->status.pet_id > 0 && sd->pd != NULL && sd->pd->pet.intimate > PET_INTIMACY_NONE) {
 		sd->pd->bl.m = map_id;
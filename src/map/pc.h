@@ -297,6 +297,8 @@ struct map_session_data {
 	int cart_weight,cart_num,cart_weight_max;
 	int fd;
 	unsigned short mapindex;
+	struct map_session_data *map_prev, *map_next; ///< Links in the player list of the current map (map_data::pc_list)
+	int16 pc_list_m; ///< Map whose player list the player is linked in, -1 if none
 	unsigned char head_dir; //0: Look forward. 1: Look right, 2: Look left.
 	unsigned int client_tick;
 	int npc_id,areanpc_id,npc_shopid,touching_id; //for script follow scriptoid;   ,npcid
@@ -646,6 +648,9 @@ END_ZEROED_BLOCK;
 	bool vars_ok;
 	bool vars_dirty;
 
+	struct mmo_charstatus *save_snapshot;  ///< Character data last sent to the char-server, base of delta saves (NULL: next save is complete)
+	unsigned int save_snapshot_generation; ///< chrif->save_generation when save_snapshot was taken
+
 	struct {
 		short stage;
 		short prizeIdx;
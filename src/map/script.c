@@ -5045,6 +5045,7 @@ static void run_script_main(struct script_state *st)
 	struct map_session_data *sd;
 	struct script_stack *stack = st->stack;
 	struct npc_data *nd;
+	const char *outer_npc = script->running_npc;
 
 	nullpo_retv(st);
 	script->attach_state(st);
@@ -5057,6 +5058,7 @@ static void run_script_main(struct script_state *st)
 		st->instance_id = map->list[nd->bl.m].instance_id;
 	else
 		st->instance_id = -1;
+	script->running_npc = (nd != NULL) ? nd->exname : NULL;
 
 	if(st->state == RERUNLINE) {
 		script->run_func(st);
@@ -5189,6 +5191,7 @@ static void run_script_main(struct script_state *st)
 			st->state=END;
 		}
 	}
+	script->running_npc = outer_npc;
 
 	if(st->sleep.tick > 0) {
 		//Restore previous script
@@ -850,6 +850,7 @@ struct script_interface {
 	int string_list_pos;
 	/*  */
 	int current_item_id;
+	const char *running_npc; ///< Unique name of the NPC whose script is being run, NULL if none (for the main loop watchdog).
 	/* */
 	struct script_label_entry *labels;
 	int label_count;
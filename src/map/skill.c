@@ -24919,7 +24919,7 @@ static int do_init_skill(bool minimal)
 		return 0;
 
 	skill->group_db = idb_alloc(DB_OPT_BASE);
-	skill->unit_db = idb_alloc(DB_OPT_BASE);
+	skill->unit_db = idb_alloc(DB_OPT_OPEN_ADDRESSING);
 	skill->cd_db = idb_alloc(DB_OPT_BASE);
 	skill->usave_db = idb_alloc(DB_OPT_RELEASE_DATA);
 	skill->bowling_db = idb_alloc(DB_OPT_BASE);
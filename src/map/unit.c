@@ -2780,8 +2780,12 @@ static int unit_remove_map(struct block_list *bl, enum clr_type clrtype, const c
 					map->list[bl->m].name, map->list[bl->m].users,
 					sd->debug_file, sd->debug_line, sd->debug_func, file, line, func);
 					Assert_report(0);
-			} else if (--map->list[bl->m].users == 0 && battle_config.dynamic_mobs) //[Skotlex]
-				map->removemobs(bl->m);
+			} else if (--map->list[bl->m].users == 0) {
+				if (battle_config.dynamic_mobs) //[Skotlex]
+					map->removemobs(bl->m);
+				if (battle_config.mob_dormant_maps)
+					map->sleep(bl->m);
+			}
 			if (!(pc_isinvisible(sd))) {
 				// decrement the number of active pvp players on the map
 				--map->list[bl->m].users_pvp;
@@ -2932,6 +2936,7 @@ static int unit_free(struct block_list *bl, enum clr_type clrtype)
 			struct map_session_data *sd = BL_UCAST(BL_PC, bl);
 
 			sd->state.loggingout = 1;
+			map->delpclist(sd);
 
 			if( status->isdead(bl) )
 				pc->setrestartvalue(sd,2);
@@ -2998,6 +3003,10 @@ static int unit_free(struct block_list *bl, enum clr_type clrtype)
 				sd->quest_log = NULL;
 				sd->num_quests = sd->avail_quests = 0;
 			}
+			if (sd->save_snapshot != NULL) {
+				aFree(sd->save_snapshot);
+				sd->save_snapshot = NULL;
+			}
 			HPM->data_store_destroy(&sd->hdata);
 			break;
 		}
@@ -3073,6 +3082,10 @@ static int unit_free(struct block_list *bl, enum clr_type clrtype)
 				aFree(md->lootitem);
 				md->lootitem=NULL;
 			}
+			if (md->ai_decision != NULL) {
+				aFree(md->ai_decision);
+				md->ai_decision = NULL;
+			}
 			if( md->guardian_data )
 			{
 				struct guild_castle* gc = md->guardian_data->castle;
@@ -0,0 +1,449 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2012-2023 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define HERCULES_CORE
+
+#include "common/cbasetypes.h"
+#include "common/core.h"
+#include "common/db.h"
+#include "common/ers.h"
+#include "common/memmgr.h"
+#include "common/nullpo.h"
+#include "common/showmsg.h"
+#include "common/socket.h"
+#include "common/strlib.h"
+#include "common/sysinfo.h"
+#include "common/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Microbenchmarks for the common/ primitives (DBMap, timers, ERS, memory
+// manager, StringBuf and the socket FIFOs).
+//
+// Every benchmark appends a CSV row to the file given with --bench-output
+// (bench_common.csv by default):
+//   revision,benchmark,population,operations,total_us,ns_per_op
+// so that the results of different builds can be compared line by line.
+// --bench-scale <n> multiplies the number of repetitions of every benchmark.
+//
+
+#define BENCH_DB_POPULATION 100000 ///< Entries in the benchmarked databases (about the size of a busy unit db).
+#define BENCH_DB_LOOKUPS 10 ///< Lookup passes over the whole population.
+#define BENCH_DB_ITERATIONS 10 ///< Iteration passes over the whole population.
+#define BENCH_TIMER_POPULATION 50000 ///< Pending timers (a few per unit on a busy server).
+#define BENCH_TIMER_SPREAD 60000 ///< Timers are due within this many ms.
+#define BENCH_ERS_ENTRIES 10000 ///< Entries allocated from an ERS before freeing them.
+#define BENCH_ERS_ROUNDS 50
+#define BENCH_MALLOC_BYTES (32 * 1024 * 1024) ///< Bytes allocated per memmgr round (limits the batch of big blocks).
+#define BENCH_MALLOC_ENTRIES 10000 ///< Maximum blocks allocated per memmgr round.
+#define BENCH_MALLOC_ROUNDS 20
+#define BENCH_STRBUF_APPENDS 1000 ///< Appends before a StringBuf is cleared (roughly a big query).
+#define BENCH_STRBUF_ROUNDS 1000
+#define BENCH_FIFO_PACKETS 1000000 ///< Packets pushed to / popped from a FIFO.
+#define BENCH_FIFO_FLUSH (64 * 1024) ///< Bytes queued in the WFIFO before it's considered sent.
+
+static char *bench_output = NULL;
+static int bench_scale = 1;
+static FILE *bench_fp = NULL;
+static int64 bench_start_us = 0;
+static volatile intptr_t bench_sink = 0; ///< Keeps the compiler from optimizing the measured work away.
+
+static int bench_int_keys[BENCH_DB_POPULATION];
+static int64 bench_int64_keys[BENCH_DB_POPULATION];
+static char bench_str_keys[BENCH_DB_POPULATION][16];
+
+/// Deterministic pseudo random numbers (xorshift32), so all builds use the same keys.
+static uint32 bench_random(void)
+{
+	static uint32 state = 2463534242U;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static void bench_begin(void)
+{
+	bench_start_us = timer->gettick_us();
+}
+
+static void bench_report(const char *name, int population, int64 operations, int64 elapsed)
+{
+	double ns_per_op = operations > 0 ? (double)elapsed * 1000 / operations : 0;
+
+	ShowMessage("%-32s %10d %12"PRId64" %12.2f ns/op\n", name, population, operations, ns_per_op);
+	fprintf(bench_fp, "%s,%s,%d,%"PRId64",%"PRId64",%.2f\n", sysinfo->vcsrevision_src(), name, population, operations, elapsed, ns_per_op);
+}
+
+static void bench_end(const char *name, int population, int64 operations)
+{
+	bench_report(name, population, operations, timer->gettick_us() - bench_start_us);
+}
+
+static void bench_init_keys(void)
+{
+	int i;
+
+	for (i = 0; i < BENCH_DB_POPULATION; i++) {
+		// ids are sparse (account/char/unit ids), unique items ids have the server id on the high bits
+		bench_int_keys[i] = (int)(bench_random() & 0x7FFFFF00) | (i & 0xFF);
+		bench_int64_keys[i] = ((int64)(i & 0xFF) << 56) | ((int64)bench_random() << 8) | (i & 0xFF);
+		snprintf(bench_str_keys[i], sizeof(bench_str_keys[i]), "key_%08x", (unsigned int)bench_random() ^ (unsigned int)i);
+	}
+}
+
+static union DBKey bench_db_key(enum DBType type, int i)
+{
+	switch (type) {
+	case DB_INT:
+		return DB->i2key(bench_int_keys[i]);
+	case DB_INT64:
+		return DB->i642key(bench_int64_keys[i]);
+	case DB_STRING:
+		return DB->str2key(bench_str_keys[i]);
+	case DB_UINT:
+	case DB_UINT64:
+	case DB_ISTRING:
+		break;
+	}
+	Assert_report(0);
+	return DB->i2key(0);
+}
+
+
+static int bench_db_noop(union DBKey key, struct DBData *data, va_list ap)
+{
+	bench_sink += DB->data2i(data);
+	return 0;
+}
+
+static void bench_db(const char *prefix, enum DBType type, enum DBOptions options, unsigned short maxlen)
+{
+	struct DBMap *db = DB->alloc(__FILE__, __func__, __LINE__, type, options, maxlen);
+	struct DBIterator *iter;
+	struct DBData *data;
+	char name[64];
+	int i, j;
+
+	bench_begin();
+	for (i = 0; i < BENCH_DB_POPULATION; i++)
+		db->put(db, bench_db_key(type, i), DB->i2data(i + 1), NULL);
+	snprintf(name, sizeof(name), "%s.insert", prefix);
+	bench_end(name, db_size(db), BENCH_DB_POPULATION);
+
+	bench_begin();
+	for (j = 0; j < BENCH_DB_LOOKUPS * bench_scale; j++) {
+		for (i = 0; i < BENCH_DB_POPULATION; i++) {
+			if ((data = db->get(db, bench_db_key(type, i))) != NULL)
+				bench_sink += DB->data2i(data);
+		}
+	}
+	snprintf(name, sizeof(name), "%s.lookup", prefix);
+	bench_end(name, db_size(db), (int64)BENCH_DB_LOOKUPS * bench_scale * BENCH_DB_POPULATION);
+
+	bench_begin();
+	for (j = 0; j < BENCH_DB_ITERATIONS * bench_scale; j++) {
+		iter = db_iterator(db);
+		for (data = iter->first(iter, NULL); dbi_exists(iter); data = iter->next(iter, NULL))
+			bench_sink += DB->data2i(data);
+		dbi_destroy(iter);
+	}
+	snprintf(name, sizeof(name), "%s.iterate", prefix);
+	bench_end(name, db_size(db), (int64)BENCH_DB_ITERATIONS * bench_scale * db_size(db));
+
+	bench_begin();
+	for (j = 0; j < BENCH_DB_ITERATIONS * bench_scale; j++)
+		db->foreach(db, bench_db_noop);
+	snprintf(name, sizeof(name), "%s.foreach", prefix);
+	bench_end(name, db_size(db), (int64)BENCH_DB_ITERATIONS * bench_scale * db_size(db));
+
+	bench_begin();
+	for (i = 0; i < BENCH_DB_POPULATION; i++)
+		db->remove(db, bench_db_key(type, i), NULL);
+	snprintf(name, sizeof(name), "%s.remove", prefix);
+	bench_end(name, BENCH_DB_POPULATION, BENCH_DB_POPULATION);
+
+	db_destroy(db);
+}
+
+static int bench_timer_noop(int tid, int64 tick, int id, intptr_t data)
+{
+	bench_sink += data;
+	return 0;
+}
+
+static void bench_timers(void)
+{
+	int *tids = aMalloc(sizeof(*tids) * BENCH_TIMER_POPULATION);
+	int64 tick = timer->gettick_nocache();
+	int64 add_us = 0, delete_us = 0, perform_us = 0, start;
+	int i, j;
+
+	timer->add_func_list(bench_timer_noop, "bench_timer_noop");
+
+	// the timers are executed ahead of the clock, each repetition continues from the last executed tick
+	for (j = 0; j < bench_scale; j++, tick += 2 * BENCH_TIMER_SPREAD + 2) {
+		start = timer->gettick_us();
+		for (i = 0; i < BENCH_TIMER_POPULATION; i++)
+			tids[i] = timer->add(tick + 1 + bench_random() % BENCH_TIMER_SPREAD, bench_timer_noop, i, (intptr_t)i);
+		add_us += timer->gettick_us() - start;
+
+		start = timer->gettick_us();
+		for (i = 0; i < BENCH_TIMER_POPULATION; i++)
+			timer->delete(tids[i], bench_timer_noop);
+		delete_us += timer->gettick_us() - start;
+
+		// deleted timers are only released when they expire
+		timer->perform(tick + BENCH_TIMER_SPREAD + 1);
+
+		for (i = 0; i < BENCH_TIMER_POPULATION; i++)
+			timer->add(tick + BENCH_TIMER_SPREAD + 2 + bench_random() % BENCH_TIMER_SPREAD, bench_timer_noop, i, (intptr_t)i);
+
+		start = timer->gettick_us();
+		timer->perform(tick + 2 * BENCH_TIMER_SPREAD + 2);
+		perform_us += timer->gettick_us() - start;
+	}
+
+	bench_report("timer.add", BENCH_TIMER_POPULATION, (int64)bench_scale * BENCH_TIMER_POPULATION, add_us);
+	bench_report("timer.delete", BENCH_TIMER_POPULATION, (int64)bench_scale * BENCH_TIMER_POPULATION, delete_us);
+	bench_report("timer.perform", BENCH_TIMER_POPULATION, (int64)bench_scale * BENCH_TIMER_POPULATION, perform_us);
+
+	aFree(tids);
+}
+
+static void bench_ers(const char *name, uint32 size)
+{
+	ERS *ers = ers_new(size, "bench_common.c::bench_ers", ERS_OPT_NONE);
+	void **entries = aMalloc(sizeof(*entries) * BENCH_ERS_ENTRIES);
+	char fullname[64];
+	int i, j;
+
+	bench_begin();
+	for (j = 0; j < BENCH_ERS_ROUNDS * bench_scale; j++) {
+		for (i = 0; i < BENCH_ERS_ENTRIES; i++)
+			entries[i] = ers_alloc(ers, char);
+		for (i = 0; i < BENCH_ERS_ENTRIES; i++)
+			ers_free(ers, entries[i]);
+	}
+	snprintf(fullname, sizeof(fullname), "%s.%u", name, size);
+	bench_end(fullname, BENCH_ERS_ENTRIES, (int64)BENCH_ERS_ROUNDS * bench_scale * BENCH_ERS_ENTRIES);
+
+	ers_destroy(ers);
+	aFree(entries);
+}
+
+static void bench_malloc(size_t size)
+{
+	int count = (int)min(BENCH_MALLOC_ENTRIES, BENCH_MALLOC_BYTES / size);
+	void **blocks = aMalloc(sizeof(*blocks) * count);
+	int64 alloc_us = 0, free_us = 0;
+	char name[64];
+	int i, j;
+
+	for (j = 0; j < BENCH_MALLOC_ROUNDS * bench_scale; j++) {
+		int64 start = timer->gettick_us();
+		for (i = 0; i < count; i++)
+			blocks[i] = aMalloc(size);
+		alloc_us += timer->gettick_us() - start;
+
+		start = timer->gettick_us();
+		for (i = 0; i < count; i++)
+			aFree(blocks[i]);
+		free_us += timer->gettick_us() - start;
+	}
+
+	snprintf(name, sizeof(name), "memmgr.malloc.%"PRIuS, size);
+	bench_report(name, count, (int64)BENCH_MALLOC_ROUNDS * bench_scale * count, alloc_us);
+	snprintf(name, sizeof(name), "memmgr.free.%"PRIuS, size);
+	bench_report(name, count, (int64)BENCH_MALLOC_ROUNDS * bench_scale * count, free_us);
+
+	aFree(blocks);
+}
+
+static void bench_strbuf(void)
+{
+	StringBuf buf;
+	int i, j;
+
+	StrBuf->Init(&buf);
+
+	bench_begin();
+	for (j = 0; j < BENCH_STRBUF_ROUNDS * bench_scale; j++) {
+		StrBuf->Clear(&buf);
+		for (i = 0; i < BENCH_STRBUF_APPENDS; i++)
+			StrBuf->AppendStr(&buf, "`char_id`, ");
+	}
+	bench_sink += StrBuf->Length(&buf);
+	bench_end("strbuf.appendstr", BENCH_STRBUF_APPENDS, (int64)BENCH_STRBUF_ROUNDS * bench_scale * BENCH_STRBUF_APPENDS);
+
+	bench_begin();
+	for (j = 0; j < BENCH_STRBUF_ROUNDS * bench_scale; j++) {
+		StrBuf->Clear(&buf);
+		for (i = 0; i < BENCH_STRBUF_APPENDS; i++)
+			StrBuf->Printf(&buf, "('%d','%d'),", i, j);
+	}
+	bench_sink += StrBuf->Length(&buf);
+	bench_end("strbuf.printf", BENCH_STRBUF_APPENDS, (int64)BENCH_STRBUF_ROUNDS * bench_scale * BENCH_STRBUF_APPENDS);
+
+	StrBuf->Destroy(&buf);
+}
+
+static int bench_fifo_noop(int fd)
+{
+	return 0;
+}
+
+static void bench_fifo(void)
+{
+	struct socket_data *s;
+	int64 packets = (int64)BENCH_FIFO_PACKETS * bench_scale;
+	int64 i;
+	size_t fill = 0;
+	int fd;
+
+	// a session without a socket behind it, the buffers are drained by hand
+	for (fd = 1; sockt->session[fd] != NULL; fd++)
+		;
+	sockt->create_session(fd, bench_fifo_noop, bench_fifo_noop, bench_fifo_noop, bench_fifo_noop, bench_fifo_noop);
+	s = sockt->session[fd];
+
+	bench_begin();
+	for (i = 0; i < packets; i++) {
+		int len = 6 + (int)(i % 8) * 8; // typical 6 to 62 bytes packets
+		WFIFOHEAD(fd, len);
+		WFIFOW(fd, 0) = (uint16)(0x0800 + i % 0x100);
+		WFIFOW(fd, 2) = (uint16)len;
+		WFIFOW(fd, 4) = (uint16)i;
+		WFIFOSET(fd, len);
+		if (s->wdata_size >= BENCH_FIFO_FLUSH)
+			s->wdata_size = 0;
+	}
+	bench_end("fifo.wfifo", BENCH_FIFO_FLUSH, packets);
+	s->wdata_size = 0;
+
+	// fill the read buffer with the same kind of packets and parse them over and over
+	sockt->realloc_fifo(fd, BENCH_FIFO_FLUSH, s->max_wdata);
+	for (i = 0; fill + 62 <= BENCH_FIFO_FLUSH; i++) {
+		int len = 6 + (int)(i % 8) * 8;
+		WBUFW(s->rdata, fill) = (uint16)(0x0800 + i % 0x100);
+		WBUFW(s->rdata, fill + 2) = (uint16)len;
+		WBUFW(s->rdata, fill + 4) = (uint16)i;
+		fill += len;
+	}
+
+	bench_begin();
+	for (i = 0; i < packets; ) {
+		s->rdata_size = fill;
+		while (RFIFOREST(fd) >= 4 && i < packets) {
+			int len = RFIFOW(fd, 2);
+			bench_sink += RFIFOW(fd, 0) + RFIFOW(fd, 4);
+			RFIFOSKIP(fd, len);
+			i++;
+		}
+		s->rdata_pos = s->rdata_size; // drop any leftover when the count is reached
+		RFIFOFLUSH(fd);
+	}
+	bench_end("fifo.rfifo", BENCH_FIFO_FLUSH, packets);
+
+	sockt->delete_session(fd);
+}
+
+static CMDLINEARG(benchoutput)
+{
+	aFree(bench_output);
+	bench_output = aStrdup(params);
+	return true;
+}
+
+static CMDLINEARG(benchscale)
+{
+	bench_scale = max(atoi(params), 1);
+	return true;
+}
+
+int do_init(int argc, char **argv)
+{
+	const char *output;
+
+	cmdline->exec(argc, argv, CMDLINE_OPT_NORMAL);
+	output = bench_output != NULL ? bench_output : "bench_common.csv";
+	if ((bench_fp = fopen(output, "w")) == NULL) {
+		ShowFatalError("Unable to open '%s' for writing.\n", output);
+		exit(EXIT_FAILURE);
+	}
+	fprintf(bench_fp, "revision,benchmark,population,operations,total_us,ns_per_op\n");
+
+	ShowStatus("Running common/ benchmarks (scale %d), results in '%s'.\n", bench_scale, output);
+	ShowMessage("%-32s %10s %12s %12s\n", "benchmark", "population", "operations", "time");
+
+	bench_init_keys();
+	bench_db("db.int", DB_INT, DB_OPT_BASE, sizeof(int));
+	bench_db("db.int.open_addressing", DB_INT, DB_OPT_OPEN_ADDRESSING, sizeof(int));
+	bench_db("db.int64", DB_INT64, DB_OPT_BASE, sizeof(int64));
+	bench_db("db.int64.open_addressing", DB_INT64, DB_OPT_OPEN_ADDRESSING, sizeof(int64));
+	bench_db("db.string", DB_STRING, DB_OPT_BASE, sizeof(bench_str_keys[0]));
+	bench_timers();
+	bench_ers("ers", 32);
+	bench_ers("ers", 256);
+	bench_malloc(16);
+	bench_malloc(64);
+	bench_malloc(256);
+	bench_malloc(1024);
+	bench_malloc(4096);
+	bench_malloc(65536);
+	bench_strbuf();
+	bench_fifo();
+
+	fclose(bench_fp);
+	bench_fp = NULL;
+
+	core->runflag = CORE_ST_STOP;
+	return EXIT_SUCCESS;
+}
+
+void do_abort(void)
+{
+}
+
+void set_server_type(void)
+{
+	SERVER_TYPE = SERVER_TYPE_UNKNOWN;
+}
+
+int do_final(void)
+{
+	aFree(bench_output);
+	bench_output = NULL;
+	return EXIT_SUCCESS;
+}
+
+int parse_console(const char *command)
+{
+	return 0;
+}
+
+void cmdline_args_init_local(void)
+{
+	CMDLINEARG_DEF2(bench-output, benchoutput, "File the CSV results are written to (default: bench_common.csv).", CMDLINE_OPT_NORMAL|CMDLINE_OPT_PARAM);
+	CMDLINEARG_DEF2(bench-scale, benchscale, "Multiplies the repetitions of every benchmark.", CMDLINE_OPT_NORMAL|CMDLINE_OPT_PARAM);
+}
@@ -0,0 +1,1510 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2012-2023 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define HERCULES_CORE
+
+#include "common/cbasetypes.h"
+#include "common/conf.h"
+#include "common/core.h"
+#include "common/memmgr.h"
+#include "common/mmo.h"
+#include "common/nullpo.h"
+#include "common/packets.h"
+#include "common/random.h"
+#include "common/showmsg.h"
+#include "common/socket.h"
+#include "common/strlib.h"
+#include "common/sysinfo.h"
+#include "common/timer.h"
+#include "char/packets_hc_struct.h"
+#include "login/packets_ac_struct.h"
+#include "login/packets_ca_struct.h"
+#include "map/mapdefines.h"
+#include "map/packets_struct.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Headless client load generator.
+//
+// Logs bots in through the login, char and map servers using the packet
+// tables of the configured PACKETVER, then makes them walk, attack monsters,
+// cast ground skills, chat and vend while measuring how long the map server
+// takes to answer each action. See doc/bench_map.md.
+//
+
+#define BENCH_MAP_PACKET_POS 20 ///< Same as MAX_PACKET_POS in map/clif.h
+#define BENCH_MAP_MAX_MOBS 32 ///< Monsters in sight remembered by each bot
+#define BENCH_MAP_HISTOGRAM 10000 ///< Latency histogram size (1 ms buckets, the last one holds everything slower)
+#define BENCH_MAP_TIMER_INTERVAL 50 ///< Interval of the main timer (ms)
+#define BENCH_MAP_UNIT_MOB 0x5 ///< CLUT_MOB in map/clif.h
+#define BENCH_MAP_SKILL_VENDING 41 ///< MC_VENDING
+
+/// Measured actions
+enum bench_map_action {
+	BMA_LOGIN,
+	BMA_CHAR_SELECT,
+	BMA_MAP_ENTER,
+	BMA_TICK,
+	BMA_WALK,
+	BMA_ATTACK,
+	BMA_SKILL,
+	BMA_CHAT,
+	BMA_VEND,
+	BMA_MAX
+};
+
+static const char *bench_map_action_name[BMA_MAX] = {
+	"login", "char_select", "map_enter", "tick", "walk", "attack", "skill", "chat", "vend"
+};
+
+enum bench_map_bot_state {
+	BOT_OFFLINE,
+	BOT_LOGIN,  ///< Connected to the login server
+	BOT_CHAR,   ///< Connected to the char server
+	BOT_MAP,    ///< Connected to the map server, waiting for the map to load
+	BOT_ONLINE, ///< On the map
+};
+
+struct bench_map_stats {
+	int64 count;
+	int64 failed;
+	int64 timeouts;
+	int64 sum_us;
+	int64 max_us;
+	int histogram[BENCH_MAP_HISTOGRAM + 1];
+};
+
+struct bench_map_mob {
+	int id;
+	short x, y;
+};
+
+struct bench_map_bot {
+	int index;
+	char userid[NAME_LENGTH];
+	char name[NAME_LENGTH];
+	enum bench_map_bot_state state;
+	int fd;
+	int skip; ///< Raw bytes (account id) to skip before the next packet
+	uint32 account_id;
+	uint32 login_id1;
+	uint32 login_id2;
+	uint32 char_id;
+	uint8 sex;
+	bool char_created;
+	uint32 map_ip;
+	uint16 map_port;
+	short x, y;
+	uint32 crypt_key;
+	int setup_index; ///< Next setup command to send
+	bool vending;
+	int64 vend_close;
+	int64 next_action;
+	int64 next_tick;
+	int64 reconnect;
+	enum bench_map_action pending; ///< Action waiting for an answer (BMA_MAX if none)
+	int64 pending_start_us;
+	int64 pending_deadline;
+	struct bench_map_mob mobs[BENCH_MAP_MAX_MOBS];
+	int mob_count;
+};
+
+/// Session data of the bot connections (so that the bot itself isn't freed with the session)
+struct bench_map_session {
+	int bot_index;
+};
+
+/// Packet handled by the map server, as listed in map/packets.h and the shuffle tables.
+struct bench_map_packet {
+	char func[48];
+	int pos[BENCH_MAP_PACKET_POS];
+	int seq;
+};
+
+/// Ids of the map server packets sent by the bots.
+struct bench_map_packet_ids {
+	int want_to_connection;
+	int load_end_ack;
+	int tick_send;
+	int walk_to_xy;
+	int action_request;
+	int global_message;
+	int get_char_name_request;
+	int use_skill_to_id;
+	int use_skill_to_pos;
+	int open_vending;
+	int close_vending;
+	int restart;
+};
+
+struct bench_map_config {
+	char login_ip[64];
+	uint16 login_port;
+	int bots;
+	char account_prefix[NAME_LENGTH];
+	int account_start;
+	char password[NAME_LENGTH];
+	bool register_accounts;
+	int char_server;
+	int char_slot;
+	bool obfuscation;
+	int login_interval;
+	int reconnect_delay;
+	int duration;
+	int report_interval;
+	int action_interval;
+	int action_timeout;
+	int tick_interval;
+	char output[256];
+	VECTOR_DECL(char *) setup_commands;
+	int weight[BMA_MAX];
+	int walk_range;
+	int skill_id;
+	int skill_level;
+	char chat_message[CHAT_SIZE_MAX];
+	int vend_level;
+	int vend_cart_index;
+	int vend_price;
+	int vend_duration;
+};
+
+static char *bench_map_config_file = NULL;
+static int bench_map_bots_override = 0;
+static struct bench_map_config bench_map_config;
+static struct bench_map_packet bench_map_packets[MAX_PACKET_DB + 1];
+static int bench_map_packet_seq = 0;
+static struct bench_map_packet_ids bench_map_ids;
+static uint32 bench_map_keys[3];
+static struct bench_map_bot *bench_map_bots = NULL;
+static struct bench_map_stats bench_map_stats[BMA_MAX];
+static uint32 bench_map_login_ip = 0;
+static int bench_map_started = 0;
+static int64 bench_map_start_tick = 0;
+static int64 bench_map_next_login = 0;
+static int64 bench_map_next_report = 0;
+static int64 bench_map_disconnects = 0;
+
+/*==========================================
+ * Packet tables
+ *------------------------------------------*/
+
+/**
+ * Registers a packet of the map server packet tables.
+ *
+ * @param id   Packet id.
+ * @param args Stringified arguments of the packet() entry ("clif->pFunc,pos,pos,...").
+ */
+static void bench_map_addpacket(int id, const char *args)
+{
+	struct bench_map_packet *p;
+	const char *sep;
+	int i = 0;
+
+	Assert_retv(id >= MIN_PACKET_DB && id <= MAX_PACKET_DB);
+
+	p = &bench_map_packets[id];
+	memset(p, 0, sizeof(*p));
+	p->seq = ++bench_map_packet_seq;
+
+	if ((sep = strchr(args, ',')) == NULL) {
+		safestrncpy(p->func, args, sizeof(p->func));
+		return;
+	}
+	safestrncpy(p->func, args, min((size_t)(sep - args + 1), sizeof(p->func)));
+	while (sep != NULL && i < BENCH_MAP_PACKET_POS) {
+		p->pos[i++] = (int)strtol(sep + 1, NULL, 0);
+		sep = strchr(sep + 1, ',');
+	}
+}
+
+static void bench_map_loadpackets(void)
+{
+#define packet(id, ...) bench_map_addpacket((id), #__VA_ARGS__)
+#include "map/packets.h"
+#ifdef PACKETVER_ZERO
+#include "map/packets_shuffle_zero.h"
+#elif defined(PACKETVER_RE)
+#include "map/packets_shuffle_re.h"
+#else  // PACKETVER_ZERO
+#include "map/packets_shuffle_main.h"
+#endif  // PACKETVER_ZERO
+#undef packet
+#define packetKeys(a,b,c) do { bench_map_keys[0] = (a); bench_map_keys[1] = (b); bench_map_keys[2] = (c); } while(0)
+#if defined(OBFUSCATIONKEY1) && defined(OBFUSCATIONKEY2) && defined(OBFUSCATIONKEY3)
+	packetKeys(OBFUSCATIONKEY1,OBFUSCATIONKEY2,OBFUSCATIONKEY3);
+#else  // defined(OBFUSCATIONKEY1) && defined(OBFUSCATIONKEY2) && defined(OBFUSCATIONKEY3)
+#ifdef PACKETVER_ZERO
+#include "map/packets_keys_zero.h"
+#else  // PACKETVER_ZERO
+#include "map/packets_keys_main.h"
+#endif  // PACKETVER_ZERO
+#endif  // defined(OBFUSCATIONKEY1) && defined(OBFUSCATIONKEY2) && defined(OBFUSCATIONKEY3)
+#undef packetKeys
+}
+
+/**
+ * Finds the packet the client uses for a map server function.
+ *
+ * When several packets are handled by the same function, the one registered
+ * last (the one of the newest shuffle table) is used.
+ *
+ * @param func Name of the handler, as written in the packet tables.
+ * @return The packet id, or 0 if not available in this packet version.
+ */
+static int bench_map_packet_id(const char *func)
+{
+	int i, id = 0, seq = 0;
+
+	nullpo_ret(func);
+
+	for (i = MIN_PACKET_DB; i <= MAX_PACKET_DB; i++) {
+		if (bench_map_packets[i].seq > seq && strcmp(bench_map_packets[i].func, func) == 0) {
+			id = i;
+			seq = bench_map_packets[i].seq;
+		}
+	}
+	return id;
+}
+
+static int bench_map_packet_pos(int id, int index)
+{
+	Assert_ret(id >= MIN_PACKET_DB && id <= MAX_PACKET_DB);
+	Assert_ret(index >= 0 && index < BENCH_MAP_PACKET_POS);
+	return bench_map_packets[id].pos[index];
+}
+
+static void bench_map_resolve_packets(void)
+{
+	struct {
+		int *id;
+		const char *func;
+		bool required;
+	} list[] = {
+		{ &bench_map_ids.want_to_connection, "clif->pWantToConnection", true },
+		{ &bench_map_ids.load_end_ack, "clif->pLoadEndAck", true },
+		{ &bench_map_ids.tick_send, "clif->pTickSend", true },
+		{ &bench_map_ids.walk_to_xy, "clif->pWalkToXY", false },
+		{ &bench_map_ids.action_request, "clif->pActionRequest", false },
+		{ &bench_map_ids.global_message, "clif->pGlobalMessage", false },
+		{ &bench_map_ids.get_char_name_request, "clif->pGetCharNameRequest", false },
+		{ &bench_map_ids.use_skill_to_id, "clif->pUseSkillToId", false },
+		{ &bench_map_ids.use_skill_to_pos, "clif->pUseSkillToPos", false },
+		{ &bench_map_ids.open_vending, "clif->pOpenVending", false },
+		{ &bench_map_ids.close_vending, "clif->pCloseVending", false },
+		{ &bench_map_ids.restart, "clif->pRestart", false },
+	};
+	int i;
+
+	bench_map_loadpackets();
+
+	for (i = 0; i < ARRAYLENGTH(list); i++) {
+		*list[i].id = bench_map_packet_id(list[i].func);
+		if (*list[i].id != 0 && packets->db[*list[i].id] != 0)
+			continue;
+		if (list[i].required) {
+			ShowFatalError("bench_map: no packet for %s in this packet version.\n", list[i].func);
+			exit(EXIT_FAILURE);
+		}
+		ShowWarning("bench_map: no packet for %s in this packet version, the actions using it are disabled.\n", list[i].func);
+		*list[i].id = 0;
+	}
+}
+
+/*==========================================
+ * Statistics
+ *------------------------------------------*/
+
+static void bench_map_stats_add(enum bench_map_action action, int64 elapsed_us, bool failed)
+{
+	struct bench_map_stats *stats;
+
+	Assert_retv(action >= 0 && action < BMA_MAX);
+	stats = &bench_map_stats[action];
+
+	stats->count++;
+	if (failed)
+		stats->failed++;
+	stats->sum_us += elapsed_us;
+	stats->max_us = max(stats->max_us, elapsed_us);
+	stats->histogram[min(elapsed_us / 1000, BENCH_MAP_HISTOGRAM)]++;
+}
+
+/// Returns the latency (ms) under which the given permille of the answers arrived.
+static int bench_map_stats_percentile(const struct bench_map_stats *stats, int permille)
+{
+	int64 target, seen = 0;
+	int i;
+
+	nullpo_ret(stats);
+	if (stats->count == 0)
+		return 0;
+
+	target = (stats->count * permille + 999) / 1000;
+	for (i = 0; i < BENCH_MAP_HISTOGRAM; i++) {
+		seen += stats->histogram[i];
+		if (seen >= target)
+			break;
+	}
+	return i + 1;
+}
+
+static void bench_map_begin(struct bench_map_bot *bot, enum bench_map_action action)
+{
+	nullpo_retv(bot);
+
+	bot->pending = action;
+	bot->pending_start_us = timer->gettick_us();
+	bot->pending_deadline = timer->gettick() + bench_map_config.action_timeout;
+}
+
+/// Records the answer to the pending action, if it's the expected one.
+static void bench_map_end(struct bench_map_bot *bot, enum bench_map_action action, bool failed)
+{
+	nullpo_retv(bot);
+
+	if (bot->pending != action)
+		return;
+	bench_map_stats_add(action, timer->gettick_us() - bot->pending_start_us, failed);
+	bot->pending = BMA_MAX;
+}
+
+static void bench_map_report(void)
+{
+	int online = 0, i;
+
+	for (i = 0; i < bench_map_config.bots; i++) {
+		if (bench_map_bots[i].state == BOT_ONLINE)
+			online++;
+	}
+
+	ShowInfo("bench_map: %d/%d bots online, %"PRId64" disconnections, %"PRId64" seconds elapsed.\n",
+	         online, bench_map_config.bots, bench_map_disconnects, DIFF_TICK(timer->gettick(), bench_map_start_tick) / 1000);
+	ShowMessage("%-12s %10s %8s %8s %10s %8s %8s %8s\n", "action", "count", "failed", "timeout", "avg ms", "p50 ms", "p99 ms", "max ms");
+	for (i = 0; i < BMA_MAX; i++) {
+		const struct bench_map_stats *stats = &bench_map_stats[i];
+		if (stats->count == 0 && stats->timeouts == 0)
+			continue;
+		ShowMessage("%-12s %10"PRId64" %8"PRId64" %8"PRId64" %10.2f %8d %8d %8.2f\n", bench_map_action_name[i],
+		            stats->count, stats->failed, stats->timeouts, stats->count > 0 ? (double)stats->sum_us / stats->count / 1000 : 0.,
+		            bench_map_stats_percentile(stats, 500), bench_map_stats_percentile(stats, 990), (double)stats->max_us / 1000);
+	}
+}
+
+static void bench_map_write_results(void)
+{
+	FILE *fp;
+	int i;
+
+	if (bench_map_config.output[0] == '\0')
+		return;
+
+	if ((fp = fopen(bench_map_config.output, "w")) == NULL) {
+		ShowError("bench_map: unable to open '%s' for writing.\n", bench_map_config.output);
+		return;
+	}
+
+	fprintf(fp, "revision,action,count,failed,timeouts,avg_ms,p50_ms,p99_ms,max_ms\n");
+	for (i = 0; i < BMA_MAX; i++) {
+		const struct bench_map_stats *stats = &bench_map_stats[i];
+		fprintf(fp, "%s,%s,%"PRId64",%"PRId64",%"PRId64",%.3f,%d,%d,%.3f\n", sysinfo->vcsrevision_src(), bench_map_action_name[i],
+		        stats->count, stats->failed, stats->timeouts, stats->count > 0 ? (double)stats->sum_us / stats->count / 1000 : 0.,
+		        bench_map_stats_percentile(stats, 500), bench_map_stats_percentile(stats, 990), (double)stats->max_us / 1000);
+	}
+	fclose(fp);
+	ShowStatus("bench_map: results written to '%s'.\n", bench_map_config.output);
+}
+
+/*==========================================
+ * Connections
+ *------------------------------------------*/
+
+static int bench_map_parse(int fd);
+
+static struct bench_map_bot *bench_map_fd2bot(int fd)
+{
+	const struct bench_map_session *session;
+	struct bench_map_bot *bot;
+
+	if (!sockt->session_is_valid(fd) || (session = sockt->session[fd]->session_data) == NULL)
+		return NULL;
+	bot = &bench_map_bots[session->bot_index];
+	if (bot->fd != fd)
+		return NULL; // connection the bot already moved away from
+	return bot;
+}
+
+/// Connects a bot to a server, closing its previous connection.
+static bool bench_map_connect(struct bench_map_bot *bot, uint32 ip, uint16 port, enum bench_map_bot_state state)
+{
+	struct bench_map_session *session;
+	int fd;
+
+	nullpo_retr(false, bot);
+
+	if (bot->fd > 0 && sockt->session_is_valid(bot->fd))
+		sockt->eof(bot->fd);
+	bot->fd = 0;
+
+	if ((fd = sockt->make_connection(ip, port, NULL)) == -1) {
+		ShowError("bench_map: bot '%s' could not connect to %u.%u.%u.%u:%u.\n", bot->userid, CONVIP(ip), port);
+		return false;
+	}
+
+	CREATE(session, struct bench_map_session, 1);
+	session->bot_index = bot->index;
+	sockt->session[fd]->session_data = session;
+	sockt->session[fd]->func_parse = bench_map_parse;
+	sockt->session[fd]->flag.validate = 0;
+
+	bot->fd = fd;
+	bot->state = state;
+	bot->skip = 0;
+	return true;
+}
+
+/// Drops the bot's connection, scheduling a new login.
+static void bench_map_disconnect(struct bench_map_bot *bot, const char *reason)
+{
+	nullpo_retv(bot);
+
+	if (reason != NULL)
+		ShowWarning("bench_map: bot '%s' disconnected: %s.\n", bot->userid, reason);
+	if (bot->fd > 0 && sockt->session_is_valid(bot->fd))
+		sockt->eof(bot->fd);
+	bot->fd = 0;
+	if (bot->pending != BMA_MAX)
+		bench_map_end(bot, bot->pending, true);
+	bot->state = BOT_OFFLINE;
+	bot->vending = false;
+	bot->mob_count = 0;
+	bench_map_disconnects++;
+	if (bench_map_config.reconnect_delay > 0)
+		bot->reconnect = timer->gettick() + bench_map_config.reconnect_delay;
+}
+
+static void bench_map_send_login(struct bench_map_bot *bot)
+{
+	struct PACKET_CA_LOGIN *p;
+	int fd;
+
+	nullpo_retv(bot);
+
+	if (!bench_map_connect(bot, bench_map_login_ip, bench_map_config.login_port, BOT_LOGIN)) {
+		bench_map_disconnect(bot, NULL);
+		return;
+	}
+	fd = bot->fd;
+
+	WFIFOHEAD(fd, sizeof(*p));
+	p = WFIFOP(fd, 0);
+	memset(p, 0, sizeof(*p));
+	p->packet_id = HEADER_CA_LOGIN;
+	p->version = PACKETVER;
+	if (!bench_map_config.register_accounts)
+		safestrncpy(p->id, bot->userid, sizeof(p->id));
+	else if (snprintf(p->id, sizeof(p->id), "%s_M", bot->userid) >= (int)sizeof(p->id))
+		ShowWarning("bench_map: user id '%s' is too long to be registered.\n", bot->userid);
+	safestrncpy(p->password, bench_map_config.password, sizeof(p->password));
+	WFIFOSET(fd, sizeof(*p));
+
+	bench_map_begin(bot, BMA_LOGIN);
+}
+
+/*==========================================
+ * Login and char servers
+ *------------------------------------------*/
+
+static void bench_map_parse_login(struct bench_map_bot *bot, int fd, int cmd, int len)
+{
+	const struct PACKET_AC_ACCEPT_LOGIN *p;
+	int count;
+	uint32 ip;
+	uint16 port;
+
+	nullpo_retv(bot);
+
+	switch (cmd) {
+	case HEADER_AC_ACCEPT_LOGIN:
+	case HEADER_AC_ACCEPT_LOGIN2:
+		p = RFIFOP(fd, 0);
+		count = (len - (int)sizeof(*p)) / (int)sizeof(p->server_list[0]);
+		if (bench_map_config.char_server >= count) {
+			bench_map_end(bot, BMA_LOGIN, true);
+			bench_map_disconnect(bot, "char server not available");
+			return;
+		}
+		bench_map_end(bot, BMA_LOGIN, false);
+		bot->login_id1 = p->auth_code;
+		bot->account_id = p->aid;
+		bot->login_id2 = p->user_level;
+		bot->sex = p->sex;
+		ip = ntohl(p->server_list[bench_map_config.char_server].ip);
+		port = (uint16)p->server_list[bench_map_config.char_server].port;
+
+		if (!bench_map_connect(bot, ip, port, BOT_CHAR)) {
+			bench_map_disconnect(bot, NULL);
+			return;
+		}
+		fd = bot->fd;
+		WFIFOHEAD(fd, 17);
+		WFIFOW(fd, 0) = 0x65;
+		WFIFOL(fd, 2) = bot->account_id;
+		WFIFOL(fd, 6) = bot->login_id1;
+		WFIFOL(fd, 10) = bot->login_id2;
+		WFIFOW(fd, 14) = 0;
+		WFIFOB(fd, 16) = bot->sex;
+		WFIFOSET(fd, 17);
+		bot->skip = 4; // the char server answers with the account id first
+		bench_map_begin(bot, BMA_CHAR_SELECT);
+		break;
+	case HEADER_AC_REFUSE_LOGIN:
+	case HEADER_AC_REFUSE_LOGIN_R2:
+	case HEADER_AC_REFUSE_LOGIN_R3:
+	case HEADER_SC_NOTIFY_BAN:
+		bench_map_end(bot, BMA_LOGIN, true);
+		bench_map_disconnect(bot, "login refused");
+		break;
+	}
+}
+
+static void bench_map_select_char(struct bench_map_bot *bot)
+{
+	nullpo_retv(bot);
+
+	WFIFOHEAD(bot->fd, 3);
+	WFIFOW(bot->fd, 0) = 0x66;
+	WFIFOB(bot->fd, 2) = bench_map_config.char_slot;
+	WFIFOSET(bot->fd, 3);
+}
+
+/// Creates a novice named after the account in the configured slot.
+static void bench_map_create_char(struct bench_map_bot *bot)
+{
+	int fd;
+
+	nullpo_retv(bot);
+	fd = bot->fd;
+	bot->char_created = true;
+
+#if PACKETVER >= 20151001
+	WFIFOHEAD(fd, 36);
+	WFIFOW(fd, 0) = 0xa39;
+	safestrncpy(WFIFOP(fd, 2), bot->userid, NAME_LENGTH);
+	WFIFOB(fd, 26) = bench_map_config.char_slot;
+	WFIFOW(fd, 27) = 1; // hair color
+	WFIFOW(fd, 29) = 1; // hair style
+	WFIFOL(fd, 31) = JOB_NOVICE;
+	WFIFOB(fd, 35) = bot->sex == SEX_FEMALE ? SEX_FEMALE : SEX_MALE;
+	WFIFOSET(fd, 36);
+#elif PACKETVER >= 20120307
+	WFIFOHEAD(fd, 31);
+	WFIFOW(fd, 0) = 0x970;
+	safestrncpy(WFIFOP(fd, 2), bot->userid, NAME_LENGTH);
+	WFIFOB(fd, 26) = bench_map_config.char_slot;
+	WFIFOW(fd, 27) = 1; // hair color
+	WFIFOW(fd, 29) = 1; // hair style
+	WFIFOSET(fd, 31);
+#else
+	WFIFOHEAD(fd, 37);
+	WFIFOW(fd, 0) = 0x67;
+	safestrncpy(WFIFOP(fd, 2), bot->userid, NAME_LENGTH);
+	memset(WFIFOP(fd, 26), 5, 6); // str, agi, vit, int, dex, luk
+	WFIFOB(fd, 32) = bench_map_config.char_slot;
+	WFIFOW(fd, 33) = 1; // hair color
+	WFIFOW(fd, 35) = 1; // hair style
+	WFIFOSET(fd, 37);
+#endif
+}
+
+static void bench_map_parse_char(struct bench_map_bot *bot, int fd, int cmd, int len)
+{
+	nullpo_retv(bot);
+
+	switch (cmd) {
+#if PACKETVER >= 20110309
+	case 0x8b9: // HC_SECOND_PASSWD_LOGIN, sent after the characters list
+		if (RFIFOW(fd, 10) != 0) { // PINCODE_LOGIN_OK
+			bench_map_end(bot, BMA_CHAR_SELECT, true);
+			bench_map_disconnect(bot, "pincode required");
+			return;
+		}
+		bench_map_select_char(bot);
+		break;
+#else
+	case 0x6b: // HC_ACCEPT_ENTER
+		bench_map_select_char(bot);
+		break;
+#endif
+	case 0x6c: // HC_REFUSE_ENTER
+		if (!bot->char_created) {
+			bench_map_create_char(bot);
+			break;
+		}
+		bench_map_end(bot, BMA_CHAR_SELECT, true);
+		bench_map_disconnect(bot, "character selection refused");
+		break;
+	case HEADER_HC_ACCEPT_MAKECHAR:
+		bench_map_select_char(bot);
+		break;
+	case 0x6e: // HC_REFUSE_MAKECHAR
+		bench_map_end(bot, BMA_CHAR_SELECT, true);
+		bench_map_disconnect(bot, "character creation refused");
+		break;
+	case 0x81: // SC_NOTIFY_BAN
+		bench_map_end(bot, BMA_CHAR_SELECT, true);
+		bench_map_disconnect(bot, "refused by the char server");
+		break;
+	case 0x71: // HC_NOTIFY_ZONESVR
+	case 0xac5: // HC_NOTIFY_ZONESVR2
+		bench_map_end(bot, BMA_CHAR_SELECT, false);
+		bot->char_id = RFIFOL(fd, 2);
+		bot->map_ip = ntohl(RFIFOL(fd, 22));
+		bot->map_port = RFIFOW(fd, 26);
+		if (!bench_map_connect(bot, bot->map_ip, bot->map_port, BOT_MAP)) {
+			bench_map_disconnect(bot, NULL);
+			return;
+		}
+		fd = bot->fd;
+		bot->crypt_key = bench_map_keys[0];
+		{
+			int id = bench_map_ids.want_to_connection;
+			int plen = packets->db[id];
+			WFIFOHEAD(fd, plen);
+			memset(WFIFOP(fd, 0), 0, plen);
+			WFIFOW(fd, 0) = id;
+			WFIFOL(fd, bench_map_packet_pos(id, 0)) = bot->account_id;
+			WFIFOL(fd, bench_map_packet_pos(id, 1)) = bot->char_id;
+			WFIFOL(fd, bench_map_packet_pos(id, 2)) = bot->login_id1;
+			WFIFOL(fd, bench_map_packet_pos(id, 3)) = (uint32)timer->gettick();
+			WFIFOB(fd, bench_map_packet_pos(id, 4)) = bot->sex;
+			if (bench_map_config.obfuscation) {
+				bot->crypt_key = bot->crypt_key * bench_map_keys[1] + bench_map_keys[2];
+				WFIFOW(fd, 0) ^= (uint16)((bot->crypt_key >> 16) & 0x7FFF);
+			}
+			WFIFOSET(fd, plen);
+		}
+#if PACKETVER < 20070521
+		bot->skip = 4; // the map server answers with the account id first
+#endif
+		bench_map_begin(bot, BMA_MAP_ENTER);
+		break;
+	}
+}
+
+/*==========================================
+ * Map server
+ *------------------------------------------*/
+
+/// Sends the packet written at the start of the bot's WFIFO, obfuscating its id.
+static void bench_map_send(struct bench_map_bot *bot, int len)
+{
+	nullpo_retv(bot);
+
+	if (bench_map_config.obfuscation) {
+		bot->crypt_key = bot->crypt_key * bench_map_keys[1] + bench_map_keys[2];
+		WFIFOW(bot->fd, 0) ^= (uint16)((bot->crypt_key >> 16) & 0x7FFF);
+	}
+	WFIFOSET(bot->fd, len);
+}
+
+/// Starts a fixed length map server packet, returning its length (0 if not available).
+static int bench_map_packet_head(struct bench_map_bot *bot, int id)
+{
+	int len;
+
+	nullpo_ret(bot);
+	if (id == 0)
+		return 0;
+
+	len = packets->db[id];
+	Assert_ret(len > 0);
+	WFIFOHEAD(bot->fd, len);
+	memset(WFIFOP(bot->fd, 0), 0, len);
+	WFIFOW(bot->fd, 0) = id;
+	return len;
+}
+
+/// Encodes a position the way the client does (see WBUFPOS in map/clif.c).
+static void bench_map_write_pos(uint8 *p, short x, short y, uint8 dir)
+{
+	nullpo_retv(p);
+
+	p[0] = (uint8)(x >> 2);
+	p[1] = (uint8)((x << 6) | ((y >> 4) & 0x3f));
+	p[2] = (uint8)((y << 4) | (dir & 0xf));
+}
+
+static void bench_map_read_pos(const uint8 *p, short *x, short *y)
+{
+	nullpo_retv(p);
+
+	*x = (short)(((p[0] & 0xff) << 2) | (p[1] >> 6));
+	*y = (short)(((p[1] & 0x3f) << 4) | (p[2] >> 4));
+}
+
+/// Reads the destination of a movement (see WBUFPOS2 in map/clif.c).
+static void bench_map_read_pos2(const uint8 *p, short *x, short *y)
+{
+	nullpo_retv(p);
+
+	*x = (short)(((p[2] & 0x0f) << 6) | (p[3] >> 2));
+	*y = (short)(((p[3] & 0x03) << 8) | p[4]);
+}
+
+static void bench_map_send_tick(struct bench_map_bot *bot)
+{
+	int id = bench_map_ids.tick_send;
+	int len;
+
+	nullpo_retv(bot);
+	if ((len = bench_map_packet_head(bot, id)) == 0)
+		return;
+	WFIFOL(bot->fd, bench_map_packet_pos(id, 0)) = (uint32)timer->gettick();
+	bench_map_send(bot, len);
+	bot->next_tick = timer->gettick() + bench_map_config.tick_interval;
+}
+
+static void bench_map_send_chat(struct bench_map_bot *bot, const char *message)
+{
+	int id = bench_map_ids.global_message;
+	int len;
+
+	nullpo_retv(bot);
+	nullpo_retv(message);
+	if (id == 0 || bot->name[0] == '\0')
+		return;
+
+#if PACKETVER >= 20151001
+	len = 4 + (int)strlen(bot->name) + 3 + (int)strlen(message);
+#else
+	len = 4 + (int)strlen(bot->name) + 3 + (int)strlen(message) + 1;
+#endif
+	WFIFOHEAD(bot->fd, len + 1);
+	WFIFOW(bot->fd, 0) = id;
+	WFIFOW(bot->fd, 2) = len;
+	snprintf(WFIFOP(bot->fd, 4), len - 4 + 1, "%s : %s", bot->name, message);
+	bench_map_send(bot, len);
+}
+
+static void bench_map_mob_set(struct bench_map_bot *bot, int id, short x, short y)
+{
+	int i;
+
+	nullpo_retv(bot);
+
+	ARR_FIND(0, bot->mob_count, i, bot->mobs[i].id == id);
+	if (i == bot->mob_count) {
+		if (bot->mob_count == BENCH_MAP_MAX_MOBS)
+			return;
+		bot->mob_count++;
+	}
+	bot->mobs[i].id = id;
+	bot->mobs[i].x = x;
+	bot->mobs[i].y = y;
+}
+
+static void bench_map_mob_remove(struct bench_map_bot *bot, int id)
+{
+	int i;
+
+	nullpo_retv(bot);
+
+	ARR_FIND(0, bot->mob_count, i, bot->mobs[i].id == id);
+	if (i < bot->mob_count)
+		bot->mobs[i] = bot->mobs[--bot->mob_count];
+}
+
+static bool bench_map_is_mob(int objecttype, int job)
+{
+#if PACKETVER >= 20091103
+	return objecttype == BENCH_MAP_UNIT_MOB;
+#else
+	return (job > 1000 && job < 4000) || job >= 20000;
+#endif
+}
+
+/// Loads the map after entering it or being warped.
+static void bench_map_load_end(struct bench_map_bot *bot)
+{
+	int id = bench_map_ids.load_end_ack;
+	int len;
+
+	nullpo_retv(bot);
+
+	bot->mob_count = 0;
+	if ((len = bench_map_packet_head(bot, id)) != 0)
+		bench_map_send(bot, len);
+}
+
+static void bench_map_parse_map(struct bench_map_bot *bot, int fd, int cmd, int len)
+{
+	nullpo_retv(bot);
+
+	switch (cmd) {
+	case authokType: {
+		const struct packet_authok *p = RFIFOP(fd, 0);
+		bench_map_end(bot, BMA_MAP_ENTER, false);
+		bench_map_read_pos(p->PosDir, &bot->x, &bot->y);
+		bot->state = BOT_ONLINE;
+		bot->setup_index = 0;
+		bot->next_action = timer->gettick() + bench_map_config.action_interval;
+		bench_map_load_end(bot);
+		if (bench_map_ids.get_char_name_request != 0) {
+			int nlen = bench_map_packet_head(bot, bench_map_ids.get_char_name_request);
+			WFIFOL(bot->fd, bench_map_packet_pos(bench_map_ids.get_char_name_request, 0)) = bot->account_id;
+			bench_map_send(bot, nlen);
+		}
+		bench_map_send_tick(bot);
+		break;
+	}
+	case 0x74: // ZC_REFUSE_ENTER
+	case 0x81: // SC_NOTIFY_BAN
+		bench_map_end(bot, BMA_MAP_ENTER, true);
+		bench_map_disconnect(bot, "refused by the map server");
+		break;
+	case HEADER_ZC_ACK_REQNAMEALL:
+		if (RFIFOL(fd, 2) == bot->account_id)
+			safestrncpy(bot->name, RFIFOP(fd, 6), NAME_LENGTH);
+		break;
+	case 0x7f: // ZC_NOTIFY_TIME
+		bench_map_end(bot, BMA_TICK, false);
+		break;
+	case 0x87: // ZC_NOTIFY_PLAYERMOVE
+		bench_map_end(bot, BMA_WALK, false);
+		bench_map_read_pos2(RFIFOP(fd, 6), &bot->x, &bot->y);
+		break;
+	case 0x91: // ZC_NPCACK_MAPMOVE
+		bot->x = RFIFOW(fd, 18);
+		bot->y = RFIFOW(fd, 20);
+		bench_map_load_end(bot);
+		break;
+	case idle_unitType:
+	case spawn_unitType: {
+		const struct packet_idle_unit *p = RFIFOP(fd, 0);
+		short x, y;
+#if PACKETVER >= 20091103
+		if (!bench_map_is_mob(p->objecttype, p->job))
+			break;
+#else
+		if (!bench_map_is_mob(0, p->job))
+			break;
+#endif
+		// packet_spawn_unit has the same layout up to the position
+		if (cmd == idle_unitType)
+			bench_map_read_pos(p->PosDir, &x, &y);
+		else
+			bench_map_read_pos(((const struct packet_spawn_unit *)p)->PosDir, &x, &y);
+		bench_map_mob_set(bot, p->GID, x, y);
+		break;
+	}
+	case unit_walkingType: {
+		const struct packet_unit_walking *p = RFIFOP(fd, 0);
+		short x, y;
+#if PACKETVER >= 20071106
+		if (!bench_map_is_mob(p->objecttype, p->job))
+			break;
+#else
+		if (!bench_map_is_mob(0, p->job))
+			break;
+#endif
+		bench_map_read_pos2(p->MoveData, &x, &y);
+		bench_map_mob_set(bot, p->GID, x, y);
+		break;
+	}
+	case 0x80: // ZC_NOTIFY_VANISH
+		if (RFIFOL(fd, 2) == bot->account_id) {
+			if (RFIFOB(fd, 6) == 1 && bench_map_ids.restart != 0) { // died, respawn
+				int rlen = bench_map_packet_head(bot, bench_map_ids.restart);
+				WFIFOB(bot->fd, 2) = 0;
+				bench_map_send(bot, rlen);
+			}
+			break;
+		}
+		bench_map_mob_remove(bot, RFIFOL(fd, 2));
+		break;
+	case damageType: {
+		const struct packet_damage *p = RFIFOP(fd, 0);
+		if (p->GID == bot->account_id)
+			bench_map_end(bot, BMA_ATTACK, false);
+		break;
+	}
+	case 0x139: // ZC_ATTACK_FAILURE_FOR_DISTANCE
+		bench_map_end(bot, BMA_ATTACK, true);
+		break;
+#ifdef HEADER_ZC_USESKILL_ACK
+	case HEADER_ZC_USESKILL_ACK: {
+		const struct PACKET_ZC_USESKILL_ACK *p = RFIFOP(fd, 0);
+		if (p->srcId == bot->account_id)
+			bench_map_end(bot, BMA_SKILL, false);
+		break;
+	}
+#endif
+	case HEADER_ZC_NOTIFY_GROUNDSKILL: {
+		const struct PACKET_ZC_NOTIFY_GROUNDSKILL *p = RFIFOP(fd, 0);
+		if (p->AID == bot->account_id)
+			bench_map_end(bot, BMA_SKILL, false);
+		break;
+	}
+	case HEADER_ZC_ACK_TOUSESKILL:
+		bench_map_end(bot, BMA_SKILL, true);
+		bench_map_end(bot, BMA_VEND, true);
+		break;
+	case 0x8e: // ZC_NOTIFY_PLAYERCHAT
+		bench_map_end(bot, BMA_CHAT, false);
+		break;
+	case 0x12d: // ZC_OPENSTORE
+		if (bot->pending == BMA_VEND && bench_map_ids.open_vending != 0) {
+			int vlen = 85 + 8;
+			WFIFOHEAD(bot->fd, vlen);
+			memset(WFIFOP(bot->fd, 0), 0, vlen);
+			WFIFOW(bot->fd, 0) = bench_map_ids.open_vending;
+			WFIFOW(bot->fd, 2) = vlen;
+			snprintf(WFIFOP(bot->fd, 4), 80, "%s's shop", bot->userid);
+			WFIFOB(bot->fd, 84) = 1;
+			WFIFOW(bot->fd, 85) = bench_map_config.vend_cart_index;
+			WFIFOW(bot->fd, 87) = 1;
+			WFIFOL(bot->fd, 89) = bench_map_config.vend_price;
+			bench_map_send(bot, vlen);
+		}
+		break;
+	case HEADER_ZC_PC_PURCHASE_MYITEMLIST:
+		bench_map_end(bot, BMA_VEND, false);
+		bot->vending = true;
+		bot->vend_close = timer->gettick() + bench_map_config.vend_duration;
+		break;
+	}
+}
+
+static int bench_map_parse(int fd)
+{
+	struct bench_map_bot *bot = bench_map_fd2bot(fd);
+
+	if (sockt->session[fd]->flag.eof) {
+		if (bot != NULL) {
+			bot->fd = 0;
+			bench_map_disconnect(bot, "connection closed by the server");
+		}
+		sockt->close(fd);
+		return 0;
+	}
+
+	if (bot == NULL) {
+		// connection the bot already moved away from
+		sockt->eof(fd);
+		return 0;
+	}
+
+	while (RFIFOREST(fd) > 0 && bot->fd == fd) {
+		int cmd, len;
+
+		if (bot->skip > 0) {
+			int skip = min(bot->skip, (int)RFIFOREST(fd));
+			RFIFOSKIP(fd, skip);
+			bot->skip -= skip;
+			continue;
+		}
+
+		if (RFIFOREST(fd) < 2)
+			return 0;
+		cmd = RFIFOW(fd, 0);
+		if (cmd < MIN_PACKET_DB || cmd > MAX_PACKET_DB || (len = packets->db[cmd]) == 0) {
+			ShowWarning("bench_map: bot '%s' received unknown packet 0x%04x, disconnecting.\n", bot->userid, (unsigned int)cmd);
+			bench_map_disconnect(bot, NULL);
+			return 0;
+		}
+		if (len == -1) {
+			if (RFIFOREST(fd) < 4)
+				return 0;
+			if ((len = RFIFOW(fd, 2)) < 4) {
+				bench_map_disconnect(bot, "invalid packet length");
+				return 0;
+			}
+		}
+		if ((int)RFIFOREST(fd) < len)
+			return 0;
+
+		switch (bot->state) {
+		case BOT_LOGIN:
+			bench_map_parse_login(bot, fd, cmd, len);
+			break;
+		case BOT_CHAR:
+			bench_map_parse_char(bot, fd, cmd, len);
+			break;
+		case BOT_MAP:
+		case BOT_ONLINE:
+			bench_map_parse_map(bot, fd, cmd, len);
+			break;
+		case BOT_OFFLINE:
+			break;
+		}
+
+		if (sockt->session_is_valid(fd))
+			RFIFOSKIP(fd, len);
+	}
+
+	return 0;
+}
+
+/*==========================================
+ * Actions
+ *------------------------------------------*/
+
+static bool bench_map_act_walk(struct bench_map_bot *bot)
+{
+	int id = bench_map_ids.walk_to_xy;
+	int range = max(bench_map_config.walk_range, 1);
+	int len;
+	short x, y;
+
+	nullpo_retr(false, bot);
+	if ((len = bench_map_packet_head(bot, id)) == 0)
+		return false;
+
+	x = (short)max(bot->x + rnd->value(-range, range), 1);
+	y = (short)max(bot->y + rnd->value(-range, range), 1);
+	bench_map_write_pos(WFIFOP(bot->fd, bench_map_packet_pos(id, 0)), x, y, 0);
+	bench_map_send(bot, len);
+	bench_map_begin(bot, BMA_WALK);
+	return true;
+}
+
+static bool bench_map_act_attack(struct bench_map_bot *bot)
+{
+	int id = bench_map_ids.action_request;
+	int len;
+
+	nullpo_retr(false, bot);
+	if (bot->mob_count == 0 || (len = bench_map_packet_head(bot, id)) == 0)
+		return false;
+
+	WFIFOL(bot->fd, bench_map_packet_pos(id, 0)) = bot->mobs[rnd->value(0, bot->mob_count - 1)].id;
+	WFIFOB(bot->fd, bench_map_packet_pos(id, 1)) = 0; // ACT_ATTACK
+	bench_map_send(bot, len);
+	bench_map_begin(bot, BMA_ATTACK);
+	return true;
+}
+
+static bool bench_map_act_skill(struct bench_map_bot *bot)
+{
+	int id = bench_map_ids.use_skill_to_pos;
+	int len;
+
+	nullpo_retr(false, bot);
+	if ((len = bench_map_packet_head(bot, id)) == 0)
+		return false;
+
+	WFIFOW(bot->fd, bench_map_packet_pos(id, 0)) = bench_map_config.skill_level;
+	WFIFOW(bot->fd, bench_map_packet_pos(id, 1)) = bench_map_config.skill_id;
+	WFIFOW(bot->fd, bench_map_packet_pos(id, 2)) = (uint16)max(bot->x + rnd->value(-2, 2), 1);
+	WFIFOW(bot->fd, bench_map_packet_pos(id, 3)) = (uint16)max(bot->y + rnd->value(-2, 2), 1);
+	bench_map_send(bot, len);
+	bench_map_begin(bot, BMA_SKILL);
+	return true;
+}
+
+static bool bench_map_act_chat(struct bench_map_bot *bot)
+{
+	nullpo_retr(false, bot);
+	if (bench_map_ids.global_message == 0 || bot->name[0] == '\0')
+		return false;
+
+	bench_map_send_chat(bot, bench_map_config.chat_message);
+	bench_map_begin(bot, BMA_CHAT);
+	return true;
+}
+
+static bool bench_map_act_vend(struct bench_map_bot *bot)
+{
+	int id = bench_map_ids.use_skill_to_id;
+	int len;
+
+	nullpo_retr(false, bot);
+	if (bot->vending || bench_map_ids.open_vending == 0 || (len = bench_map_packet_head(bot, id)) == 0)
+		return false;
+
+	WFIFOW(bot->fd, bench_map_packet_pos(id, 0)) = bench_map_config.vend_level;
+	WFIFOW(bot->fd, bench_map_packet_pos(id, 1)) = BENCH_MAP_SKILL_VENDING;
+	WFIFOL(bot->fd, bench_map_packet_pos(id, 2)) = bot->account_id;
+	bench_map_send(bot, len);
+	bench_map_begin(bot, BMA_VEND);
+	return true;
+}
+
+/// Picks an action according to the configured weights and performs it.
+static void bench_map_act(struct bench_map_bot *bot)
+{
+	int total = 0, roll, i;
+	bool done = false;
+
+	nullpo_retv(bot);
+
+	for (i = BMA_WALK; i < BMA_MAX; i++)
+		total += bench_map_config.weight[i];
+	if (total <= 0)
+		return;
+
+	roll = rnd->value(0, total - 1);
+	for (i = BMA_WALK; i < BMA_MAX - 1 && roll >= bench_map_config.weight[i]; i++)
+		roll -= bench_map_config.weight[i];
+
+	switch (i) {
+	case BMA_ATTACK:
+		done = bench_map_act_attack(bot);
+		break;
+	case BMA_SKILL:
+		done = bench_map_act_skill(bot);
+		break;
+	case BMA_CHAT:
+		done = bench_map_act_chat(bot);
+		break;
+	case BMA_VEND:
+		done = bench_map_act_vend(bot);
+		break;
+	default:
+		break;
+	}
+	if (!done)
+		bench_map_act_walk(bot);
+}
+
+static void bench_map_bot_think(struct bench_map_bot *bot, int64 tick)
+{
+	nullpo_retv(bot);
+
+	if (bot->state == BOT_OFFLINE) {
+		if (bot->reconnect != 0 && DIFF_TICK(tick, bot->reconnect) >= 0) {
+			bot->reconnect = 0;
+			bench_map_send_login(bot);
+		}
+		return;
+	}
+
+	if (bot->pending != BMA_MAX && DIFF_TICK(tick, bot->pending_deadline) >= 0) {
+		bench_map_stats[bot->pending].timeouts++;
+		if (bot->pending < BMA_TICK) { // stuck while logging in
+			bot->pending = BMA_MAX;
+			bench_map_disconnect(bot, "login timed out");
+			return;
+		}
+		bot->pending = BMA_MAX;
+	}
+
+	if (bot->state != BOT_ONLINE)
+		return;
+
+	if (DIFF_TICK(tick, bot->next_tick) >= 0) {
+		if (bot->pending == BMA_MAX)
+			bench_map_begin(bot, BMA_TICK);
+		bench_map_send_tick(bot);
+	}
+
+	if (bot->vending && DIFF_TICK(tick, bot->vend_close) >= 0) {
+		int len = bench_map_packet_head(bot, bench_map_ids.close_vending);
+		if (len != 0)
+			bench_map_send(bot, len);
+		bot->vending = false;
+	}
+
+	if (bot->pending != BMA_MAX || bot->vending || DIFF_TICK(tick, bot->next_action) < 0)
+		return;
+
+	if (bot->setup_index < VECTOR_LENGTH(bench_map_config.setup_commands)) {
+		if (bot->name[0] != '\0')
+			bench_map_send_chat(bot, VECTOR_INDEX(bench_map_config.setup_commands, bot->setup_index++));
+		bot->next_action = tick + 500;
+		return;
+	}
+
+	bench_map_act(bot);
+	bot->next_action = tick + rnd->value(bench_map_config.action_interval / 2, bench_map_config.action_interval * 3 / 2);
+}
+
+static int bench_map_timer(int tid, int64 tick, int id, intptr_t data)
+{
+	int i;
+
+	while (bench_map_started < bench_map_config.bots && DIFF_TICK(tick, bench_map_next_login) >= 0) {
+		bench_map_send_login(&bench_map_bots[bench_map_started++]);
+		bench_map_next_login += bench_map_config.login_interval;
+	}
+
+	for (i = 0; i < bench_map_started; i++)
+		bench_map_bot_think(&bench_map_bots[i], tick);
+
+	if (DIFF_TICK(tick, bench_map_next_report) >= 0) {
+		bench_map_report();
+		bench_map_next_report = tick + bench_map_config.report_interval * 1000;
+	}
+
+	if (bench_map_config.duration > 0 && DIFF_TICK(tick, bench_map_start_tick) >= (int64)bench_map_config.duration * 1000) {
+		ShowStatus("bench_map: run finished.\n");
+		core->runflag = CORE_ST_STOP;
+	}
+	return 0;
+}
+
+/*==========================================
+ * Configuration
+ *------------------------------------------*/
+
+static void bench_map_config_defaults(void)
+{
+	struct bench_map_config *c = &bench_map_config;
+
+	safestrncpy(c->login_ip, "127.0.0.1", sizeof(c->login_ip));
+	c->login_port = 6900;
+	c->bots = 100;
+	safestrncpy(c->account_prefix, "bot", sizeof(c->account_prefix));
+	c->account_start = 1;
+	safestrncpy(c->password, "botpass", sizeof(c->password));
+	c->register_accounts = false;
+	c->char_server = 0;
+	c->char_slot = 0;
+	c->obfuscation = true;
+	c->login_interval = 100;
+	c->reconnect_delay = 5000;
+	c->duration = 300;
+	c->report_interval = 10;
+	c->action_interval = 1000;
+	c->action_timeout = 5000;
+	c->tick_interval = 12000;
+	safestrncpy(c->output, "log/bench_map.csv", sizeof(c->output));
+	VECTOR_INIT(c->setup_commands);
+	c->weight[BMA_WALK] = 50;
+	c->weight[BMA_ATTACK] = 20;
+	c->weight[BMA_SKILL] = 10;
+	c->weight[BMA_CHAT] = 15;
+	c->weight[BMA_VEND] = 5;
+	c->walk_range = 8;
+	c->skill_id = 83;
+	c->skill_level = 1;
+	safestrncpy(c->chat_message, "Hello from a benchmark bot!", sizeof(c->chat_message));
+	c->vend_level = 1;
+	c->vend_cart_index = 2;
+	c->vend_price = 100;
+	c->vend_duration = 10000;
+}
+
+static void bench_map_config_read_action(struct config_setting_t *actions, enum bench_map_action action)
+{
+	struct config_setting_t *setting;
+
+	if (actions == NULL || (setting = libconfig->setting_get_member(actions, bench_map_action_name[action])) == NULL)
+		return;
+
+	libconfig->setting_lookup_int(setting, "weight", &bench_map_config.weight[action]);
+	switch (action) {
+	case BMA_WALK:
+		libconfig->setting_lookup_int(setting, "range", &bench_map_config.walk_range);
+		break;
+	case BMA_SKILL:
+		libconfig->setting_lookup_int(setting, "id", &bench_map_config.skill_id);
+		libconfig->setting_lookup_int(setting, "level", &bench_map_config.skill_level);
+		break;
+	case BMA_CHAT:
+		libconfig->setting_lookup_mutable_string(setting, "message", bench_map_config.chat_message, sizeof(bench_map_config.chat_message));
+		break;
+	case BMA_VEND:
+		libconfig->setting_lookup_int(setting, "level", &bench_map_config.vend_level);
+		libconfig->setting_lookup_int(setting, "cart_index", &bench_map_config.vend_cart_index);
+		libconfig->setting_lookup_int(setting, "price", &bench_map_config.vend_price);
+		libconfig->setting_lookup_int(setting, "duration", &bench_map_config.vend_duration);
+		break;
+	case BMA_LOGIN:
+	case BMA_CHAR_SELECT:
+	case BMA_MAP_ENTER:
+	case BMA_TICK:
+	case BMA_ATTACK:
+	case BMA_MAX:
+		break;
+	}
+}
+
+static bool bench_map_config_read(const char *filename)
+{
+	struct config_t config;
+	struct config_setting_t *setting, *list;
+	struct bench_map_config *c = &bench_map_config;
+	int i32, i;
+
+	nullpo_retr(false, filename);
+
+	if (!libconfig->load_file(&config, filename))
+		return false;
+
+	if ((setting = libconfig->lookup(&config, "bench_map")) == NULL) {
+		ShowError("bench_map_config_read: bench_map was not found in %s!\n", filename);
+		libconfig->destroy(&config);
+		return false;
+	}
+
+	libconfig->setting_lookup_mutable_string(setting, "login_ip", c->login_ip, sizeof(c->login_ip));
+	if (libconfig->setting_lookup_int(setting, "login_port", &i32) == CONFIG_TRUE)
+		c->login_port = (uint16)i32;
+	libconfig->setting_lookup_int(setting, "bots", &c->bots);
+	libconfig->setting_lookup_mutable_string(setting, "account_prefix", c->account_prefix, sizeof(c->account_prefix));
+	libconfig->setting_lookup_int(setting, "account_start", &c->account_start);
+	libconfig->setting_lookup_mutable_string(setting, "password", c->password, sizeof(c->password));
+	libconfig->setting_lookup_bool_real(setting, "register", &c->register_accounts);
+	libconfig->setting_lookup_int(setting, "char_server", &c->char_server);
+	libconfig->setting_lookup_int(setting, "char_slot", &c->char_slot);
+	libconfig->setting_lookup_bool_real(setting, "obfuscation", &c->obfuscation);
+	libconfig->setting_lookup_int(setting, "login_interval", &c->login_interval);
+	libconfig->setting_lookup_int(setting, "reconnect_delay", &c->reconnect_delay);
+	libconfig->setting_lookup_int(setting, "duration", &c->duration);
+	libconfig->setting_lookup_int(setting, "report_interval", &c->report_interval);
+	libconfig->setting_lookup_int(setting, "action_interval", &c->action_interval);
+	libconfig->setting_lookup_int(setting, "action_timeout", &c->action_timeout);
+	libconfig->setting_lookup_int(setting, "tick_interval", &c->tick_interval);
+	libconfig->setting_lookup_mutable_string(setting, "output", c->output, sizeof(c->output));
+
+	if ((list = libconfig->setting_get_member(setting, "setup_commands")) != NULL) {
+		for (i = 0; i < libconfig->setting_length(list); i++) {
+			const char *command = libconfig->setting_get_string_elem(list, i);
+			if (command == NULL || command[0] == '\0')
+				continue;
+			VECTOR_ENSURE(c->setup_commands, 1, 1);
+			VECTOR_PUSH(c->setup_commands, aStrdup(command));
+		}
+	}
+
+	list = libconfig->setting_get_member(setting, "actions");
+	for (i = BMA_WALK; i < BMA_MAX; i++)
+		bench_map_config_read_action(list, i);
+
+	libconfig->destroy(&config);
+
+	c->bots = max(c->bots, 1);
+	c->login_interval = max(c->login_interval, 0);
+	c->report_interval = max(c->report_interval, 1);
+	c->action_interval = max(c->action_interval, 1);
+	c->action_timeout = max(c->action_timeout, 1);
+	c->tick_interval = max(c->tick_interval, 1000);
+	return true;
+}
+
+/*==========================================
+ * Core
+ *------------------------------------------*/
+
+static CMDLINEARG(benchconfig)
+{
+	aFree(bench_map_config_file);
+	bench_map_config_file = aStrdup(params);
+	return true;
+}
+
+static CMDLINEARG(bots)
+{
+	bench_map_bots_override = max(atoi(params), 1);
+	return true;
+}
+
+int do_init(int argc, char **argv)
+{
+	int64 tick;
+	int i;
+
+	cmdline->exec(argc, argv, CMDLINE_OPT_NORMAL);
+
+	bench_map_config_defaults();
+	if (!bench_map_config_read(bench_map_config_file != NULL ? bench_map_config_file : "conf/bench_map.conf")) {
+		ShowFatalError("bench_map: unable to read the configuration.\n");
+		exit(EXIT_FAILURE);
+	}
+	if (bench_map_bots_override > 0)
+		bench_map_config.bots = bench_map_bots_override;
+
+	bench_map_resolve_packets();
+
+	if ((bench_map_login_ip = sockt->host2ip(bench_map_config.login_ip)) == 0) {
+		ShowFatalError("bench_map: invalid login server address '%s'.\n", bench_map_config.login_ip);
+		exit(EXIT_FAILURE);
+	}
+
+	CREATE(bench_map_bots, struct bench_map_bot, bench_map_config.bots);
+	for (i = 0; i < bench_map_config.bots; i++) {
+		struct bench_map_bot *bot = &bench_map_bots[i];
+		bot->index = i;
+		bot->pending = BMA_MAX;
+		if (snprintf(bot->userid, sizeof(bot->userid), "%s%04d", bench_map_config.account_prefix, bench_map_config.account_start + i) >= (int)sizeof(bot->userid)) {
+			ShowFatalError("bench_map: account_prefix '%s' is too long.\n", bench_map_config.account_prefix);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	ShowStatus("bench_map: %d bots against %s:%u (packet version %d) for %d seconds.\n",
+	           bench_map_config.bots, bench_map_config.login_ip, bench_map_config.login_port, PACKETVER, bench_map_config.duration);
+
+	tick = timer->gettick();
+	bench_map_start_tick = tick;
+	bench_map_next_login = tick;
+	bench_map_next_report = tick + bench_map_config.report_interval * 1000;
+	timer->add_func_list(bench_map_timer, "bench_map_timer");
+	timer->add_interval(tick + BENCH_MAP_TIMER_INTERVAL, bench_map_timer, 0, 0, BENCH_MAP_TIMER_INTERVAL);
+
+	return EXIT_SUCCESS;
+}
+
+void do_abort(void)
+{
+}
+
+void set_server_type(void)
+{
+	SERVER_TYPE = SERVER_TYPE_UNKNOWN;
+}
+
+int do_final(void)
+{
+	int i;
+
+	if (bench_map_bots != NULL) {
+		bench_map_report();
+		bench_map_write_results();
+
+		for (i = 0; i < bench_map_config.bots; i++) {
+			if (bench_map_bots[i].fd > 0 && sockt->session_is_valid(bench_map_bots[i].fd))
+				sockt->close(bench_map_bots[i].fd);
+		}
+		aFree(bench_map_bots);
+		bench_map_bots = NULL;
+	}
+
+	while (VECTOR_LENGTH(bench_map_config.setup_commands) > 0)
+		aFree(VECTOR_POP(bench_map_config.setup_commands));
+	VECTOR_CLEAR(bench_map_config.setup_commands);
+	aFree(bench_map_config_file);
+	bench_map_config_file = NULL;
+	return EXIT_SUCCESS;
+}
+
+int parse_console(const char *command)
+{
+	return 0;
+}
+
+void cmdline_args_init_local(void)
+{
+	CMDLINEARG_DEF2(bench-config, benchconfig, "Alternative bench_map configuration (default: conf/bench_map.conf).", CMDLINE_OPT_NORMAL|CMDLINE_OPT_PARAM);
+	CMDLINEARG_DEF2(bots, bots, "Overrides the number of bots.", CMDLINE_OPT_NORMAL|CMDLINE_OPT_PARAM);
+}
@@ -0,0 +1,245 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2012-2023 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define HERCULES_CORE
+
+#include "common/cbasetypes.h"
+#include "common/core.h"
+#include "common/db.h"
+#include "common/showmsg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Tests the open addressing databases (DB_OPT_OPEN_ADDRESSING): insertion,
+// lookup and removal across the rebuilds of the table, with the deleted
+// markers left by removals.
+//
+
+#define TEST(...) \
+	if (!(__VA_ARGS__)) { \
+		ShowError("  failed: " #__VA_ARGS__ "\n"); \
+		exit(1); \
+	} else { \
+		ShowStatus("  passed: " #__VA_ARGS__ "\n"); \
+	}
+
+/// Checks that the keys [0, count) with (key % modulo) == 0 (0: none) are missing and the others have value key * 3.
+static bool check_keys(struct DBMap *db, int count, int modulo)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		bool removed = (modulo != 0 && i % modulo == 0);
+
+		if (idb_exists(db, i) == removed)
+			return false;
+		if (!removed && idb_iget(db, i) != i * 3)
+			return false;
+	}
+	return true;
+}
+
+/// Counts the entries seen by an iterator.
+static int count_iterated(struct DBMap *db)
+{
+	struct DBIterator *iter = db_iterator(db);
+	int count = 0;
+
+	for (dbi_first(iter); dbi_exists(iter); dbi_next(iter))
+		count++;
+	dbi_destroy(iter);
+	return count;
+}
+
+/// Growth across many rebuilds, then removals leaving deleted markers behind.
+static void test_grow_and_remove(void)
+{
+	const int count = 5000;
+	struct DBMap *db = idb_alloc(DB_OPT_OPEN_ADDRESSING);
+	int i;
+
+	ShowStatus("Testing insertion and removal across the growth of the table.\n");
+
+	for (i = 0; i < count; i++)
+		idb_iput(db, i, i * 3);
+	TEST(db_size(db) == count);
+	TEST(check_keys(db, count, 0));
+
+	// replacing doesn't add entries
+	for (i = 0; i < count; i += 7)
+		idb_iput(db, i, i * 3);
+	TEST(db_size(db) == count);
+
+	for (i = 0; i < count; i += 2)
+		idb_remove(db, i);
+	TEST(db_size(db) == count / 2);
+	TEST(check_keys(db, count, 2));
+	TEST(count_iterated(db) == count / 2);
+
+	// the removed keys are found again once reinserted (over their deleted markers)
+	for (i = 0; i < count; i += 2)
+		idb_iput(db, i, i * 3);
+	TEST(db_size(db) == count);
+	TEST(check_keys(db, count, 0));
+
+	db_destroy(db);
+}
+
+/// Insertions and removals mixed below the growth threshold: the deleted markers alone trigger the rebuilds.
+static void test_deleted_markers(void)
+{
+	const int live = 8;
+	const int rounds = 2000;
+	struct DBMap *db = idb_alloc(DB_OPT_OPEN_ADDRESSING);
+	int i, k;
+
+	ShowStatus("Testing mixed insertions and removals on a small table.\n");
+
+	for (k = 0; k < live; k++)
+		idb_iput(db, k, k * 3);
+
+	// a sliding window of keys: each round adds one key and removes the oldest
+	for (i = 0; i < rounds; i++) {
+		idb_iput(db, live + i, (live + i) * 3);
+		idb_remove(db, i);
+	}
+	TEST(db_size(db) == live);
+	for (k = rounds; k < rounds + live; k++) {
+		if (!idb_exists(db, k) || idb_iget(db, k) != k * 3)
+			break;
+	}
+	TEST(k == rounds + live);
+	for (k = 0; k < rounds; k++) {
+		if (idb_exists(db, k))
+			break;
+	}
+	TEST(k == rounds);
+	TEST(count_iterated(db) == live);
+
+	// keys sharing their low bits follow long probe sequences through the markers
+	for (i = 0; i < 200; i++)
+		idb_iput(db, -(i << 12), i);
+	for (i = 0; i < 200; i += 3)
+		idb_remove(db, -(i << 12));
+	for (i = 0; i < 200; i++) {
+		if (idb_exists(db, -(i << 12)) != (i % 3 != 0))
+			break;
+	}
+	TEST(i == 200);
+
+	db_destroy(db);
+}
+
+/// Removals and insertions while an iterator is alive: the rebuild is postponed until it's destroyed.
+static void test_locked(void)
+{
+	const int count = 100;
+	const int added = 120; // goes over the maximum load of the 256 slots table, without filling it
+	struct DBMap *db = idb_alloc(DB_OPT_OPEN_ADDRESSING);
+	struct DBIterator *iter;
+	int i, seen = 0;
+
+	ShowStatus("Testing removals and insertions while iterating.\n");
+
+	for (i = 0; i < count; i++)
+		idb_iput(db, i, i * 3);
+
+	iter = db_iterator(db);
+	for (dbi_first(iter); dbi_exists(iter); dbi_next(iter)) {
+		seen++;
+		if (seen == 1) {
+			for (i = 0; i < count; i += 2)
+				idb_remove(db, i);
+			for (i = count; i < count + added; i++)
+				idb_iput(db, i, i * 3);
+		}
+	}
+	dbi_destroy(iter);
+	TEST(seen >= count / 2);
+	TEST(db_size(db) == count / 2 + added);
+	TEST(check_keys(db, count, 2));
+
+	for (i = 0; i < count; i += 2)
+		idb_iput(db, i, i * 3);
+	TEST(db_size(db) == count + added);
+	TEST(check_keys(db, count + added, 0));
+	TEST(count_iterated(db) == count + added);
+
+	db_destroy(db);
+}
+
+/// 64 bit keys, whose high bits must be hashed too.
+static void test_int64_keys(void)
+{
+	const int count = 1000;
+	struct DBMap *db = i64db_alloc(DB_OPT_OPEN_ADDRESSING);
+	int i;
+
+	ShowStatus("Testing 64 bit keys.\n");
+
+	for (i = 0; i < count; i++)
+		i64db_iput(db, (int64)i << 32, i);
+	TEST(db_size(db) == count);
+	for (i = 0; i < count; i += 4)
+		i64db_remove(db, (int64)i << 32);
+	for (i = 0; i < count; i++) {
+		if (i64db_exists(db, (int64)i << 32) != (i % 4 != 0) || (i % 4 != 0 && i64db_iget(db, (int64)i << 32) != i))
+			break;
+	}
+	TEST(i == count);
+	TEST(db_size(db) == count - count / 4);
+
+	db_destroy(db);
+}
+
+int do_init(int argc, char **argv)
+{
+	test_grow_and_remove();
+	test_deleted_markers();
+	test_locked();
+	test_int64_keys();
+
+	core->runflag = CORE_ST_STOP;
+	return EXIT_SUCCESS;
+}
+
+void do_abort(void)
+{
+}
+
+void set_server_type(void)
+{
+	SERVER_TYPE = SERVER_TYPE_UNKNOWN;
+}
+
+int do_final(void)
+{
+	ShowStatus("Tests passed.\n");
+
+	return EXIT_SUCCESS;
+}
+
+int parse_console(const char* command)
+{
+	return 0;
+}
+
+void cmdline_args_init_local(void) { }
@@ -0,0 +1,195 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2012-2023 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define HERCULES_CORE
+
+#include "map/mapreg_sql.c"
+
+#include "common/core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Tests the batched writes of permanent global variables against a fake
+// SQL layer whose queries can be made to fail.
+//
+
+#define TEST(...) \
+	if (!(__VA_ARGS__)) { \
+		ShowError("  failed: " #__VA_ARGS__ "\n"); \
+		exit(1); \
+	} else { \
+		ShowStatus("  passed: " #__VA_ARGS__ "\n"); \
+	}
+
+struct map_interface *map;
+struct script_interface *script;
+
+static struct map_interface fake_map;
+static struct script_interface fake_script;
+static struct sql_interface fake_sql;
+static int fake_stmt; ///< Address used as the handle of every statement
+static bool fake_execute_fails = false;
+static int fake_executed_rows = 0; ///< Rows of the successful queries
+static int fake_bound_rows = 0;    ///< Rows bound for the next query
+
+static const char *fake_get_str(int id)
+{
+	return "$test";
+}
+
+static struct SqlStmt *fake_StmtMalloc(struct Sql *sql)
+{
+	return (struct SqlStmt *)&fake_stmt;
+}
+
+static int fake_StmtPrepareStr(struct SqlStmt *self, const char *query)
+{
+	return SQL_SUCCESS;
+}
+
+static int fake_StmtBindParam(struct SqlStmt *self, size_t idx, enum SqlDataType buffer_type, const void *buffer, size_t buffer_len)
+{
+	if (idx % 3 == 0)
+		fake_bound_rows++;
+	return SQL_SUCCESS;
+}
+
+static int fake_StmtExecute(struct SqlStmt *self)
+{
+	int rows = fake_bound_rows;
+
+	fake_bound_rows = 0;
+	if (fake_execute_fails)
+		return SQL_ERROR;
+	fake_executed_rows += rows;
+	return SQL_SUCCESS;
+}
+
+static void fake_StmtFree(struct SqlStmt *self)
+{
+}
+
+static void fake_StmtShowDebug(struct SqlStmt *self, const char *debug_file, const unsigned long debug_line)
+{
+}
+
+/// Counts the variables whose save is pending.
+static int count_pending(void)
+{
+	struct DBIterator *iter = db_iterator(mapreg->regs.vars);
+	struct mapreg_save *var;
+	int count = 0;
+
+	for (var = dbi_first(iter); dbi_exists(iter); var = dbi_next(iter)) {
+		if (var->save)
+			count++;
+	}
+	dbi_destroy(iter);
+	return count;
+}
+
+/// A failed full batch is written again by the next save.
+static void test_failed_full_batch(void)
+{
+	const int count = MAPREG_BATCH_SIZE + 3;
+	struct mapreg_save *vars;
+	int i;
+
+	ShowStatus("Testing a failed full batch.\n");
+
+	CREATE(vars, struct mapreg_save, count);
+	mapreg->regs.vars = i64db_alloc(DB_OPT_BASE);
+	for (i = 0; i < count; i++) {
+		vars[i].uid = reference_uid(1, i);
+		vars[i].u.i = i;
+		mapreg->mark_saved(&vars[i]);
+		i64db_put(mapreg->regs.vars, vars[i].uid, &vars[i]);
+	}
+
+	fake_execute_fails = true;
+	mapreg->save();
+	TEST(fake_executed_rows == 0);
+	TEST(count_pending() == count);
+	TEST(mapreg->dirty);
+
+	fake_execute_fails = false;
+	mapreg->save();
+	TEST(fake_executed_rows == count);
+	TEST(count_pending() == 0);
+	TEST(!mapreg->dirty);
+
+	db_destroy(mapreg->regs.vars);
+	mapreg->regs.vars = NULL;
+	aFree(vars);
+
+	for (i = 0; i <= MAPREG_BATCH_BITS; i++) {
+		if (mapreg_batch_query[MAPREG_UPSERT_NUM][i] != NULL)
+			aFree(mapreg_batch_query[MAPREG_UPSERT_NUM][i]);
+		mapreg_batch_query[MAPREG_UPSERT_NUM][i] = NULL;
+		mapreg_batch_stmt[MAPREG_UPSERT_NUM][i] = NULL;
+	}
+}
+
+int do_init(int argc, char **argv)
+{
+	map = &fake_map;
+	script = &fake_script;
+	script->get_str = fake_get_str;
+
+	fake_sql = *SQL;
+	SQL = &fake_sql;
+	SQL->StmtMalloc = fake_StmtMalloc;
+	SQL->StmtPrepareStr = fake_StmtPrepareStr;
+	SQL->StmtBindParam = fake_StmtBindParam;
+	SQL->StmtExecute = fake_StmtExecute;
+	SQL->StmtFree = fake_StmtFree;
+	SQL->StmtShowDebug_ = fake_StmtShowDebug;
+
+	mapreg_defaults();
+
+	test_failed_full_batch();
+
+	core->runflag = CORE_ST_STOP;
+	return EXIT_SUCCESS;
+}
+
+void do_abort(void)
+{
+}
+
+void set_server_type(void)
+{
+	SERVER_TYPE = SERVER_TYPE_UNKNOWN;
+}
+
+int do_final(void)
+{
+	ShowStatus("Tests passed.\n");
+
+	return EXIT_SUCCESS;
+}
+
+int parse_console(const char* command)
+{
+	return 0;
+}
+
+void cmdline_args_init_local(void) { }